@@ -1,5 +1,6 @@
 #!/usr/bin/env python3
 
+import os
 import pyarrow.parquet as pq
 import numpy as np
 import pandas as pd
@@ -83,3 +84,199 @@ table4 = pa.Table.from_pandas(df4)
 with pq.ParquetWriter('example3.parquet', table4.schema) as writer:
     writer.write_table(table4)
 
+
+# hive partitioned dataset
+hive_schema = pa.schema([('one', pa.int64()),
+                         ('three', pa.string())])
+
+for n, (dt, region, one, three) in enumerate([
+        ('2018-01-01', 'eu', [1, 2], ['foo', 'bar']),
+        ('2018-01-01', 'us', [3, 4], ['baz', 'uno']),
+        ('2018-01-02', 'eu', [5], ['dos']),
+        ('2018-01-03', '__HIVE_DEFAULT_PARTITION__', [6], ['tres'])]):
+    path = 'hive/dt=%s/region=%s' % (dt, region)
+    os.makedirs(path, exist_ok=True)
+    table = pa.Table.from_pydict({'one': one, 'three': three}, schema=hive_schema)
+    pq.write_table(table, '%s/hive_part%d.parquet' % (path, n + 1), version='1.0')
+
+# hive partitioned by an integer key
+for bucket, one in [(1, [1, 2]), (2, [3])]:
+    path = 'hive_int/bucket=%d' % bucket
+    os.makedirs(path, exist_ok=True)
+    table = pa.Table.from_pydict({'one': one}, schema=pa.schema([('one', pa.int64())]))
+    pq.write_table(table, '%s/hive_int_part%d.parquet' % (path, bucket), version='1.0')
+
+# single row group split into pages of ten rows with a page index
+os.makedirs('pages', exist_ok=True)
+pages_table = pa.Table.from_pydict({'id': list(range(100)),
+                                    'name': ['row %02d' % i for i in range(100)]},
+                                   schema=pa.schema([('id', pa.int64()),
+                                                     ('name', pa.string())]))
+pq.write_table(pages_table, 'pages/example_pages.parquet', use_dictionary=False,
+               write_page_index=True, max_rows_per_page=10, write_batch_size=10)
+
+# ids spread over the whole range in every row group, with bloom filters
+os.makedirs('bloom', exist_ok=True)
+bloom_ids = [i * 37 % 100 for i in range(100)]
+bloom_table = pa.Table.from_pydict({'id': bloom_ids,
+                                    'name': ['user_%d' % i for i in bloom_ids]},
+                                   schema=pa.schema([('id', pa.int64()),
+                                                     ('name', pa.string())]))
+pq.write_table(bloom_table, 'bloom/example_bloom.parquet', row_group_size=25,
+               use_dictionary=False,
+               bloom_filter_options={'id': {'ndv': 25, 'fpp': 0.01},
+                                     'name': {'ndv': 25, 'fpp': 0.01}})
+
+# timestamps with fractions of a second, read truncated to whole seconds
+bloom_ts_table = pa.Table.from_pydict(
+    {'ts': [datetime(2018, 1, 1, 10, 0, 0, 500000), datetime(2018, 1, 1, 12, 0, 0),
+            datetime(2018, 1, 1, 9, 0, 0), datetime(2018, 1, 1, 11, 0, 0, 250000)]},
+    schema=pa.schema([('ts', pa.timestamp('ms'))]))
+pq.write_table(bloom_ts_table, 'bloom/example_bloom_ts.parquet', row_group_size=2,
+               use_dictionary=False, bloom_filter_options={'ts': {'ndv': 2, 'fpp': 0.01}})
+
+# few distinct values per row group spanning most of the value range
+os.makedirs('dictionary', exist_ok=True)
+dict_words = [('apple', 'zebra'), ('banana', 'yak'), ('cherry', 'xenon'), ('date', 'wolf')]
+dict_codes = [(1, 100), (2, 99), (3, 98), (4, 97)]
+dict_table = pa.Table.from_pydict(
+    {'code': [dict_codes[rg][i % 2] for rg in range(4) for i in range(10)],
+     'category': [dict_words[rg][i % 2] for rg in range(4) for i in range(10)]},
+    schema=pa.schema([('code', pa.int64()), ('category', pa.string())]))
+pq.write_table(dict_table, 'dictionary/example_dict.parquet', row_group_size=10)
+
+# dictionary too small to hold all the values, the rest is plain encoded
+pq.write_table(dict_table, 'dictionary/example_dict_fallback.parquet', row_group_size=10,
+               dictionary_pagesize_limit=1, write_batch_size=1, data_page_size=1)
+
+# categorical with a dictionary entry no row refers to
+unused_category = pa.DictionaryArray.from_arrays(pa.array([0, 1, 0, 1], pa.int32()),
+                                                 pa.array(['apple', 'banana', 'cherry']))
+pq.write_table(pa.Table.from_arrays([unused_category], names=['category']),
+               'dictionary/example_dict_unused.parquet', store_schema=False)
+
+# dictionary encoded chunk falling back to DELTA_LENGTH_BYTE_ARRAY pages,
+# written by hand as no writer at hand does that, without encoding stats
+# and with the dictionary page listed as PLAIN_DICTIONARY like old writers
+def thrift_varint(n):
+    out = bytearray()
+    while True:
+        if n < 0x80:
+            out.append(n)
+            return bytes(out)
+        out.append((n & 0x7f) | 0x80)
+        n >>= 7
+
+
+def thrift_zigzag(n):
+    return thrift_varint((n << 1) ^ (n >> 63))
+
+
+def thrift_value(ftype, value):
+    if ftype in (5, 6):     # i32, i64
+        return thrift_zigzag(value)
+    if ftype == 8:          # binary
+        return thrift_varint(len(value)) + value
+    if ftype == 9:          # list of (element type, items)
+        etype, items = value
+        header = bytes([(len(items) << 4) | etype]) if len(items) < 15 else \
+            bytes([0xf0 | etype]) + thrift_varint(len(items))
+        return header + b''.join(thrift_value(etype, item) for item in items)
+    if ftype == 12:         # struct of (field id, type, value)
+        return thrift_struct(value)
+    raise ValueError(ftype)
+
+
+def thrift_struct(fields):
+    out, last = bytearray(), 0
+    for fid, ftype, value in fields:
+        out.append(((fid - last) << 4) | ftype)
+        out += thrift_value(ftype, value)
+        last = fid
+    out.append(0)
+    return bytes(out)
+
+
+def delta_page(values):
+    # lengths as DELTA_BINARY_PACKED, all equal so that deltas take no bits
+    assert len(set(map(len, values))) == 1
+    lengths = thrift_varint(128) + thrift_varint(4) + thrift_varint(len(values)) + \
+        thrift_zigzag(len(values[0])) + thrift_zigzag(0) + bytes(4)
+    return lengths + b''.join(values)
+
+
+def page(header, data):
+    return thrift_struct([(1, 5, header[0]), (2, 5, len(data)), (3, 5, len(data)),
+                          (header[1], 12, header[2])]) + data
+
+
+dict_values = [b'aaa', b'bbb']
+delta_values = [b'ccc', b'ddd', b'eee']
+indices = [0, 1, 0]
+dict_data = b''.join(len(v).to_bytes(4, 'little') + v for v in dict_values)
+rle_data = bytes([1]) + b''.join(bytes([2, i]) for i in indices)
+
+body = bytearray(b'PAR1')
+dict_offset = len(body)
+body += page((2, 7, [(1, 5, len(dict_values)), (2, 5, 2)]), dict_data)
+data_offset = len(body)
+body += page((0, 5, [(1, 5, len(indices)), (2, 5, 8), (3, 5, 3), (4, 5, 3)]), rle_data)
+body += page((0, 5, [(1, 5, len(delta_values)), (2, 5, 6), (3, 5, 3), (4, 5, 3)]),
+             delta_page(delta_values))
+chunk_size = len(body) - dict_offset
+num_rows = len(indices) + len(delta_values)
+
+footer = thrift_struct([
+    (1, 5, 1),
+    (2, 9, (12, [[(4, 8, b'schema'), (5, 5, 1)],
+                 [(1, 5, 6), (3, 5, 0), (4, 8, b'category'), (6, 5, 0)]])),
+    (3, 6, num_rows),
+    (4, 9, (12, [[(1, 9, (12, [[(2, 6, dict_offset), (3, 12, [
+        (1, 5, 6), (2, 9, (5, [2, 3, 8, 6])), (3, 9, (8, [b'category'])), (4, 5, 0),
+        (5, 6, num_rows), (6, 6, chunk_size), (7, 6, chunk_size), (9, 6, data_offset),
+        (11, 6, dict_offset), (12, 12, [(3, 6, 0), (5, 8, b'eee'), (6, 8, b'aaa')])])]])),
+                  (2, 6, chunk_size), (3, 6, num_rows)]])),
+    (6, 8, b'parquet-cpp-arrow version 14.0.0'),
+    (7, 9, (12, [[(1, 12, [])]])),
+])
+with open('dictionary/example_dict_delta.parquet', 'wb') as f:
+    f.write(bytes(body) + footer + len(footer).to_bytes(4, 'little') + b'PAR1')
+
+# sorted by id, row groups of 100 rows in pages of 10 rows, other column unsorted
+os.makedirs('lookup', exist_ok=True)
+lookup_table = pa.Table.from_pydict({'id': list(range(1000)),
+                                     'code': [i * 379 % 1000 for i in range(1000)],
+                                     'name': ['name %03d' % i for i in range(1000)]},
+                                    schema=pa.schema([('id', pa.int64()),
+                                                      ('code', pa.int64()),
+                                                      ('name', pa.string())]))
+pq.write_table(lookup_table, 'lookup/example_lookup.parquet', row_group_size=100,
+               use_dictionary=False, write_page_index=True, max_rows_per_page=10,
+               write_batch_size=10)
+
+# events of two sources at alternating minutes, each file sorted by ts in row
+# groups of 5 rows, the row groups of the second file written in reverse order
+os.makedirs('sorted', exist_ok=True)
+events_schema = pa.schema([('ts', pa.timestamp('us')),
+                           ('id', pa.int64()),
+                           ('source', pa.string())])
+for n in range(2):
+    minutes = list(range(n, 40, 2))
+    events_table = pa.Table.from_pydict(
+        {'ts': [datetime(2018, 1, 1, m // 60, m % 60) for m in minutes],
+         'id': minutes,
+         'source': ['source %d' % (n + 1)] * len(minutes)},
+        schema=events_schema)
+    chunks = [events_table.slice(i, 5) for i in range(0, len(minutes), 5)]
+    with pq.ParquetWriter('sorted/events_%d.parquet' % (n + 1), events_schema,
+                          sorting_columns=[pq.SortingColumn(0)]) as writer:
+        for chunk in (chunks if n == 0 else reversed(chunks)):
+            writer.write_table(chunk)
+
+# floats with a NaN in the middle row group of three, row groups of 2 rows
+os.makedirs('nan', exist_ok=True)
+nan_table = pa.Table.from_pydict({'id': list(range(1, 7)),
+                                  'f': [1.0, 2.0, 3.0, float('nan'), 4.0, 5.0]},
+                                 schema=pa.schema([('id', pa.int64()),
+                                                   ('f', pa.float64())]))
+pq.write_table(nan_table, 'nan/example_nan.parquet', row_group_size=2)
@@ -0,0 +1,4 @@
+CREATE FUNCTION invalidate_files_func_cache(func regproc DEFAULT NULL)
+RETURNS INTEGER
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
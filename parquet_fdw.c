@@ -1,6 +1,8 @@
 #include "postgres.h"
 #include "fmgr.h"
 
+#include <float.h>
+
 #include "access/reloptions.h"
 #include "catalog/pg_foreign_table.h"
 #include "commands/defrem.h"
@@ -18,6 +20,17 @@ void _PG_init(void);
 /* FDW routines */
 extern void parquetGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid);
 extern void parquetGetForeignPaths(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid);
+extern void parquetGetForeignUpperPaths(PlannerInfo *     root,
+                                        UpperRelationKind stage,
+                                        RelOptInfo *      input_rel,
+                                        RelOptInfo *      output_rel,
+                                        void *            extra);
+extern void parquetGetForeignJoinPaths(PlannerInfo *      root,
+                                       RelOptInfo *       joinrel,
+                                       RelOptInfo *       outerrel,
+                                       RelOptInfo *       innerrel,
+                                       JoinType           jointype,
+                                       JoinPathExtraData *extra);
 extern ForeignScan *   parquetGetForeignPlan(PlannerInfo *root,
                                              RelOptInfo * baserel,
                                              Oid          foreigntableid,
@@ -54,8 +67,45 @@ extern void  parquetShutdownForeignScan(ForeignScanState *node);
 extern List *parquetImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid);
 extern Datum parquet_fdw_validator_impl(PG_FUNCTION_ARGS);
 
+/* Cost model coefficients */
+extern double parquet_fdw_decompress_cost;
+extern double parquet_fdw_decode_cost;
+
 void _PG_init(void)
 {
+    DefineCustomRealVariable("parquet_fdw.decompress_cost",
+                             "Sets the planner's estimate of the cost of decompressing a page "
+                             "of parquet data with snappy.",
+                             "Other codecs are costed in proportion to their speed.",
+                             &parquet_fdw_decompress_cost,
+                             0.5,
+                             0.0,
+                             DBL_MAX,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomRealVariable("parquet_fdw.decode_cost",
+                             "Sets the planner's estimate of the cost of decoding a value "
+                             "of a parquet column.",
+                             "Strings are costed in proportion to their width.",
+                             &parquet_fdw_decode_cost,
+                             0.001,
+                             0.0,
+                             DBL_MAX,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+#if PG_VERSION_NUM >= 150000
+    MarkGUCPrefixReserved("parquet_fdw");
+#else
+    EmitWarningsOnPlaceholders("parquet_fdw");
+#endif
 }
 
 PG_FUNCTION_INFO_V1(parquet_fdw_validator);
@@ -72,6 +122,8 @@ Datum parquet_fdw_handler(PG_FUNCTION_ARGS)
     fdwroutine->GetForeignRelSize           = parquetGetForeignRelSize;
     fdwroutine->GetForeignPaths             = parquetGetForeignPaths;
     fdwroutine->GetForeignPlan              = parquetGetForeignPlan;
+    fdwroutine->GetForeignUpperPaths        = parquetGetForeignUpperPaths;
+    fdwroutine->GetForeignJoinPaths         = parquetGetForeignJoinPaths;
     fdwroutine->BeginForeignScan            = parquetBeginForeignScan;
     fdwroutine->IterateForeignScan          = parquetIterateForeignScan;
     fdwroutine->ReScanForeignScan           = parquetReScanForeignScan;
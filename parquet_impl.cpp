@@ -13,9 +13,13 @@
 
 #include <sys/stat.h>
 
+#include <algorithm>
+#include <cmath>
 #include <filesystem>
 #include <list>
 #include <mutex>
+#include <numeric>
+#include <random>
 #include <set>
 
 #include "arrow/api.h"
@@ -30,15 +34,19 @@
 extern "C" {
 #include "postgres.h"
 
+#include "access/genam.h"
 #include "access/htup_details.h"
 #include "access/nbtree.h"
 #include "access/parallel.h"
 #include "access/reloptions.h"
 #include "access/sysattr.h"
+#include "catalog/pg_aggregate.h"
 #include "catalog/pg_foreign_table.h"
+#include "catalog/pg_namespace.h"
 #include "catalog/pg_type.h"
 #include "commands/defrem.h"
 #include "commands/explain.h"
+#include "executor/executor.h"
 #include "executor/spi.h"
 #include "executor/tuptable.h"
 #include "foreign/fdwapi.h"
@@ -47,26 +55,39 @@ extern "C" {
 #include "nodes/execnodes.h"
 #include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
 #include "optimizer/cost.h"
 #include "optimizer/pathnode.h"
 #include "optimizer/paths.h"
 #include "optimizer/planmain.h"
 #include "optimizer/restrictinfo.h"
+#include "optimizer/tlist.h"
 #include "parser/parse_coerce.h"
 #include "parser/parse_func.h"
 #include "parser/parse_oper.h"
 #include "parser/parse_type.h"
+#include "rewrite/rewriteManip.h"
 #include "utils/builtins.h"
 #include "utils/date.h"
+#include "utils/inval.h"
+#include "utils/datum.h"
 #include "utils/jsonb.h"
 #include "utils/lsyscache.h"
 #include "utils/memdebug.h"
 #include "utils/memutils.h"
+#include "utils/pg_locale.h"
 #include "utils/regproc.h"
 #include "utils/rel.h"
+#include "utils/ruleutils.h"
+#include "utils/selfuncs.h"
+#include "utils/syscache.h"
 #include "utils/timestamp.h"
 #include "utils/typcache.h"
 
+#if PG_VERSION_NUM >= 150000
+#    include "common/pg_prng.h"
+#endif
+
 #if PG_VERSION_NUM < 120000
 #    include "nodes/relation.h"
 #    include "optimizer/var.h"
@@ -77,12 +98,29 @@ extern "C" {
 #endif
 }
 
+#include "src/CostModel.hpp"
+#include "src/FilesFuncCache.hpp"
 #include "src/FilterPushdown.hpp"
+#include "src/JoinHashTable.hpp"
+#include "src/HivePartitions.hpp"
+#include "src/MetadataAggregates.hpp"
 #include "src/ParquetFdwExecutionState.hpp"
 #include "src/ParquetFdwReader.hpp"
+#include "src/PlanPayload.hpp"
+#include "src/VectorAggregates.hpp"
+#include "src/VectorProjection.hpp"
 #include "src/functions/ConvertCsvToParquet.hpp"
 #include "src/functions/Filesystem.hpp"
 
+/* Default number of files whose footers are read in estimation mode */
+#define DEFAULT_ESTIMATE_SAMPLE_SIZE 100
+
+/*
+ * Fraction of cpu_operator_cost charged per value accumulated by vectorized
+ * aggregates, which do without a transition function call per row
+ */
+#define VECTORIZED_AGG_COST_FRACTION 0.25
+
 /* from costsize.c */
 #define LOG2(x) (log(x) / 0.693147180559945)
 
@@ -91,6 +129,8 @@ extern "C" {
 #endif
 
 static void  destroy_parquet_state(void *arg);
+static void  destroy_aggregate_state(void *arg);
+static void  destroy_join_state(void *arg);
 
 /*
  * Plain C struct for fdw_state
@@ -99,23 +139,136 @@ struct ParquetFdwPlanState
 {
     List *     filenames;
     List *     attrs_sorted;
+    List *     partition_attrs; // hive partition columns
     Bitmapset *attrs_used; // attributes actually used in query
     bool       use_mmap;
+    bool       dictionary_pruning; // check equalities against dictionary pages
+    bool       dictionary_groups;  // take groups from dictionary pages
     uint64_t numTotalRows;
     uint64_t numRowsToRead;
-    size_t numPagesToRead;
+    double numRowsEstimated;     // rows of those satisfying the conditions
+    size_t numPagesToRead;       // compressed pages of the used columns
+    Cost   decodeCost;           // decompressing and decoding them
+    Cost   firstRowGroupCost;    // reading the first row group, -1 before it is known
     List * rowGroupsToSkip;
+    int    estimate_threshold;   // file count from which footers are sampled
+    int    estimate_sample_size; // number of footers to read in that case
+    int    parallel_workers;     // workers of parallel scans, -1 to plan by size
+    int    numSampledFiles;      // 0 if all the footers were read
+    double rowsErrorBound;       // 95% confidence bound of numRowsToRead
+    uint64_t numRowGroups;       // row groups left after pruning
+    double * lookup_fractions;   // share of row groups read by a lookup, per attribute
 };
 
 typedef enum {
-    FDW_PLAN_STATE_FILENAMES = 0,
+    FDW_PLAN_STATE_FILES = 0,
     FDW_PLAN_STATE_ATTRS_USED,
     FDW_PLAN_STATE_ATTRS_SORTED,
     FDW_PLAN_STATE_USE_MMAP,
-    FDW_PLAN_STATE_ROW_GROUPS_TO_SKIP,
+    FDW_PLAN_STATE_PARTITION_ATTRS,
+    FDW_PLAN_STATE_ESTIMATE,
+    FDW_PLAN_STATE_DICTIONARY_PRUNING,
+    FDW_PLAN_STATE_LIMIT,  // pushed down count and offset, NIL if there are none
+    FDW_PLAN_STATE_TOP_N,  // sort keys of Top-N scans, NIL for other ones
     FDW_PLAN_STATE_END__
 } FdwPlanStatePack;
 
+/* Scans of upper and join relations, fdw_private of which starts with the kind */
+typedef enum {
+    FDW_UPPER_METADATA = 0,
+    FDW_UPPER_AGGREGATE,
+    FDW_UPPER_LIMIT,
+    FDW_UPPER_TOP_N,
+    FDW_UPPER_JOIN,
+} FdwUpperScanKind;
+
+/* fdw_private of scans returning aggregates computed from metadata */
+typedef enum {
+    FDW_METADATA_KIND = 0,
+    FDW_METADATA_ROWS,
+    FDW_METADATA_NUM_FILES,
+    FDW_METADATA_NUM_ROW_GROUPS,
+} FdwMetadataPlanStatePack;
+
+/* fdw_private of scans aggregating the rows they read */
+typedef enum {
+    FDW_AGGREGATE_KIND = 0,
+    FDW_AGGREGATE_SCAN,        // FdwPlanStatePack of the table scan
+    FDW_AGGREGATE_RELID,
+    FDW_AGGREGATE_GROUP_ATTRS, // attribute numbers grouped by
+    FDW_AGGREGATE_AGGREGATES,  // kind and attribute number of each aggregate
+    FDW_AGGREGATE_OUTPUTS,     // see VectorAggregates::getGroup
+    FDW_AGGREGATE_QUALS,
+    FDW_AGGREGATE_PARTIAL,
+    FDW_AGGREGATE_DICTIONARY_GROUPS,
+    FDW_AGGREGATE_TLIST,       // fdw_scan_tlist, only used by planner
+} FdwAggregatePlanStatePack;
+
+/*
+ * fdw_private of paths of scans with pushed down LIMIT and OFFSET, Top-N
+ * scans also sort the rows and check the conditions of the table
+ */
+typedef enum {
+    FDW_LIMIT_KIND = 0,
+    FDW_LIMIT_COUNT, // -1 for no count
+    FDW_LIMIT_OFFSET,
+    FDW_LIMIT_RELID,
+    FDW_LIMIT_KEYS,  // attribute number, ordering operator, collation and nulls first of each key
+    FDW_LIMIT_QUALS,
+} FdwLimitPathPack;
+
+/* fdw_private of scans joining two tables by a hash table of one of them */
+typedef enum {
+    FDW_JOIN_KIND = 0,
+    FDW_JOIN_BUILD_SCAN,  // FdwPlanStatePack of the table whose rows are hashed
+    FDW_JOIN_BUILD_RELID,
+    FDW_JOIN_BUILD_RTI,   // range table index as planned, Vars of the quals refer to it
+    FDW_JOIN_BUILD_QUALS,
+    FDW_JOIN_PROBE_SCAN,  // FdwPlanStatePack of the table looked up in the hash table
+    FDW_JOIN_PROBE_RELID,
+    FDW_JOIN_PROBE_RTI,
+    FDW_JOIN_PROBE_QUALS,
+    FDW_JOIN_KEYS,        // build and probe attribute numbers, type and collation of each key
+    FDW_JOIN_CLAUSES,     // join clauses, probe side first, only used by EXPLAIN
+    FDW_JOIN_OUTPUTS,     // side (1 for probe) and attribute number of each fdw_scan_tlist entry
+    FDW_JOIN_TLIST,       // fdw_scan_tlist, only used by planner
+} FdwJoinPlanStatePack;
+
+struct MetadataScanState
+{
+    List *rows;
+    int   nextRow;
+};
+
+struct AggregateScanState
+{
+    ParquetFdwExecutionState *festate;
+    VectorAggregates *        aggregates;
+    std::vector<int>          outputs;
+    ExprState *               qual;
+    TupleTableSlot *          rowSlot; // rows of the table the quals are checked on
+    MemoryContext             outputCxt;
+    bool                      aggregated;
+    size_t                    nextGroup;
+};
+
+struct JoinScanState
+{
+    ParquetFdwExecutionState *        build;
+    ParquetFdwExecutionState *        probe;
+    JoinHashTable *                   table;
+    std::vector<std::pair<bool, int>> outputs; // probe side or not and attribute index
+    ExprState *                       buildQual;
+    ExprState *                       probeQual;
+    TupleTableSlot *                  buildSlot;
+    TupleTableSlot *                  probeSlot;
+    TupleTableSlot *                  matchSlot; // rows of the build side kept by the table
+    const std::vector<MinimalTuple> * matches;   // of the current probe row
+    size_t                            nextMatch;
+    size_t                            numProbeRowGroups; // before pruning by the key ranges
+    bool                              built;
+};
+
 typedef enum
 {
     PS_START = 0,
@@ -190,7 +343,8 @@ static List *parse_filenames_list(const char *str)
     return filenames;
 }
 
-static List* getFilesToRead(const char* filenamesListString) {
+static List* getFilesToRead(const char* filenamesListString,
+                            const HivePartitions *partitions = nullptr) {
     ListCell* lc;
     List* fileNamesList = parse_filenames_list(filenamesListString);
     List* fileNames = NIL;
@@ -205,6 +359,10 @@ static List* getFilesToRead(const char* filenamesListString) {
             {
                 elog(ERROR, "parquet_fdw: No such file or directory");
             }
+            else if (std::filesystem::is_directory(path) && partitions)
+            {
+                fileNames = list_concat(fileNames, partitions->listFiles(filename));
+            }
             else if (std::filesystem::is_directory(path))
             {
                 for (auto &entry : std::filesystem::recursive_directory_iterator(path))
@@ -220,6 +378,12 @@ static List* getFilesToRead(const char* filenamesListString) {
             }
             else if (std::filesystem::is_regular_file(path))
             {
+                if (partitions && !partitions->pathMatches(filename))
+                {
+                    elog(DEBUG1, "parquet_fdw: skipping partition %s", filename);
+                    continue;
+                }
+
                 elog(DEBUG1, "Appending file %s", path.c_str());
                 char* thisFile = pstrdup(path.c_str());
                 fileNames = lappend(fileNames, makeString(thisFile));
@@ -370,6 +534,22 @@ static void destroy_parquet_state(void *arg)
         delete festate;
 }
 
+static void destroy_aggregate_state(void *arg)
+{
+    AggregateScanState *state = (AggregateScanState *)arg;
+
+    delete state->aggregates;
+    delete state;
+}
+
+static void destroy_join_state(void *arg)
+{
+    JoinScanState *state = (JoinScanState *)arg;
+
+    delete state->table;
+    delete state;
+}
+
 /*
  * OidFunctionCall1NullableArg
  *      Practically a copy-paste from FunctionCall1Coll with added capability
@@ -406,7 +586,14 @@ static Datum OidFunctionCall1NullableArg(Oid functionId, Datum arg, bool argisnu
     return result;
 }
 
-static List *get_filenames_from_userfunc(const char *funcname, const char *funcarg)
+/*
+ * get_filenames_from_userfunc
+ *      Call files_func to get the list of files. If cacheTtl is positive then
+ *      the result is reused for that many seconds and remembered as used for
+ *      the foreign table relid.
+ */
+static List *get_filenames_from_userfunc(const char *funcname, const char *funcarg,
+                                         int cacheTtl = 0, Oid relid = InvalidOid)
 {
     Jsonb *    j = nullptr;
     Oid        funcid;
@@ -429,6 +616,27 @@ static List *get_filenames_from_userfunc(const char *funcname, const char *funca
     }
 
     funcid    = LookupFuncName(f, 1, &jsonboid, false);
+
+    if (cacheTtl > 0)
+    {
+        bool found = false;
+
+        try
+        {
+            found = FilesFuncCache::lookup(funcid, funcarg, cacheTtl, relid, &res);
+        }
+        catch (std::exception &e)
+        {
+            elog(ERROR, "parquet_fdw: %s", e.what());
+        }
+
+        if (found)
+        {
+            elog(DEBUG1, "parquet_fdw: using cached result of '%s'", funcname);
+            return res;
+        }
+    }
+
     filenames = OidFunctionCall1NullableArg(funcid, (Datum)j, funcarg == nullptr);
 
     arr = DatumGetArrayTypeP(filenames);
@@ -451,21 +659,113 @@ static List *get_filenames_from_userfunc(const char *funcname, const char *funca
         res = lappend(res, makeString(TextDatumGetCString(values[i])));
     }
 
+    if (cacheTtl > 0)
+    {
+        try
+        {
+            FilesFuncCache::store(funcid, funcarg, relid, res);
+        }
+        catch (std::exception &e)
+        {
+            elog(ERROR, "parquet_fdw: %s", e.what());
+        }
+    }
+
     return res;
 }
 
-static void get_table_options(Oid relid, ParquetFdwPlanState *fdw_private)
+/*
+ * parse_columns
+ *      Convert space separated list of column names to attribute numbers.
+ *      The kind of the columns is used in the error message.
+ */
+static List *parse_columns(Oid relid, const char *str, const char *kind)
+{
+    List *    attnums = NIL;
+    ListCell *lc;
+
+    foreach (lc, parse_filenames_list(str))
+    {
+        char *     name   = strVal((Value *)lfirst(lc));
+        AttrNumber attnum = get_attnum(relid, name);
+
+        if (attnum == InvalidAttrNumber)
+            ereport(ERROR,
+                    (errcode(ERRCODE_FDW_INVALID_OPTION_NAME),
+                     errmsg("parquet_fdw: %s column \"%s\" does not exist", kind, name)));
+
+        attnums = lappend_int(attnums, attnum);
+    }
+
+    return attnums;
+}
+
+/*
+ * get_partition_attr_flags
+ *      Convert list of partition attribute numbers to a per attribute flags.
+ */
+static std::vector<bool> get_partition_attr_flags(List *partition_attrs, int natts)
+{
+    std::vector<bool> flags;
+    ListCell *        lc;
+
+    if (partition_attrs == NIL)
+        return flags;
+
+    flags.resize(natts, false);
+    foreach (lc, partition_attrs)
+        flags[lfirst_int(lc) - 1] = true;
+
+    return flags;
+}
+
+/*
+ * parse_int_option
+ *      Parse integer option value which must not be less than minValue.
+ */
+static int parse_int_option(DefElem *def, int minValue)
+{
+    const char *str = defGetString(def);
+    char *      end;
+    long        value;
+
+    errno = 0;
+    value = strtol(str, &end, 10);
+
+    if (errno != 0 || end == str || *end != '\0' || value < minValue || value > INT_MAX)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("invalid value for integer option \"%s\": %s", def->defname, str)));
+
+    return (int)value;
+}
+
+/*
+ * get_table_options
+ *      Read table options and build the list of files to read. If baserel
+ *      is provided then its restriction clauses are used to skip hive
+ *      partitions that cannot match.
+ */
+static void get_table_options(Oid relid, ParquetFdwPlanState *fdw_private,
+                              RelOptInfo *baserel = nullptr)
 {
     ForeignTable *table;
     ListCell *    lc;
+    char *        filename = nullptr;
     char *        funcname = nullptr;
     char *        funcarg  = nullptr;
+    int           cacheTtl = 0;
 
     if (!fdw_private)
         elog(ERROR, "FDW plan state not provided.");
 
-    fdw_private->use_mmap    = false;
-    table                    = GetForeignTable(relid);
+    fdw_private->use_mmap             = false;
+    fdw_private->dictionary_pruning   = false;
+    fdw_private->dictionary_groups    = false;
+    fdw_private->estimate_threshold   = 0;
+    fdw_private->estimate_sample_size = DEFAULT_ESTIMATE_SAMPLE_SIZE;
+    fdw_private->parallel_workers     = -1;
+    table                             = GetForeignTable(relid);
 
     foreach (lc, table->options)
     {
@@ -473,7 +773,7 @@ static void get_table_options(Oid relid, ParquetFdwPlanState *fdw_private)
 
         if (strcmp(def->defname, "filename") == 0)
         {
-            fdw_private->filenames = getFilesToRead(defGetString(def));
+            filename = defGetString(def);
         }
         else if (strcmp(def->defname, "files_func") == 0)
         {
@@ -483,6 +783,10 @@ static void get_table_options(Oid relid, ParquetFdwPlanState *fdw_private)
         {
             funcarg = defGetString(def);
         }
+        else if (strcmp(def->defname, "files_func_cache_ttl") == 0)
+        {
+            cacheTtl = parse_int_option(def, 0);
+        }
         else if (strcmp(def->defname, "use_mmap") == 0)
         {
             if (!parse_bool(defGetString(def), &fdw_private->use_mmap))
@@ -491,12 +795,78 @@ static void get_table_options(Oid relid, ParquetFdwPlanState *fdw_private)
                          errmsg("invalid value for boolean option \"%s\": %s", def->defname,
                                 defGetString(def))));
         }
+        else if (strcmp(def->defname, "dictionary_pruning") == 0)
+        {
+            if (!parse_bool(defGetString(def), &fdw_private->dictionary_pruning))
+                ereport(ERROR,
+                        (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                         errmsg("invalid value for boolean option \"%s\": %s", def->defname,
+                                defGetString(def))));
+        }
+        else if (strcmp(def->defname, "dictionary_groups") == 0)
+        {
+            if (!parse_bool(defGetString(def), &fdw_private->dictionary_groups))
+                ereport(ERROR,
+                        (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                         errmsg("invalid value for boolean option \"%s\": %s", def->defname,
+                                defGetString(def))));
+        }
+        else if (strcmp(def->defname, "partition_columns") == 0)
+        {
+            fdw_private->partition_attrs = parse_columns(relid, defGetString(def), "partition");
+        }
+        else if (strcmp(def->defname, "sorted") == 0)
+        {
+            fdw_private->attrs_sorted = parse_columns(relid, defGetString(def), "sorted");
+        }
+        else if (strcmp(def->defname, "estimate_threshold") == 0)
+        {
+            fdw_private->estimate_threshold = parse_int_option(def, 0);
+        }
+        else if (strcmp(def->defname, "estimate_sample_size") == 0)
+        {
+            fdw_private->estimate_sample_size = parse_int_option(def, 1);
+        }
+        else if (strcmp(def->defname, "parallel_workers") == 0)
+        {
+            fdw_private->parallel_workers = parse_int_option(def, 0);
+        }
         else
             elog(ERROR, "unknown option '%s'", def->defname);
     }
 
+    if (fdw_private->partition_attrs)
+    {
+        HivePartitions partitions(relid, fdw_private->partition_attrs);
+
+        if (baserel)
+            partitions.setClauses(baserel->relid, baserel->baserestrictinfo);
+
+        if (filename)
+            fdw_private->filenames = getFilesToRead(filename, &partitions);
+
+        if (funcname)
+        {
+            List *filenames = get_filenames_from_userfunc(funcname, funcarg, cacheTtl, relid);
+
+            foreach (lc, filenames)
+            {
+                char *fn = strVal((Value *)lfirst(lc));
+
+                if (partitions.pathMatches(fn))
+                    fdw_private->filenames = lappend(fdw_private->filenames, lfirst(lc));
+                else
+                    elog(DEBUG1, "parquet_fdw: skipping partition %s", fn);
+            }
+        }
+        return;
+    }
+
+    if (filename)
+        fdw_private->filenames = getFilesToRead(filename);
+
     if (funcname)
-        fdw_private->filenames = get_filenames_from_userfunc(funcname, funcarg);
+        fdw_private->filenames = get_filenames_from_userfunc(funcname, funcarg, cacheTtl, relid);
 }
 
 static void extract_used_attributes(RelOptInfo *baserel)
@@ -513,19 +883,293 @@ static void extract_used_attributes(RelOptInfo *baserel)
         pull_varattnos((Node *)rinfo->clause, baserel->relid, &fdw_private->attrs_used);
     }
 
-    if (bms_is_empty(fdw_private->attrs_used))
+    /*
+     * No attribute may be used at all, e.g. by EXISTS, in which case no column
+     * is read and the scan returns empty rows by the row counts of row groups.
+     */
+}
+
+/*
+ * has_column_statistics
+ *      Whether ANALYZE collected statistics of any column of the table.
+ */
+static bool has_column_statistics(Oid relid, int natts)
+{
+    for (AttrNumber attnum = 1; attnum <= natts; ++attnum)
+    {
+        if (SearchSysCacheExists3(STATRELATTINH, ObjectIdGetDatum(relid), Int16GetDatum(attnum),
+                                  BoolGetDatum(false)))
+            return true;
+    }
+    return false;
+}
+
+/*
+ * estimate_rows
+ *      Number of rows satisfying the conditions of the relation. Those are
+ *      estimated from the statistics of the row groups left after pruning,
+ *      unless the table has been analyzed, in which case the selectivity of
+ *      the conditions is taken from the statistics of its columns. Either way
+ *      there are no more rows than the row groups to read have.
+ */
+static double estimate_rows(PlannerInfo *root, RelOptInfo *baserel, Oid relid, int natts)
+{
+    auto   fdw_private = (ParquetFdwPlanState *)baserel->fdw_private;
+    double rows        = fdw_private->numRowsEstimated;
+
+    if (has_column_statistics(relid, natts))
+        rows = fdw_private->numTotalRows
+             * clauselist_selectivity(root, baserel->baserestrictinfo, 0, JOIN_INNER, nullptr);
+
+    return clamp_row_est(std::min(rows, (double)fdw_private->numRowsToRead));
+}
+
+/*
+ * read_cost
+ *      Cost of decompressing and decoding the row groups of the file left
+ *      after pruning. The first row group read by the scan also makes up its
+ *      startup cost, as no row is returned before it is buffered.
+ */
+static Cost read_cost(ParquetFdwPlanState *fdw_private, const ParquetFdwReader &reader,
+                      const std::vector<bool> &attrUseList, List *skipList)
+{
+    Cost cost = 0;
+
+    for (int r = 0; r < (int)reader.getNumRowGroups(); ++r)
+    {
+        if (list_member_int(skipList, r))
+            continue;
+
+        const auto rowGroupCost = CostModel::rowGroupCost(reader, r, attrUseList);
+
+        if (fdw_private->firstRowGroupCost < 0)
+            fdw_private->firstRowGroupCost = seq_page_cost * rowGroupCost.pages + rowGroupCost.cpu;
+        cost += rowGroupCost.cpu;
+    }
+
+    return cost;
+}
+
+/*
+ * lookup_attrs
+ *      Attributes needed by other relations, i.e. the ones join clauses may
+ *      look up rows of this relation by.
+ */
+static std::vector<int> lookup_attrs(RelOptInfo *baserel, TupleDesc tupleDesc,
+                                     const std::vector<bool> &partitionAttrs)
+{
+    std::vector<int> res;
+
+    if (baserel->joininfo == NIL && !baserel->has_eclass_joins)
+        return res;
+
+    for (int attnum = 1; attnum <= std::min(tupleDesc->natts, (int)baserel->max_attr); ++attnum)
+    {
+        Relids needed = bms_difference(baserel->attr_needed[attnum - baserel->min_attr],
+                                       baserel->relids);
+
+        /* Relid 0 stands for the final target list */
+        needed = bms_del_member(needed, 0);
+
+        if (!bms_is_empty(needed) && !TupleDescAttr(tupleDesc, attnum - 1)->attisdropped
+            && (partitionAttrs.empty() || !partitionAttrs[attnum - 1]))
+            res.push_back(attnum - 1);
+        bms_free(needed);
+    }
+
+    return res;
+}
+
+/*
+ * set_lookup_fractions
+ *      Estimate from the row group statistics how many row groups a lookup by
+ *      every attribute would read.
+ */
+static void set_lookup_fractions(ParquetFdwPlanState *                     fdw_private,
+                                 TupleDesc                                 tupleDesc,
+                                 const std::vector<int> &                  attrs,
+                                 const std::vector<FilterPushdown::ColumnRanges> &ranges)
+{
+    FilterPushdown filterPushdown(0);
+
+    if (attrs.empty())
+        return;
+
+    fdw_private->lookup_fractions = (double *)palloc(sizeof(double) * tupleDesc->natts);
+    for (int i = 0; i < tupleDesc->natts; ++i)
+        fdw_private->lookup_fractions[i] = -1;
+
+    for (size_t i = 0; i < attrs.size(); ++i)
+    {
+        const Oid collid = TupleDescAttr(tupleDesc, attrs[i])->attcollation;
+
+        fdw_private->lookup_fractions[attrs[i]] = filterPushdown.lookupFraction(ranges[i], collid);
+        elog(DEBUG1, "parquet_fdw: lookup by attribute %d reads %.3f of row groups",
+             attrs[i] + 1, fdw_private->lookup_fractions[attrs[i]]);
+    }
+}
+
+/*
+ * estimate_rel_size_from_sample
+ *      Estimate the relation size for a large set of files without reading
+ *      all the footers. A random sample of files is read and the number of
+ *      rows and pages that pass the row group filters is extrapolated to the
+ *      rest of files proportionally to their size on disk (ratio estimator).
+ *      Row groups of the files that were not sampled are pruned on executor
+ *      startup instead.
+ */
+static void estimate_rel_size_from_sample(ParquetFdwPlanState *    fdw_private,
+                                          TupleDesc                tupleDesc,
+                                          const std::vector<bool> &attrUseList,
+                                          const std::vector<bool> &partitionAttrs,
+                                          List *                   restrictinfo,
+                                          const std::vector<int> & lookupAttrs,
+                                          std::vector<FilterPushdown::ColumnRanges> &lookupRanges)
+{
+    const int           numFiles = list_length(fdw_private->filenames);
+    const int           numSamples = std::min(fdw_private->estimate_sample_size, numFiles);
+    std::vector<char *> filenames;
+    std::vector<double> fileSizes;
+    std::vector<int>    sample(numFiles);
+    double              totalBytes = 0;
+    double              sampledBytes = 0;
+    double              sampledRows = 0;
+    double              sampledRowsEstimated = 0;
+    double              sampledTotalRows = 0;
+    double              sampledPages = 0;
+    double              sampledDecodeCost = 0;
+    double              sampledRowGroups = 0;
+    std::vector<double> rowsToRead;
+    ListCell *          lc;
+
+    /* File sizes are cheap to get compared to footers */
+    foreach (lc, fdw_private->filenames)
+    {
+        char *     filename = strVal((Value *)lfirst(lc));
+        const auto size = (double)std::filesystem::file_size(filename);
+
+        filenames.push_back(filename);
+        fileSizes.push_back(size);
+        totalBytes += size;
+    }
+
+    /* Fixed seed makes the plan stable for the same set of files */
+    std::iota(sample.begin(), sample.end(), 0);
+    std::shuffle(sample.begin(), sample.end(), std::mt19937(numFiles));
+    sample.resize(numSamples);
+    std::sort(sample.begin(), sample.end());
+
+    for (int fileIdx : sample)
+    {
+        uint64_t numTotalRows = 0;
+        uint64_t numRowsToRead = 0;
+        size_t   numPagesToRead = 0;
+        auto     reader = std::make_unique<ParquetFdwReader>(filenames[fileIdx]);
+
+        if (!partitionAttrs.empty())
+            reader->setPartitionAttrs(partitionAttrs);
+        reader->validateSchema(tupleDesc);
+
+        FilterPushdown filterPushdown(reader->getNumRowGroups());
+        filterPushdown.setDictionaryPruning(fdw_private->dictionary_pruning);
+        filterPushdown.extract_rowgroup_filters(restrictinfo);
+
+        List *skipList = filterPushdown.getRowGroupSkipListAndUpdateTupleCount(
+                *reader, tupleDesc, attrUseList, &numTotalRows, &numRowsToRead, &numPagesToRead);
+
+        for (size_t i = 0; i < lookupAttrs.size(); ++i)
+            filterPushdown.collectColumnRanges(*reader, lookupAttrs[i], lookupRanges[i]);
+
+        sampledDecodeCost += read_cost(fdw_private, *reader, attrUseList, skipList);
+        sampledRowsEstimated += filterPushdown.estimateRows(*reader, skipList);
+        sampledRowGroups += reader->getNumRowGroups() - list_length(skipList);
+        list_free(skipList);
+
+        sampledBytes += fileSizes[fileIdx];
+        sampledRows += numRowsToRead;
+        sampledTotalRows += numTotalRows;
+        sampledPages += numPagesToRead;
+        rowsToRead.push_back(numRowsToRead);
+    }
+
+    /* Scale sampled values by size, fall back to the number of files for empty files */
+    const double scale = sampledBytes > 0 ? totalBytes / sampledBytes : (double)numFiles / numSamples;
+    const double ratio = sampledBytes > 0 ? sampledRows / sampledBytes : 0;
+
+    fdw_private->numTotalRows    = (uint64_t)(sampledTotalRows * scale);
+    fdw_private->numRowsToRead   = (uint64_t)(sampledRows * scale);
+    fdw_private->numRowsEstimated = sampledRowsEstimated * scale;
+    fdw_private->numPagesToRead  = std::max((size_t)(sampledPages * scale), (size_t)1);
+    fdw_private->decodeCost      = sampledDecodeCost * scale;
+    fdw_private->numRowGroups    = (uint64_t)(sampledRowGroups * scale);
+    fdw_private->numSampledFiles = numSamples;
+    fdw_private->rowsErrorBound  = 0;
+
+    /*
+     * Variance of the ratio estimator of the total:
+     *      N^2 * (1 - n/N) / n * sum((y_i - R * x_i)^2) / (n - 1)
+     */
+    if (numSamples > 1 && numSamples < numFiles)
+    {
+        double residuals = 0;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const double residual = sampledBytes > 0
+                                  ? rowsToRead[i] - ratio * fileSizes[sample[i]]
+                                  : rowsToRead[i] - sampledRows / numSamples;
+
+            residuals += residual * residual;
+        }
+
+        fdw_private->rowsErrorBound = 1.96 * numFiles
+                                    * sqrt((1.0 - (double)numSamples / numFiles) / numSamples
+                                           * residuals / (numSamples - 1));
+    }
+
+    elog(DEBUG1, "parquet_fdw: estimated %lu rows (+/- %.0f) from %d of %d files",
+         fdw_private->numRowsToRead, fdw_private->rowsErrorBound, numSamples, numFiles);
+}
+
+/*
+ * sorted_attr
+ *      Attribute the rows of the file are sorted by, -1 if there is none. The
+ *      rows of every row group have to be sorted by it according to the file
+ *      metadata, and the min/max ranges of the row groups must not overlap.
+ *      Parquet orders strings bytewise, so text columns only qualify with the
+ *      C collation.
+ */
+static int sorted_attr(const ParquetFdwReader &reader, FilterPushdown &filter, TupleDesc tupleDesc)
+{
+    const int        column = reader.sortingColumn();
+    std::vector<int> order;
+
+    if (column < 0)
+        return -1;
+
+    for (int attIdx = 0; attIdx < tupleDesc->natts; ++attIdx)
     {
-        bms_free(fdw_private->attrs_used);
-        fdw_private->attrs_used = bms_make_singleton(1 - FirstLowInvalidHeapAttributeNumber);
+        const Oid collid = TupleDescAttr(tupleDesc, attIdx)->attcollation;
+
+        if (reader.columnIndex(attIdx) != column)
+            continue;
+
+        if (OidIsValid(collid) && !lc_collate_is_c(collid))
+            return -1;
+
+        return filter.orderRowGroups(reader, attIdx, collid, &order) ? attIdx : -1;
     }
+
+    return -1;
 }
 
 extern "C" void parquetGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid)
 {
     ParquetFdwPlanState *fdw_private = (ParquetFdwPlanState *)palloc0(sizeof(ParquetFdwPlanState));
     fdw_private->rowGroupsToSkip = NIL;
+    fdw_private->firstRowGroupCost = -1;
 
-    get_table_options(foreigntableid, fdw_private);
+    get_table_options(foreigntableid, fdw_private, baserel);
     baserel->fdw_private = fdw_private;
 
     /* Collect used attributes to reduce number of read columns during scan */
@@ -551,6 +1195,8 @@ extern "C" void parquetGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel,
         ListCell *lc, *lc2;
 
         auto attrUseList = std::vector<bool>(tupleDesc->natts, false);
+        const auto partitionAttrs =
+                get_partition_attr_flags(fdw_private->partition_attrs, tupleDesc->natts);
         int attIdx = -1;
         while ((attIdx = bms_next_member(fdw_private->attrs_used, attIdx)) >= 0)
         {
@@ -558,67 +1204,169 @@ extern "C" void parquetGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel,
             attrUseList[attNum] = true;
         }
 
-        std::shared_ptr<arrow::Schema> previousSchema;
-        List* allFiles = list_copy(fdw_private->filenames);
-        foreach (lc, allFiles)
-        {
-            char *     filename = strVal((Value *)lfirst(lc));
-            auto reader = std::make_unique<ParquetFdwReader>(filename);
-
-            if (previousSchema)
-                reader->schemaMustBeEqual(previousSchema);
-            else
-                reader->validateSchema(tupleDesc);
+        /* Statistics of the join columns to cost parameterized paths with */
+        const auto lookupAttrs = lookup_attrs(baserel, tupleDesc, partitionAttrs);
+        std::vector<FilterPushdown::ColumnRanges> lookupRanges(lookupAttrs.size());
 
-            FilterPushdown filterPushdown(reader->getNumRowGroups());
-            filterPushdown.extract_rowgroup_filters(baserel->baserestrictinfo);
+        /*
+         * Attribute all the files are found sorted by unless the table is
+         * declared sorted, -1 if there is none and -2 before the first file
+         */
+        int sortedAttr = fdw_private->attrs_sorted == NIL ? -2 : -1;
 
-            /*
-             * Extract list of row groups that match query clauses. Also calculate
-             * approximate number of rows in result set based on total number of tuples
-             * in those row groups. It isn't very precise but it is best we got.
-             */
-            List *thisFileSkipList = filterPushdown.getRowGroupSkipListAndUpdateTupleCount(
-                filename,
-                tupleDesc,
-                attrUseList,
-                &(fdw_private->numTotalRows),
-                &(fdw_private->numRowsToRead),
-                &(fdw_private->numPagesToRead));
-
-            if (thisFileSkipList != NIL && reader->getNumRowGroups() == (size_t)thisFileSkipList->length)
-            {
-                elog(DEBUG1, "parquet_fdw: skipping file %s", filename);
-                fdw_private->filenames = list_delete_ptr(fdw_private->filenames, lfirst(lc));
-            }
-            else
+        if (fdw_private->estimate_threshold > 0
+            && list_length(fdw_private->filenames) > fdw_private->estimate_threshold)
+        {
+            estimate_rel_size_from_sample(fdw_private, tupleDesc, attrUseList, partitionAttrs,
+                                          baserel->baserestrictinfo, lookupAttrs, lookupRanges);
+        }
+        else
+        {
+            std::shared_ptr<arrow::Schema> previousSchema;
+            List* allFiles = list_copy(fdw_private->filenames);
+            foreach (lc, allFiles)
             {
-                foreach(lc2, thisFileSkipList) {
-                    elog(DEBUG1, "parquet_fdw: skipping rowgroup %d of file %s", lfirst_int(lc2), filename);
-                }
-                fdw_private->rowGroupsToSkip = lappend(fdw_private->rowGroupsToSkip, thisFileSkipList);
-            }
+                char *     filename = strVal((Value *)lfirst(lc));
+                auto reader = std::make_unique<ParquetFdwReader>(filename);
 
-            previousSchema = reader->GetSchema();
-            reader.reset();
-        }
-    }
-    catch (std::exception &e)
-    {
-        elog(ERROR, "parquet_fdw: error validating schema: %s", e.what());
-    }
+                if (!partitionAttrs.empty())
+                    reader->setPartitionAttrs(partitionAttrs);
 
-    baserel->rows = fdw_private->numRowsToRead;
-    baserel->tuples = fdw_private->numTotalRows;
-}
+                if (previousSchema)
+                    reader->schemaMustBeEqual(previousSchema);
+                else
+                    reader->validateSchema(tupleDesc);
 
-static Path* constructPath(PlannerInfo *root, RelOptInfo *baserel, const double parallelDivisor)
-{
+                FilterPushdown filterPushdown(reader->getNumRowGroups());
+                filterPushdown.setDictionaryPruning(fdw_private->dictionary_pruning);
+                filterPushdown.extract_rowgroup_filters(baserel->baserestrictinfo);
+
+                /*
+                 * Extract list of row groups that match query clauses. Also calculate
+                 * approximate number of rows in result set based on total number of tuples
+                 * in those row groups. It isn't very precise but it is best we got.
+                 */
+                List *thisFileSkipList = filterPushdown.getRowGroupSkipListAndUpdateTupleCount(
+                    *reader,
+                    tupleDesc,
+                    attrUseList,
+                    &(fdw_private->numTotalRows),
+                    &(fdw_private->numRowsToRead),
+                    &(fdw_private->numPagesToRead));
+
+                for (size_t i = 0; i < lookupAttrs.size(); ++i)
+                    filterPushdown.collectColumnRanges(*reader, lookupAttrs[i], lookupRanges[i]);
+                fdw_private->decodeCost += read_cost(fdw_private, *reader, attrUseList, thisFileSkipList);
+                fdw_private->numRowsEstimated += filterPushdown.estimateRows(*reader, thisFileSkipList);
+                if (sortedAttr != -1)
+                {
+                    const int attIdx = sorted_attr(*reader, filterPushdown, tupleDesc);
+
+                    sortedAttr = sortedAttr == -2 || sortedAttr == attIdx ? attIdx : -1;
+                }
+                fdw_private->numRowGroups += reader->getNumRowGroups() - list_length(thisFileSkipList);
+
+                if (thisFileSkipList != NIL && reader->getNumRowGroups() == (size_t)thisFileSkipList->length)
+                {
+                    elog(DEBUG1, "parquet_fdw: skipping file %s", filename);
+                    fdw_private->filenames = list_delete_ptr(fdw_private->filenames, lfirst(lc));
+                }
+                else
+                {
+                    foreach(lc2, thisFileSkipList) {
+                        elog(DEBUG1, "parquet_fdw: skipping rowgroup %d of file %s", lfirst_int(lc2), filename);
+                    }
+                    fdw_private->rowGroupsToSkip = lappend(fdw_private->rowGroupsToSkip, thisFileSkipList);
+                }
+
+                previousSchema = reader->GetSchema();
+                reader.reset();
+            }
+        }
+
+        if (sortedAttr >= 0)
+        {
+            elog(DEBUG1, "parquet_fdw: files are sorted by column %s",
+                 NameStr(TupleDescAttr(tupleDesc, sortedAttr)->attname));
+            fdw_private->attrs_sorted = list_make1_int(sortedAttr + 1);
+        }
+
+        set_lookup_fractions(fdw_private, tupleDesc, lookupAttrs, lookupRanges);
+    }
+    catch (std::exception &e)
+    {
+        elog(ERROR, "parquet_fdw: error validating schema: %s", e.what());
+    }
+
+    if (fdw_private->firstRowGroupCost < 0)
+        fdw_private->firstRowGroupCost = 0;
+
+    baserel->tuples = fdw_private->numTotalRows;
+    baserel->rows   = estimate_rows(root, baserel, foreigntableid, tupleDesc->natts);
+}
+
+/*
+ * parallel_workers
+ *      Number of workers for a parallel scan of the row groups left after
+ *      pruning. Unless the table sets it, one worker is planned for tables of
+ *      min_parallel_table_scan_size and one more each time the size triples,
+ *      the same way as for heap tables. Row groups are handed out to workers
+ *      one by one, so there are never more workers than row groups.
+ */
+static int parallel_workers(ParquetFdwPlanState *fdw_private)
+{
+    int workers = fdw_private->parallel_workers;
+
+    if (workers < 0)
+    {
+        const double pages     = fdw_private->numPagesToRead;
+        double       threshold = std::max(min_parallel_table_scan_size, 1);
+
+        if (pages < min_parallel_table_scan_size)
+            return 0;
+
+        workers = 1;
+        while (pages >= threshold * 3 && workers < max_parallel_workers_per_gather)
+        {
+            workers++;
+            threshold *= 3;
+        }
+    }
+
+    workers = std::min<int64>(workers, fdw_private->numRowGroups);
+    return std::min(workers, max_parallel_workers_per_gather);
+}
+
+/*
+ * parallel_divisor
+ *      Share of the rows processed by each process of a parallel scan, the
+ *      same as for heap tables: the leader contributes less the more workers
+ *      there are to gather rows from.
+ */
+static double parallel_divisor(int workers)
+{
+    double divisor = workers;
+
+    if (parallel_leader_participation)
+        divisor += std::max(0.0, 1.0 - 0.3 * workers);
+    return divisor;
+}
+
+static Path* constructPath(PlannerInfo *root, RelOptInfo *baserel, const double parallelDivisor,
+                           List *pathkeys = NIL)
+{
     auto fdw_private = (ParquetFdwPlanState *)baserel->fdw_private;
+    const int numFiles = list_length(fdw_private->filenames);
 
 
-    const Cost startupCost = 0.0;
-    const Cost cpuRunCost = (cpu_tuple_cost * fdw_private->numRowsToRead) / parallelDivisor;
+    const Cost startupCost = fdw_private->firstRowGroupCost;
+    Cost cpuRunCost = (cpu_tuple_cost * fdw_private->numRowsToRead + fdw_private->decodeCost)
+                    / parallelDivisor;
+
+    /* Merging sorted files compares every row with the heads of the others */
+    if (pathkeys != NIL && numFiles > 1)
+        cpuRunCost += cpu_operator_cost * list_length(pathkeys) * fdw_private->numRowsToRead
+                    * LOG2(numFiles);
     const Cost diskRunCost = seq_page_cost * fdw_private->numPagesToRead;
 
     const Cost parallelCostScaler = parallelDivisor > 1.0 ? 1.0 : 2.0;
@@ -629,15 +1377,175 @@ static Path* constructPath(PlannerInfo *root, RelOptInfo *baserel, const double
             root,
             baserel,
             nullptr, // default pathtarget
-            fdw_private->numRowsToRead / parallelDivisor,
+            baserel->rows / parallelDivisor,
             startupCost,
             totalCost,
-            nullptr, // no pathkeys
+            pathkeys,
             nullptr, // no outer rel either
             nullptr, // no extra plan
             (List *)fdw_private));
 }
 
+/*
+ * lookup_attr
+ *      Attribute index of the column a join clause compares with an expression
+ *      of other relations, -1 if the clause is no such comparison.
+ */
+static int lookup_attr(RestrictInfo *rinfo, RelOptInfo *baserel, bool *equality)
+{
+    OpExpr *  expr;
+    Node *    column;
+    ListCell *lc;
+
+    if (!is_opclause(rinfo->clause) || list_length(((OpExpr *)rinfo->clause)->args) != 2)
+        return -1;
+
+    expr = (OpExpr *)rinfo->clause;
+    if (bms_equal(rinfo->left_relids, baserel->relids)
+        && !bms_overlap(rinfo->right_relids, baserel->relids))
+        column = (Node *)linitial(expr->args);
+    else if (bms_equal(rinfo->right_relids, baserel->relids)
+             && !bms_overlap(rinfo->left_relids, baserel->relids))
+        column = (Node *)lsecond(expr->args);
+    else
+        return -1;
+
+    while (IsA(column, RelabelType))
+        column = (Node *)((RelabelType *)column)->arg;
+
+    if (!IsA(column, Var) || ((Var *)column)->varattno <= 0)
+        return -1;
+
+    /* Only comparisons are checked against statistics */
+    *equality = false;
+    List *interpretations = get_op_btree_interpretation(expr->opno);
+    if (interpretations == NIL)
+        return -1;
+
+    foreach (lc, interpretations)
+    {
+        if (((OpBtreeInterpretation *)lfirst(lc))->strategy == BTEqualStrategyNumber)
+            *equality = true;
+    }
+
+    return ((Var *)column)->varattno - 1;
+}
+
+static bool ec_member_matches_attr(PlannerInfo *root, RelOptInfo *rel, EquivalenceClass *ec,
+                                   EquivalenceMember *em, void *arg)
+{
+    Expr *expr = em->em_expr;
+
+    while (IsA(expr, RelabelType))
+        expr = ((RelabelType *)expr)->arg;
+
+    return IsA(expr, Var) && (Index)((Var *)expr)->varno == rel->relid
+           && ((Var *)expr)->varlevelsup == 0 && ((Var *)expr)->varattno == *(AttrNumber *)arg;
+}
+
+/*
+ * add_parameterized_paths
+ *      Add paths looking up rows by the values of other relations for nested
+ *      loops. Every rescan checks row group and page statistics against the
+ *      current values, so such a path is only worth it if the statistics of
+ *      the join column are tight, e.g. if the data is sorted by it.
+ */
+static void add_parameterized_paths(PlannerInfo *root, RelOptInfo *baserel)
+{
+    auto      fdw_private = (ParquetFdwPlanState *)baserel->fdw_private;
+    List *    clauses     = NIL;
+    List *    ppi_list    = NIL;
+    ListCell *lc;
+
+    if (fdw_private->lookup_fractions == nullptr)
+        return;
+
+    foreach (lc, baserel->joininfo)
+    {
+        RestrictInfo *rinfo = (RestrictInfo *)lfirst(lc);
+
+        if (join_clause_is_movable_to(rinfo, baserel))
+            clauses = lappend(clauses, rinfo);
+    }
+
+    /* Equalities implied by equivalence classes are not in joininfo */
+    if (baserel->has_eclass_joins)
+    {
+        for (AttrNumber attnum = 1; attnum <= baserel->max_attr; ++attnum)
+        {
+            if (fdw_private->lookup_fractions[attnum - 1] < 0)
+                continue;
+
+            clauses = list_concat(clauses,
+                                  generate_implied_equalities_for_column(
+                                          root, baserel, ec_member_matches_attr, (void *)&attnum,
+                                          baserel->lateral_referencers));
+        }
+    }
+
+    foreach (lc, clauses)
+    {
+        RestrictInfo *rinfo = (RestrictInfo *)lfirst(lc);
+        bool          equality;
+        const int     attIdx = lookup_attr(rinfo, baserel, &equality);
+        Relids        required_outer;
+
+        if (attIdx < 0 || fdw_private->lookup_fractions[attIdx] < 0
+            || contain_volatile_functions((Node *)rinfo->clause))
+            continue;
+
+        required_outer = bms_union(rinfo->clause_relids, baserel->lateral_relids);
+        required_outer = bms_del_member(required_outer, baserel->relid);
+        if (bms_is_empty(required_outer))
+            continue;
+
+        ppi_list = list_append_unique_ptr(ppi_list,
+                                          get_baserel_parampathinfo(root, baserel, required_outer));
+    }
+
+    foreach (lc, ppi_list)
+    {
+        ParamPathInfo *ppi      = (ParamPathInfo *)lfirst(lc);
+        double         fraction = 1.0;
+        ListCell *     lc2;
+
+        foreach (lc2, ppi->ppi_clauses)
+        {
+            bool      equality;
+            const int attIdx = lookup_attr((RestrictInfo *)lfirst(lc2), baserel, &equality);
+
+            if (attIdx >= 0 && equality && fdw_private->lookup_fractions[attIdx] >= 0)
+                fraction = std::min(fraction, fdw_private->lookup_fractions[attIdx]);
+        }
+
+        /* Statistics don't narrow lookups down */
+        if (fraction >= 1.0)
+            continue;
+
+        /* Matching rows may span more row groups than a single value */
+        fraction = std::min(1.0, fraction + ppi->ppi_rows / std::max(baserel->tuples, 1.0));
+
+        /* Statistics of every row group are checked on each rescan */
+        const Cost startupCost = cpu_operator_cost * list_length(ppi->ppi_clauses)
+                               * fdw_private->numRowGroups;
+        const Cost cpuRunCost  = (cpu_tuple_cost * fdw_private->numRowsToRead + fdw_private->decodeCost)
+                               * fraction;
+        const Cost diskRunCost = random_page_cost * fdw_private->numPagesToRead * fraction;
+
+        add_path(baserel,
+                 (Path *)create_foreignscan_path(root,
+                                                 baserel,
+                                                 nullptr, // default pathtarget
+                                                 ppi->ppi_rows,
+                                                 startupCost,
+                                                 startupCost + cpuRunCost + diskRunCost,
+                                                 nullptr, // no pathkeys
+                                                 ppi->ppi_req_outer,
+                                                 nullptr, // no extra plan
+                                                 (List *)fdw_private));
+    }
+}
+
 extern "C" void parquetGetForeignPaths(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid)
 {
     ParquetFdwPlanState *fdw_private;
@@ -672,13 +1580,17 @@ extern "C" void parquetGetForeignPaths(PlannerInfo *root, RelOptInfo *baserel, O
     Path *foreignPath = constructPath(root, baserel, 1.0);
     add_path(baserel, foreignPath);
 
-    if (baserel->consider_parallel > 0)
-    {
-        const int numWorkers = parallel_leader_participation
-                             ? max_parallel_workers_per_gather + 1
-                             : max_parallel_workers_per_gather;
+    /* Rows of the sorted files are merged into the order of the sort keys */
+    if (pathkeys != NIL)
+        add_path(baserel, constructPath(root, baserel, 1.0, pathkeys));
+
+    add_parameterized_paths(root, baserel);
 
-        const double parallelDivisor = static_cast<double>(numWorkers);
+    const int numWorkers = parallel_workers(fdw_private);
+
+    if (baserel->consider_parallel > 0 && numWorkers > 0)
+    {
+        const double parallelDivisor = parallel_divisor(numWorkers);
 
         Path* parallelPath = constructPath(root, baserel, parallelDivisor);
 
@@ -690,212 +1602,2434 @@ extern "C" void parquetGetForeignPaths(PlannerInfo *root, RelOptInfo *baserel, O
     }
 }
 
-extern "C" ForeignScan *parquetGetForeignPlan(PlannerInfo *root,
-                                              RelOptInfo * baserel,
-                                              Oid          foreigntableid,
-                                              ForeignPath *best_path,
-                                              List *       tlist,
-                                              List *       scan_clauses,
-                                              Plan *       outer_plan)
+static bool contain_param_walker(Node *node, void *context)
 {
-    ParquetFdwPlanState *fdw_private  = (ParquetFdwPlanState *)best_path->fdw_private;
-    Index                scan_relid   = baserel->relid;
-    List *               attrs_used   = NIL;
-    List *               attrs_sorted = NIL;
-    AttrNumber           attr;
-    List *               params = NIL;
-    ListCell *           lc;
+    if (node == NULL)
+        return false;
 
-    /*
-     * We have no native ability to evaluate restriction clauses, so we just
-     * put all the scan_clauses into the plan node's qual list for the
-     * executor to check.  So all we have to do here is strip RestrictInfo
-     * nodes from the clauses and ignore pseudoconstants (which will be
-     * handled elsewhere).
-     */
-    scan_clauses = extract_actual_clauses(scan_clauses, false);
+    if (IsA(node, Param))
+        return true;
 
-    /*
-     * We can't just pass arbitrary structure into make_foreignscan() because
-     * in some cases (i.e. plan caching) postgres may want to make a copy of
-     * the plan and it can only make copy of something it knows of, namely
-     * Nodes. So we need to convert everything in nodes and store it in a List.
-     */
-    attr = -1;
-    while ((attr = bms_next_member(fdw_private->attrs_used, attr)) >= 0)
-        attrs_used = lappend_int(attrs_used, attr);
+    return expression_tree_walker(node, (bool (*)()) contain_param_walker, context);
+}
 
-    foreach (lc, fdw_private->attrs_sorted)
-        attrs_sorted = lappend_int(attrs_sorted, lfirst_int(lc));
+/*
+ * is_runtime_operand
+ *      Whether expression isn't a constant at planning time but is one for the
+ *      whole scan, i.e. it only depends on Params and stable functions.
+ */
+static bool is_runtime_operand(Node *node)
+{
+    return !IsA(node, Const) && !contain_var_clause(node) && !contain_volatile_functions(node)
+           && !contain_subplans(node)
+           && (contain_mutable_functions(node) || contain_param_walker(node, NULL));
+}
 
-    /* Packing all the data needed by executor into the list */
-    for (int item = 0; item < FDW_PLAN_STATE_END__; ++item) {
-        switch (item) {
-            case FDW_PLAN_STATE_FILENAMES:
-                params = lappend(params, fdw_private->filenames);
-                break;
+static bool contain_runtime_operand(Node *node, void *context)
+{
+    if (node == NULL)
+        return false;
 
-            case FDW_PLAN_STATE_ATTRS_USED:
-                params = lappend(params, attrs_used);
-                break;
+    if (is_runtime_operand(node))
+        return true;
 
-            case FDW_PLAN_STATE_ATTRS_SORTED:
-                params = lappend(params, attrs_sorted);
-                break;
+    return expression_tree_walker(node, (bool (*)()) contain_runtime_operand, context);
+}
 
-            case FDW_PLAN_STATE_USE_MMAP:
-                params = lappend(params, makeInteger(fdw_private->use_mmap));
-                break;
+struct RuntimeOperandsContext
+{
+    PlanState *  ps;
+    ExprContext *econtext;
+};
 
-            case FDW_PLAN_STATE_ROW_GROUPS_TO_SKIP:
-                params = lappend(params, fdw_private->rowGroupsToSkip);
-                break;
+/*
+ * evaluate_runtime_operands
+ *      Replace Params and stable function calls with their current values.
+ */
+static Node *evaluate_runtime_operands(Node *node, RuntimeOperandsContext *context)
+{
+    if (node == NULL)
+        return NULL;
 
-            default:
-                elog(ERROR, "FDW plan state item missing: %d", item);
-        }
+    if (is_runtime_operand(node))
+    {
+        const Oid  type  = exprType(node);
+        ExprState *state = ExecInitExpr((Expr *)node, context->ps);
+        Datum      value;
+        bool       isnull;
+        int16      typlen;
+        bool       typbyval;
+
+        get_typlenbyval(type, &typlen, &typbyval);
+        value = ExecEvalExpr(state, context->econtext, &isnull);
+        if (!isnull)
+            value = datumCopy(value, typbyval, typlen);
+
+        return (Node *)makeConst(type, exprTypmod(node), exprCollation(node), typlen, value,
+                                 isnull, typbyval);
     }
 
-    /* Create the ForeignScan node */
-    return make_foreignscan(tlist, scan_clauses, scan_relid, NIL, /* no expressions to evaluate */
-                            params, NIL,                          /* no custom tlist */
-                            NIL,                                  /* no remote quals */
-                            outer_plan);
+    return expression_tree_mutator(node, (Node * (*)()) evaluate_runtime_operands, (void *)context);
 }
 
-extern "C" void parquetBeginForeignScan(ForeignScanState *node, int eflags)
+/*
+ * prune_row_groups_at_execution
+ *      Prune row groups with the clauses which operands became known only at
+ *      execution time. This is done on the first iteration rather than at the
+ *      scan start as initplans aren't initialized at that point yet.
+ */
+static void prune_row_groups_at_execution(ForeignScanState *node, ParquetFdwExecutionState *festate)
 {
-    ParquetFdwExecutionState *festate;
-    MemoryContextCallback *   callback;
-    MemoryContext             reader_cxt;
-    ForeignScan *             plan        = (ForeignScan *)node->ss.ps.plan;
-    EState *                  estate      = node->ss.ps.state;
-    List *                    fdw_private = plan->fdw_private;
-    List *                    attrs_list;
-    ListCell *                lc, *lc2;
-    List *                    filenames    = NIL;
-    List *                    attrs_sorted = NIL;
-    bool                      use_mmap     = false;
-    int                       i            = 0;
-    List* rowGroupsToSkip = NIL;
+    RuntimeOperandsContext context;
+    MemoryContext          cxt;
+    MemoryContext          oldcxt;
+    List *                 clauses;
 
-    TupleTableSlot *slot        = node->ss.ss_ScanTupleSlot;
-    TupleDesc       tupleDesc   = slot->tts_tupleDescriptor;
-    auto            attrUseList = std::vector<bool>(tupleDesc->natts, false);
+    cxt    = festate->resetRuntimeContext();
+    oldcxt = MemoryContextSwitchTo(cxt);
 
-    /* Unwrap fdw_private */
-    foreach (lc, fdw_private)
+    context.ps       = &node->ss.ps;
+    context.econtext = node->ss.ps.ps_ExprContext;
+    clauses          = (List *)evaluate_runtime_operands((Node *)festate->getRuntimeClauses(),
+                                                         &context);
+
+    try
     {
-        switch (i)
+        festate->pruneRowGroups(clauses);
+    }
+    catch (std::exception &e)
+    {
+        elog(ERROR, "parquet_fdw: %s", e.what());
+    }
+
+    MemoryContextSwitchTo(oldcxt);
+}
+
+/*
+ * metadata_aggregate
+ *      Recognize aggregates that can be computed from parquet metadata:
+ *      count(*), count(col), min(col) and max(col). Footer min/max are
+ *      compared bytewise and don't account for NaNs, so min/max are only
+ *      taken from statistics for types where that is the same as in postgres.
+ *      Values of partition columns are exact and can be of any type.
+ */
+static bool metadata_aggregate(Aggref *                      aggref,
+                               Index                         relid,
+                               const std::vector<bool> &     partitionAttrs,
+                               MetadataAggregates::Aggregate *agg)
+{
+    const char *name;
+    Var *       var;
+
+    if (aggref->aggorder != NIL || aggref->aggdistinct != NIL || aggref->aggfilter != NULL
+        || aggref->aggkind != AGGKIND_NORMAL || aggref->agglevelsup != 0
+        || aggref->aggsplit != AGGSPLIT_SIMPLE
+        || get_func_namespace(aggref->aggfnoid) != PG_CATALOG_NAMESPACE)
+        return false;
+
+    name = get_func_name(aggref->aggfnoid);
+
+    if (aggref->aggstar)
+    {
+        agg->kind = MetadataAggregates::AGG_COUNT_STAR;
+        return strcmp(name, "count") == 0;
+    }
+
+    if (list_length(aggref->args) != 1)
+        return false;
+
+    var = (Var *)((TargetEntry *)linitial(aggref->args))->expr;
+    if (!IsA(var, Var) || (Index)var->varno != relid || var->varlevelsup != 0 || var->varattno <= 0)
+        return false;
+
+    agg->column.attIdx = var->varattno - 1;
+    agg->column.type   = var->vartype;
+    agg->column.collid = var->varcollid;
+
+    if (strcmp(name, "count") == 0)
+    {
+        agg->kind = MetadataAggregates::AGG_COUNT;
+        return true;
+    }
+
+    if (strcmp(name, "min") == 0)
+        agg->kind = MetadataAggregates::AGG_MIN;
+    else if (strcmp(name, "max") == 0)
+        agg->kind = MetadataAggregates::AGG_MAX;
+    else
+        return false;
+
+    if (aggref->aggtype != var->vartype)
+        return false;
+
+    if (!partitionAttrs.empty() && partitionAttrs[agg->column.attIdx])
+        return OidIsValid(lookup_type_cache(var->vartype, TYPECACHE_CMP_PROC)->cmp_proc);
+
+    switch (var->vartype)
+    {
+    case INT4OID:
+    case INT8OID:
+    case DATEOID:
+    case TIMESTAMPOID:
+    case BYTEAOID:
+        return true;
+    case TEXTOID:
+        return lc_collate_is_c(var->varcollid);
+    default:
+        return false;
+    }
+}
+
+/*
+ * add_metadata_aggregate_path
+ *      Add a path returning the aggregates of the query computed from the
+ *      footers if all the scanned row groups are known to match the
+ *      conditions entirely and all the aggregates can be computed from
+ *      statistics. The footers are read and the results computed here, the
+ *      scan just returns them.
+ */
+static void add_metadata_aggregate_path(PlannerInfo *root, RelOptInfo *input_rel, RelOptInfo *output_rel)
+{
+    auto                                       fdw_private = (ParquetFdwPlanState *)input_rel->fdw_private;
+    Query *                                    parse       = root->parse;
+    PathTarget *                               target      = root->upper_targets[UPPERREL_GROUP_AGG];
+    const Index                                relid       = input_rel->relid;
+    std::vector<MetadataAggregates::Column>    groupColumns;
+    std::vector<MetadataAggregates::Aggregate> aggregates;
+    std::vector<std::pair<bool, size_t>>       outputs; /* group column or aggregate */
+    List *                                     clauses           = NIL;
+    List *                                     partitionClauses  = NIL;
+    List *                                     rows              = NIL;
+    ListCell *                                 lc;
+    int                                        i;
+
+    if (parse->groupingSets != NIL || parse->havingQual != NULL || parse->hasTargetSRFs)
+        return;
+
+    RangeTblEntry *rte = root->simple_rte_array[relid];
+#if PG_VERSION_NUM < 120000
+    Relation rel = heap_open(rte->relid, AccessShareLock);
+#else
+    Relation rel = table_open(rte->relid, AccessShareLock);
+#endif
+    TupleDesc tupleDesc = RelationGetDescr(rel);
+#if PG_VERSION_NUM < 120000
+    heap_close(rel, AccessShareLock);
+#else
+    table_close(rel, AccessShareLock);
+#endif
+
+    const auto partitionAttrs = get_partition_attr_flags(fdw_private->partition_attrs, tupleDesc->natts);
+
+    /* Conditions must be decided by the partition values or the statistics alone */
+    foreach (lc, input_rel->baserestrictinfo)
+    {
+        RestrictInfo *rinfo      = (RestrictInfo *)lfirst(lc);
+        Node *        clause     = (Node *)rinfo->clause;
+        Bitmapset *   attrs      = NULL;
+        bool          hasRegular = false;
+        bool          hasPartition = false;
+        int           attIdx     = -1;
+
+        if (rinfo->pseudoconstant || contain_mutable_functions(clause) || contain_subplans(clause)
+            || contain_param_walker(clause, NULL))
+            return;
+
+        pull_varattnos(clause, relid, &attrs);
+        while ((attIdx = bms_next_member(attrs, attIdx)) >= 0)
         {
-        case FDW_PLAN_STATE_FILENAMES:
-            filenames = (List *)lfirst(lc);
-            break;
+            const AttrNumber attnum = attIdx + FirstLowInvalidHeapAttributeNumber;
 
-        case FDW_PLAN_STATE_ATTRS_USED:
-            attrs_list = (List *)lfirst(lc);
-            foreach (lc2, attrs_list)
-            {
-                const auto idx      = lfirst_int(lc2);
-                const auto attNum   = idx - 1 + FirstLowInvalidHeapAttributeNumber;
-                attrUseList[attNum] = true;
-            }
-            break;
+            if (attnum <= 0)
+                return;
+            if (!partitionAttrs.empty() && partitionAttrs[attnum - 1])
+                hasPartition = true;
+            else
+                hasRegular = true;
+        }
 
-        case FDW_PLAN_STATE_ATTRS_SORTED:
-            attrs_sorted = (List *)lfirst(lc);
-            break;
+        if (hasRegular && hasPartition)
+            return;
+        else if (hasPartition)
+            partitionClauses = lappend(partitionClauses, rinfo);
+        else
+            clauses = lappend(clauses, rinfo);
+    }
 
-        case FDW_PLAN_STATE_USE_MMAP:
-            use_mmap = (bool)intVal((Value *)lfirst(lc));
+    /* Only aggregates and partition columns grouped by can be returned */
+    i = 0;
+    foreach (lc, target->exprs)
+    {
+        Expr *      expr         = (Expr *)lfirst(lc);
+        const Index sortgroupref = get_pathtarget_sortgroupref(target, i++);
+
+        if (sortgroupref && get_sortgroupref_clause_noerr(sortgroupref, parse->groupClause))
+        {
+            Var *var = (Var *)expr;
+
+            if (!IsA(var, Var) || (Index)var->varno != relid || var->varlevelsup != 0 || var->varattno <= 0
+                || partitionAttrs.empty() || !partitionAttrs[var->varattno - 1])
+                return;
+
+            outputs.push_back({ true, groupColumns.size() });
+            groupColumns.push_back({ var->varattno - 1, var->vartype, var->varcollid });
+        }
+        else if (IsA(expr, Aggref))
+        {
+            MetadataAggregates::Aggregate agg;
+
+            if (!metadata_aggregate((Aggref *)expr, relid, partitionAttrs, &agg))
+                return;
+
+            outputs.push_back({ false, aggregates.size() });
+            aggregates.push_back(agg);
+        }
+        else
+            return;
+    }
+
+    if (groupColumns.size() != (size_t)list_length(parse->groupClause))
+        return;
+
+    MetadataAggregates metadataAggregates(groupColumns, aggregates);
+    Datum *            partitionValues = (Datum *)palloc0(sizeof(Datum) * tupleDesc->natts);
+    bool *             partitionNulls  = (bool *)palloc0(sizeof(bool) * tupleDesc->natts);
+    std::unique_ptr<HivePartitions> partitions;
+
+    if (fdw_private->partition_attrs != NIL)
+    {
+        partitions = std::make_unique<HivePartitions>(rte->relid, fdw_private->partition_attrs);
+        partitions->setClauses(relid, partitionClauses);
+    }
+
+    try
+    {
+        foreach (lc, fdw_private->filenames)
+        {
+            char *filename = strVal((Value *)lfirst(lc));
+
+            if (partitions)
+            {
+                if (!partitions->pathSatisfies(filename))
+                    return;
+                partitions->getValues(filename, partitionValues, partitionNulls);
+            }
+
+            auto reader = std::make_unique<ParquetFdwReader>(filename);
+
+            if (!partitionAttrs.empty())
+                reader->setPartitionAttrs(partitionAttrs);
+            reader->validateSchema(tupleDesc);
+
+            FilterPushdown filterPushdown(reader->getNumRowGroups());
+            filterPushdown.extract_rowgroup_filters(clauses);
+
+            if (!metadataAggregates.addFile(*reader, filterPushdown, partitionValues, partitionNulls))
+            {
+                elog(DEBUG1, "parquet_fdw: aggregates of file %s can't be computed from metadata",
+                     filename);
+                return;
+            }
+        }
+
+        for (const auto &group : metadataAggregates.getGroups())
+        {
+            List *row = NIL;
+
+            i = 0;
+            foreach (lc, target->exprs)
+            {
+                Expr *     expr = (Expr *)lfirst(lc);
+                const auto [isGroup, idx] = outputs[i++];
+                const Oid  type = exprType((Node *)expr);
+                int16      typlen;
+                bool       typbyval;
+
+                get_typlenbyval(type, &typlen, &typbyval);
+                row = lappend(row, makeConst(type, exprTypmod((Node *)expr), exprCollation((Node *)expr),
+                                             typlen,
+                                             isGroup ? group.keys[idx] : group.values[idx],
+                                             isGroup ? group.keyNulls[idx] : group.nulls[idx],
+                                             typbyval));
+            }
+            rows = lappend(rows, row);
+        }
+    }
+    catch (std::exception &e)
+    {
+        elog(ERROR, "parquet_fdw: %s", e.what());
+    }
+
+    const double numRows = std::max(list_length(rows), 1);
+    const Cost   cost    = cpu_tuple_cost * numRows;
+    List *       private_list =
+            list_make4(makeInteger(FDW_UPPER_METADATA), rows,
+                       makeInteger(list_length(fdw_private->filenames)),
+                       makeInteger(metadataAggregates.getNumRowGroups()));
+
+#if PG_VERSION_NUM < 120000
+    add_path(output_rel,
+             (Path *)create_foreignscan_path(root, output_rel, target, numRows, cost, cost,
+                                             NIL,     // no pathkeys
+                                             nullptr, // no outer rel either
+                                             nullptr, // no extra plan
+                                             private_list));
+#else
+    add_path(output_rel,
+             (Path *)create_foreign_upper_path(root, output_rel, target, numRows, cost, cost,
+                                               NIL,     // no pathkeys
+                                               nullptr, // no extra plan
+                                               private_list));
+#endif
+}
+
+/*
+ * vectorized_aggregate
+ *      Recognize aggregates the scan can compute over Arrow arrays: count,
+ *      sum and avg of integer and floating point columns, min and max of
+ *      those and of dates and timestamps. Partial aggregates return their
+ *      transition states, which are only plain values or arrays for the
+ *      aggregates of int8 columns if those are count, min or max.
+ */
+static bool vectorized_aggregate(Aggref *                     aggref,
+                                 Index                        relid,
+                                 const std::vector<bool> &    partitionAttrs,
+                                 VectorAggregates::Aggregate *agg)
+{
+    const bool  partial = aggref->aggsplit == AGGSPLIT_INITIAL_SERIAL;
+    const char *name;
+    Var *       var;
+    Oid         resultType;
+
+    if (aggref->aggorder != NIL || aggref->aggdistinct != NIL || aggref->aggfilter != NULL
+        || aggref->aggkind != AGGKIND_NORMAL || aggref->agglevelsup != 0
+        || (aggref->aggsplit != AGGSPLIT_SIMPLE && !partial)
+        || get_func_namespace(aggref->aggfnoid) != PG_CATALOG_NAMESPACE)
+        return false;
+
+    name = get_func_name(aggref->aggfnoid);
+
+    if (aggref->aggstar)
+    {
+        agg->kind   = VectorAggregates::AGG_COUNT_STAR;
+        agg->attIdx = -1;
+        return strcmp(name, "count") == 0;
+    }
+
+    if (list_length(aggref->args) != 1)
+        return false;
+
+    var = (Var *)((TargetEntry *)linitial(aggref->args))->expr;
+    if (!IsA(var, Var) || (Index)var->varno != relid || var->varlevelsup != 0 || var->varattno <= 0
+        || (!partitionAttrs.empty() && partitionAttrs[var->varattno - 1]))
+        return false;
+
+    agg->attIdx = var->varattno - 1;
+
+    if (strcmp(name, "count") == 0)
+    {
+        agg->kind = VectorAggregates::AGG_COUNT;
+        return true;
+    }
+    else if (strcmp(name, "sum") == 0)
+    {
+        agg->kind = VectorAggregates::AGG_SUM;
+        switch (var->vartype)
+        {
+        case INT4OID:
+            resultType = INT8OID;
+            break;
+        case INT8OID:
+            resultType = partial ? InvalidOid : NUMERICOID;
+            break;
+        case FLOAT4OID:
+        case FLOAT8OID:
+            resultType = var->vartype;
+            break;
+        default:
+            return false;
+        }
+    }
+    else if (strcmp(name, "avg") == 0)
+    {
+        agg->kind = VectorAggregates::AGG_AVG;
+        switch (var->vartype)
+        {
+        case INT4OID:
+            resultType = partial ? INT8ARRAYOID : NUMERICOID;
+            break;
+        case INT8OID:
+            resultType = partial ? InvalidOid : NUMERICOID;
+            break;
+        case FLOAT4OID:
+        case FLOAT8OID:
+            resultType = partial ? FLOAT8ARRAYOID : FLOAT8OID;
+            break;
+        default:
+            return false;
+        }
+    }
+    else if (strcmp(name, "min") == 0 || strcmp(name, "max") == 0)
+    {
+        agg->kind = strcmp(name, "min") == 0 ? VectorAggregates::AGG_MIN : VectorAggregates::AGG_MAX;
+        switch (var->vartype)
+        {
+        case INT4OID:
+        case INT8OID:
+        case FLOAT4OID:
+        case FLOAT8OID:
+        case DATEOID:
+        case TIMESTAMPOID:
+            resultType = var->vartype;
+            break;
+        default:
+            return false;
+        }
+    }
+    else
+        return false;
+
+    return OidIsValid(resultType) && aggref->aggtype == resultType;
+}
+
+/*
+ * vectorized_group_key
+ *      Whether rows can be grouped by the column by comparing its values
+ *      bytewise. Values of hive partition columns are compared as datums.
+ */
+static bool vectorized_group_key(Var *var, Index relid, const std::vector<bool> &partitionAttrs)
+{
+    if (!IsA(var, Var) || (Index)var->varno != relid || var->varlevelsup != 0 || var->varattno <= 0)
+        return false;
+
+    if (!partitionAttrs.empty() && partitionAttrs[var->varattno - 1])
+        return true;
+
+    switch (var->vartype)
+    {
+    case BOOLOID:
+    case INT4OID:
+    case INT8OID:
+    case DATEOID:
+    case TIMESTAMPOID:
+    case BYTEAOID:
+        return true;
+    case TEXTOID:
+#if PG_VERSION_NUM >= 120000
+        return !OidIsValid(var->varcollid) || get_collation_isdeterministic(var->varcollid);
+#else
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+/*
+ * scan_quals
+ *      Conditions of the table for upper scans to check on the rows they
+ *      read themselves. Fails if any of them can't be evaluated this way.
+ */
+static bool scan_quals(RelOptInfo *baserel, List **quals)
+{
+    ListCell *lc;
+
+    *quals = NIL;
+    foreach (lc, baserel->baserestrictinfo)
+    {
+        RestrictInfo *rinfo  = (RestrictInfo *)lfirst(lc);
+        Node *        clause = (Node *)rinfo->clause;
+        Bitmapset *   attrs  = NULL;
+        int           attIdx;
+
+        if (rinfo->pseudoconstant || contain_volatile_functions(clause) || contain_subplans(clause)
+            || contain_param_walker(clause, NULL))
+            return false;
+
+        /* No system columns or whole-row references */
+        pull_varattnos(clause, baserel->relid, &attrs);
+        attIdx = bms_next_member(attrs, -1);
+        if (attIdx >= 0 && attIdx + FirstLowInvalidHeapAttributeNumber <= 0)
+            return false;
+
+        *quals = lappend(*quals, rinfo->clause);
+    }
+    return true;
+}
+
+/*
+ * add_vectorized_aggregate_path
+ *      Add a path aggregating the rows of the table within the scan, over
+ *      Arrow arrays of whole row groups, instead of passing them to an
+ *      Aggregate node. The scan evaluates the conditions of the table itself.
+ *      With `partial` the path is a partial one returning transition states
+ *      of the aggregates for Finalize Aggregate above Gather to combine.
+ */
+static void add_vectorized_aggregate_path(PlannerInfo *root,
+                                          RelOptInfo * input_rel,
+                                          RelOptInfo * output_rel,
+                                          PathTarget * target,
+                                          List *       group_clause,
+                                          bool         partial)
+{
+    auto                                     fdw_private = (ParquetFdwPlanState *)input_rel->fdw_private;
+    Query *                                  parse       = root->parse;
+    const Index                              relid       = input_rel->relid;
+    std::vector<int>                         groupAttrs;
+    std::vector<VectorAggregates::Aggregate> aggregates;
+    List *                                   tlist         = NIL;
+    List *                                   quals         = NIL;
+    List *                                   group_attrs   = NIL;
+    List *                                   agg_list      = NIL;
+    List *                                   outputs       = NIL;
+    List *                                   group_exprs;
+    int                                      parallelWorkers = 0;
+    QualCost                                 qualCost;
+    ListCell *                               lc;
+    int                                      i;
+
+    if (parse->groupingSets != NIL || parse->havingQual != NULL || parse->hasTargetSRFs)
+        return;
+
+    if (partial)
+    {
+        if (input_rel->partial_pathlist == NIL || !output_rel->consider_parallel)
+            return;
+        parallelWorkers = ((Path *)linitial(input_rel->partial_pathlist))->parallel_workers;
+        if (parallelWorkers <= 0)
+            return;
+    }
+
+    RangeTblEntry *rte = root->simple_rte_array[relid];
+#if PG_VERSION_NUM < 120000
+    Relation rel = heap_open(rte->relid, AccessShareLock);
+#else
+    Relation rel = table_open(rte->relid, AccessShareLock);
+#endif
+    const int natts = RelationGetNumberOfAttributes(rel);
+#if PG_VERSION_NUM < 120000
+    heap_close(rel, AccessShareLock);
+#else
+    table_close(rel, AccessShareLock);
+#endif
+
+    const auto partitionAttrs = get_partition_attr_flags(fdw_private->partition_attrs, natts);
+
+    group_exprs = get_sortgrouplist_exprs(group_clause, parse->targetList);
+    foreach (lc, group_exprs)
+    {
+        Var *var = (Var *)lfirst(lc);
+
+        if (!vectorized_group_key(var, relid, partitionAttrs))
+            return;
+
+        groupAttrs.push_back(var->varattno - 1);
+        group_attrs = lappend_int(group_attrs, var->varattno);
+    }
+
+    /* The scan has to filter the rows by the conditions of the table itself */
+    if (!scan_quals(input_rel, &quals))
+        return;
+
+    /*
+     * The scan returns the group keys and the aggregates, expressions of
+     * those are computed by the target list of the plan
+     */
+    i = 0;
+    foreach (lc, target->exprs)
+    {
+        Expr *      expr         = (Expr *)lfirst(lc);
+        const Index sortgroupref = get_pathtarget_sortgroupref(target, i++);
+
+        if (sortgroupref && get_sortgroupref_clause_noerr(sortgroupref, group_clause))
+            tlist = add_to_flat_tlist(tlist, list_make1(expr));
+        else
+            tlist = add_to_flat_tlist(tlist, pull_var_clause((Node *)expr, PVC_INCLUDE_AGGREGATES
+                                                                                   | PVC_INCLUDE_PLACEHOLDERS));
+    }
+
+    foreach (lc, tlist)
+    {
+        Expr *expr = ((TargetEntry *)lfirst(lc))->expr;
+
+        if (IsA(expr, Aggref))
+        {
+            VectorAggregates::Aggregate agg;
+
+            if (!vectorized_aggregate((Aggref *)expr, relid, partitionAttrs, &agg))
+                return;
+
+            outputs  = lappend_int(outputs, aggregates.size());
+            agg_list = lappend(agg_list, list_make2_int(agg.kind, agg.attIdx + 1));
+            aggregates.push_back(agg);
+        }
+        else if (IsA(expr, Var))
+        {
+            const auto key = std::find(groupAttrs.begin(), groupAttrs.end(), ((Var *)expr)->varattno - 1);
+
+            if ((Index)((Var *)expr)->varno != relid || key == groupAttrs.end())
+                return;
+
+            outputs = lappend_int(outputs, -1 - (int)(key - groupAttrs.begin()));
+        }
+        else
+            return;
+    }
+
+    /*
+     * Rows are neither formed nor passed to an Aggregate node, only the ones
+     * checked against conditions are deformed into a slot
+     */
+    const double numGroups =
+            group_exprs == NIL ? 1.0
+#if PG_VERSION_NUM >= 140000
+                               : estimate_num_groups(root, group_exprs, input_rel->rows, NULL, NULL);
+#else
+                               : estimate_num_groups(root, group_exprs, input_rel->rows, NULL);
+#endif
+    const double parallelDivisor = partial ? parallel_divisor(parallelWorkers) : 1.0;
+
+    cost_qual_eval(&qualCost, quals, root);
+
+    const Cost diskRunCost = seq_page_cost * fdw_private->numPagesToRead;
+    const Cost decodeCost  = fdw_private->decodeCost;
+    const Cost filterCost  = quals != NIL
+                                   ? (cpu_tuple_cost + qualCost.per_tuple) * fdw_private->numRowsToRead
+                                   : 0.0;
+    const Cost aggCost     = VECTORIZED_AGG_COST_FRACTION * cpu_operator_cost * input_rel->rows
+                           * (aggregates.size() + groupAttrs.size());
+    const Cost totalCost   = diskRunCost + qualCost.startup + (decodeCost + filterCost + aggCost) / parallelDivisor
+                           + cpu_tuple_cost * numGroups;
+
+    List *private_list = NIL;
+    for (int item = 0; item <= FDW_AGGREGATE_TLIST; ++item)
+    {
+        switch (item)
+        {
+        case FDW_AGGREGATE_KIND:
+            private_list = lappend(private_list, makeInteger(FDW_UPPER_AGGREGATE));
+            break;
+        case FDW_AGGREGATE_SCAN:
+            /* Packed by parquetGetForeignPlan */
+            private_list = lappend(private_list, NIL);
+            break;
+        case FDW_AGGREGATE_RELID:
+            private_list = lappend(private_list, makeInteger((int)rte->relid));
+            break;
+        case FDW_AGGREGATE_GROUP_ATTRS:
+            private_list = lappend(private_list, group_attrs);
+            break;
+        case FDW_AGGREGATE_AGGREGATES:
+            private_list = lappend(private_list, agg_list);
+            break;
+        case FDW_AGGREGATE_OUTPUTS:
+            private_list = lappend(private_list, outputs);
+            break;
+        case FDW_AGGREGATE_QUALS:
+            private_list = lappend(private_list, quals);
+            break;
+        case FDW_AGGREGATE_PARTIAL:
+            private_list = lappend(private_list, makeInteger(partial));
+            break;
+        case FDW_AGGREGATE_DICTIONARY_GROUPS:
+            private_list = lappend(private_list, makeInteger(fdw_private->dictionary_groups));
+            break;
+        case FDW_AGGREGATE_TLIST:
+            private_list = lappend(private_list, tlist);
+            break;
+        }
+    }
+
+#if PG_VERSION_NUM < 120000
+    Path *path = (Path *)create_foreignscan_path(root, output_rel, target, numGroups, totalCost, totalCost,
+                                                 NIL,     // no pathkeys
+                                                 nullptr, // no outer rel either
+                                                 nullptr, // no extra plan
+                                                 private_list);
+#else
+    Path *path = (Path *)create_foreign_upper_path(root, output_rel, target, numGroups, totalCost, totalCost,
+                                                   NIL,     // no pathkeys
+                                                   nullptr, // no extra plan
+                                                   private_list);
+#endif
+
+    if (partial)
+    {
+        path->parallel_aware   = true;
+        path->parallel_safe    = true;
+        path->parallel_workers = parallelWorkers;
+        add_partial_path(output_rel, path);
+    }
+    else
+        add_path(output_rel, path);
+}
+
+#if PG_VERSION_NUM >= 120000
+/*
+ * limit_value
+ *      Value of a constant LIMIT or OFFSET clause, -1 if it is absent or NULL.
+ */
+static bool limit_value(Node *clause, int64 *value)
+{
+    *value = -1;
+    if (clause == NULL)
+        return true;
+
+    if (!IsA(clause, Const))
+        return false;
+
+    if (!((Const *)clause)->constisnull)
+    {
+        *value = DatumGetInt64(((Const *)clause)->constvalue);
+        /* Negative values are reported by the executor */
+        if (*value < 0)
+            return false;
+    }
+    return true;
+}
+
+/*
+ * add_limit_path
+ *      Scan replacing the Limit node right above it, which stops reading as
+ *      soon as enough rows are returned. Row groups within the offset are
+ *      passed over by their row counts without being read, and only the
+ *      pages holding the rows up to the limit are read of the last one.
+ *      Rows are only counted this way if none of them are filtered out by
+ *      conditions.
+ */
+static void add_limit_path(PlannerInfo *       root,
+                           RelOptInfo *        input_rel,
+                           RelOptInfo *        output_rel,
+                           FinalPathExtraData *extra)
+{
+    auto   fdw_private = (ParquetFdwPlanState *)input_rel->fdw_private;
+    Query *parse       = root->parse;
+    int64  count, offset;
+
+    if (!extra->limit_needed || parse->commandType != CMD_SELECT || parse->rowMarks != NIL
+        || parse->hasTargetSRFs || input_rel->baserestrictinfo != NIL)
+        return;
+
+#if PG_VERSION_NUM >= 130000
+    if (parse->limitOption != LIMIT_OPTION_COUNT)
+        return;
+#endif
+
+    if (!limit_value(parse->limitCount, &count) || !limit_value(parse->limitOffset, &offset))
+        return;
+    offset = std::max<int64>(offset, 0);
+
+    const double numRows  = fdw_private->numRowsToRead;
+    const double rows     = std::max(numRows - offset, 0.0);
+    const double outRows  = count >= 0 ? std::min<double>(count, rows) : rows;
+    const double fraction = numRows > 0 ? outRows / numRows : 0.0;
+    const Cost   cost     = (seq_page_cost * fdw_private->numPagesToRead + fdw_private->decodeCost
+                             + cpu_tuple_cost * numRows)
+                          * fraction;
+    const Cost   startup  = std::min(fdw_private->firstRowGroupCost, cost);
+
+    List *private_list = list_make4(makeInteger(FDW_UPPER_LIMIT),
+                                    makeConst(INT8OID, -1, InvalidOid, sizeof(int64),
+                                              Int64GetDatum(count), false, FLOAT8PASSBYVAL),
+                                    makeConst(INT8OID, -1, InvalidOid, sizeof(int64),
+                                              Int64GetDatum(offset), false, FLOAT8PASSBYVAL),
+                                    makeInteger(input_rel->relid));
+
+    add_path(output_rel,
+             (Path *)create_foreign_upper_path(root, output_rel, root->upper_targets[UPPERREL_FINAL], outRows,
+                                               startup, cost,
+                                               NIL,     // no pathkeys
+                                               nullptr, // no extra plan
+                                               private_list));
+}
+
+/*
+ * top_n_key
+ *      Attribute number, ordering operator, collation and nulls first of a
+ *      sort key on a column of the table, NIL if it's an expression.
+ */
+static List *top_n_key(PathKey *pathkey, Index relid)
+{
+    EquivalenceClass *ec = pathkey->pk_eclass;
+    ListCell *        lc;
+
+    if (ec->ec_has_volatile)
+        return NIL;
+
+    foreach (lc, ec->ec_members)
+    {
+        EquivalenceMember *em   = (EquivalenceMember *)lfirst(lc);
+        Expr *             expr = em->em_expr;
+        Oid                sortop;
+
+        if (em->em_is_child || em->em_is_const)
+            continue;
+
+        while (IsA(expr, RelabelType))
+            expr = ((RelabelType *)expr)->arg;
+
+        if (!IsA(expr, Var) || (Index)((Var *)expr)->varno != relid || ((Var *)expr)->varlevelsup != 0
+            || ((Var *)expr)->varattno <= 0)
+            continue;
+
+        sortop = get_opfamily_member(pathkey->pk_opfamily, em->em_datatype, em->em_datatype,
+                                     pathkey->pk_strategy);
+        if (!OidIsValid(sortop))
+            return NIL;
+
+        return list_make4_int(((Var *)expr)->varattno, (int)sortop, (int)ec->ec_collation,
+                              pathkey->pk_nulls_first);
+    }
+    return NIL;
+}
+
+/*
+ * add_top_n_path
+ *      Scan replacing the Sort and Limit nodes above it, which keeps the
+ *      first rows in the order of the query in a bounded heap. Row groups are
+ *      read in the order of their statistics of the first sort column, the
+ *      max ones for descending order, and reading stops at the first row
+ *      group none of whose rows may come before the last row of the heap.
+ *      For tables sorted or clustered by the column only the first few row
+ *      groups are read. The conditions of the table are checked by the scan.
+ */
+static void add_top_n_path(PlannerInfo *       root,
+                           RelOptInfo *        baserel,
+                           RelOptInfo *        output_rel,
+                           FinalPathExtraData *extra)
+{
+    auto      fdw_private = (ParquetFdwPlanState *)baserel->fdw_private;
+    Query *   parse       = root->parse;
+    List *    keys        = NIL;
+    List *    quals       = NIL;
+    int64     count, offset;
+    QualCost  qualCost;
+    ListCell *lc;
+
+    if (!extra->limit_needed || parse->commandType != CMD_SELECT || parse->rowMarks != NIL
+        || parse->hasTargetSRFs || root->sort_pathkeys == NIL)
+        return;
+
+#if PG_VERSION_NUM >= 130000
+    if (parse->limitOption != LIMIT_OPTION_COUNT)
+        return;
+#endif
+
+    /* Without a count all the rows are returned and have to be sorted anyway */
+    if (!limit_value(parse->limitCount, &count) || !limit_value(parse->limitOffset, &offset) || count < 0)
+        return;
+    offset = std::max<int64>(offset, 0);
+
+    foreach (lc, root->sort_pathkeys)
+    {
+        List *key = top_n_key((PathKey *)lfirst(lc), baserel->relid);
+
+        if (key == NIL)
+            return;
+        keys = lappend(keys, key);
+    }
+
+    if (!scan_quals(baserel, &quals))
+        return;
+
+    cost_qual_eval(&qualCost, quals, root);
+
+    /*
+     * Sorted tables are read up to the row group holding the last row kept,
+     * others entirely, unless their row groups happen to be clustered
+     */
+    const double numRows  = fdw_private->numRowsToRead;
+    const double bound    = (double)count + offset;
+    const double outRows  = std::min<double>(count, std::max(baserel->rows - offset, 0.0));
+    const bool   sorted   = fdw_private->attrs_sorted != NIL
+                        && linitial_int(fdw_private->attrs_sorted) == linitial_int((List *)linitial(keys));
+    const double fraction = sorted ? std::min(1.0, bound / std::max(baserel->rows, 1.0)) : 1.0;
+    const Cost   readCost = (seq_page_cost * fdw_private->numPagesToRead + fdw_private->decodeCost
+                             + (cpu_tuple_cost + qualCost.per_tuple) * numRows)
+                          * fraction;
+    /* Only the rows satisfying the conditions are put into the heap */
+    const Cost   heapCost = 2.0 * cpu_operator_cost * baserel->rows * fraction
+                          * LOG2(2.0 * std::max(bound, 1.0));
+    const Cost   startup  = qualCost.startup + readCost + heapCost;
+
+    List *private_list = NIL;
+    for (int item = 0; item <= FDW_LIMIT_QUALS; ++item)
+    {
+        switch (item)
+        {
+        case FDW_LIMIT_KIND:
+            private_list = lappend(private_list, makeInteger(FDW_UPPER_TOP_N));
+            break;
+        case FDW_LIMIT_COUNT:
+            private_list = lappend(private_list, makeConst(INT8OID, -1, InvalidOid, sizeof(int64),
+                                                           Int64GetDatum(count), false, FLOAT8PASSBYVAL));
+            break;
+        case FDW_LIMIT_OFFSET:
+            private_list = lappend(private_list, makeConst(INT8OID, -1, InvalidOid, sizeof(int64),
+                                                           Int64GetDatum(offset), false, FLOAT8PASSBYVAL));
             break;
+        case FDW_LIMIT_RELID:
+            private_list = lappend(private_list, makeInteger(baserel->relid));
+            break;
+        case FDW_LIMIT_KEYS:
+            private_list = lappend(private_list, keys);
+            break;
+        case FDW_LIMIT_QUALS:
+            private_list = lappend(private_list, quals);
+            break;
+        }
+    }
+
+    add_path(output_rel,
+             (Path *)create_foreign_upper_path(root, output_rel, root->upper_targets[UPPERREL_FINAL], outRows,
+                                               startup, startup + cpu_tuple_cost * outRows,
+                                               root->sort_pathkeys,
+                                               nullptr, // no extra plan
+                                               private_list));
+}
+#endif
+
+extern "C" void parquetGetForeignUpperPaths(PlannerInfo *    root,
+                                            UpperRelationKind stage,
+                                            RelOptInfo *     input_rel,
+                                            RelOptInfo *     output_rel,
+                                            void *           extra)
+{
+#if PG_VERSION_NUM >= 120000
+    /*
+     * Sorted rows of a single parquet table, the table is remembered for the
+     * Top-N scan of the final stage
+     */
+    if (stage == UPPERREL_ORDERED)
+    {
+        if (input_rel->reloptkind == RELOPT_BASEREL && output_rel->fdw_private == NULL)
+            output_rel->fdw_private = input_rel;
+        return;
+    }
+
+    if (stage == UPPERREL_FINAL && input_rel->fdw_private != NULL && output_rel->fdw_private == NULL
+        && input_rel == fetch_upper_rel(root, UPPERREL_ORDERED, NULL))
+    {
+        RelOptInfo *baserel = (RelOptInfo *)input_rel->fdw_private;
+
+        output_rel->fdw_private = baserel->fdw_private;
+        add_top_n_path(root, baserel, output_rel, (FinalPathExtraData *)extra);
+        return;
+    }
+#endif
+
+    /* Only aggregates and limits over a single parquet table, and only once */
+    if (input_rel->reloptkind != RELOPT_BASEREL || output_rel->fdw_private != NULL)
+        return;
+
+    switch (stage)
+    {
+    case UPPERREL_GROUP_AGG:
+        output_rel->fdw_private = input_rel->fdw_private;
+        add_metadata_aggregate_path(root, input_rel, output_rel);
+        add_vectorized_aggregate_path(root, input_rel, output_rel, output_rel->reltarget,
+                                      root->parse->groupClause, false);
+        break;
+
+    case UPPERREL_PARTIAL_GROUP_AGG:
+        output_rel->fdw_private = input_rel->fdw_private;
+        add_vectorized_aggregate_path(root, input_rel, output_rel, output_rel->reltarget,
+                                      root->parse->groupClause, true);
+        break;
+
+    case UPPERREL_DISTINCT:
+        /*
+         * DISTINCT of the rows of the table is grouping them without
+         * aggregates, the distinct rows are the ones of the input target
+         */
+        if (root->parse->hasDistinctOn)
+            break;
+        output_rel->fdw_private = input_rel->fdw_private;
+        add_vectorized_aggregate_path(root, input_rel, output_rel, input_rel->reltarget,
+                                      root->parse->distinctClause, false);
+        break;
+
+#if PG_VERSION_NUM >= 120000
+    case UPPERREL_FINAL:
+        output_rel->fdw_private = input_rel->fdw_private;
+        add_limit_path(root, input_rel, output_rel, (FinalPathExtraData *)extra);
+        break;
+#endif
+
+    default:
+        break;
+    }
+}
+
+/*
+ * hash_join_key
+ *      Columns of the probe and the build side compared by an equality join
+ *      clause. Only columns whose equal values are binary equal qualify, so
+ *      that the rows can be hashed by their encoded values.
+ */
+static bool hash_join_key(RestrictInfo *rinfo,
+                          RelOptInfo *  probe,
+                          RelOptInfo *  build,
+                          Var **        probeVar,
+                          Var **        buildVar)
+{
+    OpExpr *        expr = (OpExpr *)rinfo->clause;
+    TypeCacheEntry *typentry;
+    Var *           left, *right;
+
+    if (rinfo->pseudoconstant || !IsA(expr, OpExpr) || list_length(expr->args) != 2)
+        return false;
+
+    left  = (Var *)linitial(expr->args);
+    right = (Var *)lsecond(expr->args);
+    if (!IsA(left, Var) || !IsA(right, Var))
+        return false;
+
+    if ((Index)left->varno == probe->relid && (Index)right->varno == build->relid)
+    {
+        *probeVar = left;
+        *buildVar = right;
+    }
+    else if ((Index)left->varno == build->relid && (Index)right->varno == probe->relid)
+    {
+        *probeVar = right;
+        *buildVar = left;
+    }
+    else
+        return false;
+
+    if (left->vartype != right->vartype || !vectorized_group_key(*probeVar, probe->relid, {})
+        || !vectorized_group_key(*buildVar, build->relid, {}))
+        return false;
+
+#if PG_VERSION_NUM >= 120000
+    if (OidIsValid(expr->inputcollid) && !get_collation_isdeterministic(expr->inputcollid))
+        return false;
+#endif
+
+    typentry = lookup_type_cache(left->vartype, TYPECACHE_EQ_OPR);
+    return expr->opno == typentry->eq_opr;
+}
+
+/*
+ * parquetGetForeignJoinPaths
+ *      Add a path joining two parquet tables by equality of their columns
+ *      within a single scan. The rows of the table expected to return fewer
+ *      rows are kept in a hash table, then the other table is scanned and
+ *      its rows are looked up in it. Row groups of the probe side whose
+ *      statistics fall outside of the range of the keys of the hashed rows
+ *      are skipped. Conditions of the tables are checked by the scan.
+ */
+extern "C" void parquetGetForeignJoinPaths(PlannerInfo *      root,
+                                           RelOptInfo *       joinrel,
+                                           RelOptInfo *       outerrel,
+                                           RelOptInfo *       innerrel,
+                                           JoinType           jointype,
+                                           JoinPathExtraData *extra)
+{
+    List *    keys        = NIL;
+    List *    clauses     = NIL;
+    List *    tlist       = NIL;
+    List *    outputs     = NIL;
+    List *    build_quals = NIL;
+    List *    probe_quals = NIL;
+    ListCell *lc;
+
+    /* Only inner joins of two parquet tables, and only once */
+    if (!enable_hashjoin || joinrel->fdw_private != NULL || jointype != JOIN_INNER || outerrel->reloptkind != RELOPT_BASEREL
+        || innerrel->reloptkind != RELOPT_BASEREL || outerrel->fdw_private == NULL
+        || innerrel->fdw_private == NULL || !bms_is_empty(joinrel->lateral_relids))
+        return;
+    joinrel->fdw_private = outerrel->fdw_private;
+
+    /* Rows of the table returning fewer of them are hashed */
+    RelOptInfo *build = outerrel->rows <= innerrel->rows ? outerrel : innerrel;
+    RelOptInfo *probe = build == outerrel ? innerrel : outerrel;
+
+    foreach (lc, extra->restrictlist)
+    {
+        RestrictInfo *rinfo = (RestrictInfo *)lfirst(lc);
+        OpExpr *      expr  = (OpExpr *)rinfo->clause;
+        Var *         probeVar, *buildVar;
+
+        if (!hash_join_key(rinfo, probe, build, &probeVar, &buildVar))
+            return;
+
+        keys    = lappend(keys, list_make4_int(buildVar->varattno, probeVar->varattno,
+                                               (int)probeVar->vartype, (int)expr->inputcollid));
+        clauses = lappend(clauses, make_opclause(expr->opno, BOOLOID, false, (Expr *)copyObjectImpl(probeVar),
+                                                 (Expr *)copyObjectImpl(buildVar), InvalidOid,
+                                                 expr->inputcollid));
+    }
+    if (keys == NIL)
+        return;
+
+    /* The scan returns plain columns of the tables only */
+    foreach (lc, joinrel->reltarget->exprs)
+    {
+        Var *var = (Var *)lfirst(lc);
+
+        if (!IsA(var, Var) || var->varattno <= 0)
+            return;
+        tlist = add_to_flat_tlist(tlist, list_make1(var));
+    }
+    foreach (lc, tlist)
+    {
+        Var *var = (Var *)((TargetEntry *)lfirst(lc))->expr;
+
+        outputs = lappend(outputs, list_make2_int((Index)var->varno == probe->relid, var->varattno));
+    }
+
+    if (!scan_quals(build, &build_quals) || !scan_quals(probe, &probe_quals))
+        return;
+
+    /* The hashed rows have to fit into work_mem */
+    const double hashBytes =
+            build->rows * (MAXALIGN(build->reltarget->width) + MAXALIGN(SizeofMinimalTupleHeader));
+    if (hashBytes > work_mem * 1024.0)
+        return;
+
+    /*
+     * Both tables are read as by their own scans, but the rows are neither
+     * passed to a Hash node nor to a Hash Join one. Skipping of row groups of
+     * the probe side depends on the data and isn't accounted for.
+     */
+    const int  numKeys   = list_length(keys);
+    const Cost startup   = build->cheapest_total_path->total_cost + cpu_operator_cost * numKeys * build->rows;
+    const Cost totalCost = startup + probe->cheapest_total_path->total_cost
+                         + cpu_operator_cost * numKeys * probe->rows + cpu_tuple_cost * joinrel->rows;
+
+    List *private_list = NIL;
+    for (int item = 0; item <= FDW_JOIN_TLIST; ++item)
+    {
+        switch (item)
+        {
+        case FDW_JOIN_KIND:
+            private_list = lappend(private_list, makeInteger(FDW_UPPER_JOIN));
+            break;
+        case FDW_JOIN_BUILD_SCAN:
+        case FDW_JOIN_PROBE_SCAN:
+            /* Packed by parquetGetForeignPlan */
+            private_list = lappend(private_list, NIL);
+            break;
+        case FDW_JOIN_BUILD_RELID:
+            private_list = lappend(private_list, makeInteger((int)root->simple_rte_array[build->relid]->relid));
+            break;
+        case FDW_JOIN_BUILD_RTI:
+            private_list = lappend(private_list, makeInteger(build->relid));
+            break;
+        case FDW_JOIN_BUILD_QUALS:
+            private_list = lappend(private_list, build_quals);
+            break;
+        case FDW_JOIN_PROBE_RELID:
+            private_list = lappend(private_list, makeInteger((int)root->simple_rte_array[probe->relid]->relid));
+            break;
+        case FDW_JOIN_PROBE_RTI:
+            private_list = lappend(private_list, makeInteger(probe->relid));
+            break;
+        case FDW_JOIN_PROBE_QUALS:
+            private_list = lappend(private_list, probe_quals);
+            break;
+        case FDW_JOIN_KEYS:
+            private_list = lappend(private_list, keys);
+            break;
+        case FDW_JOIN_CLAUSES:
+            private_list = lappend(private_list, clauses);
+            break;
+        case FDW_JOIN_OUTPUTS:
+            private_list = lappend(private_list, outputs);
+            break;
+        case FDW_JOIN_TLIST:
+            private_list = lappend(private_list, tlist);
+            break;
+        }
+    }
+
+    add_path(joinrel,
+             (Path *)create_foreign_join_path(root, joinrel,
+                                              nullptr, // default pathtarget
+                                              joinrel->rows, startup, totalCost,
+                                              NIL,     // no pathkeys
+                                              nullptr, // no outer rel either
+                                              nullptr, // no extra plan
+                                              private_list));
+}
+
+/*
+ * pack_plan_state
+ *      Convert the planner state of the table scan into a list of nodes for
+ *      the executor.
+ */
+static List *pack_plan_state(ParquetFdwPlanState *fdw_private, bool sorted = false)
+{
+    List *     params       = NIL;
+    List *     attrs_used   = NIL;
+    List *     attrs_sorted = NIL;
+    AttrNumber attr;
+    ListCell * lc;
+
+    attr = -1;
+    while ((attr = bms_next_member(fdw_private->attrs_used, attr)) >= 0)
+        attrs_used = lappend_int(attrs_used, attr);
+
+    /* Files are only merged by scans whose output has to be sorted */
+    if (sorted)
+    {
+        foreach (lc, fdw_private->attrs_sorted)
+            attrs_sorted = lappend_int(attrs_sorted, lfirst_int(lc));
+    }
+
+    /* Packing all the data needed by executor into the list */
+    for (int item = 0; item < FDW_PLAN_STATE_END__; ++item) {
+        switch (item) {
+            case FDW_PLAN_STATE_FILES:
+                try
+                {
+                    /* Skip lists are built by executor if the size was estimated */
+                    params = lappend(params,
+                                     PlanPayload::encode(fdw_private->filenames,
+                                                         fdw_private->numSampledFiles > 0
+                                                                 ? NIL
+                                                                 : fdw_private->rowGroupsToSkip));
+                }
+                catch (std::exception &e)
+                {
+                    elog(ERROR, "parquet_fdw: %s", e.what());
+                }
+                break;
+
+            case FDW_PLAN_STATE_ATTRS_USED:
+                params = lappend(params, attrs_used);
+                break;
+
+            case FDW_PLAN_STATE_ATTRS_SORTED:
+                params = lappend(params, attrs_sorted);
+                break;
+
+            case FDW_PLAN_STATE_USE_MMAP:
+                params = lappend(params, makeInteger(fdw_private->use_mmap));
+                break;
+
+            case FDW_PLAN_STATE_PARTITION_ATTRS:
+                params = lappend(params, list_copy(fdw_private->partition_attrs));
+                break;
+
+            case FDW_PLAN_STATE_ESTIMATE:
+                /* Row groups are pruned by executor if the size was estimated */
+                if (fdw_private->numSampledFiles > 0)
+                    params = lappend(params,
+                                     list_make2(makeInteger(fdw_private->numSampledFiles),
+                                                makeFloat(psprintf("%.0f", fdw_private->rowsErrorBound))));
+                else
+                    params = lappend(params, NIL);
+                break;
+
+            case FDW_PLAN_STATE_DICTIONARY_PRUNING:
+                params = lappend(params, makeInteger(fdw_private->dictionary_pruning));
+                break;
+
+            case FDW_PLAN_STATE_LIMIT:
+                /* Set by parquetGetForeignPlan for limit scans */
+                params = lappend(params, NIL);
+                break;
+
+            case FDW_PLAN_STATE_TOP_N:
+                /* Set by parquetGetForeignPlan for Top-N scans */
+                params = lappend(params, NIL);
+                break;
+
+            default:
+                elog(ERROR, "FDW plan state item missing: %d", item);
+        }
+    }
+
+    return params;
+}
+
+struct ProjectionContext
+{
+    Index                    relid;
+    const std::vector<bool> *partitionAttrs;
+    List *                   quals;
+    List *                   exprs;
+};
+
+static bool expr_occurs_walker(Node *node, Node *expr)
+{
+    if (node == NULL)
+        return false;
+
+    if (equal(node, expr))
+        return true;
+
+    return expression_tree_walker(node, (bool (*)()) expr_occurs_walker, expr);
+}
+
+/*
+ * pull_projection_exprs
+ *      Collect the largest subexpressions the scan can compute over the
+ *      arrays of the columns, see VectorProjection. Only arguments of
+ *      operators and functions are looked into, which are evaluated for
+ *      every row unlike branches of CASE or arguments of aggregates.
+ *      Expressions occurring in the conditions are left out for the
+ *      conditions to refer to the columns only.
+ */
+static bool pull_projection_exprs(Node *node, ProjectionContext *context)
+{
+    if (node == NULL || IsA(node, Var) || IsA(node, Const))
+        return false;
+
+    if (!IsA(node, List) && !IsA(node, TargetEntry)
+        && VectorProjection::supported((Expr *)node, context->relid, *context->partitionAttrs)
+        && !expr_occurs_walker((Node *)context->quals, node))
+    {
+        context->exprs = list_append_unique(context->exprs, node);
+        return false;
+    }
+
+    if (IsA(node, List) || IsA(node, TargetEntry) || IsA(node, OpExpr) || IsA(node, FuncExpr)
+        || IsA(node, RelabelType))
+        return expression_tree_walker(node, (bool (*)()) pull_projection_exprs, context);
+
+    return false;
+}
+
+/*
+ * projection_scan_tlist
+ *      Scan target list with the expressions of the query target list the
+ *      scan computes over whole row groups after the columns of the table,
+ *      NIL if there are none. Vars and expressions of the plan refer to the
+ *      entries of the list after setrefs, so columns keep their numbers.
+ *      This is only done for plain scans of queries reading the single
+ *      table, whose target list is computed over the rows of the scan.
+ */
+static List *projection_scan_tlist(PlannerInfo *root,
+                                   RelOptInfo * baserel,
+                                   Oid          foreigntableid,
+                                   ForeignPath *best_path,
+                                   List *       quals)
+{
+    ParquetFdwPlanState *fdw_private = (ParquetFdwPlanState *)baserel->fdw_private;
+    ProjectionContext    context;
+    Bitmapset *          attrs  = NULL;
+    List *               tlist  = NIL;
+    int                  attIdx = -1;
+    ListCell *           lc;
+
+    if (best_path->path.pathkeys != NIL || PATH_REQ_OUTER(&best_path->path) != NULL
+        || root->parse->commandType != CMD_SELECT || root->parse->rowMarks != NIL
+        || bms_membership(root->all_baserels) != BMS_SINGLETON)
+        return NIL;
+
+    /* Whole-row references and system columns are not in the scan tuple */
+    pull_varattnos((Node *)baserel->reltarget->exprs, baserel->relid, &attrs);
+    pull_varattnos((Node *)quals, baserel->relid, &attrs);
+    while ((attIdx = bms_next_member(attrs, attIdx)) >= 0)
+    {
+        if (attIdx + FirstLowInvalidHeapAttributeNumber <= 0)
+            return NIL;
+    }
+
+#if PG_VERSION_NUM < 120000
+    Relation rel = heap_open(foreigntableid, AccessShareLock);
+#else
+    Relation rel = table_open(foreigntableid, AccessShareLock);
+#endif
+    TupleDesc  tupleDesc      = RelationGetDescr(rel);
+    const auto partitionAttrs = get_partition_attr_flags(fdw_private->partition_attrs, tupleDesc->natts);
+
+    context.relid          = baserel->relid;
+    context.partitionAttrs = &partitionAttrs;
+    context.quals          = quals;
+    context.exprs          = NIL;
+    pull_projection_exprs((Node *)root->processed_tlist, &context);
+
+    if (context.exprs != NIL)
+    {
+        for (int i = 0; i < tupleDesc->natts; ++i)
+        {
+            Form_pg_attribute attr = TupleDescAttr(tupleDesc, i);
+            Expr *            expr;
+
+            if (attr->attisdropped)
+                expr = (Expr *)makeNullConst(INT4OID, -1, InvalidOid);
+            else
+                expr = (Expr *)makeVar(baserel->relid, i + 1, attr->atttypid, attr->atttypmod,
+                                       attr->attcollation, 0);
+            tlist = lappend(tlist, makeTargetEntry(expr, i + 1, NULL, false));
+        }
+
+        foreach (lc, context.exprs)
+            tlist = lappend(tlist, makeTargetEntry((Expr *)copyObjectImpl(lfirst(lc)),
+                                                   list_length(tlist) + 1, NULL, false));
+    }
+
+#if PG_VERSION_NUM < 120000
+    heap_close(rel, AccessShareLock);
+#else
+    table_close(rel, AccessShareLock);
+#endif
+
+    return tlist;
+}
+
+extern "C" ForeignScan *parquetGetForeignPlan(PlannerInfo *root,
+                                              RelOptInfo * baserel,
+                                              Oid          foreigntableid,
+                                              ForeignPath *best_path,
+                                              List *       tlist,
+                                              List *       scan_clauses,
+                                              Plan *       outer_plan)
+{
+    ParquetFdwPlanState *fdw_private  = (ParquetFdwPlanState *)best_path->fdw_private;
+    Index                scan_relid   = baserel->relid;
+    List *               params = NIL;
+    List *               runtime_clauses = NIL;
+    Relids               outer_relids = PATH_REQ_OUTER(&best_path->path);
+    ListCell *           lc;
+
+    /*
+     * Tables joined by the scan. The conditions of the tables and the join
+     * clauses are evaluated by the scan on the rows of either table, and
+     * their Vars are left as they are.
+     */
+    if (IS_JOIN_REL(baserel))
+    {
+        int item = 0;
+
+        foreach (lc, best_path->fdw_private)
+        {
+            Node *value = (Node *)lfirst(lc);
+
+            if (item == FDW_JOIN_BUILD_SCAN || item == FDW_JOIN_PROBE_SCAN)
+            {
+                const Index rti = intVal(list_nth(best_path->fdw_private, item == FDW_JOIN_BUILD_SCAN
+                                                                                  ? FDW_JOIN_BUILD_RTI
+                                                                                  : FDW_JOIN_PROBE_RTI));
+
+                value = (Node *)pack_plan_state((ParquetFdwPlanState *)root->simple_rel_array[rti]->fdw_private);
+            }
+            else if (item == FDW_JOIN_BUILD_QUALS || item == FDW_JOIN_PROBE_QUALS
+                     || item == FDW_JOIN_CLAUSES)
+            {
+                /* Operators of the quals are looked up by executor */
+                value = (Node *)copyObjectImpl(value);
+                fix_opfuncids(value);
+            }
+            params = lappend(params, value);
+            item++;
+        }
+
+        return make_foreignscan(tlist, NIL, 0, NIL, params,
+                                (List *)list_nth(best_path->fdw_private, FDW_JOIN_TLIST),
+                                NIL, /* no remote quals */
+                                outer_plan);
+    }
+
+    /* Aggregates computed from metadata, the scan just returns them */
+    if (baserel->reloptkind == RELOPT_UPPER_REL
+        && intVal(linitial(best_path->fdw_private)) == FDW_UPPER_METADATA)
+        return make_foreignscan(tlist, NIL, 0, NIL, best_path->fdw_private,
+                                make_tlist_from_pathtarget(best_path->path.pathtarget),
+                                NIL, /* no remote quals */
+                                outer_plan);
+
+    /*
+     * The scan replaces the Limit node, and the Sort node of Top-N scans, and
+     * scans the table itself, the target list is computed over its rows as
+     * usual. Conditions checked by Top-N scans are passed as fdw_exprs for
+     * their Vars to be adjusted along with the rest of the plan.
+     */
+    if (baserel->reloptkind == RELOPT_UPPER_REL
+        && (intVal(linitial(best_path->fdw_private)) == FDW_UPPER_LIMIT
+            || intVal(linitial(best_path->fdw_private)) == FDW_UPPER_TOP_N))
+    {
+        const Index relid = intVal(list_nth(best_path->fdw_private, FDW_LIMIT_RELID));
+        List *      quals = NIL;
+
+        params = pack_plan_state((ParquetFdwPlanState *)baserel->fdw_private);
+        lfirst(list_nth_cell(params, FDW_PLAN_STATE_LIMIT)) =
+                list_make2(list_nth(best_path->fdw_private, FDW_LIMIT_COUNT),
+                           list_nth(best_path->fdw_private, FDW_LIMIT_OFFSET));
+
+        if (intVal(linitial(best_path->fdw_private)) == FDW_UPPER_TOP_N)
+        {
+            lfirst(list_nth_cell(params, FDW_PLAN_STATE_TOP_N)) = list_nth(best_path->fdw_private, FDW_LIMIT_KEYS);
+            quals = (List *)list_nth(best_path->fdw_private, FDW_LIMIT_QUALS);
+        }
+
+        return make_foreignscan(tlist, NIL, relid, quals, params, NIL, /* no custom tlist */
+                                NIL,                                   /* no remote quals */
+                                outer_plan);
+    }
+
+    /* Aggregates computed by the scan of the table */
+    if (baserel->reloptkind == RELOPT_UPPER_REL)
+    {
+        int item = 0;
+
+        foreach (lc, best_path->fdw_private)
+        {
+            Node *value = (Node *)lfirst(lc);
+
+            if (item == FDW_AGGREGATE_SCAN)
+                value = (Node *)pack_plan_state((ParquetFdwPlanState *)baserel->fdw_private);
+            else if (item == FDW_AGGREGATE_QUALS)
+            {
+                /* Operators of the quals are looked up by executor */
+                value = (Node *)copyObjectImpl(value);
+                fix_opfuncids(value);
+            }
+            params = lappend(params, value);
+            item++;
+        }
+
+        return make_foreignscan(tlist, NIL, 0, NIL, params,
+                                (List *)list_nth(best_path->fdw_private, FDW_AGGREGATE_TLIST),
+                                NIL, /* no remote quals */
+                                outer_plan);
+    }
+
+    /*
+     * Clauses comparing columns with Params or stable functions can't be
+     * used for row group filtering by planner. Pass them to executor to prune
+     * row groups when the values are known. The same goes for columns wrapped
+     * into stable functions like date_trunc() of timestamptz, which depend on
+     * settings, and for join clauses of parameterized paths, whose references
+     * to outer relations are replaced with Params by the core planner after
+     * this function.
+     */
+    foreach (lc, scan_clauses)
+    {
+        RestrictInfo *rinfo  = lfirst_node(RestrictInfo, lc);
+        Node *        clause = (Node *)rinfo->clause;
+
+        if (rinfo->pseudoconstant || contain_volatile_functions(clause))
+            continue;
+
+        if (contain_runtime_operand(clause, NULL) || contain_mutable_functions(clause)
+            || bms_overlap(rinfo->clause_relids, outer_relids))
+            runtime_clauses = lappend(runtime_clauses, clause);
+    }
+
+    /*
+     * We have no native ability to evaluate restriction clauses, so we just
+     * put all the scan_clauses into the plan node's qual list for the
+     * executor to check.  So all we have to do here is strip RestrictInfo
+     * nodes from the clauses and ignore pseudoconstants (which will be
+     * handled elsewhere).
+     */
+    scan_clauses = extract_actual_clauses(scan_clauses, false);
+
+    /*
+     * We can't just pass arbitrary structure into make_foreignscan() because
+     * in some cases (i.e. plan caching) postgres may want to make a copy of
+     * the plan and it can only make copy of something it knows of, namely
+     * Nodes. So we need to convert everything in nodes and store it in a List.
+     */
+    params = pack_plan_state(fdw_private, best_path->path.pathkeys != NIL);
+
+    /* Create the ForeignScan node */
+    return make_foreignscan(tlist, scan_clauses, scan_relid, runtime_clauses, params,
+                            projection_scan_tlist(root, baserel, foreigntableid, best_path, scan_clauses),
+                            NIL, /* no remote quals */
+                            outer_plan);
+}
+
+/*
+ * create_execution_state
+ *      Set up the reading of the files of the table scan from the unpacked
+ *      plan state, see pack_plan_state.
+ */
+static ParquetFdwExecutionState *create_execution_state(ForeignScanState *node,
+                                                        List *            fdw_private,
+                                                        Oid               relid,
+                                                        TupleDesc         tupleDesc,
+                                                        List *            runtime_clauses,
+                                                        List *            quals,
+                                                        int               eflags)
+{
+    ParquetFdwExecutionState *festate;
+    MemoryContextCallback *   callback;
+    MemoryContext             reader_cxt;
+    EState *                  estate      = node->ss.ps.state;
+    List *                    attrs_list;
+    ListCell *                lc, *lc2;
+    Const *                   files        = nullptr;
+    List *                    attrs_sorted = NIL;
+    bool                      use_mmap     = false;
+    bool                      dictionary_pruning = false;
+    int                       i            = 0;
+    List* partitionAttrs  = NIL;
+    List* estimate        = NIL;
+    List* limit           = NIL;
+    List* top_n           = NIL;
+    auto  attrUseList     = std::vector<bool>(tupleDesc->natts, false);
+
+    /* Unwrap fdw_private */
+    foreach (lc, fdw_private)
+    {
+        switch (i)
+        {
+        case FDW_PLAN_STATE_FILES:
+            files = (Const *)lfirst(lc);
+            break;
+
+        case FDW_PLAN_STATE_ATTRS_USED:
+            attrs_list = (List *)lfirst(lc);
+            foreach (lc2, attrs_list)
+            {
+                const auto idx      = lfirst_int(lc2);
+                const auto attNum   = idx - 1 + FirstLowInvalidHeapAttributeNumber;
+                attrUseList[attNum] = true;
+            }
+            break;
+
+        case FDW_PLAN_STATE_ATTRS_SORTED:
+            attrs_sorted = (List *)lfirst(lc);
+            break;
+
+        case FDW_PLAN_STATE_USE_MMAP:
+            use_mmap = (bool)intVal((Value *)lfirst(lc));
+            break;
+
+        case FDW_PLAN_STATE_PARTITION_ATTRS:
+            partitionAttrs = (List*)lfirst(lc);
+            break;
+
+        case FDW_PLAN_STATE_ESTIMATE:
+            estimate = (List*)lfirst(lc);
+            break;
+
+        case FDW_PLAN_STATE_DICTIONARY_PRUNING:
+            dictionary_pruning = (bool)intVal((Value *)lfirst(lc));
+            break;
+
+        case FDW_PLAN_STATE_LIMIT:
+            limit = (List *)lfirst(lc);
+            break;
+
+        case FDW_PLAN_STATE_TOP_N:
+            top_n = (List *)lfirst(lc);
+            break;
+
+        case FDW_PLAN_STATE_END__:
+            break;
+
+        default:
+            elog(ERROR, "Unknown FDW plan state item number: %d", i);
+        }
+        ++i;
+    }
+
+    MemoryContext cxt = estate->es_query_cxt;
+    reader_cxt = AllocSetContextCreate(cxt, "parquet_fdw tuple data", ALLOCSET_DEFAULT_SIZES);
+
+    std::vector<SortSupportData> sort_keys;
+    foreach (lc, attrs_sorted)
+    {
+        SortSupportData sort_key;
+        int             attr = lfirst_int(lc);
+        Oid             typid;
+        int             typmod;
+        Oid             collid;
+        Oid             sort_op;
+
+        memset(&sort_key, 0, sizeof(SortSupportData));
+
+        get_atttypetypmodcoll(relid, attr, &typid, &typmod, &collid);
+
+        sort_key.ssup_cxt         = reader_cxt;
+        sort_key.ssup_collation   = collid;
+        sort_key.ssup_nulls_first = false;
+        sort_key.ssup_attno       = attr;
+        sort_key.abbreviate       = false;
+
+        get_sort_group_operators(typid, true, false, false, &sort_op, nullptr, nullptr, nullptr);
+
+        PrepareSortSupportFromOrderingOp(sort_op, &sort_key);
+
+        try
+        {
+            sort_keys.push_back(sort_key);
+        }
+        catch (std::exception &e)
+        {
+            elog(ERROR, "parquet_fdw: scan initialization failed: %s", e.what());
+        }
+    }
+
+    festate = new ParquetFdwExecutionState(reader_cxt, tupleDesc, attrUseList, use_mmap);
+    festate->setPartitionAttrs(get_partition_attr_flags(partitionAttrs, tupleDesc->natts));
+    festate->setDictionaryPruning(dictionary_pruning);
+    festate->setSortKeys(sort_keys);
+    if (!(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+        festate->setRuntimeClauses(runtime_clauses);
+    festate->setPageFilterClauses(quals);
+    if (limit != NIL && top_n == NIL)
+        festate->setLimit(DatumGetInt64(((Const *)linitial(limit))->constvalue),
+                          DatumGetInt64(((Const *)lsecond(limit))->constvalue));
+
+    if (files) {
+        Datum *partitionValues = (Datum *)palloc0(sizeof(Datum) * tupleDesc->natts);
+        bool * partitionNulls  = (bool *)palloc0(sizeof(bool) * tupleDesc->natts);
+        std::unique_ptr<HivePartitions> partitions;
+        std::vector<PlanPayload::File>  filesToRead;
+
+        if (partitionAttrs)
+            partitions = std::make_unique<HivePartitions>(relid, partitionAttrs);
+
+        try
+        {
+            filesToRead = PlanPayload::decode(files);
+        }
+        catch (std::exception &e)
+        {
+            elog(ERROR, "parquet_fdw: %s", e.what());
+        }
+
+        for (const auto &file : filesToRead)
+        {
+            const char *filename = file.path.c_str();
+
+            if (partitions)
+                partitions->getValues(filename, partitionValues, partitionNulls);
+
+            try
+            {
+                /*
+                 * Footers of most files weren't read during planning if the
+                 * size was estimated, so row groups are filtered here using
+                 * the scan quals.
+                 */
+                if (!estimate)
+                    festate->addFileToRead(filename, reader_cxt, file.rowGroupsToSkip,
+                                           partitionValues, partitionNulls);
+                else if (!festate->addFileToPrune(filename, reader_cxt, quals,
+                                                  partitionValues, partitionNulls))
+                    elog(DEBUG1, "parquet_fdw: skipping file %s", filename);
+            }
+            catch (std::exception &e)
+            {
+                elog(ERROR, "parquet_fdw: %s", e.what());
+            }
+        }
+    }
+
+    if (top_n != NIL)
+    {
+        std::vector<SortSupportData> top_n_keys;
+
+        foreach (lc, top_n)
+        {
+            List *          key = (List *)lfirst(lc);
+            SortSupportData sort_key;
+
+            memset(&sort_key, 0, sizeof(SortSupportData));
+
+            sort_key.ssup_cxt         = reader_cxt;
+            sort_key.ssup_attno       = linitial_int(key);
+            sort_key.ssup_collation   = (Oid)lthird_int(key);
+            sort_key.ssup_nulls_first = (bool)lfourth_int(key);
+            sort_key.abbreviate       = false;
+
+            PrepareSortSupportFromOrderingOp((Oid)lsecond_int(key), &sort_key);
+
+            try
+            {
+                top_n_keys.push_back(sort_key);
+            }
+            catch (std::exception &e)
+            {
+                elog(ERROR, "parquet_fdw: scan initialization failed: %s", e.what());
+            }
+        }
+
+        try
+        {
+            festate->setTopN(top_n_keys, DatumGetInt64(((Const *)linitial(limit))->constvalue),
+                             DatumGetInt64(((Const *)lsecond(limit))->constvalue),
+                             ExecInitQual(quals, &node->ss.ps), node->ss.ps.ps_ExprContext);
+        }
+        catch (std::exception &e)
+        {
+            elog(ERROR, "parquet_fdw: %s", e.what());
+        }
+    }
+
+    /*
+     * Enable automatic execution state destruction by using memory context
+     * callback
+     */
+    callback       = (MemoryContextCallback *)palloc(sizeof(MemoryContextCallback));
+    callback->func = destroy_parquet_state;
+    callback->arg  = (void *)festate;
+    MemoryContextRegisterResetCallback(reader_cxt, callback);
+
+    return festate;
+}
+
+
+/*
+ * relation_tuple_desc
+ *      Copy of the tuple descriptor of a table scanned by a scan without a
+ *      relation of its own.
+ */
+static TupleDesc relation_tuple_desc(Oid relid)
+{
+    TupleDesc tupleDesc;
+
+#if PG_VERSION_NUM < 120000
+    Relation rel = heap_open(relid, NoLock);
+    tupleDesc    = CreateTupleDescCopy(RelationGetDescr(rel));
+    heap_close(rel, NoLock);
+#else
+    Relation rel = table_open(relid, NoLock);
+    tupleDesc    = CreateTupleDescCopy(RelationGetDescr(rel));
+    table_close(rel, NoLock);
+#endif
+
+    return tupleDesc;
+}
+
+/*
+ * begin_aggregate_scan
+ *      Set up the scan of the table and the aggregation of its rows.
+ */
+static void begin_aggregate_scan(ForeignScanState *node, int eflags)
+{
+    ForeignScan *         plan        = (ForeignScan *)node->ss.ps.plan;
+    EState *              estate      = node->ss.ps.state;
+    List *                fdw_private = plan->fdw_private;
+    const Oid             relid       = (Oid)intVal(list_nth(fdw_private, FDW_AGGREGATE_RELID));
+    List *                quals       = (List *)list_nth(fdw_private, FDW_AGGREGATE_QUALS);
+    const bool            partial     = intVal(list_nth(fdw_private, FDW_AGGREGATE_PARTIAL));
+    AggregateScanState *  state;
+    MemoryContextCallback *callback;
+    MemoryContext          agg_cxt;
+    TupleDesc             tupleDesc;
+    std::vector<int>      groupAttrs;
+    std::vector<VectorAggregates::Aggregate> aggregates;
+    ListCell *            lc;
+
+    tupleDesc = relation_tuple_desc(relid);
+
+    foreach (lc, (List *)list_nth(fdw_private, FDW_AGGREGATE_GROUP_ATTRS))
+        groupAttrs.push_back(lfirst_int(lc) - 1);
+
+    foreach (lc, (List *)list_nth(fdw_private, FDW_AGGREGATE_AGGREGATES))
+    {
+        List *agg = (List *)lfirst(lc);
+
+        aggregates.push_back({ (VectorAggregates::Kind)linitial_int(agg), lsecond_int(agg) - 1 });
+    }
+
+    agg_cxt = AllocSetContextCreate(estate->es_query_cxt, "parquet_fdw aggregates", ALLOCSET_DEFAULT_SIZES);
+
+    state          = new AggregateScanState();
+    state->festate = create_execution_state(node, (List *)list_nth(fdw_private, FDW_AGGREGATE_SCAN), relid,
+                                            tupleDesc, NIL, quals, eflags);
+    try
+    {
+        state->aggregates = new VectorAggregates(agg_cxt, tupleDesc, groupAttrs, aggregates, partial);
+    }
+    catch (std::exception &e)
+    {
+        elog(ERROR, "parquet_fdw: %s", e.what());
+    }
+
+    /*
+     * Without conditions every row of a row group falls into the groups of
+     * its dictionary. Dictionaries may hold values no row refers to though,
+     * so this is only done if the table says they don't.
+     */
+    if (quals == NIL && intVal(list_nth(fdw_private, FDW_AGGREGATE_DICTIONARY_GROUPS)))
+        state->festate->setDictionaryGroups(state->aggregates);
+
+    foreach (lc, (List *)list_nth(fdw_private, FDW_AGGREGATE_OUTPUTS))
+        state->outputs.push_back(lfirst_int(lc));
+
+    if (quals != NIL)
+    {
+        state->qual = ExecInitQual(quals, &node->ss.ps);
+#if PG_VERSION_NUM < 120000
+        state->rowSlot = ExecInitExtraTupleSlot(estate, tupleDesc);
+#else
+        state->rowSlot = ExecInitExtraTupleSlot(estate, tupleDesc, &TTSOpsVirtual);
+#endif
+    }
+    state->outputCxt = AllocSetContextCreate(agg_cxt, "parquet_fdw aggregate results", ALLOCSET_DEFAULT_SIZES);
+
+    /* Destroyed along with the rest of the query memory */
+    callback       = (MemoryContextCallback *)palloc(sizeof(MemoryContextCallback));
+    callback->func = destroy_aggregate_state;
+    callback->arg  = (void *)state;
+    MemoryContextRegisterResetCallback(estate->es_query_cxt, callback);
+
+    node->fdw_state = state;
+}
+
+/*
+ * begin_join_scan
+ *      Set up the scans of both tables and the hash table of the rows of the
+ *      build side.
+ */
+static void begin_join_scan(ForeignScanState *node, int eflags)
+{
+    ForeignScan *          plan        = (ForeignScan *)node->ss.ps.plan;
+    EState *               estate      = node->ss.ps.state;
+    List *                 fdw_private = plan->fdw_private;
+    const Oid              buildRelid  = (Oid)intVal(list_nth(fdw_private, FDW_JOIN_BUILD_RELID));
+    const Oid              probeRelid  = (Oid)intVal(list_nth(fdw_private, FDW_JOIN_PROBE_RELID));
+    List *                 buildQuals  = (List *)list_nth(fdw_private, FDW_JOIN_BUILD_QUALS);
+    List *                 probeQuals  = (List *)list_nth(fdw_private, FDW_JOIN_PROBE_QUALS);
+    TupleDesc              buildDesc   = relation_tuple_desc(buildRelid);
+    TupleDesc              probeDesc   = relation_tuple_desc(probeRelid);
+    JoinScanState *        state;
+    MemoryContextCallback *callback;
+    MemoryContext          join_cxt;
+    std::vector<JoinHashTable::Key> keys;
+    ListCell *             lc;
+
+    foreach (lc, (List *)list_nth(fdw_private, FDW_JOIN_KEYS))
+    {
+        List *key = (List *)lfirst(lc);
+
+        keys.push_back({ linitial_int(key) - 1, lsecond_int(key) - 1, (Oid)lthird_int(key),
+                         (Oid)lfourth_int(key) });
+    }
+
+    join_cxt = AllocSetContextCreate(estate->es_query_cxt, "parquet_fdw hash join", ALLOCSET_DEFAULT_SIZES);
+
+    state        = new JoinScanState();
+    state->build = create_execution_state(node, (List *)list_nth(fdw_private, FDW_JOIN_BUILD_SCAN), buildRelid,
+                                          buildDesc, NIL, buildQuals, eflags);
+    state->probe = create_execution_state(node, (List *)list_nth(fdw_private, FDW_JOIN_PROBE_SCAN), probeRelid,
+                                          probeDesc, NIL, probeQuals, eflags);
+    state->numProbeRowGroups = state->probe->getNumRowGroupsToRead();
+    try
+    {
+        state->table = new JoinHashTable(join_cxt, keys);
+    }
+    catch (std::exception &e)
+    {
+        elog(ERROR, "parquet_fdw: %s", e.what());
+    }
+
+    foreach (lc, (List *)list_nth(fdw_private, FDW_JOIN_OUTPUTS))
+    {
+        List *output = (List *)lfirst(lc);
+
+        state->outputs.push_back({ (bool)linitial_int(output), lsecond_int(output) - 1 });
+    }
+
+    if (buildQuals != NIL)
+        state->buildQual = ExecInitQual(buildQuals, &node->ss.ps);
+    if (probeQuals != NIL)
+        state->probeQual = ExecInitQual(probeQuals, &node->ss.ps);
+#if PG_VERSION_NUM < 120000
+    state->buildSlot = ExecInitExtraTupleSlot(estate, buildDesc);
+    state->probeSlot = ExecInitExtraTupleSlot(estate, probeDesc);
+    state->matchSlot = ExecInitExtraTupleSlot(estate, buildDesc);
+#else
+    state->buildSlot = ExecInitExtraTupleSlot(estate, buildDesc, &TTSOpsVirtual);
+    state->probeSlot = ExecInitExtraTupleSlot(estate, probeDesc, &TTSOpsVirtual);
+    state->matchSlot = ExecInitExtraTupleSlot(estate, buildDesc, &TTSOpsMinimalTuple);
+#endif
+
+    /* Destroyed along with the rest of the query memory */
+    callback       = (MemoryContextCallback *)palloc(sizeof(MemoryContextCallback));
+    callback->func = destroy_join_state;
+    callback->arg  = (void *)state;
+    MemoryContextRegisterResetCallback(estate->es_query_cxt, callback);
+
+    node->fdw_state = state;
+}
+
+/*
+ * is_join_scan
+ *      Whether the scan joins two tables, see begin_join_scan.
+ */
+static bool is_join_scan(ForeignScanState *node)
+{
+    ForeignScan *plan = (ForeignScan *)node->ss.ps.plan;
+
+    return plan->scan.scanrelid == 0 && intVal(linitial(plan->fdw_private)) == FDW_UPPER_JOIN;
+}
+
+static bool is_top_n_scan(ForeignScanState *node)
+{
+    ForeignScan *plan = (ForeignScan *)node->ss.ps.plan;
+
+    return plan->scan.scanrelid != 0 && list_nth(plan->fdw_private, FDW_PLAN_STATE_TOP_N) != NIL;
+}
+
+/*
+ * begin_projection_scan
+ *      Set up the scan of the table computing expressions of the target
+ *      list, see projection_scan_tlist. Only the columns and expressions the
+ *      target list and the qual refer to are put into the scan tuple. The
+ *      qual is checked by the scan itself, so that the expressions are only
+ *      computed for the rows it returns.
+ */
+static void begin_projection_scan(ForeignScanState *node, int eflags)
+{
+    ForeignScan *             plan      = (ForeignScan *)node->ss.ps.plan;
+    TupleDesc                 tupleDesc = CreateTupleDescCopy(RelationGetDescr(node->ss.ss_currentRelation));
+    ParquetFdwExecutionState *festate;
+    Bitmapset *               attrs  = NULL;
+    int                       attIdx = -1;
+    std::vector<bool>         emitList(tupleDesc->natts, false);
+    std::vector<Expr *>       exprs;
+    std::vector<int>          outputAttrs;
+
+    festate = create_execution_state(node, plan->fdw_private, RelationGetRelid(node->ss.ss_currentRelation),
+                                     tupleDesc, plan->fdw_exprs, plan->scan.plan.qual, eflags);
+    node->fdw_state = festate;
+
+    pull_varattnos((Node *)plan->scan.plan.targetlist, INDEX_VAR, &attrs);
+    pull_varattnos((Node *)plan->scan.plan.qual, INDEX_VAR, &attrs);
+    while ((attIdx = bms_next_member(attrs, attIdx)) >= 0)
+    {
+        const int attnum = attIdx + FirstLowInvalidHeapAttributeNumber;
+
+        if (attnum <= 0)
+            continue;
+
+        if (attnum <= tupleDesc->natts)
+            emitList[attnum - 1] = true;
+        else
+        {
+            exprs.push_back(((TargetEntry *)list_nth(plan->fdw_scan_tlist, attnum - 1))->expr);
+            outputAttrs.push_back(attnum - 1);
+        }
+    }
+
+    if (exprs.empty())
+        return;
+
+    MemoryContext cxt = AllocSetContextCreate(node->ss.ps.state->es_query_cxt,
+                                              "parquet_fdw computed expressions", ALLOCSET_DEFAULT_SIZES);
+
+    try
+    {
+        festate->setProjection(new VectorProjection(cxt, exprs, outputAttrs), emitList, node->ss.ps.qual,
+                               node->ss.ps.ps_ExprContext);
+    }
+    catch (std::exception &e)
+    {
+        elog(ERROR, "parquet_fdw: %s", e.what());
+    }
+    node->ss.ps.qual = NULL;
+}
+
+extern "C" void parquetBeginForeignScan(ForeignScanState *node, int eflags)
+{
+    ForeignScan *plan        = (ForeignScan *)node->ss.ps.plan;
+    List *       fdw_private = plan->fdw_private;
+
+    /* Aggregates computed from metadata during planning */
+    if (plan->scan.scanrelid == 0 && intVal(linitial(fdw_private)) == FDW_UPPER_METADATA)
+    {
+        MetadataScanState *state = (MetadataScanState *)palloc0(sizeof(MetadataScanState));
+
+        state->rows     = (List *)list_nth(fdw_private, FDW_METADATA_ROWS);
+        node->fdw_state = state;
+        return;
+    }
+
+    if (is_join_scan(node))
+    {
+        begin_join_scan(node, eflags);
+        return;
+    }
+
+    if (plan->scan.scanrelid == 0)
+    {
+        begin_aggregate_scan(node, eflags);
+        return;
+    }
+
+    /* fdw_exprs of Top-N scans are the conditions they check, see parquetGetForeignPlan */
+    if (is_top_n_scan(node))
+        node->fdw_state = create_execution_state(node, fdw_private, RelationGetRelid(node->ss.ss_currentRelation),
+                                                 node->ss.ss_ScanTupleSlot->tts_tupleDescriptor,
+                                                 NIL, plan->fdw_exprs, eflags);
+    else if (plan->fdw_scan_tlist != NIL)
+        begin_projection_scan(node, eflags);
+    else
+        node->fdw_state = create_execution_state(node, fdw_private, RelationGetRelid(node->ss.ss_currentRelation),
+                                                 node->ss.ss_ScanTupleSlot->tts_tupleDescriptor,
+                                                 plan->fdw_exprs, plan->scan.plan.qual, eflags);
+}
+
+/*
+ * iterate_metadata_scan
+ *      Return the next row of aggregates computed from metadata.
+ */
+static TupleTableSlot *iterate_metadata_scan(ForeignScanState *node)
+{
+    MetadataScanState *state = (MetadataScanState *)node->fdw_state;
+    TupleTableSlot *   slot  = node->ss.ss_ScanTupleSlot;
+    ListCell *         lc;
+    int                i = 0;
+
+    ExecClearTuple(slot);
+    if (state->nextRow >= list_length(state->rows))
+        return slot;
+
+    foreach (lc, (List *)list_nth(state->rows, state->nextRow++))
+    {
+        Const *value = (Const *)lfirst(lc);
+
+        slot->tts_values[i] = value->constvalue;
+        slot->tts_isnull[i] = value->constisnull;
+        i++;
+    }
+
+    return ExecStoreVirtualTuple(slot);
+}
+
+/*
+ * is_aggregate_scan
+ *      Whether the scan computes aggregates over the rows of the table, see
+ *      begin_aggregate_scan.
+ */
+static bool is_aggregate_scan(ForeignScanState *node)
+{
+    ForeignScan *plan = (ForeignScan *)node->ss.ps.plan;
+
+    return plan->scan.scanrelid == 0 && intVal(linitial(plan->fdw_private)) == FDW_UPPER_AGGREGATE;
+}
+
+/*
+ * scan_execution_state
+ *      State of the reading of the files, nullptr for aggregates computed
+ *      from metadata and for joins.
+ */
+static ParquetFdwExecutionState *scan_execution_state(ForeignScanState *node)
+{
+    if (is_aggregate_scan(node))
+        return ((AggregateScanState *)node->fdw_state)->festate;
+    if (((Scan *)node->ss.ps.plan)->scanrelid == 0)
+        return nullptr;
+    return (ParquetFdwExecutionState *)node->fdw_state;
+}
+
+/*
+ * aggregate_rows
+ *      Feed all the row groups of the scan to the aggregates. Rows are
+ *      checked against the remaining clauses one by one if there are any.
+ */
+static void aggregate_rows(ForeignScanState *node, AggregateScanState *state)
+{
+    ExprContext *         econtext = node->ss.ps.ps_ExprContext;
+    std::vector<uint32_t> rows;
+    ParquetFdwReader *    reader;
+
+    while ((reader = state->festate->nextRowGroup()) != nullptr)
+    {
+        rows.clear();
+
+        if (state->qual)
+        {
+            while (!reader->finishedReadingRowGroup())
+            {
+                const uint32_t row = reader->getRow();
+
+                ExecClearTuple(state->rowSlot);
+                if (!reader->next(state->rowSlot))
+                    break;
+                ExecStoreVirtualTuple(state->rowSlot);
+
+                econtext->ecxt_scantuple = state->rowSlot;
+                if (ExecQual(state->qual, econtext))
+                    rows.push_back(row);
+                ResetExprContext(econtext);
+            }
+        }
+        else
+        {
+            rows.resize(reader->getBufferedNumRows());
+            std::iota(rows.begin(), rows.end(), 0);
+        }
+
+        state->aggregates->addRowGroup(*reader, rows);
+        CHECK_FOR_INTERRUPTS();
+    }
+}
+
+/*
+ * iterate_aggregate_scan
+ *      Aggregate the whole table on the first call, then return the groups
+ *      one by one.
+ */
+static TupleTableSlot *iterate_aggregate_scan(ForeignScanState *node)
+{
+    AggregateScanState *state = (AggregateScanState *)node->fdw_state;
+    TupleTableSlot *    slot  = node->ss.ss_ScanTupleSlot;
+
+    ExecClearTuple(slot);
+    try
+    {
+        if (!state->aggregated)
+        {
+            aggregate_rows(node, state);
+            state->aggregated = true;
+        }
+
+        if (state->nextGroup >= state->aggregates->getNumGroups())
+            return slot;
+
+        MemoryContextReset(state->outputCxt);
+        MemoryContext oldcxt = MemoryContextSwitchTo(state->outputCxt);
+        state->aggregates->getGroup(state->nextGroup++, state->outputs, slot->tts_values, slot->tts_isnull);
+        MemoryContextSwitchTo(oldcxt);
+    }
+    catch (std::exception &e)
+    {
+        elog(ERROR, "parquet_fdw: %s", e.what());
+    }
+
+    return ExecStoreVirtualTuple(slot);
+}
+
+/*
+ * build_hash_table
+ *      Keep all the rows of the build side passing its conditions in the hash
+ *      table, then skip the row groups of the probe side whose statistics
+ *      fall outside of the range of the keys of the kept rows.
+ */
+static void build_hash_table(ForeignScanState *node, JoinScanState *state)
+{
+    ExprContext *econtext = node->ss.ps.ps_ExprContext;
+    MemoryContext cxt, oldcxt;
+    List *        clauses = NIL;
 
-        case FDW_PLAN_STATE_ROW_GROUPS_TO_SKIP:
-            rowGroupsToSkip = (List*)lfirst(lc);
+    while (true)
+    {
+        ExecClearTuple(state->buildSlot);
+        if (!state->build->next(state->buildSlot))
             break;
 
-        case FDW_PLAN_STATE_END__:
-            break;
+        if (state->buildQual)
+        {
+            econtext->ecxt_scantuple = state->buildSlot;
+            const bool passed        = ExecQual(state->buildQual, econtext);
 
-        default:
-            elog(ERROR, "Unknown FDW plan state item number: %d", i);
+            ResetExprContext(econtext);
+            if (!passed)
+                continue;
         }
-        ++i;
+
+        state->table->insert(state->buildSlot);
+        CHECK_FOR_INTERRUPTS();
     }
+    state->built = true;
 
-    MemoryContext cxt = estate->es_query_cxt;
-    reader_cxt = AllocSetContextCreate(cxt, "parquet_fdw tuple data", ALLOCSET_DEFAULT_SIZES);
+    if (state->table->getNumRows() == 0)
+        return;
 
-    std::list<SortSupportData> sort_keys;
-    foreach (lc, attrs_sorted)
-    {
-        SortSupportData sort_key;
-        int             attr = lfirst_int(lc);
-        Oid             typid;
-        int             typmod;
-        Oid             collid;
-        Oid             relid = RelationGetRelid(node->ss.ss_currentRelation);
-        Oid             sort_op;
+    cxt    = state->probe->resetRuntimeContext();
+    oldcxt = MemoryContextSwitchTo(cxt);
 
-        memset(&sort_key, 0, sizeof(SortSupportData));
+    const auto &keys = state->table->getKeys();
+    for (size_t k = 0; k < keys.size(); ++k)
+    {
+        TypeCacheEntry *typentry = lookup_type_cache(keys[k].type, TYPECACHE_BTREE_OPFAMILY);
+        Datum           min, max;
+        int16           typlen;
+        bool            typbyval;
+
+        if (!OidIsValid(typentry->btree_opf))
+            continue;
+
+        const Oid geOp = get_opfamily_member(typentry->btree_opf, keys[k].type, keys[k].type,
+                                             BTGreaterEqualStrategyNumber);
+        const Oid leOp = get_opfamily_member(typentry->btree_opf, keys[k].type, keys[k].type,
+                                             BTLessEqualStrategyNumber);
+        if (!OidIsValid(geOp) || !OidIsValid(leOp))
+            continue;
+
+        state->table->keyRange(k, &min, &max);
+        get_typlenbyval(keys[k].type, &typlen, &typbyval);
+
+        /* FilterPushdown identifies columns by attribute numbers only */
+        Var *var = makeVar(1, keys[k].probeAttIdx + 1, keys[k].type, -1, keys[k].collid, 0);
+
+        clauses = lappend(clauses, make_opclause(geOp, BOOLOID, false, (Expr *)var,
+                                                 (Expr *)makeConst(keys[k].type, -1, keys[k].collid, typlen,
+                                                                   min, false, typbyval),
+                                                 InvalidOid, keys[k].collid));
+        clauses = lappend(clauses, make_opclause(leOp, BOOLOID, false, (Expr *)var,
+                                                 (Expr *)makeConst(keys[k].type, -1, keys[k].collid, typlen,
+                                                                   max, false, typbyval),
+                                                 InvalidOid, keys[k].collid));
+    }
 
-        get_atttypetypmodcoll(relid, attr, &typid, &typmod, &collid);
+    state->probe->pruneRowGroups(clauses);
+    MemoryContextSwitchTo(oldcxt);
+}
 
-        sort_key.ssup_cxt         = reader_cxt;
-        sort_key.ssup_collation   = collid;
-        sort_key.ssup_nulls_first = true;
-        sort_key.ssup_attno       = attr;
-        sort_key.abbreviate       = false;
+/*
+ * iterate_join_scan
+ *      Build the hash table on the first call, then return the rows of the
+ *      probe side joined with each of their matches one by one.
+ */
+static TupleTableSlot *iterate_join_scan(ForeignScanState *node)
+{
+    JoinScanState * state    = (JoinScanState *)node->fdw_state;
+    ExprContext *   econtext = node->ss.ps.ps_ExprContext;
+    TupleTableSlot *slot     = node->ss.ss_ScanTupleSlot;
 
-        get_sort_group_operators(typid, true, false, false, &sort_op, nullptr, nullptr, nullptr);
+    ExecClearTuple(slot);
+    try
+    {
+        if (!state->built)
+            build_hash_table(node, state);
 
-        PrepareSortSupportFromOrderingOp(sort_op, &sort_key);
+        if (state->table->getNumRows() == 0)
+            return slot;
 
-        try
-        {
-            sort_keys.push_back(sort_key);
-        }
-        catch (std::exception &e)
+        while (!state->matches || state->nextMatch >= state->matches->size())
         {
-            elog(ERROR, "parquet_fdw: scan initialization failed: %s", e.what());
-        }
-    }
+            ExecClearTuple(state->probeSlot);
+            if (!state->probe->next(state->probeSlot))
+                return slot;
 
-    festate = new ParquetFdwExecutionState(reader_cxt, tupleDesc, attrUseList, use_mmap);
+            if (state->probeQual)
+            {
+                econtext->ecxt_scantuple = state->probeSlot;
+                const bool passed        = ExecQual(state->probeQual, econtext);
+
+                ResetExprContext(econtext);
+                if (!passed)
+                    continue;
+            }
 
-    if (filenames) {
-        if (!rowGroupsToSkip)
-            elog(ERROR, "parquet_fdw: got a null skiplist");
+            state->matches   = state->table->lookup(state->probeSlot);
+            state->nextMatch = 0;
+            CHECK_FOR_INTERRUPTS();
+        }
 
-        if (filenames->length != rowGroupsToSkip->length)
-            elog(ERROR, "Filenames count does not match skiplist count.");
+        ExecStoreMinimalTuple((*state->matches)[state->nextMatch++], state->matchSlot, false);
+        slot_getallattrs(state->matchSlot);
 
-        forboth(lc, filenames, lc2, rowGroupsToSkip)
+        for (size_t i = 0; i < state->outputs.size(); ++i)
         {
-            char *filename  = strVal((Value *)lfirst(lc));
-            List* skipList = (List*)lfirst(lc2);
+            const auto [isProbe, attIdx] = state->outputs[i];
+            TupleTableSlot *source       = isProbe ? state->probeSlot : state->matchSlot;
 
-            try
-            {
-                festate->addFileToRead(filename, reader_cxt, skipList);
-            }
-            catch (std::exception &e)
-            {
-                elog(ERROR, "parquet_fdw: %s", e.what());
-            }
+            slot->tts_values[i] = source->tts_values[attIdx];
+            slot->tts_isnull[i] = source->tts_isnull[attIdx];
         }
     }
+    catch (std::exception &e)
+    {
+        elog(ERROR, "parquet_fdw: %s", e.what());
+    }
 
-    /*
-     * Enable automatic execution state destruction by using memory context
-     * callback
-     */
-    callback       = (MemoryContextCallback *)palloc(sizeof(MemoryContextCallback));
-    callback->func = destroy_parquet_state;
-    callback->arg  = (void *)festate;
-    MemoryContextRegisterResetCallback(reader_cxt, callback);
-
-    node->fdw_state = festate;
+    return ExecStoreVirtualTuple(slot);
 }
 
 extern "C" TupleTableSlot *parquetIterateForeignScan(ForeignScanState *node)
@@ -903,6 +4037,20 @@ extern "C" TupleTableSlot *parquetIterateForeignScan(ForeignScanState *node)
     ParquetFdwExecutionState *festate = (ParquetFdwExecutionState *)node->fdw_state;
     TupleTableSlot *          slot    = node->ss.ss_ScanTupleSlot;
 
+    if (is_aggregate_scan(node))
+        return iterate_aggregate_scan(node);
+
+    if (is_join_scan(node))
+        return iterate_join_scan(node);
+
+    if (((Scan *)node->ss.ps.plan)->scanrelid == 0)
+        return iterate_metadata_scan(node);
+
+    if (festate->isRuntimePruningPending())
+        prune_row_groups_at_execution(node, festate);
+
+    const uint64 numRowsFiltered = festate->getNumRowsFiltered();
+
     ExecClearTuple(slot);
     try
     {
@@ -913,6 +4061,9 @@ extern "C" TupleTableSlot *parquetIterateForeignScan(ForeignScanState *node)
         elog(ERROR, "parquet_fdw: %s", e.what());
     }
 
+    /* Rows rejected by the qual checked by the scan, see begin_projection_scan */
+    InstrCountFiltered1(node, festate->getNumRowsFiltered() - numRowsFiltered);
+
     return slot;
 }
 
@@ -926,11 +4077,34 @@ extern "C" void parquetEndForeignScan(ForeignScanState *node)
 
 extern "C" void parquetReScanForeignScan(ForeignScanState *node)
 {
-    ParquetFdwExecutionState *festate = (ParquetFdwExecutionState *)node->fdw_state;
+    ParquetFdwExecutionState *festate = scan_execution_state(node);
+
+    if (is_aggregate_scan(node))
+    {
+        AggregateScanState *state = (AggregateScanState *)node->fdw_state;
+
+        state->aggregated = false;
+        state->nextGroup  = 0;
+        state->aggregates->reset();
+    }
+    else if (is_join_scan(node))
+    {
+        /* The hash table is kept, only the probe side is scanned again */
+        JoinScanState *state = (JoinScanState *)node->fdw_state;
+
+        state->matches   = nullptr;
+        state->nextMatch = 0;
+        festate          = state->probe;
+    }
+    else if (((Scan *)node->ss.ps.plan)->scanrelid == 0)
+    {
+        ((MetadataScanState *)node->fdw_state)->nextRow = 0;
+        return;
+    }
 
     try
     {
-        festate->rescan();
+        festate->rescan(node->ss.ps.chgParam != NULL);
     }
     catch (std::exception &e)
     {
@@ -938,6 +4112,51 @@ extern "C" void parquetReScanForeignScan(ForeignScanState *node)
     }
 }
 
+/*
+ * sample_row_positions
+ *      Positions of targrows rows drawn uniformly without replacement out of
+ *      numRows, in ascending order (Floyd's algorithm). All the rows are taken
+ *      if there are not more of them than targrows.
+ */
+static std::vector<uint64> sample_row_positions(uint64 numRows, int targrows)
+{
+    std::vector<uint64> positions;
+
+    if (numRows <= (uint64)targrows)
+    {
+        positions.resize(numRows);
+        std::iota(positions.begin(), positions.end(), 0);
+        return positions;
+    }
+
+#if PG_VERSION_NUM >= 150000
+    std::mt19937_64 gen(pg_prng_uint64(&pg_global_prng_state));
+#else
+    std::mt19937_64 gen(random());
+#endif
+    std::set<uint64> chosen;
+
+    for (uint64 j = numRows - targrows; j < numRows; ++j)
+    {
+        const uint64 t = std::uniform_int_distribution<uint64>(0, j)(gen);
+
+        if (!chosen.insert(t).second)
+            chosen.insert(j);
+    }
+
+    positions.assign(chosen.begin(), chosen.end());
+    return positions;
+}
+
+/*
+ * parquetAcquireSampleRowsFunc
+ *      Two-stage sample of the rows of the table. The rows are counted from
+ *      the footers of the files, then row positions are drawn uniformly over
+ *      all of them, so that each row group gets a number of sampled rows
+ *      proportional to its row count. Only the row groups with sampled rows
+ *      are read, up to the last sampled row, and only the sampled rows are
+ *      converted into tuples.
+ */
 static int parquetAcquireSampleRowsFunc(Relation   relation,
                                         int        elevel,
                                         HeapTuple *rows,
@@ -952,7 +4171,10 @@ static int parquetAcquireSampleRowsFunc(Relation   relation,
     uint64    num_rows = 0;
     ListCell *lc;
 
-    ParquetFdwPlanState newPlanState;
+    /* Row counts of the row groups of every file, from the footers */
+    std::vector<std::vector<int64_t>> rowGroupRows;
+
+    ParquetFdwPlanState newPlanState = {};
     get_table_options(RelationGetRelid(relation), &newPlanState);
     ParquetFdwPlanState *fdw_private = &newPlanState;
 
@@ -961,10 +4183,16 @@ static int parquetAcquireSampleRowsFunc(Relation   relation,
         elog(ERROR, "List of filenames is empty");
 
     const auto attrUseList = std::vector<bool>(tupleDesc->natts, true);
+    const auto partitionAttrs =
+            get_partition_attr_flags(fdw_private->partition_attrs, tupleDesc->natts);
 
-    reader_cxt = AllocSetContextCreate(CurrentMemoryContext, "parquet_fdw tuple data",
-                                       ALLOCSET_DEFAULT_SIZES);
-    const auto festate = new ParquetFdwExecutionState(reader_cxt, tupleDesc, attrUseList, false);
+    std::unique_ptr<HivePartitions> partitions;
+    Datum *partitionValues = (Datum *)palloc0(sizeof(Datum) * tupleDesc->natts);
+    bool * partitionNulls  = (bool *)palloc0(sizeof(bool) * tupleDesc->natts);
+
+    if (fdw_private->partition_attrs)
+        partitions = std::make_unique<HivePartitions>(RelationGetRelid(relation),
+                                                      fdw_private->partition_attrs);
 
     try
     {
@@ -973,7 +4201,9 @@ static int parquetAcquireSampleRowsFunc(Relation   relation,
         {
             char *filename = strVal((Value *)lfirst(lc));
             auto reader = std::make_unique<ParquetFdwReader>(filename);
-            num_rows += reader->getNumTotalRows();
+
+            if (!partitionAttrs.empty())
+                reader->setPartitionAttrs(partitionAttrs);
 
             if (previousSchema)
                 reader->schemaMustBeEqual(previousSchema);
@@ -981,8 +4211,13 @@ static int parquetAcquireSampleRowsFunc(Relation   relation,
                 reader->validateSchema(tupleDesc);
 
             previousSchema = reader->GetSchema();
-            festate->addFileToRead(filename, reader_cxt, nullptr);
-            reader.reset();
+
+            rowGroupRows.emplace_back();
+            for (size_t rg = 0; rg < reader->getNumRowGroups(); ++rg)
+            {
+                rowGroupRows.back().push_back(reader->getRowGroup(rg)->num_rows());
+                num_rows += rowGroupRows.back().back();
+            }
         }
     }
     catch (const std::exception &e)
@@ -990,31 +4225,81 @@ static int parquetAcquireSampleRowsFunc(Relation   relation,
         elog(ERROR, "parquet_fdw: %s", e.what());
     }
 
-    PG_TRY();
-    {
-        int    ratio = num_rows / targrows;
-
-        /* Set ratio to at least 1 to avoid devision by zero issue */
-        ratio = ratio < 1 ? 1 : ratio;
+    const auto positions = sample_row_positions(num_rows, targrows);
 
+    reader_cxt = AllocSetContextCreate(CurrentMemoryContext, "parquet_fdw tuple data",
+                                       ALLOCSET_DEFAULT_SIZES);
 #if PG_VERSION_NUM < 120000
-        slot = MakeSingleTupleTableSlot(tupleDesc);
+    slot = MakeSingleTupleTableSlot(tupleDesc);
 #else
-        slot = MakeSingleTupleTableSlot(tupleDesc, &TTSOpsHeapTuple);
+    slot = MakeSingleTupleTableSlot(tupleDesc, &TTSOpsHeapTuple);
 #endif
 
-        while (true)
+    ParquetFdwReader *reader   = nullptr;
+    size_t            position = 0;
+    uint64            firstRow = 0; /* of the row group in the whole table */
+    int               fileId   = 0;
+
+    PG_TRY();
+    {
+        foreach (lc, filenames)
         {
-            CHECK_FOR_INTERRUPTS();
+            char *filename = strVal((Value *)lfirst(lc));
 
-            if (cnt >= targrows)
-                break;
+            for (size_t rg = 0; rg < rowGroupRows[fileId].size(); ++rg)
+            {
+                const uint64 lastRow = firstRow + rowGroupRows[fileId][rg];
+                tRowRanges   ranges;
 
-            ExecClearTuple(slot);
-            if (!festate->next(slot, false))
-                break;
+                for (; position < positions.size() && positions[position] < lastRow; ++position)
+                {
+                    const int64_t row = positions[position] - firstRow;
+                    ranges.push_back({row, row + 1});
+                }
+                firstRow = lastRow;
+
+                if (ranges.empty())
+                    continue;
+
+                try
+                {
+                    if (!reader)
+                    {
+                        reader = new ParquetFdwReader(filename);
+                        reader->setMemoryContext(reader_cxt);
+
+                        if (!partitionAttrs.empty())
+                        {
+                            reader->setPartitionAttrs(partitionAttrs);
+                            if (partitions)
+                            {
+                                partitions->getValues(filename, partitionValues, partitionNulls);
+                                reader->setPartitionValues(partitionValues, partitionNulls);
+                            }
+                        }
+                    }
+
+                    reader->bufferRowGroup(rg, tupleDesc, attrUseList, ranges.back().second);
+                    reader->setRowRanges(ranges);
+
+                    while (!reader->finishedReadingRowGroup())
+                    {
+                        CHECK_FOR_INTERRUPTS();
+
+                        ExecClearTuple(slot);
+                        reader->next(slot);
+                        rows[cnt++] = heap_form_tuple(tupleDesc, slot->tts_values, slot->tts_isnull);
+                    }
+                }
+                catch (const std::exception &e)
+                {
+                    elog(ERROR, "parquet_fdw: %s", e.what());
+                }
+            }
 
-            rows[cnt++] = heap_form_tuple(tupleDesc, slot->tts_values, slot->tts_isnull);
+            delete reader;
+            reader = nullptr;
+            ++fileId;
         }
 
         *totalrows     = num_rows;
@@ -1024,22 +4309,25 @@ static int parquetAcquireSampleRowsFunc(Relation   relation,
     }
     PG_CATCH();
     {
-        elog(LOG, "Cancelled");
-        delete festate;
+        delete reader;
         PG_RE_THROW();
     }
     PG_END_TRY();
 
-    delete festate;
+    MemoryContextDelete(reader_cxt);
 
-    return cnt - 1;
+    ereport(elevel,
+            (errmsg("\"%s\": table contains " UINT64_FORMAT " rows, %d rows in sample",
+                    RelationGetRelationName(relation), num_rows, cnt)));
+
+    return cnt;
 }
 
 extern "C" bool parquetAnalyzeForeignTable(Relation               relation,
                                            AcquireSampleRowsFunc *func,
                                            BlockNumber *          totalpages)
 {
-    ParquetFdwPlanState newPlanState;
+    ParquetFdwPlanState newPlanState = {};
     get_table_options(RelationGetRelid(relation), &newPlanState);
     ParquetFdwPlanState *fdw_private = &newPlanState;
 
@@ -1070,52 +4358,117 @@ extern "C" bool parquetAnalyzeForeignTable(Relation               relation,
 }
 
 /*
- * parquetExplainForeignScan
- *      Additional explain information, namely row groups list.
+ * explain_skipped_pages
+ *      Show the number of pages ruled out by page indexes during execution.
+ *      Only the pages skipped by this process are counted.
  */
-extern "C" void parquetExplainForeignScan(ForeignScanState *node, ExplainState *es)
+static void explain_skipped_pages(ParquetFdwExecutionState *festate, ExplainState *es)
 {
-    List *         fdw_private;
-    ListCell *     lc, *lc2, *lc3;
-    StringInfoData str;
-    List *         filenames;
-    List *         rowgroups_list;
+    if (es->analyze && festate && festate->usesPageIndex())
+        ExplainPropertyText("Skipped pages",
+                            psprintf(UINT64_FORMAT, festate->getNumPagesSkipped()), es);
+}
+
+/*
+ * explain_scalar_chunks
+ *      Show the number of column chunks holding only NULLs or a single value
+ *      according to their statistics, which were not read.
+ */
+static void explain_scalar_chunks(ParquetFdwExecutionState *festate, ExplainState *es)
+{
+    if (es->analyze && festate && festate->getNumScalarChunks() > 0)
+        ExplainPropertyText("Chunks from statistics",
+                            psprintf(UINT64_FORMAT, festate->getNumScalarChunks()), es);
+}
+
+/*
+ * explain_table_scan
+ *      Files read by the scan and row groups skipped in them.
+ */
+static void explain_table_scan(ParquetFdwExecutionState *festate,
+                               List *                    fdw_private,
+                               List *                    runtime_clauses,
+                               ExplainState *            es)
+{
+    StringInfoData                 str;
+    Const *                        files;
+    List *                         estimate;
+    List *                         limit;
+    std::vector<PlanPayload::File> filesToRead;
 
     initStringInfo(&str);
 
-    fdw_private    = ((ForeignScan *)node->ss.ps.plan)->fdw_private;
-    filenames      = (List *)linitial(fdw_private);
-    rowgroups_list = (List *)llast(fdw_private);
+    files       = (Const *)list_nth(fdw_private, FDW_PLAN_STATE_FILES);
+    estimate    = (List *)list_nth(fdw_private, FDW_PLAN_STATE_ESTIMATE);
+    limit       = (List *)list_nth(fdw_private, FDW_PLAN_STATE_LIMIT);
+
+    try
+    {
+        filesToRead = PlanPayload::decode(files);
+    }
+    catch (std::exception &e)
+    {
+        elog(ERROR, "parquet_fdw: %s", e.what());
+    }
+
+    if (list_nth(fdw_private, FDW_PLAN_STATE_ATTRS_SORTED) != NIL)
+        ExplainPropertyText("Reader", "Multifile Merge", es);
+    else
+        ExplainPropertyText("Reader", "Multifile", es);
+
+    if (limit != NIL)
+    {
+        const int64 count  = DatumGetInt64(((Const *)linitial(limit))->constvalue);
+        const int64 offset = DatumGetInt64(((Const *)lsecond(limit))->constvalue);
+
+        if (count >= 0)
+            ExplainPropertyText("Limit", psprintf(INT64_FORMAT, count), es);
+        if (offset > 0)
+            ExplainPropertyText("Offset", psprintf(INT64_FORMAT, offset), es);
+    }
+
+    if (runtime_clauses != NIL)
+        ExplainPropertyText("Runtime filters", psprintf("%d", list_length(runtime_clauses)), es);
 
-    ExplainPropertyText("Reader", "Multifile", es);
+    if (estimate)
+    {
+        ExplainPropertyText("Estimated from",
+                            psprintf("%d of %zu files", intVal(linitial(estimate)),
+                                     filesToRead.size()),
+                            es);
+        if (es->verbose)
+            ExplainPropertyText("Rows error bound", strVal(lsecond(estimate)), es);
+        ExplainPropertyText("Skipped row groups", "determined at execution", es);
+        explain_skipped_pages(festate, es);
+        explain_scalar_chunks(festate, es);
+        return;
+    }
 
-    forboth(lc, filenames, lc2, rowgroups_list)
+    for (const auto &file : filesToRead)
     {
-        char *filename  = strVal((Value *)lfirst(lc));
-        List *rowgroups = (List *)lfirst(lc2);
-        bool  is_first  = true;
+        bool is_first = true;
 
         /* Only print filename if there're more than one file */
-        if (list_length(filenames) > 1)
+        if (filesToRead.size() > 1)
         {
             appendStringInfoChar(&str, '\n');
             appendStringInfoSpaces(&str, (es->indent + 1) * 2);
 
 #ifdef _GNU_SOURCE
-            appendStringInfo(&str, "%s: ", basename(filename));
+            appendStringInfo(&str, "%s: ", basename((char *)file.path.c_str()));
 #else
-            appendStringInfo(&str, "%s: ", basename(pstrdup(filename)));
+            appendStringInfo(&str, "%s: ", basename(pstrdup(file.path.c_str())));
 #endif
         }
 
-        if (rowgroups) {
-            foreach (lc3, rowgroups)
+        if (!file.rowGroupsToSkip.empty()) {
+            for (const auto skipped : file.rowGroupsToSkip)
             {
                 /*
                  * As parquet-tools use 1 based indexing for row groups it's probably
                  * a good idea to output row groups numbers in the same way.
                  */
-                int rowgroup = lfirst_int(lc3) + 1;
+                int rowgroup = skipped + 1;
 
                 if (is_first)
                 {
@@ -1131,6 +4484,175 @@ extern "C" void parquetExplainForeignScan(ForeignScanState *node, ExplainState *
     }
 
     ExplainPropertyText("Skipped row groups", str.data, es);
+    explain_skipped_pages(festate, es);
+    explain_scalar_chunks(festate, es);
+}
+
+/*
+ * explain_scan_filter
+ *      Conditions checked by the scan itself rather than by a Filter of the
+ *      plan. Columns of joins are qualified with their relations.
+ */
+static void explain_scan_filter(ForeignScanState *node,
+                                List *            quals,
+                                ExplainState *    es,
+                                const char *      label = "Filter")
+{
+    if (quals == NIL)
+        return;
+
+#if PG_VERSION_NUM < 130000
+    es->deparse_cxt = set_deparse_context_planstate(es->deparse_cxt, (Node *)node, NIL);
+#else
+    es->deparse_cxt = set_deparse_context_plan(es->deparse_cxt, node->ss.ps.plan, NIL);
+#endif
+    ExplainPropertyText(label,
+                        deparse_expression((Node *)make_ands_explicit(quals), es->deparse_cxt,
+                                           es->verbose || is_join_scan(node), false),
+                        es);
+}
+
+/*
+ * explain_join_exprs
+ *      Conditions of a join scan for EXPLAIN. Vars of the conditions refer to
+ *      the range table as planned, which may have been merged into the one
+ *      of an outer query since.
+ */
+static List *explain_join_exprs(ForeignScanState *node, List *exprs)
+{
+    ForeignScan *plan     = (ForeignScan *)node->ss.ps.plan;
+    const Index  buildRti = intVal(list_nth(plan->fdw_private, FDW_JOIN_BUILD_RTI));
+    const Index  probeRti = intVal(list_nth(plan->fdw_private, FDW_JOIN_PROBE_RTI));
+    const int    offset   = bms_next_member(plan->fs_relids, -1) - (int)std::min(buildRti, probeRti);
+
+    exprs = (List *)copyObjectImpl(exprs);
+    if (offset != 0)
+        OffsetVarNodes((Node *)exprs, offset, 0);
+    return exprs;
+}
+
+/*
+ * explain_top_n_keys
+ *      Columns Top-N scans order the rows by, in the format of Sort Key.
+ */
+static void explain_top_n_keys(ForeignScanState *node, List *keys, ExplainState *es)
+{
+    TupleDesc tupleDesc = RelationGetDescr(node->ss.ss_currentRelation);
+    List *    result    = NIL;
+    ListCell *lc;
+
+    foreach (lc, keys)
+    {
+        List *         key        = (List *)lfirst(lc);
+        const char *   attname    = NameStr(TupleDescAttr(tupleDesc, linitial_int(key) - 1)->attname);
+        const bool     nullsFirst = lfourth_int(key);
+        Oid            opfamily, opcintype;
+        int16          strategy   = BTLessStrategyNumber;
+        StringInfoData str;
+
+        initStringInfo(&str);
+        appendStringInfoString(&str, quote_identifier(attname));
+
+        get_ordering_op_properties((Oid)lsecond_int(key), &opfamily, &opcintype, &strategy);
+        if (strategy == BTGreaterStrategyNumber)
+            appendStringInfoString(&str, nullsFirst ? " DESC" : " DESC NULLS LAST");
+        else if (nullsFirst)
+            appendStringInfoString(&str, " NULLS FIRST");
+
+        result = lappend(result, str.data);
+    }
+
+    ExplainPropertyList("Top-N key", result, es);
+}
+
+/*
+ * parquetExplainForeignScan
+ *      Additional explain information, namely row groups list.
+ */
+extern "C" void parquetExplainForeignScan(ForeignScanState *node, ExplainState *es)
+{
+    List *fdw_private = ((ForeignScan *)node->ss.ps.plan)->fdw_private;
+
+    if (is_aggregate_scan(node))
+    {
+        auto festate = scan_execution_state(node);
+
+        explain_scan_filter(node, (List *)list_nth(fdw_private, FDW_AGGREGATE_QUALS), es);
+        explain_table_scan(festate, (List *)list_nth(fdw_private, FDW_AGGREGATE_SCAN),
+                           NIL, es);
+        ExplainPropertyText("Vectorized aggregates",
+                            psprintf("%d%s", list_length((List *)list_nth(fdw_private, FDW_AGGREGATE_AGGREGATES)),
+                                     intVal(list_nth(fdw_private, FDW_AGGREGATE_PARTIAL)) ? " (partial)" : ""),
+                            es);
+
+        /* Row groups whose groups were taken from dictionary pages */
+        if (es->analyze && festate && festate->getNumDictionaryRowGroups() > 0)
+            ExplainPropertyText("Dictionary row groups",
+                                psprintf(UINT64_FORMAT, festate->getNumDictionaryRowGroups()), es);
+        return;
+    }
+
+    if (is_join_scan(node))
+    {
+        auto state = (JoinScanState *)node->fdw_state;
+
+        explain_scan_filter(node, explain_join_exprs(node, (List *)list_nth(fdw_private, FDW_JOIN_CLAUSES)),
+                            es, "Hash Cond");
+        explain_scan_filter(node,
+                            explain_join_exprs(node, list_concat(list_copy((List *)list_nth(fdw_private,
+                                                                                            FDW_JOIN_PROBE_QUALS)),
+                                                                 (List *)list_nth(fdw_private, FDW_JOIN_BUILD_QUALS))),
+                            es);
+
+        /* Rows kept in the hash table and row groups of the probe side left to read */
+        if (es->analyze && state && state->built)
+        {
+            const size_t numHashed = state->table->getNumRows();
+
+            ExplainPropertyText("Hashed rows", psprintf("%zu", numHashed), es);
+            ExplainPropertyText("Probed row groups",
+                                psprintf("%zu of %zu", numHashed > 0 ? state->probe->getNumRowGroupsToRead() : 0,
+                                         state->numProbeRowGroups),
+                                es);
+        }
+        return;
+    }
+
+    if (((Scan *)node->ss.ps.plan)->scanrelid == 0)
+    {
+        ExplainPropertyText("Reader", "Metadata", es);
+        ExplainPropertyText("Aggregated files",
+                            psprintf("%d", (int)intVal(list_nth(fdw_private, FDW_METADATA_NUM_FILES))), es);
+        ExplainPropertyText("Aggregated row groups",
+                            psprintf("%d", (int)intVal(list_nth(fdw_private, FDW_METADATA_NUM_ROW_GROUPS))),
+                            es);
+        return;
+    }
+
+    if (is_top_n_scan(node))
+    {
+        auto festate = (ParquetFdwExecutionState *)node->fdw_state;
+
+        explain_scan_filter(node, ((ForeignScan *)node->ss.ps.plan)->fdw_exprs, es);
+        explain_top_n_keys(node, (List *)list_nth(fdw_private, FDW_PLAN_STATE_TOP_N), es);
+        explain_table_scan(festate, fdw_private, NIL, es);
+        if (es->analyze && festate)
+            ExplainPropertyText("Read row groups",
+                                psprintf(UINT64_FORMAT " of %zu", festate->getNumRowGroupsRead(),
+                                         festate->getNumRowGroupsToRead()),
+                                es);
+        return;
+    }
+
+    explain_table_scan((ParquetFdwExecutionState *)node->fdw_state, fdw_private,
+                       ((ForeignScan *)node->ss.ps.plan)->fdw_exprs, es);
+
+    /* Expressions of the target list computed over row groups */
+    if (((ForeignScan *)node->ss.ps.plan)->fdw_scan_tlist != NIL)
+        ExplainPropertyText("Vectorized expressions",
+                            psprintf("%d", list_length(((ForeignScan *)node->ss.ps.plan)->fdw_scan_tlist)
+                                                   - RelationGetDescr(node->ss.ss_currentRelation)->natts),
+                            es);
 }
 
 /* Parallel query execution */
@@ -1152,7 +4674,7 @@ extern "C" void parquetInitializeDSMForeignScan(ForeignScanState *node,
     ReadCoordinator *         coord = (ReadCoordinator *)coordinate;
     ParquetFdwExecutionState *festate;
 
-    festate = (ParquetFdwExecutionState *)node->fdw_state;
+    festate = scan_execution_state(node);
     festate->set_coordinator(coord);
 }
 
@@ -1170,7 +4692,7 @@ extern "C" void
     ReadCoordinator *         coord = (ReadCoordinator *)coordinate;
     ParquetFdwExecutionState *festate;
 
-    festate = (ParquetFdwExecutionState *)node->fdw_state;
+    festate = scan_execution_state(node);
     festate->set_coordinator(coord);
 }
 
@@ -1304,15 +4826,33 @@ extern "C" Datum parquet_fdw_validator_impl(PG_FUNCTION_ARGS)
         }
         else if (strcmp(def->defname, "sorted") == 0)
             ; /* do nothing */
+        else if (strcmp(def->defname, "partition_columns") == 0)
+        {
+            /* Columns are checked against the table definition on planning */
+            if (*defGetString(def) == '\0')
+                ereport(ERROR,
+                        (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                         errmsg("parquet_fdw: partition_columns must not be empty")));
+        }
+        else if (strcmp(def->defname, "files_func_cache_ttl") == 0)
+            parse_int_option(def, 0);
+        else if (strcmp(def->defname, "estimate_threshold") == 0)
+            parse_int_option(def, 0);
+        else if (strcmp(def->defname, "estimate_sample_size") == 0)
+            parse_int_option(def, 1);
+        else if (strcmp(def->defname, "parallel_workers") == 0)
+            parse_int_option(def, 0);
         else if (strcmp(def->defname, "batch_size") == 0)
             /* check that int value is valid */
             strtol(defGetString(def), nullptr, 10);
-        else if (strcmp(def->defname, "use_mmap") == 0)
+        else if (strcmp(def->defname, "use_mmap") == 0
+                 || strcmp(def->defname, "dictionary_pruning") == 0
+                 || strcmp(def->defname, "dictionary_groups") == 0)
         {
             /* Check that bool value is valid */
-            bool use_mmap;
+            bool value;
 
-            if (!parse_bool(defGetString(def), &use_mmap))
+            if (!parse_bool(defGetString(def), &value))
                 ereport(ERROR,
                         (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
                          errmsg("invalid value for boolean option \"%s\": %s", def->defname,
@@ -1500,6 +5040,59 @@ Datum import_parquet(PG_FUNCTION_ARGS)
     PG_RETURN_VOID();
 }
 
+/*
+ * invalidate_files_func_cache
+ *      Drop cached results of files_func in the current backend and send
+ *      relcache invalidations for the foreign tables using the function (or
+ *      any files_func if none is given) so that the other backends drop
+ *      theirs as well once the transaction commits.
+ */
+PG_FUNCTION_INFO_V1(invalidate_files_func_cache);
+Datum invalidate_files_func_cache(PG_FUNCTION_ARGS)
+{
+    Oid         funcid   = PG_ARGISNULL(0) ? InvalidOid : PG_GETARG_OID(0);
+    Oid         jsonboid = JSONBOID;
+    Relation    rel;
+    SysScanDesc scan;
+    HeapTuple   tuple;
+
+#if PG_VERSION_NUM < 120000
+    rel = heap_open(ForeignTableRelationId, AccessShareLock);
+#else
+    rel = table_open(ForeignTableRelationId, AccessShareLock);
+#endif
+    scan = systable_beginscan(rel, InvalidOid, false, nullptr, 0, nullptr);
+
+    while (HeapTupleIsValid(tuple = systable_getnext(scan)))
+    {
+        Oid           relid = ((Form_pg_foreign_table)GETSTRUCT(tuple))->ftrelid;
+        ForeignTable *table = GetForeignTable(relid);
+        ListCell *    lc;
+
+        foreach (lc, table->options)
+        {
+            DefElem *def = (DefElem *)lfirst(lc);
+
+            if (strcmp(def->defname, "files_func") != 0)
+                continue;
+
+            if (funcid == InvalidOid
+                || LookupFuncName(stringToQualifiedNameList(defGetString(def)), 1, &jsonboid,
+                                  true) == funcid)
+                CacheInvalidateRelcacheByRelid(relid);
+        }
+    }
+
+    systable_endscan(scan);
+#if PG_VERSION_NUM < 120000
+    heap_close(rel, AccessShareLock);
+#else
+    table_close(rel, AccessShareLock);
+#endif
+
+    PG_RETURN_INT32(FilesFuncCache::invalidate(funcid));
+}
+
 PG_FUNCTION_INFO_V1(convert_csv_to_parquet);
 Datum convert_csv_to_parquet(PG_FUNCTION_ARGS)
 {
@@ -0,0 +1,91 @@
+#include "CostModel.hpp"
+
+/*
+ * Defaults relative to seq_page_cost of reading 8kB of a cached file: snappy
+ * decompresses 8kB in about half of that time, decoding a value takes about a
+ * tenth of cpu_tuple_cost.
+ */
+double parquet_fdw_decompress_cost = 0.5;
+double parquet_fdw_decode_cost     = 0.001;
+
+/*
+ * codec_weight
+ *      Cost of decompressing a page relative to snappy, from the throughput of
+ *      the codecs' reference implementations.
+ */
+static double codec_weight(arrow::Compression::type codec)
+{
+    switch (codec)
+    {
+    case arrow::Compression::UNCOMPRESSED:
+        return 0.0;
+    case arrow::Compression::LZ4:
+    case arrow::Compression::LZ4_FRAME:
+    case arrow::Compression::LZ4_HADOOP:
+        return 0.7;
+    case arrow::Compression::SNAPPY:
+    case arrow::Compression::LZO:
+        return 1.0;
+    case arrow::Compression::ZSTD:
+        return 1.5;
+    case arrow::Compression::BROTLI:
+        return 3.0;
+    case arrow::Compression::GZIP:
+    case arrow::Compression::BZ2:
+        return 4.0;
+    default:
+        return 1.0;
+    }
+}
+
+/*
+ * type_weight
+ *      Cost of decoding a value of the type relative to a fixed width one.
+ *      Strings and byte arrays are copied into datums byte by byte.
+ */
+static double type_weight(arrow::Type::type type, double width)
+{
+    switch (type)
+    {
+    case arrow::Type::BOOL:
+        return 0.5;
+    case arrow::Type::STRING:
+    case arrow::Type::BINARY:
+        return 2.0 + width / 16.0;
+    default:
+        return 1.0;
+    }
+}
+
+CostModel::RowGroupCost CostModel::rowGroupCost(const ParquetFdwReader &reader, int rowGroupId,
+                                                const std::vector<bool> &attrUseList)
+{
+    const auto   rowgroup = reader.getRowGroup(rowGroupId);
+    const auto   schema   = reader.GetSchema();
+    RowGroupCost res;
+
+    for (size_t numAttr = 0; numAttr < attrUseList.size(); ++numAttr)
+    {
+        const int column = reader.columnIndex(numAttr);
+
+        if (!attrUseList[numAttr] || column < 0 || column >= rowgroup->num_columns())
+            continue;
+
+        const auto   chunk        = rowgroup->ColumnChunk(column);
+        const double uncompressed = chunk->total_uncompressed_size();
+        const double numValues    = std::max<int64_t>(chunk->num_values(), 1);
+        const auto   type         = column < schema->num_fields() ? schema->field(column)->type()->id()
+                                                                  : arrow::Type::NA;
+        double       decode       = type_weight(type, uncompressed / numValues);
+
+        /* Dictionary indexes are unpacked in bulk */
+        if (reader.isDictionaryEncoded(rowGroupId, column))
+            decode *= 0.5;
+
+        res.pages += (double)chunk->total_compressed_size() / BLCKSZ;
+        res.cpu += parquet_fdw_decompress_cost * codec_weight(chunk->compression()) * uncompressed / BLCKSZ
+                 + parquet_fdw_decode_cost * decode * chunk->num_values();
+    }
+
+    return res;
+}
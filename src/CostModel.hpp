@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+#include "ParquetFdwReader.hpp"
+
+extern "C" {
+#include "postgres.h"
+#include "nodes/nodes.h"
+}
+
+/* Coefficients of the cost model, see _PG_init() */
+extern "C" double parquet_fdw_decompress_cost;
+extern "C" double parquet_fdw_decode_cost;
+
+/*
+ * CostModel
+ *      Cost of reading the used column chunks of a row group, made of the
+ *      compressed pages read from disk and of the CPU work of decompressing
+ *      and decoding them. The CPU work depends on the codec, the type of the
+ *      column, the width of strings and whether the chunk is dictionary
+ *      encoded. Emitting the rows is costed by the callers.
+ */
+class CostModel
+{
+public:
+    struct RowGroupCost
+    {
+        double pages = 0; /* compressed bytes read in pages */
+        Cost   cpu   = 0; /* decompression and decoding */
+    };
+
+    static RowGroupCost rowGroupCost(const ParquetFdwReader &reader, int rowGroupId,
+                                     const std::vector<bool> &attrUseList);
+};
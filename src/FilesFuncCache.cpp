@@ -0,0 +1,104 @@
+#include "FilesFuncCache.hpp"
+
+extern "C" {
+#include "nodes/value.h"
+#include "utils/inval.h"
+#include "utils/syscache.h"
+}
+
+std::map<FilesFuncCache::tKey, FilesFuncCache::Entry> FilesFuncCache::entries;
+bool                                                  FilesFuncCache::callbackRegistered = false;
+
+/*
+ * procCallback
+ *      Forget cached results of the functions that were changed or dropped.
+ */
+void FilesFuncCache::procCallback(Datum arg, int cacheid, uint32 hashvalue)
+{
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        const uint32 entryHash =
+                GetSysCacheHashValue1(PROCOID, ObjectIdGetDatum(it->first.first));
+
+        if (hashvalue == 0 || entryHash == hashvalue)
+            it = entries.erase(it);
+        else
+            ++it;
+    }
+}
+
+/*
+ * relCallback
+ *      Forget cached results used for the invalidated foreign table.
+ */
+void FilesFuncCache::relCallback(Datum arg, Oid relid)
+{
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        if (relid == InvalidOid || it->second.relids.count(relid))
+            it = entries.erase(it);
+        else
+            ++it;
+    }
+}
+
+bool FilesFuncCache::lookup(Oid funcoid, const char *arg, int ttl, Oid relid, List **files)
+{
+    const auto it = entries.find({ funcoid, arg ? arg : "" });
+
+    if (it == entries.end())
+        return false;
+
+    /* In microseconds, the ttl may be too large for milliseconds in an int */
+    if (GetCurrentTimestamp() - it->second.created >= (int64)ttl * USECS_PER_SEC)
+    {
+        entries.erase(it);
+        return false;
+    }
+
+    it->second.relids.insert(relid);
+
+    *files = NIL;
+    for (const auto &file : it->second.files)
+        *files = lappend(*files, makeString(pstrdup(file.c_str())));
+
+    return true;
+}
+
+void FilesFuncCache::store(Oid funcoid, const char *arg, Oid relid, List *files)
+{
+    Entry     entry;
+    ListCell *lc;
+
+    if (!callbackRegistered)
+    {
+        CacheRegisterSyscacheCallback(PROCOID, procCallback, (Datum)0);
+        CacheRegisterRelcacheCallback(relCallback, (Datum)0);
+        callbackRegistered = true;
+    }
+
+    foreach (lc, files)
+        entry.files.push_back(strVal((Value *)lfirst(lc)));
+    entry.created = GetCurrentTimestamp();
+    entry.relids.insert(relid);
+
+    entries[{ funcoid, arg ? arg : "" }] = std::move(entry);
+}
+
+int FilesFuncCache::invalidate(Oid funcoid)
+{
+    int count = 0;
+
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        if (funcoid == InvalidOid || it->first.first == funcoid)
+        {
+            it = entries.erase(it);
+            ++count;
+        }
+        else
+            ++it;
+    }
+
+    return count;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#if __cplusplus > 199711L
+#    define register // Deprecated in C++11.
+#endif               // #if __cplusplus > 199711L
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include "postgres.h"
+
+#include "nodes/pg_list.h"
+#include "utils/timestamp.h"
+}
+
+/*
+ * FilesFuncCache
+ *      Backend-local cache of the file lists returned by files_func.
+ *
+ * Entries are keyed by the function oid and the files_func_arg string and
+ * expire after the table's files_func_cache_ttl seconds. Redefinition or
+ * removal of the function drops its entries in every backend through the
+ * syscache invalidation mechanism. Entries also remember the foreign tables
+ * they were used for and are dropped on relcache invalidation of any of them,
+ * which is how invalidate_files_func_cache() reaches every backend.
+ */
+class FilesFuncCache
+{
+private:
+    using tKey = std::pair<Oid, std::string>;
+
+    struct Entry
+    {
+        std::vector<std::string> files;
+        TimestampTz              created;
+        std::set<Oid>            relids;
+    };
+
+    static std::map<tKey, Entry> entries;
+    static bool                  callbackRegistered;
+
+    static void procCallback(Datum arg, int cacheid, uint32 hashvalue);
+    static void relCallback(Datum arg, Oid relid);
+
+public:
+    /* Returns true and fills files if there is an entry not older than ttl */
+    static bool lookup(Oid funcoid, const char *arg, int ttl, Oid relid, List **files);
+
+    static void store(Oid funcoid, const char *arg, Oid relid, List *files);
+
+    /* Drop entries of the function or all the entries if funcoid is invalid */
+    static int invalidate(Oid funcoid);
+};
@@ -1,210 +1,2751 @@
 
 #include "FilterPushdown.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 #include "parquet/arrow/reader.h"
 #include "parquet/arrow/schema.h"
 
-extern "C" {
-#include "access/nbtree.h"
-#include "nodes/makefuncs.h"
-#include "nodes/nodeFuncs.h"
-#include "nodes/pathnodes.h"
-#include "utils/lsyscache.h"
-#include "utils/typcache.h"
+extern "C" {
+#include "access/htup_details.h"
+#include "access/nbtree.h"
+#include "catalog/pg_collation.h"
+#include "catalog/pg_language.h"
+#include "catalog/pg_proc.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "nodes/pathnodes.h"
+#include "utils/array.h"
+#include "utils/lsyscache.h"
+#include "utils/pg_locale.h"
+#include "utils/selfuncs.h"
+#include "utils/syscache.h"
+#include "utils/typcache.h"
+}
+
+/* Maximum number of array elements expanded into separate comparisons */
+#define MAX_EXPANDED_ARRAY_ELEMENTS 100
+
+/*
+ * Built-in functions which are non-decreasing in one of their arguments
+ * while the rest are constants. Only the ones that cannot fail on any valid
+ * input are listed as they are called on the row group statistics.
+ */
+static const struct
+{
+    const char *name;     /* internal function name */
+    int         argIndex; /* the monotonic argument */
+} monotonic_functions[] = {
+    /* casts */
+    { "i2toi4", 0 },
+    { "int28", 0 },
+    { "int48", 0 },
+    { "i2tof", 0 },
+    { "i2tod", 0 },
+    { "i4tof", 0 },
+    { "i4tod", 0 },
+    { "i8tof", 0 },
+    { "i8tod", 0 },
+    { "ftod", 0 },
+    { "timestamp_date", 0 },
+    { "timestamptz_date", 0 },
+    /* date_trunc() */
+    { "timestamp_trunc", 1 },
+    { "timestamptz_trunc", 1 },
+    { "timestamptz_trunc_zone", 1 },
+};
+
+/*
+ * internal_function_name
+ *      Return the name of built-in function or NULL for functions written in
+ *      other languages.
+ */
+static char *internal_function_name(Oid funcid)
+{
+    HeapTuple tuple;
+    char *    name = NULL;
+
+    tuple = SearchSysCache1(PROCOID, ObjectIdGetDatum(funcid));
+    if (!HeapTupleIsValid(tuple))
+        return NULL;
+
+    if (((Form_pg_proc)GETSTRUCT(tuple))->prolang == INTERNALlanguageId)
+    {
+        bool  isnull;
+        Datum prosrc = SysCacheGetAttr(PROCOID, tuple, Anum_pg_proc_prosrc, &isnull);
+
+        if (!isnull)
+            name = TextDatumGetCString(prosrc);
+    }
+    ReleaseSysCache(tuple);
+
+    return name;
+}
+
+/*
+ * monotonic_argument
+ *      Return the index of the argument the function is monotonic in or -1.
+ */
+static int monotonic_argument(Oid funcid)
+{
+    const char *name = internal_function_name(funcid);
+
+    if (name == NULL)
+        return -1;
+
+    for (const auto &func : monotonic_functions)
+    {
+        if (strcmp(func.name, name) == 0)
+            return func.argIndex;
+    }
+    return -1;
+}
+
+/*
+ * find_cmp_func
+ *      Find comparison function for two given types. Returns false if types
+ *      are not comparable.
+ */
+bool FilterPushdown::find_cmp_func(FmgrInfo *finfo, Oid type1, Oid type2)
+{
+    const auto      key = std::make_pair(type1, type2);
+    const auto      it  = cmpFuncs.find(key);
+    Oid             cmp_proc_oid = InvalidOid;
+    TypeCacheEntry *tce_1, *tce_2;
+
+    if (it != cmpFuncs.end())
+    {
+        *finfo = it->second;
+        return OidIsValid(finfo->fn_oid);
+    }
+
+    tce_1 = lookup_type_cache(type1, TYPECACHE_BTREE_OPFAMILY);
+    tce_2 = lookup_type_cache(type2, TYPECACHE_BTREE_OPFAMILY);
+
+    if (OidIsValid(tce_1->btree_opf))
+        cmp_proc_oid = get_opfamily_proc(tce_1->btree_opf, tce_1->btree_opintype,
+                                         tce_2->btree_opintype, BTORDER_PROC);
+
+    memset(finfo, 0, sizeof(FmgrInfo));
+    if (OidIsValid(cmp_proc_oid))
+        fmgr_info_cxt(cmp_proc_oid, finfo, cxt);
+    cmpFuncs[key] = *finfo;
+
+    return OidIsValid(cmp_proc_oid);
+}
+
+/*
+ * compare
+ *      Compare two values of possibly different types. Sets *ok to false if
+ *      there is no comparison function for those types.
+ */
+int FilterPushdown::compare(Oid type1, Datum value1, Oid type2, Datum value2, Oid collid, bool *ok)
+{
+    FmgrInfo finfo;
+
+    *ok = find_cmp_func(&finfo, type1, type2);
+    if (!*ok)
+        return 0;
+
+    return DatumGetInt32(FunctionCall2Coll(&finfo, collid, value1, value2));
+}
+
+/*
+ * apply_transforms
+ *      Compute the expression of the leaf for the given column value.
+ */
+Datum FilterPushdown::apply_transforms(const FilterNode &node, Datum value)
+{
+    for (const auto &transform : node.transforms)
+    {
+        auto               it = transformFuncs.find(transform.funcid);
+        std::vector<Datum> args = transform.args;
+
+        if (it == transformFuncs.end())
+        {
+            FmgrInfo finfo;
+
+            fmgr_info_cxt(transform.funcid, &finfo, cxt);
+            it = transformFuncs.emplace(transform.funcid, finfo).first;
+        }
+
+        args[transform.argIndex] = value;
+        switch (args.size())
+        {
+        case 1:
+            value = FunctionCall1Coll(&it->second, transform.collid, args[0]);
+            break;
+        case 2:
+            value = FunctionCall2Coll(&it->second, transform.collid, args[0], args[1]);
+            break;
+        case 3:
+            value = FunctionCall3Coll(&it->second, transform.collid, args[0], args[1], args[2]);
+            break;
+        default:
+            Assert(false);
+        }
+    }
+
+    return value;
+}
+
+/*
+ * extract_column
+ *      Check whether expression is a column reference, possibly wrapped into
+ *      binary compatible casts and monotonic functions, and fill the column
+ *      part of the leaf.
+ */
+bool FilterPushdown::extract_column(Expr *expr, FilterNode &column)
+{
+    Expr *arg = expr;
+
+    while (IsA(arg, RelabelType))
+        arg = ((RelabelType *)arg)->arg;
+
+    if (IsA(arg, Var))
+    {
+        if (((Var *)arg)->varattno <= 0)
+            return false;
+
+        column.attnum = ((Var *)arg)->varattno;
+    }
+    else if (IsA(arg, FuncExpr))
+    {
+        FuncExpr *      func     = (FuncExpr *)arg;
+        const int       argIndex = monotonic_argument(func->funcid);
+        ColumnTransform transform;
+        ListCell *      lc;
+        int             i = 0;
+
+        if (argIndex < 0 || func->funcretset || argIndex >= list_length(func->args))
+            return false;
+
+        if (!stableTransforms && func_volatile(func->funcid) != PROVOLATILE_IMMUTABLE)
+            return false;
+
+        foreach (lc, func->args)
+        {
+            Expr *funcArg = (Expr *)lfirst(lc);
+
+            if (i++ == argIndex)
+            {
+                transform.args.push_back((Datum)0);
+                continue;
+            }
+            if (!IsA(funcArg, Const) || ((Const *)funcArg)->constisnull)
+                return false;
+            transform.args.push_back(((Const *)funcArg)->constvalue);
+        }
+
+        if (!extract_column((Expr *)list_nth(func->args, argIndex), column))
+            return false;
+
+        transform.funcid   = func->funcid;
+        transform.collid   = func->inputcollid;
+        transform.argIndex = argIndex;
+        column.transforms.push_back(transform);
+    }
+    else
+        return false;
+
+    column.columnExpr = expr;
+    column.columnType = exprType((Node *)expr);
+    return true;
+}
+
+/*
+ * make_range
+ *      Build a leaf for "column <strategy> value" clause.
+ */
+FilterPushdown::FilterNode FilterPushdown::make_range(const FilterNode &column, Const *value, int strategy, Oid collid)
+{
+    FilterNode node = column;
+
+    node.collid = collid;
+
+    /* Comparison with NULL is neither true nor false */
+    if (value->constisnull)
+    {
+        node.kind         = FilterNode::FILTER_IN;
+        node.hasNullValue = true;
+        return node;
+    }
+
+    node.kind = FilterNode::FILTER_RANGE;
+    switch (strategy)
+    {
+    case BTLessStrategyNumber:
+    case BTLessEqualStrategyNumber:
+        node.upper          = value;
+        node.upperInclusive = (strategy == BTLessEqualStrategyNumber);
+        break;
+    case BTEqualStrategyNumber:
+        node.lower = node.upper = value;
+        break;
+    case BTGreaterEqualStrategyNumber:
+    case BTGreaterStrategyNumber:
+        node.lower          = value;
+        node.lowerInclusive = (strategy == BTGreaterEqualStrategyNumber);
+        break;
+    default:
+        node.kind = FilterNode::FILTER_UNKNOWN;
+    }
+
+    return node;
+}
+
+/*
+ * make_comparison
+ *      Build a leaf for binary operator clause like "VAR OP CONST" or
+ *      "CONST OP VAR".
+ */
+FilterPushdown::FilterNode FilterPushdown::make_comparison(Expr *left, Expr *right, Oid opno, Oid collid)
+{
+    TypeCacheEntry *tce;
+    FilterNode      column;
+    Const *         c;
+    int             strategy;
+    bool            commuted = false;
+
+    if (IsA(right, Const) && extract_column(left, column))
+        c = (Const *)right;
+    else if (IsA(left, Const) && extract_column(right, column))
+    {
+        c        = (Const *)left;
+        commuted = true;
+    }
+    else
+        return FilterNode();
+
+    tce      = lookup_type_cache(column.columnType, TYPECACHE_BTREE_OPFAMILY);
+    strategy = get_op_opfamily_strategy(opno, tce->btree_opf);
+
+    /* Not a btree family operator? Could still be a negation of equality */
+    if (strategy == 0)
+    {
+        const Oid negator = get_negator(opno);
+        FilterNode node;
+
+        if (!OidIsValid(negator)
+            || get_op_opfamily_strategy(negator, tce->btree_opf) != BTEqualStrategyNumber)
+            return FilterNode();
+
+        node.kind = FilterNode::FILTER_NOT;
+        node.children.push_back(make_range(column, c, BTEqualStrategyNumber, collid));
+        return node;
+    }
+
+    if (commuted)
+        strategy = BTCommuteStrategyNumber(strategy);
+
+    return make_range(column, c, strategy, collid);
+}
+
+/*
+ * make_prefix_match
+ *      Build a leaf for "TEXT_VAR LIKE 'prefix%...'" or
+ *      "starts_with(TEXT_VAR, 'prefix')" clause. Matching strings lie within
+ *      ['prefix', 'prefiy') range in bytewise order, which is also the order
+ *      of parquet string statistics.
+ */
+FilterPushdown::FilterNode FilterPushdown::make_prefix_match(Expr *left, Expr *right, bool isLike)
+{
+    FilterNode  column;
+    FilterNode  node;
+    Const *     c = (Const *)right;
+    std::string pattern;
+    std::string prefix;
+    size_t      pos = 0;
+
+    if (!IsA(right, Const) || !extract_column(left, column) || !column.transforms.empty()
+        || column.columnType != TEXTOID)
+        return FilterNode();
+
+    if (c->constisnull)
+        return make_range(column, c, BTEqualStrategyNumber, C_COLLATION_OID);
+
+    pattern = TextDatumGetCString(c->constvalue);
+    if (isLike)
+    {
+        /* Fixed prefix ends at the first wildcard */
+        for (; pos < pattern.size() && pattern[pos] != '%' && pattern[pos] != '_'; ++pos)
+        {
+            if (pattern[pos] == '\\' && ++pos == pattern.size())
+                break;
+            prefix.push_back(pattern[pos]);
+        }
+    }
+    else
+        prefix = pattern;
+
+    if (prefix.empty())
+        return FilterNode();
+
+    node                = column;
+    node.kind           = FilterNode::FILTER_RANGE;
+    node.collid         = C_COLLATION_OID;
+    node.lower          = makeConst(TEXTOID, -1, C_COLLATION_OID, -1,
+                                    CStringGetTextDatum(prefix.c_str()), false, false);
+    node.lowerInclusive = true;
+
+    /* The least string greater than all the strings with the prefix */
+    while (!prefix.empty() && (unsigned char)prefix.back() == 0xFF)
+        prefix.pop_back();
+    if (!prefix.empty())
+    {
+        prefix.back()       = (char)((unsigned char)prefix.back() + 1);
+        node.upper          = makeConst(TEXTOID, -1, C_COLLATION_OID, -1,
+                                        CStringGetTextDatum(prefix.c_str()), false, false);
+        node.upperInclusive = false;
+    }
+
+    /*
+     * Unless the pattern is just the prefix followed by '%' a string with the
+     * prefix may still not match it.
+     */
+    if (isLike && pattern.compare(pos, std::string::npos, "%") != 0)
+    {
+        FilterNode andNode;
+
+        andNode.kind = FilterNode::FILTER_AND;
+        andNode.children.push_back(node);
+        andNode.children.push_back(FilterNode());
+        return andNode;
+    }
+
+    return node;
+}
+
+/*
+ * make_array_comparison
+ *      Build a node for "VAR OP ANY/ALL (ARRAY)" clause. "VAR = ANY (...)"
+ *      (and thus "VAR IN (...)") becomes a single leaf with sorted values,
+ *      other operators are expanded into OR/AND of comparisons.
+ */
+FilterPushdown::FilterNode FilterPushdown::make_array_comparison(ScalarArrayOpExpr *expr)
+{
+    Expr *             left  = (Expr *)linitial(expr->args);
+    Expr *             right = (Expr *)lsecond(expr->args);
+    std::vector<Datum> elems;
+    std::vector<bool>  elemNulls;
+    Oid                elemType;
+    int16              typlen;
+    bool               typbyval;
+    char               typalign;
+    TypeCacheEntry *   tce;
+    int                strategy;
+    FilterNode         column;
+    FilterNode         node;
+
+    if (!extract_column(left, column))
+        return FilterNode();
+
+    elemType = get_element_type(exprType((Node *)right));
+    if (!OidIsValid(elemType))
+        return FilterNode();
+    get_typlenbyvalalign(elemType, &typlen, &typbyval, &typalign);
+
+    if (IsA(right, Const))
+    {
+        Const *c = (Const *)right;
+        Datum *values;
+        bool * nulls;
+        int    num;
+
+        /* NULL array gives NULL result */
+        if (c->constisnull)
+            return make_range(column, c, BTEqualStrategyNumber, expr->inputcollid);
+
+        deconstruct_array(DatumGetArrayTypeP(c->constvalue), elemType, typlen, typbyval, typalign,
+                          &values, &nulls, &num);
+        for (int i = 0; i < num; ++i)
+        {
+            elems.push_back(values[i]);
+            elemNulls.push_back(nulls[i]);
+        }
+    }
+    else if (IsA(right, ArrayExpr))
+    {
+        ListCell *lc;
+
+        foreach (lc, ((ArrayExpr *)right)->elements)
+        {
+            if (!IsA(lfirst(lc), Const))
+                return FilterNode();
+            elems.push_back(((Const *)lfirst(lc))->constvalue);
+            elemNulls.push_back(((Const *)lfirst(lc))->constisnull);
+        }
+    }
+    else
+        return FilterNode();
+
+    tce      = lookup_type_cache(column.columnType, TYPECACHE_BTREE_OPFAMILY);
+    strategy = get_op_opfamily_strategy(expr->opno, tce->btree_opf);
+
+    if (expr->useOr && strategy == BTEqualStrategyNumber)
+    {
+        bool ok = true;
+
+        node           = column;
+        node.kind      = FilterNode::FILTER_IN;
+        node.collid    = expr->inputcollid;
+        node.valueType = elemType;
+
+        for (size_t i = 0; i < elems.size(); ++i)
+        {
+            if (elemNulls[i])
+                node.hasNullValue = true;
+            else
+                node.values.push_back(elems[i]);
+        }
+
+        std::sort(node.values.begin(), node.values.end(), [&](Datum a, Datum b) {
+            bool cmpOk;
+            int  res = compare(elemType, a, elemType, b, node.collid, &cmpOk);
+
+            ok = ok && cmpOk;
+            return res < 0;
+        });
+        node.values.erase(std::unique(node.values.begin(), node.values.end(),
+                                      [&](Datum a, Datum b) {
+                                          bool cmpOk;
+                                          int  res = compare(elemType, a, elemType, b,
+                                                             node.collid, &cmpOk);
+
+                                          ok = ok && cmpOk;
+                                          return res == 0;
+                                      }),
+                          node.values.end());
+
+        return ok ? node : FilterNode();
+    }
+
+    if (elems.size() > MAX_EXPANDED_ARRAY_ELEMENTS)
+        return FilterNode();
+
+    node.kind = expr->useOr ? FilterNode::FILTER_OR : FilterNode::FILTER_AND;
+    for (size_t i = 0; i < elems.size(); ++i)
+    {
+        Const *c = makeConst(elemType, -1, expr->inputcollid, typlen, elems[i], elemNulls[i],
+                             typbyval);
+
+        node.children.push_back(make_comparison(left, (Expr *)c, expr->opno, expr->inputcollid));
+    }
+    if (!expr->useOr)
+        merge_column_intervals(node);
+
+    return node;
+}
+
+/*
+ * make_row_comparison
+ *      Expand row comparison "(a, b) < (1, 2)" into
+ *      "a < 1 OR (a = 1 AND b < 2)".
+ */
+FilterPushdown::FilterNode FilterPushdown::make_row_comparison(RowCompareExpr *expr)
+{
+    const int  numArgs = list_length(expr->largs);
+    FilterNode result;
+    int        strategy;
+    int        strictStrategy;
+
+    switch (expr->rctype)
+    {
+    case ROWCOMPARE_LT:
+        strategy = strictStrategy = BTLessStrategyNumber;
+        break;
+    case ROWCOMPARE_LE:
+        strategy       = BTLessEqualStrategyNumber;
+        strictStrategy = BTLessStrategyNumber;
+        break;
+    case ROWCOMPARE_GE:
+        strategy       = BTGreaterEqualStrategyNumber;
+        strictStrategy = BTGreaterStrategyNumber;
+        break;
+    case ROWCOMPARE_GT:
+        strategy = strictStrategy = BTGreaterStrategyNumber;
+        break;
+    default:
+        return FilterNode();
+    }
+
+    /* Build the expansion from the last column backwards */
+    for (int i = numArgs - 1; i >= 0; --i)
+    {
+        Expr *     left   = (Expr *)list_nth(expr->largs, i);
+        Expr *     right  = (Expr *)list_nth(expr->rargs, i);
+        const Oid  collid = list_nth_oid(expr->inputcollids, i);
+        const Oid  opf    = list_nth_oid(expr->opfamilies, i);
+        FilterNode column;
+        Const *    c;
+        int        s      = (i == numArgs - 1) ? strategy : strictStrategy;
+        FilterNode cmp;
+
+        if (IsA(right, Const) && extract_column(left, column))
+            c = (Const *)right;
+        else if (IsA(left, Const) && extract_column(right, column))
+        {
+            c = (Const *)left;
+            s = BTCommuteStrategyNumber(s);
+        }
+        else
+            return FilterNode();
+
+        /* Operators must follow default ordering of the column type */
+        if (opf != lookup_type_cache(column.columnType, TYPECACHE_BTREE_OPFAMILY)->btree_opf)
+            return FilterNode();
+
+        cmp = make_range(column, c, s, collid);
+        if (i == numArgs - 1)
+            result = cmp;
+        else
+        {
+            FilterNode equal;
+            FilterNode orNode;
+
+            equal.kind = FilterNode::FILTER_AND;
+            equal.children.push_back(make_range(column, c, BTEqualStrategyNumber, collid));
+            equal.children.push_back(result);
+
+            orNode.kind = FilterNode::FILTER_OR;
+            orNode.children.push_back(cmp);
+            orNode.children.push_back(equal);
+            result = orNode;
+        }
+    }
+
+    return result;
+}
+
+/*
+ * make_node
+ *      Convert clause into pruning tree.
+ */
+FilterPushdown::FilterNode FilterPushdown::make_node(Expr *clause)
+{
+    if (IsA(clause, RestrictInfo))
+        clause = ((RestrictInfo *)clause)->clause;
+
+    switch (nodeTag(clause))
+    {
+    case T_OpExpr:
+    {
+        OpExpr *    expr = (OpExpr *)clause;
+        const char *funcname;
+
+        /* Only interested in binary opexprs */
+        if (list_length(expr->args) != 2)
+            break;
+
+        /* LIKE and ^@ operators */
+        funcname = internal_function_name(get_opcode(expr->opno));
+        if (funcname && (strcmp(funcname, "textlike") == 0
+                         || strcmp(funcname, "text_starts_with") == 0))
+            return make_prefix_match((Expr *)linitial(expr->args), (Expr *)lsecond(expr->args),
+                                     strcmp(funcname, "textlike") == 0);
+
+        return make_comparison((Expr *)linitial(expr->args), (Expr *)lsecond(expr->args),
+                               expr->opno, expr->inputcollid);
+    }
+
+    case T_FuncExpr:
+    {
+        FuncExpr *  expr     = (FuncExpr *)clause;
+        const char *funcname = internal_function_name(expr->funcid);
+
+        if (funcname && strcmp(funcname, "text_starts_with") == 0
+            && list_length(expr->args) == 2)
+            return make_prefix_match((Expr *)linitial(expr->args), (Expr *)lsecond(expr->args),
+                                     false);
+        break;
+    }
+
+    case T_ScalarArrayOpExpr:
+        return make_array_comparison((ScalarArrayOpExpr *)clause);
+
+    case T_RowCompareExpr:
+        return make_row_comparison((RowCompareExpr *)clause);
+
+    case T_NullTest:
+    {
+        NullTest * test = (NullTest *)clause;
+        FilterNode node;
+
+        /* Monotonic functions are strict, so only the column can be NULL */
+        if (test->argisrow || !extract_column(test->arg, node))
+            break;
+
+        node.kind   = FilterNode::FILTER_NULL_TEST;
+        node.isNull = (test->nulltesttype == IS_NULL);
+        return node;
+    }
+
+    case T_BoolExpr:
+    {
+        BoolExpr * expr = (BoolExpr *)clause;
+        FilterNode node;
+        ListCell * lc;
+
+        switch (expr->boolop)
+        {
+        case AND_EXPR:
+            node.kind = FilterNode::FILTER_AND;
+            break;
+        case OR_EXPR:
+            node.kind = FilterNode::FILTER_OR;
+            break;
+        case NOT_EXPR:
+            node.kind = FilterNode::FILTER_NOT;
+            break;
+        }
+
+        foreach (lc, expr->args)
+            node.children.push_back(make_node((Expr *)lfirst(lc)));
+
+        if (node.kind == FilterNode::FILTER_AND)
+            merge_column_intervals(node);
+        return node;
+    }
+
+    case T_Var:
+    {
+        FilterNode column;
+
+        /*
+         * Trivial expression containing only a single boolean Var. This
+         * also covers cases "BOOL_VAR = true"
+         */
+        if (!extract_column(clause, column))
+            break;
+        return make_range(column, (Const *)makeBoolConst(true, false), BTEqualStrategyNumber,
+                          InvalidOid);
+    }
+
+    default:
+        break;
+    }
+
+    return FilterNode();
+}
+
+/*
+ * merge_column_intervals
+ *      Intersect ranges on the same column under AND node. This also removes
+ *      IN list values that fall out of the range. Leaves that cannot be
+ *      compared with each other are kept as is.
+ */
+void FilterPushdown::merge_column_intervals(FilterNode &node)
+{
+    auto &children = node.children;
+
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        FilterNode &range = children[i];
+
+        if (range.kind != FilterNode::FILTER_RANGE || range.empty)
+            continue;
+
+        for (size_t j = i + 1; j < children.size();)
+        {
+            FilterNode &other = children[j];
+            FilterNode  merged = range;
+            bool        ok = true;
+
+            if (other.kind != FilterNode::FILTER_RANGE || other.attnum != range.attnum
+                || other.collid != range.collid || !equal(other.columnExpr, range.columnExpr))
+            {
+                ++j;
+                continue;
+            }
+
+            if (other.lower)
+            {
+                int c = merged.lower ? compare(merged.lower->consttype, merged.lower->constvalue,
+                                               other.lower->consttype, other.lower->constvalue,
+                                               range.collid, &ok)
+                                     : -1;
+
+                if (c < 0)
+                {
+                    merged.lower          = other.lower;
+                    merged.lowerInclusive = other.lowerInclusive;
+                }
+                else if (c == 0)
+                    merged.lowerInclusive = merged.lowerInclusive && other.lowerInclusive;
+            }
+
+            if (ok && other.upper)
+            {
+                int c = merged.upper ? compare(merged.upper->consttype, merged.upper->constvalue,
+                                               other.upper->consttype, other.upper->constvalue,
+                                               range.collid, &ok)
+                                     : 1;
+
+                if (c > 0)
+                {
+                    merged.upper          = other.upper;
+                    merged.upperInclusive = other.upperInclusive;
+                }
+                else if (c == 0)
+                    merged.upperInclusive = merged.upperInclusive && other.upperInclusive;
+            }
+
+            if (ok && merged.lower && merged.upper)
+            {
+                int c = compare(merged.lower->consttype, merged.lower->constvalue,
+                                merged.upper->consttype, merged.upper->constvalue, range.collid,
+                                &ok);
+
+                merged.empty = c > 0 || (c == 0 && !(merged.lowerInclusive && merged.upperInclusive));
+            }
+
+            if (!ok)
+            {
+                ++j;
+                continue;
+            }
+
+            range = merged;
+            children.erase(children.begin() + j);
+        }
+    }
+
+    /* Leave only IN values that are within the range on the same column */
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        const FilterNode &range = children[i];
+        bool              merged = false;
+
+        if (range.kind != FilterNode::FILTER_RANGE)
+            continue;
+
+        for (auto &in : children)
+        {
+            std::vector<Datum> values;
+            bool               ok = true;
+
+            if (in.kind != FilterNode::FILTER_IN || in.attnum != range.attnum
+                || in.collid != range.collid || !equal(in.columnExpr, range.columnExpr))
+                continue;
+
+            for (Datum value : in.values)
+            {
+                bool within = !range.empty;
+
+                if (within && range.lower)
+                {
+                    int c = compare(in.valueType, value, range.lower->consttype,
+                                    range.lower->constvalue, range.collid, &ok);
+                    within = range.lowerInclusive ? c >= 0 : c > 0;
+                }
+                if (ok && within && range.upper)
+                {
+                    int c = compare(in.valueType, value, range.upper->consttype,
+                                    range.upper->constvalue, range.collid, &ok);
+                    within = range.upperInclusive ? c <= 0 : c < 0;
+                }
+                if (!ok)
+                    break;
+                if (within)
+                    values.push_back(value);
+            }
+
+            if (ok)
+            {
+                in.values = values;
+                merged    = true;
+                break;
+            }
+        }
+
+        /* Range is implied by the filtered IN list now */
+        if (merged)
+        {
+            children.erase(children.begin() + i);
+            --i;
+        }
+    }
+}
+
+/*
+ * Native comparisons of the fixed width types. Floats follow postgres
+ * ordering where NaN is greater than any other value.
+ */
+static int cmp_int16(Datum value1, Datum value2)
+{
+    const int16 a = DatumGetInt16(value1), b = DatumGetInt16(value2);
+
+    return (a > b) - (a < b);
+}
+
+static int cmp_int32(Datum value1, Datum value2)
+{
+    const int32 a = DatumGetInt32(value1), b = DatumGetInt32(value2);
+
+    return (a > b) - (a < b);
+}
+
+static int cmp_int64(Datum value1, Datum value2)
+{
+    const int64 a = DatumGetInt64(value1), b = DatumGetInt64(value2);
+
+    return (a > b) - (a < b);
+}
+
+template <typename T>
+static int cmp_float(T a, T b)
+{
+    if (std::isnan(a))
+        return std::isnan(b) ? 0 : 1;
+    if (std::isnan(b))
+        return -1;
+    return (a > b) - (a < b);
+}
+
+static int cmp_float4(Datum value1, Datum value2)
+{
+    return cmp_float(DatumGetFloat4(value1), DatumGetFloat4(value2));
+}
+
+static int cmp_float8(Datum value1, Datum value2)
+{
+    return cmp_float(DatumGetFloat8(value1), DatumGetFloat8(value2));
+}
+
+static int cmp_bool(Datum value1, Datum value2)
+{
+    return (int)DatumGetBool(value1) - (int)DatumGetBool(value2);
+}
+
+/*
+ * make_comparator
+ *      Resolve comparison of two given types. Returns false if types are not
+ *      comparable.
+ */
+bool FilterPushdown::make_comparator(Comparator *cmp, Oid type1, Oid type2, Oid collid)
+{
+    FmgrInfo finfo;
+
+    cmp->native = nullptr;
+    cmp->collid = collid;
+
+    if (type1 == type2)
+    {
+        switch (type1)
+        {
+        case BOOLOID:
+            cmp->native = cmp_bool;
+            return true;
+        case INT2OID:
+            cmp->native = cmp_int16;
+            return true;
+        case INT4OID:
+        case DATEOID:
+            cmp->native = cmp_int32;
+            return true;
+        case INT8OID:
+        case TIMESTAMPOID:
+        case TIMESTAMPTZOID:
+            cmp->native = cmp_int64;
+            return true;
+        case FLOAT4OID:
+            cmp->native = cmp_float4;
+            return true;
+        case FLOAT8OID:
+            cmp->native = cmp_float8;
+            return true;
+        default:
+            break;
+        }
+    }
+
+    if (!find_cmp_func(&finfo, type1, type2))
+        return false;
+
+    cmp->finfo = &cmpFuncs[std::make_pair(type1, type2)];
+    return true;
+}
+
+/*
+ * to_datum
+ *      Convert a value of parquet physical type to postgres Datum of the type
+ *      matching the arrow type of the column.
+ */
+static Datum to_datum(bool value, arrow::DataType *)
+{
+    return BoolGetDatum(value);
+}
+
+static Datum to_datum(int32_t value, arrow::DataType *arrow_type)
+{
+    if (arrow_type->id() == arrow::Type::DATE32)
+        return DateADTGetDatum(value + (UNIX_EPOCH_JDATE - POSTGRES_EPOCH_JDATE));
+    return Int32GetDatum(value);
+}
+
+static Datum to_datum(int64_t value, arrow::DataType *arrow_type)
+{
+    if (arrow_type->id() == arrow::Type::TIMESTAMP)
+    {
+        TimestampTz ts;
+        auto        tstype = (arrow::TimestampType *)arrow_type;
+
+        to_postgres_timestamp(tstype, value, ts);
+        return TimestampGetDatum(ts);
+    }
+    return Int64GetDatum(value);
+}
+
+static Datum to_datum(float value, arrow::DataType *)
+{
+    return Float4GetDatum(value);
+}
+
+static Datum to_datum(double value, arrow::DataType *)
+{
+    return Float8GetDatum(value);
+}
+
+static Datum to_datum(const parquet::ByteArray &value, arrow::DataType *)
+{
+    return PointerGetDatum(cstring_to_text_with_len((const char *)value.ptr, value.len));
+}
+
+/*
+ * physical_type_matches
+ *      Whether statistics of the parquet physical type can be converted to
+ *      values of the arrow type.
+ */
+static bool physical_type_matches(parquet::Type::type physicalType, arrow::DataType *arrow_type)
+{
+    switch (arrow_type->id())
+    {
+    case arrow::Type::BOOL:
+        return physicalType == parquet::Type::BOOLEAN;
+    case arrow::Type::INT32:
+    case arrow::Type::DATE32:
+        return physicalType == parquet::Type::INT32;
+    case arrow::Type::INT64:
+    case arrow::Type::TIMESTAMP:
+        return physicalType == parquet::Type::INT64;
+    case arrow::Type::FLOAT:
+        return physicalType == parquet::Type::FLOAT;
+    case arrow::Type::DOUBLE:
+        return physicalType == parquet::Type::DOUBLE;
+    case arrow::Type::STRING:
+    case arrow::Type::BINARY:
+        return physicalType == parquet::Type::BYTE_ARRAY;
+    default:
+        return false;
+    }
+}
+
+template <typename DType>
+static void typed_min_max(parquet::Statistics *stats, arrow::DataType *arrow_type, Datum *min, Datum *max)
+{
+    auto typed = (parquet::TypedStatistics<DType> *)stats;
+
+    *min = to_datum(typed->min(), arrow_type);
+    *max = to_datum(typed->max(), arrow_type);
+}
+
+/*
+ * decode_min_max
+ *      Convert min/max values of typed column statistics to postgres Datums.
+ *      Returns false if the values cannot be represented.
+ */
+static bool decode_min_max(parquet::Statistics *stats, arrow::DataType *arrow_type, Datum *min, Datum *max)
+{
+    if (!physical_type_matches(stats->physical_type(), arrow_type))
+        return false;
+
+    switch (stats->physical_type())
+    {
+    case parquet::Type::BOOLEAN:
+        typed_min_max<parquet::BooleanType>(stats, arrow_type, min, max);
+        break;
+    case parquet::Type::INT32:
+        typed_min_max<parquet::Int32Type>(stats, arrow_type, min, max);
+        break;
+    case parquet::Type::INT64:
+        typed_min_max<parquet::Int64Type>(stats, arrow_type, min, max);
+        break;
+    case parquet::Type::FLOAT:
+        typed_min_max<parquet::FloatType>(stats, arrow_type, min, max);
+        break;
+    case parquet::Type::DOUBLE:
+        typed_min_max<parquet::DoubleType>(stats, arrow_type, min, max);
+        break;
+    case parquet::Type::BYTE_ARRAY:
+        typed_min_max<parquet::ByteArrayType>(stats, arrow_type, min, max);
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+#ifdef PARQUET_FDW_PAGE_INDEX
+template <typename DType>
+static void typed_page_bounds(const parquet::ColumnIndex &index,
+                              arrow::DataType *           arrow_type,
+                              std::vector<bool> &         hasMinMax,
+                              std::vector<Datum> &        min,
+                              std::vector<Datum> &        max)
+{
+    const auto &typed     = (const parquet::TypedColumnIndex<DType> &)index;
+    const auto &nullPages = index.null_pages();
+
+    if (typed.min_values().size() != nullPages.size() || typed.max_values().size() != nullPages.size())
+        return;
+
+    for (size_t i = 0; i < nullPages.size(); ++i)
+    {
+        if (nullPages[i])
+            continue;
+
+        min[i]       = to_datum(typed.min_values()[i], arrow_type);
+        max[i]       = to_datum(typed.max_values()[i], arrow_type);
+        hasMinMax[i] = true;
+    }
+}
+
+/*
+ * decode_page_bounds
+ *      Convert page min/max values of the column index to postgres Datums.
+ */
+static void decode_page_bounds(const parquet::ColumnIndex &index,
+                               parquet::Type::type         physicalType,
+                               arrow::DataType *           arrow_type,
+                               std::vector<bool> &         hasMinMax,
+                               std::vector<Datum> &        min,
+                               std::vector<Datum> &        max)
+{
+    if (!physical_type_matches(physicalType, arrow_type))
+        return;
+
+    switch (physicalType)
+    {
+    case parquet::Type::BOOLEAN:
+        typed_page_bounds<parquet::BooleanType>(index, arrow_type, hasMinMax, min, max);
+        break;
+    case parquet::Type::INT32:
+        typed_page_bounds<parquet::Int32Type>(index, arrow_type, hasMinMax, min, max);
+        break;
+    case parquet::Type::INT64:
+        typed_page_bounds<parquet::Int64Type>(index, arrow_type, hasMinMax, min, max);
+        break;
+    case parquet::Type::FLOAT:
+        typed_page_bounds<parquet::FloatType>(index, arrow_type, hasMinMax, min, max);
+        break;
+    case parquet::Type::DOUBLE:
+        typed_page_bounds<parquet::DoubleType>(index, arrow_type, hasMinMax, min, max);
+        break;
+    case parquet::Type::BYTE_ARRAY:
+        typed_page_bounds<parquet::ByteArrayType>(index, arrow_type, hasMinMax, min, max);
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * intersect_ranges
+ *      Rows within both range lists.
+ */
+static tRowRanges intersect_ranges(const tRowRanges &a, const tRowRanges &b)
+{
+    tRowRanges res;
+    size_t     i = 0, j = 0;
+
+    while (i < a.size() && j < b.size())
+    {
+        const int64_t first = std::max(a[i].first, b[j].first);
+        const int64_t last  = std::min(a[i].second, b[j].second);
+
+        if (first < last)
+            res.push_back({ first, last });
+
+        if (a[i].second < b[j].second)
+            ++i;
+        else
+            ++j;
+    }
+
+    return res;
+}
+
+/*
+ * unite_ranges
+ *      Rows within any of the range lists.
+ */
+static tRowRanges unite_ranges(const tRowRanges &a, const tRowRanges &b)
+{
+    tRowRanges all(a);
+    tRowRanges res;
+
+    all.insert(all.end(), b.begin(), b.end());
+    std::sort(all.begin(), all.end());
+
+    for (const auto &range : all)
+    {
+        if (!res.empty() && range.first <= res.back().second)
+            res.back().second = std::max(res.back().second, range.second);
+        else
+            res.push_back(range);
+    }
+
+    return res;
+}
+
+/*
+ * append_range
+ *      Add rows following the last range of the list.
+ */
+static void append_range(tRowRanges &ranges, int64_t first, int64_t last)
+{
+    if (first >= last)
+        return;
+
+    if (!ranges.empty() && ranges.back().second == first)
+        ranges.back().second = last;
+    else
+        ranges.push_back({ first, last });
+}
+#endif
+
+/*
+ * equality_values
+ *      Values the leaf requires the column itself to be equal to one of.
+ *      Returns false for any other kind of leaf.
+ */
+bool FilterPushdown::equality_values(const FilterNode &node, std::vector<Datum> *values, Oid *valueType)
+{
+    /* Stored values are not the transformed ones */
+    if (!node.transforms.empty())
+        return false;
+
+    if (node.kind == FilterNode::FILTER_IN && !node.values.empty())
+    {
+        *values    = node.values;
+        *valueType = node.valueType;
+        return true;
+    }
+
+    if (node.kind == FilterNode::FILTER_RANGE && !node.empty && node.lower
+        && node.lower == node.upper && node.lowerInclusive && node.upperInclusive)
+    {
+        values->assign(1, node.lower->constvalue);
+        *valueType = node.lower->consttype;
+        return true;
+    }
+
+    return false;
+}
+
+template <typename T>
+static bool read_plain(const uint8_t *data, int64_t size, int64_t &pos, T *value)
+{
+    if (pos + (int64_t)sizeof(T) > size)
+        return false;
+
+    memcpy(value, data + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+/*
+ * decode_dictionary
+ *      Convert plain encoded values of the dictionary page to postgres Datums.
+ *      Returns false if the page cannot be decoded.
+ */
+static bool decode_dictionary(const parquet::DictionaryPage &page,
+                              parquet::Type::type            physicalType,
+                              arrow::DataType *              arrow_type,
+                              std::vector<Datum> &           values)
+{
+    const uint8_t *data = page.data();
+    const int64_t  size = page.size();
+    int64_t        pos  = 0;
+
+    if (page.encoding() != parquet::Encoding::PLAIN
+        && page.encoding() != parquet::Encoding::PLAIN_DICTIONARY)
+        return false;
+
+    if (!physical_type_matches(physicalType, arrow_type))
+        return false;
+
+    values.reserve(page.num_values());
+    for (int32_t i = 0; i < page.num_values(); ++i)
+    {
+        switch (physicalType)
+        {
+        case parquet::Type::INT32:
+        {
+            int32_t v;
+
+            if (!read_plain(data, size, pos, &v))
+                return false;
+            values.push_back(to_datum(v, arrow_type));
+            break;
+        }
+        case parquet::Type::INT64:
+        {
+            int64_t v;
+
+            if (!read_plain(data, size, pos, &v))
+                return false;
+            values.push_back(to_datum(v, arrow_type));
+            break;
+        }
+        case parquet::Type::FLOAT:
+        {
+            float v;
+
+            if (!read_plain(data, size, pos, &v))
+                return false;
+            values.push_back(to_datum(v, arrow_type));
+            break;
+        }
+        case parquet::Type::DOUBLE:
+        {
+            double v;
+
+            if (!read_plain(data, size, pos, &v))
+                return false;
+            values.push_back(to_datum(v, arrow_type));
+            break;
+        }
+        case parquet::Type::BYTE_ARRAY:
+        {
+            uint32_t len;
+
+            if (!read_plain(data, size, pos, &len) || pos + len > size)
+                return false;
+            values.push_back(to_datum(parquet::ByteArray(len, data + pos), arrow_type));
+            pos += len;
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * dictionary
+ *      Distinct values of the column chunk if it is entirely dictionary
+ *      encoded. Pages are read and decoded once per row group and column.
+ */
+const std::optional<std::vector<Datum>> &FilterPushdown::dictionary(const ParquetFdwReader &reader,
+                                                                     int rowGroupId,
+                                                                     int columnIndex)
+{
+    const auto key = std::make_pair(rowGroupId, columnIndex);
+    auto       it  = dictionaries.find(key);
+
+    if (it != dictionaries.end())
+        return it->second;
+
+    auto &res  = dictionaries[key];
+    auto  page = reader.getDictionaryPage(rowGroupId, columnIndex);
+
+    if (page)
+    {
+        const auto         chunk = reader.getRowGroup(rowGroupId)->ColumnChunk(columnIndex);
+        const auto         type  = reader.GetSchema()->field(columnIndex)->type();
+        std::vector<Datum> values;
+        MemoryContext      oldcxt = MemoryContextSwitchTo(cxt);
+
+        if (decode_dictionary(*page, chunk->type(), type.get(), values))
+            res = std::move(values);
+        MemoryContextSwitchTo(oldcxt);
+    }
+
+    return res;
+}
+
+/*
+ * probe_dictionaries
+ *      Rule out row groups where the dictionary of the column contains none
+ *      of the values the leaf requires the column to be equal to. As reading
+ *      dictionary pages is expensive this is done only if enabled and only
+ *      for row groups the other checks have left.
+ */
+void FilterPushdown::probe_dictionaries(const FilterNode &      node,
+                                        const ParquetFdwReader &reader,
+                                        int                     columnIndex,
+                                        std::vector<Truth> &    res)
+{
+    std::vector<Datum> values;
+    Oid                valueType;
+    Comparator         cmp;
+
+    if (!dictionaryPruning || !equality_values(node, &values, &valueType))
+        return;
+
+    const auto pgType = arrowTypeToPostgresType(reader.GetSchema()->field(columnIndex)->type()->id());
+
+    if (pgType == InvalidOid || !make_comparator(&cmp, valueType, pgType, node.collid))
+        return;
+
+    for (size_t r = 0; r < res.size(); ++r)
+    {
+        if (!res[r].canBeTrue)
+            continue;
+
+        const auto &dict = dictionary(reader, r, columnIndex);
+        if (!dict)
+            continue;
+
+        bool found = false;
+        for (Datum value : values)
+        {
+            for (Datum entry : *dict)
+            {
+                if (cmp(value, entry) == 0)
+                {
+                    found = true;
+                    break;
+                }
+            }
+            if (found)
+                break;
+        }
+
+        if (!found)
+        {
+            elog(DEBUG1, "parquet_fdw: dictionary rules out rowgroup %zu of file %s", r,
+                 reader.getPath().c_str());
+            res[r].canBeTrue = false;
+        }
+    }
+}
+
+#ifdef PARQUET_FDW_BLOOM_FILTER
+/*
+ * bloom_filter_hash
+ *      Hash of the value as it would be stored in the column of the arrow
+ *      type. Returns false if the value has no exact representation there or
+ *      equal values may have different representations.
+ */
+static bool bloom_filter_hash(const parquet::BloomFilter &filter,
+                              arrow::DataType *           arrow_type,
+                              Oid                         valueType,
+                              Datum                       value,
+                              Oid                         collid,
+                              uint64_t *                  hash)
+{
+    switch (arrow_type->id())
+    {
+    case arrow::Type::INT32:
+    case arrow::Type::INT64:
+    {
+        int64 v;
+
+        switch (valueType)
+        {
+        case INT2OID:
+            v = DatumGetInt16(value);
+            break;
+        case INT4OID:
+            v = DatumGetInt32(value);
+            break;
+        case INT8OID:
+            v = DatumGetInt64(value);
+            break;
+        default:
+            return false;
+        }
+
+        if (arrow_type->id() == arrow::Type::INT64)
+            *hash = filter.Hash((int64_t)v);
+        else if (v >= PG_INT32_MIN && v <= PG_INT32_MAX)
+            *hash = filter.Hash((int32_t)v);
+        else
+            return false;
+        return true;
+    }
+    case arrow::Type::DATE32:
+    {
+        DateADT d;
+
+        if (valueType != DATEOID)
+            return false;
+
+        d = DatumGetDateADT(value);
+        if (DATE_NOT_FINITE(d))
+            return false;
+
+        *hash = filter.Hash((int32_t)(d + (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE)));
+        return true;
+    }
+    case arrow::Type::TIMESTAMP:
+    {
+        auto      tstype = (arrow::TimestampType *)arrow_type;
+        Timestamp ts;
+        int64_t   v;
+
+        if (valueType != TIMESTAMPOID)
+            return false;
+
+        /*
+         * Values are read truncated to whole seconds, so the constant also
+         * equals stored values with fractions of a second, which hash
+         * differently. Only columns of whole seconds are probed.
+         */
+        if (tstype->unit() != arrow::TimeUnit::SECOND)
+            return false;
+
+        ts = DatumGetTimestamp(value);
+        if (TIMESTAMP_NOT_FINITE(ts))
+            return false;
+
+        /* Microseconds since unix epoch */
+        v = ts + (int64_t)(POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE) * USECS_PER_DAY;
+        if (v % USECS_PER_SEC != 0)
+            return false;
+
+        *hash = filter.Hash(v / USECS_PER_SEC);
+        return true;
+    }
+    case arrow::Type::FLOAT:
+    {
+        float v;
+
+        if (valueType != FLOAT4OID)
+            return false;
+
+        /* Zeros of both signs and NaNs are equal but hash differently */
+        v = DatumGetFloat4(value);
+        if (v == 0 || std::isnan(v))
+            return false;
+
+        *hash = filter.Hash(v);
+        return true;
+    }
+    case arrow::Type::DOUBLE:
+    {
+        double v;
+
+        if (valueType != FLOAT8OID)
+            return false;
+
+        v = DatumGetFloat8(value);
+        if (v == 0 || std::isnan(v))
+            return false;
+
+        *hash = filter.Hash(v);
+        return true;
+    }
+    case arrow::Type::STRING:
+    case arrow::Type::BINARY:
+    {
+        bytea *v;
+
+        if (arrow_type->id() == arrow::Type::STRING ? (valueType != TEXTOID && valueType != VARCHAROID)
+                                                    : valueType != BYTEAOID)
+            return false;
+
+#if PG_VERSION_NUM >= 120000
+        /* Equal strings must be equal byte-wise */
+        if (OidIsValid(collid) && !get_collation_isdeterministic(collid))
+            return false;
+#endif
+
+        v = DatumGetByteaPP(value);
+        *hash = filter.Hash(parquet::ByteArray((uint32_t)VARSIZE_ANY_EXHDR(v),
+                                               (const uint8_t *)VARDATA_ANY(v)));
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+/*
+ * probe_bloom_filters
+ *      Rule out row groups where the bloom filter of the column contains none
+ *      of the values the leaf requires the column to be equal to. Only row
+ *      groups min/max statistics didn't exclude already are probed.
+ */
+void FilterPushdown::probe_bloom_filters(const FilterNode &      node,
+                                         const ParquetFdwReader &reader,
+                                         int                     columnIndex,
+                                         std::vector<Truth> &    res)
+{
+    std::vector<Datum> values;
+    Oid                valueType;
+
+    if (!equality_values(node, &values, &valueType))
+        return;
+
+    const auto type = reader.GetSchema()->field(columnIndex)->type();
+
+    for (size_t r = 0; r < res.size(); ++r)
+    {
+        if (!res[r].canBeTrue)
+            continue;
+
+        const auto column = reader.getRowGroup(r)->ColumnChunk(columnIndex);
+        if (!physical_type_matches(column->type(), type.get()))
+            return;
+
+        const auto filter = reader.getBloomFilter(r, columnIndex);
+        if (!filter)
+            continue;
+
+        bool found = false;
+        for (Datum value : values)
+        {
+            uint64_t hash;
+
+            if (!bloom_filter_hash(*filter, type.get(), valueType, value, node.collid, &hash)
+                || filter->FindHash(hash))
+            {
+                found = true;
+                break;
+            }
+        }
+
+        if (!found)
+        {
+            elog(DEBUG1, "parquet_fdw: bloom filter rules out rowgroup %zu of file %s", r,
+                 reader.getPath().c_str());
+            res[r].canBeTrue = false;
+        }
+    }
+}
+#endif
+
+/*
+ * column_stats
+ *      Decode statistics of the column for all the row groups of the file.
+ */
+const FilterPushdown::ColumnStats &FilterPushdown::column_stats(const ParquetFdwReader &reader,
+                                                                int                     columnIndex)
+{
+    auto it = columnStats.find(columnIndex);
+
+    if (it != columnStats.end())
+        return it->second;
+
+    const size_t  numRowGroups = reader.getNumRowGroups();
+    const auto    type         = reader.GetSchema()->field(columnIndex)->type();
+    ColumnStats & res          = columnStats[columnIndex];
+    MemoryContext oldcxt;
+
+    res.pgType = arrowTypeToPostgresType(type->id());
+    res.hasStats.resize(numRowGroups, false);
+    res.hasNulls.resize(numRowGroups, true);
+    res.hasValues.resize(numRowGroups, true);
+    res.hasMinMax.resize(numRowGroups, false);
+    res.min.resize(numRowGroups, (Datum)0);
+    res.max.resize(numRowGroups, (Datum)0);
+    res.nullCount.resize(numRowGroups, -1);
+
+    /* Decoded values are kept as long as the object */
+    oldcxt = MemoryContextSwitchTo(cxt);
+
+    for (size_t r = 0; r < numRowGroups; ++r)
+    {
+        const auto rowgroup = reader.getRowGroup(r);
+
+        if (columnIndex >= rowgroup->num_columns())
+            continue;
+
+        const auto stats = rowgroup->ColumnChunk(columnIndex)->statistics();
+        if (!stats)
+            continue;
+
+        res.hasStats[r]  = true;
+        res.hasNulls[r]  = !stats->HasNullCount() || stats->null_count() > 0;
+        res.nullCount[r] = stats->HasNullCount() ? stats->null_count() : -1;
+        res.hasValues[r] = stats->num_values() > 0;
+        res.hasMinMax[r] = stats->HasMinMax() && res.pgType != InvalidOid
+                           && decode_min_max(stats.get(), type.get(), &res.min[r], &res.max[r]);
+    }
+
+    MemoryContextSwitchTo(oldcxt);
+
+    return res;
+}
+
+/*
+ * evaluate_leaf
+ *      Check column statistics of every row group against the leaf.
+ */
+std::vector<FilterPushdown::Truth> FilterPushdown::evaluate_leaf(const FilterNode & node,
+                                                                 const ColumnStats &stats)
+{
+    const size_t       numRowGroups = stats.hasStats.size();
+    std::vector<Truth> res(numRowGroups, Truth{ true, true });
+    const Datum *      min = stats.min.data();
+    const Datum *      max = stats.max.data();
+    std::vector<Datum> transformedMin, transformedMax;
+    Oid                pgType = stats.pgType;
+    Comparator         lowerCmp, upperCmp, valueCmp;
+    bool               ok = true;
+
+    if (node.kind == FilterNode::FILTER_NULL_TEST)
+    {
+        for (size_t r = 0; r < numRowGroups; ++r)
+        {
+            if (stats.hasStats[r])
+                res[r] = node.isNull ? Truth{ stats.hasNulls[r], stats.hasValues[r] }
+                                     : Truth{ stats.hasValues[r], stats.hasNulls[r] };
+        }
+        return res;
+    }
+
+    if (!node.transforms.empty())
+    {
+        transformedMin = stats.min;
+        transformedMax = stats.max;
+        for (size_t r = 0; r < numRowGroups; ++r)
+        {
+            if (stats.hasMinMax[r] && stats.hasValues[r])
+            {
+                transformedMin[r] = apply_transforms(node, min[r]);
+                transformedMax[r] = apply_transforms(node, max[r]);
+            }
+        }
+        min    = transformedMin.data();
+        max    = transformedMax.data();
+        pgType = node.columnType;
+    }
+
+    /* Resolve comparisons once for all the row groups */
+    if (node.kind == FilterNode::FILTER_RANGE)
+    {
+        if (node.lower)
+            ok = make_comparator(&lowerCmp, node.lower->consttype, pgType, node.collid);
+        if (ok && node.upper)
+            ok = make_comparator(&upperCmp, node.upper->consttype, pgType, node.collid);
+    }
+    else
+        ok = node.values.empty() || make_comparator(&valueCmp, node.valueType, pgType, node.collid);
+
+    for (size_t r = 0; r < numRowGroups; ++r)
+    {
+        if (!stats.hasStats[r])
+            continue;
+
+        /* Comparisons are NULL for all the rows if there are no values */
+        if (!stats.hasValues[r])
+        {
+            res[r] = { false, false };
+            continue;
+        }
+
+        if (node.kind == FilterNode::FILTER_RANGE && node.empty)
+        {
+            res[r] = { false, true };
+            continue;
+        }
+
+        if (!stats.hasMinMax[r] || !ok)
+            continue;
+
+        if (node.kind == FilterNode::FILTER_RANGE)
+        {
+            bool canBeTrue = true;
+            bool lowerOk   = true; /* all values satisfy lower bound */
+            bool upperOk   = true; /* all values satisfy upper bound */
+
+            if (node.lower)
+            {
+                const int cmax = lowerCmp(node.lower->constvalue, max[r]);
+                const int cmin = lowerCmp(node.lower->constvalue, min[r]);
+
+                canBeTrue = canBeTrue && (node.lowerInclusive ? cmax <= 0 : cmax < 0);
+                lowerOk   = node.lowerInclusive ? cmin <= 0 : cmin < 0;
+            }
+
+            if (node.upper)
+            {
+                const int cmin = upperCmp(node.upper->constvalue, min[r]);
+                const int cmax = upperCmp(node.upper->constvalue, max[r]);
+
+                canBeTrue = canBeTrue && (node.upperInclusive ? cmin >= 0 : cmin > 0);
+                upperOk   = node.upperInclusive ? cmax >= 0 : cmax > 0;
+            }
+
+            res[r] = { canBeTrue, !(lowerOk && upperOk) };
+        }
+        else
+        {
+            size_t left  = 0;
+            size_t right = node.values.size();
+
+            res[r] = { false, !node.hasNullValue };
+
+            /* Find the first value which is not less than min */
+            while (left < right)
+            {
+                const size_t mid = (left + right) / 2;
+
+                if (valueCmp(node.values[mid], min[r]) < 0)
+                    left = mid + 1;
+                else
+                    right = mid;
+            }
+
+            if (left < node.values.size())
+            {
+                const int cmax = valueCmp(node.values[left], max[r]);
+                const int cmin = valueCmp(node.values[left], min[r]);
+
+                res[r].canBeTrue = cmax <= 0;
+
+                /* All the values of the row group are equal to the listed one */
+                if (cmin == 0 && cmax == 0)
+                    res[r].canBeFalse = false;
+            }
+        }
+    }
+
+    return res;
+}
+
+/*
+ * evaluate
+ *      Check whether the clause can be true or false for some rows of each
+ *      row group.
+ */
+std::vector<FilterPushdown::Truth> FilterPushdown::evaluate(const FilterNode &      node,
+                                                            const ParquetFdwReader &reader)
+{
+    const size_t numRowGroups = reader.getNumRowGroups();
+
+    switch (node.kind)
+    {
+    case FilterNode::FILTER_AND:
+    {
+        std::vector<Truth> res(numRowGroups, Truth{ true, false });
+
+        for (const auto &child : node.children)
+        {
+            const auto t = evaluate(child, reader);
+
+            for (size_t r = 0; r < numRowGroups; ++r)
+            {
+                res[r].canBeTrue  = res[r].canBeTrue && t[r].canBeTrue;
+                res[r].canBeFalse = res[r].canBeFalse || t[r].canBeFalse;
+            }
+        }
+        return res;
+    }
+
+    case FilterNode::FILTER_OR:
+    {
+        std::vector<Truth> res(numRowGroups, Truth{ false, true });
+
+        for (const auto &child : node.children)
+        {
+            const auto t = evaluate(child, reader);
+
+            for (size_t r = 0; r < numRowGroups; ++r)
+            {
+                res[r].canBeTrue  = res[r].canBeTrue || t[r].canBeTrue;
+                res[r].canBeFalse = res[r].canBeFalse && t[r].canBeFalse;
+            }
+        }
+        return res;
+    }
+
+    case FilterNode::FILTER_NOT:
+    {
+        auto res = evaluate(node.children[0], reader);
+
+        for (auto &t : res)
+            std::swap(t.canBeTrue, t.canBeFalse);
+        return res;
+    }
+
+    case FilterNode::FILTER_RANGE:
+    case FilterNode::FILTER_IN:
+    case FilterNode::FILTER_NULL_TEST:
+    {
+        /* Partition columns are pruned by directory already */
+        const int columnIndex = reader.columnIndex(node.attnum - 1);
+        if (columnIndex < 0)
+            break;
+
+        auto res = evaluate_leaf(node, column_stats(reader, columnIndex));
+#ifdef PARQUET_FDW_BLOOM_FILTER
+        probe_bloom_filters(node, reader, columnIndex, res);
+#endif
+        probe_dictionaries(node, reader, columnIndex, res);
+        return res;
+    }
+
+    case FilterNode::FILTER_UNKNOWN:
+        break;
+    }
+
+    return std::vector<Truth>(numRowGroups, Truth{ true, true });
+}
+
+/*
+ * Kinds of values whose differences are comparable, so that the share of a
+ * range of a row group is the share of the difference of its bounds
+ */
+enum ValueScale
+{
+    SCALE_NONE,
+    SCALE_NUMBER,
+    SCALE_DATE,
+    SCALE_TIMESTAMP,
+};
+
+/*
+ * scale_value
+ *      Value of a number, date or timestamp on the scale of its kind. Sets
+ *      whether the type only has whole values.
+ */
+static ValueScale scale_value(Oid type, Datum value, double *res, bool *integral)
+{
+    *integral = true;
+
+    switch (type)
+    {
+    case BOOLOID:
+        *res = DatumGetBool(value);
+        return SCALE_NUMBER;
+    case INT2OID:
+        *res = DatumGetInt16(value);
+        return SCALE_NUMBER;
+    case INT4OID:
+        *res = DatumGetInt32(value);
+        return SCALE_NUMBER;
+    case INT8OID:
+        *res = DatumGetInt64(value);
+        return SCALE_NUMBER;
+    case FLOAT4OID:
+        *integral = false;
+        *res      = DatumGetFloat4(value);
+        return std::isfinite(*res) ? SCALE_NUMBER : SCALE_NONE;
+    case FLOAT8OID:
+        *integral = false;
+        *res      = DatumGetFloat8(value);
+        return std::isfinite(*res) ? SCALE_NUMBER : SCALE_NONE;
+    case DATEOID:
+        *res = DatumGetDateADT(value);
+        return DATE_NOT_FINITE(DatumGetDateADT(value)) ? SCALE_NONE : SCALE_DATE;
+    case TIMESTAMPOID:
+    case TIMESTAMPTZOID:
+        *integral = false;
+        *res      = DatumGetTimestamp(value);
+        return TIMESTAMP_NOT_FINITE(DatumGetTimestamp(value)) ? SCALE_NONE : SCALE_TIMESTAMP;
+    default:
+        return SCALE_NONE;
+    }
+}
+
+/*
+ * default_selectivity
+ *      Share of the rows satisfying the leaf without statistics to tell, the
+ *      same as postgres assumes for columns without statistics.
+ */
+static double default_selectivity(bool equality, bool lower, bool upper, size_t numValues)
+{
+    if (numValues > 0)
+        return std::min(1.0, numValues * DEFAULT_EQ_SEL);
+    if (equality)
+        return DEFAULT_EQ_SEL;
+    if (lower && upper)
+        return DEFAULT_RANGE_INEQ_SEL;
+    return DEFAULT_INEQ_SEL;
+}
+
+/*
+ * null_fraction
+ *      Share of the rows of the row group with NULLs in the column, for row
+ *      groups with statistics.
+ */
+double FilterPushdown::null_fraction(const ColumnStats &stats, size_t rowGroupId, double numRows)
+{
+    if (stats.nullCount[rowGroupId] >= 0)
+        return std::min(stats.nullCount[rowGroupId] / numRows, 1.0);
+    return stats.hasNulls[rowGroupId] ? DEFAULT_UNK_SEL : 0.0;
+}
+
+/*
+ * leaf_selectivity
+ *      Share of the rows of every row group satisfying the leaf. Values of a
+ *      row group are taken as spread evenly between its min and max, and as
+ *      distinct unless the type has fewer whole values in between.
+ */
+std::vector<double> FilterPushdown::leaf_selectivity(const FilterNode &      node,
+                                                     const ColumnStats &     stats,
+                                                     const ParquetFdwReader &reader)
+{
+    const size_t        numRowGroups = stats.hasStats.size();
+    std::vector<double> res(numRowGroups, 1.0);
+    const Oid           pgType   = node.transforms.empty() ? stats.pgType : node.columnType;
+    bool                equality = false;
+    bool                ok;
+
+    if (node.kind == FilterNode::FILTER_RANGE && node.lower && node.upper && node.lowerInclusive
+        && node.upperInclusive)
+        equality = compare(node.lower->consttype, node.lower->constvalue, node.upper->consttype,
+                           node.upper->constvalue, node.collid, &ok) == 0
+                   && ok;
+
+    const double defaultSel = default_selectivity(
+        equality, node.lower, node.upper, node.kind == FilterNode::FILTER_IN ? node.values.size() : 0);
+
+    for (size_t r = 0; r < numRowGroups; ++r)
+    {
+        const double numRows = reader.getRowGroup(r)->num_rows();
+
+        if (!stats.hasStats[r] || numRows <= 0)
+        {
+            res[r] = node.kind == FilterNode::FILTER_NULL_TEST ? (node.isNull ? DEFAULT_UNK_SEL : 1.0 - DEFAULT_UNK_SEL)
+                                                               : defaultSel;
+            continue;
+        }
+
+        const double nullFrac = null_fraction(stats, r, numRows);
+
+        if (node.kind == FilterNode::FILTER_NULL_TEST)
+        {
+            res[r] = node.isNull ? nullFrac : 1.0 - nullFrac;
+            continue;
+        }
+
+        /* Comparisons are NULL for all the rows if there are no values */
+        if (!stats.hasValues[r] || (node.kind == FilterNode::FILTER_RANGE && node.empty))
+        {
+            res[r] = 0.0;
+            continue;
+        }
+
+        if (!stats.hasMinMax[r])
+        {
+            res[r] = (1.0 - nullFrac) * defaultSel;
+            continue;
+        }
+
+        const Datum min = node.transforms.empty() ? stats.min[r] : apply_transforms(node, stats.min[r]);
+        const Datum max = node.transforms.empty() ? stats.max[r] : apply_transforms(node, stats.max[r]);
+        double      low, high;
+        bool        integral;
+        const auto  scale = scale_value(pgType, min, &low, &integral);
+
+        scale_value(pgType, max, &high, &integral);
+
+        /*
+         * Distinct values in the row group, as many as postgres assumes for
+         * columns without statistics if the values cannot be counted
+         */
+        const double nonNull  = std::max(numRows * (1.0 - nullFrac), 1.0);
+        const bool   single   = scale != SCALE_NONE ? low == high
+                                                    : compare(pgType, min, pgType, max, node.collid, &ok) == 0 && ok;
+        const double distinct = single              ? 1.0
+                              : scale == SCALE_NONE ? std::min(nonNull, 1.0 / DEFAULT_EQ_SEL)
+                              : integral            ? std::min(nonNull, high - low + 1)
+                                                    : nonNull;
+
+        /* Share of the values of the row group equal to the value */
+        const auto equalShare = [&](Oid type, Datum value) {
+            double v;
+            bool   valueIntegral;
+
+            if (scale != SCALE_NONE && scale_value(type, value, &v, &valueIntegral) == scale
+                && (v < low || v > high))
+                return 0.0;
+            return 1.0 / distinct;
+        };
+
+        double sel;
+
+        if (node.kind == FilterNode::FILTER_IN)
+        {
+            sel = 0.0;
+            for (const Datum value : node.values)
+                sel += equalShare(node.valueType, value);
+        }
+        else if (equality)
+            sel = equalShare(node.lower->consttype, node.lower->constvalue);
+        else if (scale == SCALE_NONE)
+            sel = defaultSel;
+        else
+        {
+            double from = low;
+            double to   = high;
+            double v;
+            bool   valueIntegral;
+
+            sel = -1.0;
+            if (node.lower)
+            {
+                if (scale_value(node.lower->consttype, node.lower->constvalue, &v, &valueIntegral) != scale)
+                    sel = defaultSel;
+                else
+                    from = std::max(from, !node.lowerInclusive && integral && valueIntegral ? v + 1 : v);
+            }
+            if (node.upper)
+            {
+                if (scale_value(node.upper->consttype, node.upper->constvalue, &v, &valueIntegral) != scale)
+                    sel = defaultSel;
+                else
+                    to = std::min(to, !node.upperInclusive && integral && valueIntegral ? v - 1 : v);
+            }
+
+            if (sel < 0)
+            {
+                if (to < from)
+                    sel = 0.0;
+                else if (low == high)
+                    sel = 1.0;
+                else if (integral)
+                    sel = (to - from + 1) / (high - low + 1);
+                else
+                    sel = (to - from) / (high - low);
+            }
+        }
+
+        res[r] = (1.0 - nullFrac) * std::clamp(sel, 0.0, 1.0);
+    }
+
+    return res;
+}
+
+/*
+ * selectivity
+ *      Share of the rows of every row group satisfying the clause, taking the
+ *      clauses combined by AND and OR as independent within a row group.
+ */
+std::vector<double> FilterPushdown::selectivity(const FilterNode &node, const ParquetFdwReader &reader)
+{
+    const size_t numRowGroups = reader.getNumRowGroups();
+
+    switch (node.kind)
+    {
+    case FilterNode::FILTER_AND:
+    {
+        std::vector<double> res(numRowGroups, 1.0);
+
+        for (const auto &child : node.children)
+        {
+            const auto sel = selectivity(child, reader);
+
+            for (size_t r = 0; r < numRowGroups; ++r)
+                res[r] *= sel[r];
+        }
+        return res;
+    }
+
+    case FilterNode::FILTER_OR:
+    {
+        std::vector<double> res(numRowGroups, 0.0);
+
+        for (const auto &child : node.children)
+        {
+            const auto sel = selectivity(child, reader);
+
+            for (size_t r = 0; r < numRowGroups; ++r)
+                res[r] += sel[r] - res[r] * sel[r];
+        }
+        return res;
+    }
+
+    case FilterNode::FILTER_NOT:
+    {
+        /* Unknown clauses are counted as true, and so are their negations */
+        if (!judged_by_statistics(node.children[0], reader))
+            break;
+
+        auto       res   = selectivity(node.children[0], reader);
+        const auto nulls = null_share(node.children[0], reader);
+
+        /* Rows for which the clause is NULL satisfy neither it nor NOT */
+        for (size_t r = 0; r < numRowGroups; ++r)
+            res[r] = std::max(1.0 - res[r] - nulls[r], 0.0);
+        return res;
+    }
+
+    case FilterNode::FILTER_RANGE:
+    case FilterNode::FILTER_IN:
+    case FilterNode::FILTER_NULL_TEST:
+    {
+        /* Files of partitions not matching are not read at all */
+        const int columnIndex = reader.columnIndex(node.attnum - 1);
+        if (columnIndex < 0)
+            break;
+
+        return leaf_selectivity(node, column_stats(reader, columnIndex), reader);
+    }
+
+    case FilterNode::FILTER_UNKNOWN:
+        break;
+    }
+
+    return std::vector<double>(numRowGroups, 1.0);
 }
 
 /*
- * find_cmp_func
- *      Find comparison function for two given types.
+ * judged_by_statistics
+ *      Whether every leaf of the clause is a condition on a column stored in
+ *      the files, which selectivity() estimates from the statistics.
  */
-void FilterPushdown::find_cmp_func(FmgrInfo *finfo, Oid type1, Oid type2)
+bool FilterPushdown::judged_by_statistics(const FilterNode &node, const ParquetFdwReader &reader)
 {
-    Oid             cmp_proc_oid;
-    TypeCacheEntry *tce_1, *tce_2;
+    switch (node.kind)
+    {
+    case FilterNode::FILTER_AND:
+    case FilterNode::FILTER_OR:
+    case FilterNode::FILTER_NOT:
+        for (const auto &child : node.children)
+        {
+            if (!judged_by_statistics(child, reader))
+                return false;
+        }
+        return true;
 
-    tce_1 = lookup_type_cache(type1, TYPECACHE_BTREE_OPFAMILY);
-    tce_2 = lookup_type_cache(type2, TYPECACHE_BTREE_OPFAMILY);
+    case FilterNode::FILTER_RANGE:
+    case FilterNode::FILTER_IN:
+    case FilterNode::FILTER_NULL_TEST:
+        return reader.columnIndex(node.attnum - 1) >= 0;
+
+    case FilterNode::FILTER_UNKNOWN:
+        break;
+    }
 
-    cmp_proc_oid = get_opfamily_proc(tce_1->btree_opf, tce_1->btree_opintype, tce_2->btree_opintype,
-                                     BTORDER_PROC);
-    fmgr_info(cmp_proc_oid, finfo);
+    return false;
 }
 
 /*
- * row_group_matches_filter
- *      Check if min/max values of the column of the row group match filter.
+ * null_share
+ *      Share of the rows of every row group for which the clause is NULL,
+ *      taken as the largest share of NULLs among the columns of its leaves.
  */
-bool FilterPushdown::row_group_matches_filter(parquet::Statistics *stats, arrow::DataType *arrow_type,
-    const RowGroupFilter& filter)
+std::vector<double> FilterPushdown::null_share(const FilterNode &node, const ParquetFdwReader &reader)
 {
-    FmgrInfo finfo;
-    Datum    val      = filter.value->constvalue;
-    int      collid   = filter.value->constcollid;
-    int      strategy = filter.strategy;
-
-    const auto postgresType = arrowTypeToPostgresType(arrow_type->id());
-    find_cmp_func(&finfo, filter.value->consttype, postgresType);
+    const size_t        numRowGroups = reader.getNumRowGroups();
+    std::vector<double> res(numRowGroups, 0.0);
 
-    switch (filter.strategy)
+    switch (node.kind)
     {
-    case BTLessStrategyNumber:
-    case BTLessEqualStrategyNumber:
+    case FilterNode::FILTER_AND:
+    case FilterNode::FILTER_OR:
+    case FilterNode::FILTER_NOT:
+        for (const auto &child : node.children)
+        {
+            const auto nulls = null_share(child, reader);
+
+            for (size_t r = 0; r < numRowGroups; ++r)
+                res[r] = std::max(res[r], nulls[r]);
+        }
+        break;
+
+    case FilterNode::FILTER_RANGE:
+    case FilterNode::FILTER_IN:
     {
-        Datum lower;
-        int   cmpres;
-        bool  satisfies;
+        const int columnIndex = reader.columnIndex(node.attnum - 1);
+        if (columnIndex < 0)
+            break;
 
-        lower  = bytes_to_postgres_type(stats->EncodeMin().c_str(), arrow_type);
-        cmpres = FunctionCall2Coll(&finfo, collid, val, lower);
+        const auto &stats = column_stats(reader, columnIndex);
+        for (size_t r = 0; r < numRowGroups; ++r)
+        {
+            const double numRows = reader.getRowGroup(r)->num_rows();
 
-        satisfies = (strategy == BTLessStrategyNumber && cmpres > 0)
-                || (strategy == BTLessEqualStrategyNumber && cmpres >= 0);
+            if (stats.hasStats[r] && numRows > 0)
+                res[r] = null_fraction(stats, r, numRows);
+        }
+        break;
+    }
 
-        if (!satisfies)
-            return false;
+    /* IS [NOT] NULL is never NULL */
+    case FilterNode::FILTER_NULL_TEST:
+    case FilterNode::FILTER_UNKNOWN:
         break;
     }
 
-    case BTGreaterStrategyNumber:
-    case BTGreaterEqualStrategyNumber:
+    return res;
+}
+
+double FilterPushdown::estimateRows(const ParquetFdwReader &reader, List *skipList)
+{
+    const auto sel  = selectivity(root, reader);
+    double     rows = 0;
+
+    for (size_t r = 0; r < sel.size(); ++r)
+    {
+        if (!list_member_int(skipList, r))
+            rows += sel[r] * reader.getRowGroup(r)->num_rows();
+    }
+
+    return rows;
+}
+
+/*
+ * hasFilters
+ *      Whether any of the clauses can be checked against statistics.
+ */
+bool FilterPushdown::hasFilters() const
+{
+    for (const auto &child : root.children)
     {
-        Datum upper;
-        int   cmpres;
-        bool  satisfies;
+        if (child.kind != FilterNode::FILTER_UNKNOWN)
+            return true;
+    }
+    return false;
+}
+
+#ifdef PARQUET_FDW_PAGE_INDEX
+/*
+ * evaluate_pages
+ *      Find rows of the row group for which the clause can be true and rows
+ *      for which it can be false using per-page statistics of the column
+ *      index.
+ */
+FilterPushdown::RowRangesTruth FilterPushdown::evaluate_pages(const FilterNode &                node,
+                                                              const ParquetFdwReader &          reader,
+                                                              int                               rowGroupId,
+                                                              parquet::RowGroupPageIndexReader *pageIndex)
+{
+    const int64_t  numRows = reader.getRowGroup(rowGroupId)->num_rows();
+    const tRowRanges all{ { 0, numRows } };
 
-        upper  = bytes_to_postgres_type(stats->EncodeMax().c_str(), arrow_type);
-        cmpres = FunctionCall2Coll(&finfo, collid, val, upper);
+    switch (node.kind)
+    {
+    case FilterNode::FILTER_AND:
+    {
+        RowRangesTruth res{ all, {} };
 
-        satisfies = (strategy == BTGreaterStrategyNumber && cmpres < 0)
-                || (strategy == BTGreaterEqualStrategyNumber && cmpres <= 0);
+        for (const auto &child : node.children)
+        {
+            const auto t = evaluate_pages(child, reader, rowGroupId, pageIndex);
 
-        if (!satisfies)
-            return false;
-        break;
+            res.canBeTrue  = intersect_ranges(res.canBeTrue, t.canBeTrue);
+            res.canBeFalse = unite_ranges(res.canBeFalse, t.canBeFalse);
+        }
+        return res;
     }
 
-    case BTEqualStrategyNumber:
+    case FilterNode::FILTER_OR:
     {
-        Datum lower, upper;
+        RowRangesTruth res{ {}, all };
+
+        for (const auto &child : node.children)
+        {
+            const auto t = evaluate_pages(child, reader, rowGroupId, pageIndex);
 
-        lower = bytes_to_postgres_type(stats->EncodeMin().c_str(), arrow_type);
-        upper = bytes_to_postgres_type(stats->EncodeMax().c_str(), arrow_type);
+            res.canBeTrue  = unite_ranges(res.canBeTrue, t.canBeTrue);
+            res.canBeFalse = intersect_ranges(res.canBeFalse, t.canBeFalse);
+        }
+        return res;
+    }
 
-        int l = FunctionCall2Coll(&finfo, collid, val, lower);
-        int u = FunctionCall2Coll(&finfo, collid, val, upper);
+    case FilterNode::FILTER_NOT:
+    {
+        auto res = evaluate_pages(node.children[0], reader, rowGroupId, pageIndex);
 
-        if (l < 0 || u > 0)
-            return false;
-        break;
+        std::swap(res.canBeTrue, res.canBeFalse);
+        return res;
     }
 
-    default:
-        return true;
+    case FilterNode::FILTER_RANGE:
+    case FilterNode::FILTER_IN:
+    case FilterNode::FILTER_NULL_TEST:
+    {
+        const int columnIndex = reader.columnIndex(node.attnum - 1);
+        if (columnIndex < 0)
+            break;
+
+        const auto columnIdx = pageIndex->GetColumnIndex(columnIndex);
+        const auto offsetIdx = pageIndex->GetOffsetIndex(columnIndex);
+        if (!columnIdx || !offsetIdx)
+            break;
+
+        const auto & nullPages = columnIdx->null_pages();
+        const auto & locations = offsetIdx->page_locations();
+        const size_t numPages  = nullPages.size();
+
+        if (locations.size() != numPages
+            || (columnIdx->has_null_counts() && columnIdx->null_counts().size() != numPages))
+            break;
+
+        /* Treat every page as a row group of its own */
+        const auto  type = reader.GetSchema()->field(columnIndex)->type();
+        ColumnStats stats;
+
+        stats.pgType = arrowTypeToPostgresType(type->id());
+        stats.hasStats.assign(numPages, true);
+        stats.hasNulls.resize(numPages);
+        stats.hasValues.resize(numPages);
+        stats.hasMinMax.assign(numPages, false);
+        stats.min.assign(numPages, (Datum)0);
+        stats.max.assign(numPages, (Datum)0);
+
+        for (size_t p = 0; p < numPages; ++p)
+        {
+            stats.hasNulls[p]  = !columnIdx->has_null_counts() || columnIdx->null_counts()[p] > 0;
+            stats.hasValues[p] = !nullPages[p];
+        }
+
+        if (stats.pgType != InvalidOid)
+            decode_page_bounds(*columnIdx,
+                               reader.getRowGroup(rowGroupId)->ColumnChunk(columnIndex)->type(),
+                               type.get(), stats.hasMinMax, stats.min, stats.max);
+
+        const auto     pages = evaluate_leaf(node, stats);
+        RowRangesTruth res;
+
+        for (size_t p = 0; p < numPages; ++p)
+        {
+            const int64_t first = locations[p].first_row_index;
+            const int64_t last  = p + 1 < numPages ? locations[p + 1].first_row_index : numRows;
+
+            if (pages[p].canBeTrue)
+                append_range(res.canBeTrue, first, last);
+            if (pages[p].canBeFalse)
+                append_range(res.canBeFalse, first, last);
+        }
+        return res;
     }
 
-    return true;
+    case FilterNode::FILTER_UNKNOWN:
+        break;
+    }
+
+    return RowRangesTruth{ all, all };
+}
+
+/*
+ * getRowRanges
+ *      Rows of the row group which may satisfy the clauses according to the
+ *      page index.
+ */
+bool FilterPushdown::getRowRanges(ParquetFdwReader &reader, int rowGroupId, tRowRanges *ranges)
+{
+    if (!hasFilters())
+        return false;
+
+    const auto pageIndex = reader.getPageIndex(rowGroupId);
+    if (!pageIndex)
+        return false;
+
+    const int64_t numRows = reader.getRowGroup(rowGroupId)->num_rows();
+
+    *ranges = evaluate_pages(root, reader, rowGroupId, pageIndex.get()).canBeTrue;
+
+    return !(ranges->size() == 1 && ranges->front().first == 0 && ranges->front().second == numRows);
 }
+#endif
 
 /*
  * extract_rowgroup_filters
- *      Build a list of expressions we can use to filter out row groups.
+ *      Build a tree of expressions we can use to filter out row groups.
  */
 void FilterPushdown::extract_rowgroup_filters(List *scan_clauses)
 {
     ListCell *lc;
 
+    /* The tree may be rebuilt with new values of runtime operands */
+    root.children.clear();
+
     foreach (lc, scan_clauses)
-    {
-        TypeCacheEntry *tce;
-        Expr *          clause = (Expr *)lfirst(lc);
-        OpExpr *        expr;
-        Expr *          left, *right;
-        int             strategy;
-        Const *         c;
-        Var *           v;
-        Oid             opno;
+        root.children.push_back(make_node((Expr *)lfirst(lc)));
 
-        if (IsA(clause, RestrictInfo))
-            clause = ((RestrictInfo *)clause)->clause;
+    merge_column_intervals(root);
+}
+
+/*
+ * exact_statistics
+ *      Whether min/max statistics bound every value of the leaf column in the
+ *      order it is compared in. Float statistics leave NaNs out and string
+ *      ones are ordered bytewise, which only non-C collations differ from.
+ */
+static bool exact_statistics(Oid type, Oid collid)
+{
+    if (type == FLOAT4OID || type == FLOAT8OID)
+        return false;
+
+    return !OidIsValid(collid) || lc_collate_is_c(collid);
+}
 
-        if (IsA(clause, OpExpr))
+/*
+ * null_sources
+ *      Collect columns whose NULLs may make the clause NULL. Returns false if
+ *      the clause may be NULL for other reasons, like a NULL in an IN list,
+ *      or may be false for values the statistics don't bound.
+ */
+bool FilterPushdown::null_sources(const FilterNode &node, std::set<AttrNumber> &attnums)
+{
+    switch (node.kind)
+    {
+    case FilterNode::FILTER_AND:
+    case FilterNode::FILTER_OR:
+    case FilterNode::FILTER_NOT:
+        for (const auto &child : node.children)
         {
-            expr = (OpExpr *)clause;
+            if (!null_sources(child, attnums))
+                return false;
+        }
+        return true;
 
-            /* Only interested in binary opexprs */
-            if (list_length(expr->args) != 2)
-                continue;
+    case FilterNode::FILTER_IN:
+        if (node.hasNullValue || !exact_statistics(node.columnType, node.collid))
+            return false;
+        attnums.insert(node.attnum);
+        return true;
 
-            left  = (Expr *)linitial(expr->args);
-            right = (Expr *)lsecond(expr->args);
+    case FilterNode::FILTER_RANGE:
+        if (!exact_statistics(node.columnType, node.collid))
+            return false;
+        attnums.insert(node.attnum);
+        return true;
 
-            /*
-             * Looking for expressions like "EXPR OP CONST" or "CONST OP EXPR"
-             *
-             * XXX Currently only Var as expression is supported. Will be
-             * extended in future.
-             */
-            if (IsA(right, Const))
-            {
-                if (!IsA(left, Var))
-                    continue;
-                v    = (Var *)left;
-                c    = (Const *)right;
-                opno = expr->opno;
-            }
-            else if (IsA(left, Const))
-            {
-                /* reverse order (CONST OP VAR) */
-                if (!IsA(right, Var))
-                    continue;
-                v    = (Var *)right;
-                c    = (Const *)left;
-                opno = get_commutator(expr->opno);
-            }
-            else
-                continue;
+    case FilterNode::FILTER_NULL_TEST:
+        return true;
 
-            /* TODO */
-            tce      = lookup_type_cache(exprType((Node *)left), TYPECACHE_BTREE_OPFAMILY);
-            strategy = get_op_opfamily_strategy(opno, tce->btree_opf);
+    case FilterNode::FILTER_UNKNOWN:
+        break;
+    }
 
-            /* Not a btree family operator? */
-            if (strategy == 0)
-                continue;
-        }
-        else if (IsA(clause, Var))
+    return false;
+}
+
+/*
+ * matchRowGroups
+ *      Tell for every row group whether none, some or all of its rows satisfy
+ *      the clauses. All rows match if the clauses cannot be false for any of
+ *      them and none of the compared columns has NULLs in the row group.
+ */
+std::vector<FilterPushdown::RowGroupMatch> FilterPushdown::matchRowGroups(const ParquetFdwReader &reader)
+{
+    const size_t               numRowGroups = reader.getNumRowGroups();
+    const auto                 matches      = evaluate(root, reader);
+    std::vector<RowGroupMatch> res(numRowGroups, MATCH_SOME);
+    std::set<AttrNumber>       attnums;
+    std::vector<int>           columns;
+    bool                       exact = null_sources(root, attnums);
+
+    for (AttrNumber attnum : attnums)
+    {
+        const int columnIndex = reader.columnIndex(attnum - 1);
+
+        if (columnIndex < 0)
+            exact = false;
+        else
+            columns.push_back(columnIndex);
+    }
+
+    for (size_t r = 0; r < numRowGroups; ++r)
+    {
+        if (!matches[r].canBeTrue)
         {
-            /*
-             * Trivial expression containing only a single boolean Var. This
-             * also covers cases "BOOL_VAR = true"
-             * */
-            v        = (Var *)clause;
-            strategy = BTEqualStrategyNumber;
-            c        = (Const *)makeBoolConst(true, false);
+            res[r] = MATCH_NONE;
+            continue;
         }
-        else if (IsA(clause, BoolExpr))
+
+        if (!exact || matches[r].canBeFalse)
+            continue;
+
+        res[r] = MATCH_ALL;
+        for (int columnIndex : columns)
         {
-            /*
-             * Similar to previous case but for expressions like "!BOOL_VAR" or
-             * "BOOL_VAR = false"
-             */
-            BoolExpr *boolExpr = (BoolExpr *)clause;
+            const auto &stats = column_stats(reader, columnIndex);
 
-            if (boolExpr->args && list_length(boolExpr->args) != 1)
-                continue;
+            if (!stats.hasStats[r] || stats.hasNulls[r])
+                res[r] = MATCH_SOME;
+        }
+    }
 
-            if (!IsA(linitial(boolExpr->args), Var))
-                continue;
+    return res;
+}
+
+/*
+ * columnMinMax
+ *      Decoded min/max statistics of the attribute in the row group.
+ */
+bool FilterPushdown::columnMinMax(const ParquetFdwReader &reader, int attIdx, int rowGroupId, Oid *type,
+                                  Datum *min, Datum *max)
+{
+    const int columnIndex = reader.columnIndex(attIdx);
+
+    if (columnIndex < 0)
+        return false;
+
+    const auto &stats = column_stats(reader, columnIndex);
+
+    if (!stats.hasMinMax[rowGroupId])
+        return false;
+
+    *type = stats.pgType;
+    *min  = stats.min[rowGroupId];
+    *max  = stats.max[rowGroupId];
+    return true;
+}
+
+/*
+ * dictionaryValues
+ *      Decoded dictionary page of the attribute in the row group.
+ */
+bool FilterPushdown::dictionaryValues(const ParquetFdwReader &reader, int attIdx, int rowGroupId,
+                                      Oid *type, const std::vector<Datum> **values)
+{
+    const int columnIndex = reader.columnIndex(attIdx);
+
+    if (columnIndex < 0)
+        return false;
+
+    const auto &dict = dictionary(reader, rowGroupId, columnIndex);
+
+    if (!dict)
+        return false;
+
+    *type   = arrowTypeToPostgresType(reader.GetSchema()->field(columnIndex)->type()->id());
+    *values = &*dict;
+    return true;
+}
+
+/*
+ * sortBound
+ *      Min or max statistics of the attribute in the row group, depending on
+ *      the direction of the sort order.
+ */
+bool FilterPushdown::sortBound(const ParquetFdwReader &reader, int attIdx, int rowGroupId,
+                               bool descending, bool nullsFirst, Oid *type, Datum *bound)
+{
+    const int columnIndex = reader.columnIndex(attIdx);
+
+    if (columnIndex < 0)
+        return false;
+
+    const auto &stats = column_stats(reader, columnIndex);
+
+    if (!stats.hasMinMax[rowGroupId] || (nullsFirst && stats.hasNulls[rowGroupId]))
+        return false;
+
+    *type  = stats.pgType;
+    *bound = descending ? stats.max[rowGroupId] : stats.min[rowGroupId];
+    return true;
+}
+
+/*
+ * collectColumnRanges
+ *      Append min/max statistics of the attribute in every row group of the
+ *      file. Row groups with nulls only can't match a lookup and are counted
+ *      but not appended, the ones without statistics are counted as
+ *      unbounded.
+ */
+void FilterPushdown::collectColumnRanges(const ParquetFdwReader &reader, int attIdx, ColumnRanges &ranges)
+{
+    const int    columnIndex  = reader.columnIndex(attIdx);
+    const size_t numRowGroups = reader.getNumRowGroups();
+
+    ranges.numRowGroups += numRowGroups;
+
+    if (columnIndex < 0)
+    {
+        ranges.numUnbounded += numRowGroups;
+        return;
+    }
 
-            v        = (Var *)linitial(boolExpr->args);
-            strategy = BTEqualStrategyNumber;
-            c        = (Const *)makeBoolConst(false, false);
+    const auto &stats = column_stats(reader, columnIndex);
+
+    if (ranges.type == InvalidOid)
+        ranges.type = stats.pgType;
+
+    for (size_t r = 0; r < numRowGroups; ++r)
+    {
+        if (stats.hasMinMax[r] && stats.pgType == ranges.type)
+        {
+            ranges.min.push_back(stats.min[r]);
+            ranges.max.push_back(stats.max[r]);
         }
-        else
-            continue;
+        else if (!stats.hasStats[r] || stats.hasValues[r])
+            ranges.numUnbounded++;
+    }
+}
+
+/*
+ * lookupFraction
+ *      Estimate the share of row groups a lookup by a single value reads as
+ *      the average number of ranges a range of a row group intersects with.
+ *      That is close to one row group for sorted data and to all of them for
+ *      data in random order.
+ */
+double FilterPushdown::lookupFraction(const ColumnRanges &ranges, Oid collid)
+{
+    const double n = ranges.min.size();
+    Comparator   cmp;
+    double       disjoint = 0;
+
+    if (ranges.numRowGroups == 0 || ranges.type == InvalidOid
+        || !make_comparator(&cmp, ranges.type, ranges.type, collid))
+        return -1;
+
+    const auto less = [&cmp](Datum value1, Datum value2) { return cmp(value1, value2) < 0; };
+    auto       mins = ranges.min;
+
+    std::sort(mins.begin(), mins.end(), less);
+
+    /* Pairs of ranges one of which ends before the other starts */
+    for (Datum max : ranges.max)
+        disjoint += mins.end() - std::upper_bound(mins.begin(), mins.end(), max, less);
 
-        filters.push_back({ v->varattno, c, strategy });
+    const double depth = n > 0 ? (n * n - 2 * disjoint) / n : 0;
+
+    return std::min(1.0, (depth + ranges.numUnbounded) / ranges.numRowGroups);
+}
+
+/*
+ * orderRowGroups
+ *      Order the row groups of the file by the min statistics of the
+ *      attribute. Ties keep the file order, so that row groups of a file
+ *      declared sorted stay in place. If all the rows of every row group are
+ *      sorted, reading them in this order returns the rows of the file sorted
+ *      as long as the ranges are disjoint.
+ */
+bool FilterPushdown::orderRowGroups(const ParquetFdwReader &reader, int attIdx, Oid collid,
+                                    std::vector<int> *order)
+{
+    const int  columnIndex  = reader.columnIndex(attIdx);
+    const int  numRowGroups = reader.getNumRowGroups();
+    Comparator cmp;
+
+    order->resize(numRowGroups);
+    for (int r = 0; r < numRowGroups; ++r)
+        (*order)[r] = r;
+
+    if (columnIndex < 0)
+        return false;
+
+    const auto &stats = column_stats(reader, columnIndex);
+
+    for (int r = 0; r < numRowGroups; ++r)
+    {
+        if (!stats.hasMinMax[r])
+            return false;
+    }
+
+    if (!make_comparator(&cmp, stats.pgType, stats.pgType, collid))
+        return false;
+
+    std::stable_sort(order->begin(), order->end(),
+                     [&](int r1, int r2) { return cmp(stats.min[r1], stats.min[r2]) < 0; });
+
+    for (int i = 0; i < numRowGroups; ++i)
+    {
+        const int r = (*order)[i];
+
+        if (stats.hasNulls[r])
+            return false;
+        if (i > 0 && cmp(stats.max[(*order)[i - 1]], stats.min[r]) > 0)
+            return false;
     }
+
+    return true;
 }
 
 /*
@@ -223,46 +2764,28 @@ List* FilterPushdown::getRowGroupSkipListAndUpdateTupleCount(
 {
     List* rowGroupSkipList = NIL;
 
-    /* Check each row group whether it matches the filters */
+    /* Check all the row groups against the filters at once */
     const int32_t numRowGroups = reader.getNumRowGroups();
+    const auto    matches      = evaluate(root, reader);
+
     for (int r = 0; r < numRowGroups; r++)
     {
-        bool skipRowGroup = false;
         const auto rowgroup = reader.getRowGroup(r);
-        for (auto &filter : filters)
-        {
-            AttrNumber  attnum;
-            const char *attname;
+        const bool skipRowGroup = !matches[r].canBeTrue;
 
-            attnum  = filter.attnum - 1;
-            attname = NameStr(TupleDescAttr(tupleDesc, attnum)->attname);
-
-            // Attnum == column name since schema is identical
-            const auto column = rowgroup->ColumnChunk(attnum);
-            const auto columnName = column->path_in_schema()->ToDotString();
-            if (strcmp(attname, columnName.c_str()))
-                Error("Attribute name does not match column name");
-
-            const auto stats = column->statistics();
-            if (!stats)
-                continue;
-
-            const auto type = reader.GetSchema()->field(attnum)->type();
-            skipRowGroup = !row_group_matches_filter(stats.get(), type.get(), filter);
-            if (skipRowGroup) {
-                rowGroupSkipList = lappend_int(rowGroupSkipList, r);
-                break;
-            }
-        }
+        if (skipRowGroup)
+            rowGroupSkipList = lappend_int(rowGroupSkipList, r);
 
         *numTotalRows += rowgroup->num_rows();
         if (!skipRowGroup) {
             *numRowsToRead += rowgroup->num_rows();
 
             for (size_t numAttr = 0; numAttr < attrUseList.size(); ++numAttr) {
-                if (attrUseList[numAttr])
+                const int columnIndex = reader.columnIndex(numAttr);
+
+                if (attrUseList[numAttr] && columnIndex >= 0)
                 {
-                    const auto columnSize = rowgroup->ColumnChunk(numAttr)->total_uncompressed_size();
+                    const auto columnSize = rowgroup->ColumnChunk(columnIndex)->total_compressed_size();
                     *numPagesToRead += columnSize / BLCKSZ;
                 }
             }
@@ -6,6 +6,7 @@
 #endif               // #if __cplusplus > 199711L
 
 #include <arrow/api.h>
+#include <parquet/metadata.h>
 #include <parquet/statistics.h>
 
 #include "ParquetFdwReader.hpp"
@@ -15,6 +16,7 @@ extern "C" {
 #include "postgres.h"
 #include "postgres_ext.h"
 #include "catalog/pg_type.h"
+#include "nodes/primnodes.h"
 #include "access/tupdesc.h"
 #include "utils/builtins.h"
 #include "utils/date.h"
@@ -22,72 +24,229 @@ extern "C" {
 }
 
 #include <map>
+#include <optional>
 #include <set>
+#include <vector>
 
 struct FmgrInfo;
 struct List;
+class ParquetFdwReader;
 
 class FilterPushdown {
 
 private:
-    struct RowGroupFilter
+    /*
+     * Monotonic (non-decreasing) function applied to the column, like a cast
+     * or date_trunc(). Minimum and maximum of the function over a row group
+     * are the function of column minimum and maximum.
+     */
+    struct ColumnTransform
     {
-        AttrNumber attnum;
-        Const *    value;
-        int        strategy;
+        Oid                funcid;
+        Oid                collid;
+        int                argIndex; /* position of the column argument */
+        std::vector<Datum> args;     /* constant arguments */
     };
 
-    std::vector<bool> rowGroupSkipList;
-    std::vector<RowGroupFilter> filters;
+    /*
+     * Pruning tree built from the scan clauses. Every node is evaluated
+     * against the statistics of a row group and tells whether the clause
+     * can be true and whether it can be false for some row of that group.
+     * Rows for which the clause evaluates to NULL count as neither, which
+     * gives a proper three-valued logic for NOT.
+     */
+    struct FilterNode
+    {
+        enum Kind
+        {
+            FILTER_UNKNOWN, /* clause we cannot reason about */
+            FILTER_AND,
+            FILTER_OR,
+            FILTER_NOT,
+            FILTER_RANGE,     /* column within [lower, upper] */
+            FILTER_IN,        /* column equal to one of sorted values */
+            FILTER_NULL_TEST, /* column IS [NOT] NULL */
+        };
 
-    void find_cmp_func(FmgrInfo *finfo, Oid type1, Oid type2);
+        Kind                    kind = FILTER_UNKNOWN;
+        std::vector<FilterNode> children;
+
+        /* column reference of the leaf nodes */
+        AttrNumber attnum = InvalidAttrNumber;
+        Oid        collid = InvalidOid;
+
+        /* expression over the column the leaf compares and its type */
+        Expr *                       columnExpr = nullptr;
+        Oid                          columnType = InvalidOid;
+        std::vector<ColumnTransform> transforms; /* innermost first */
+
+        /* FILTER_RANGE, bounds are NULL if unbounded */
+        Const *lower          = nullptr;
+        Const *upper          = nullptr;
+        bool   lowerInclusive = true;
+        bool   upperInclusive = true;
+        bool   empty          = false; /* contradicting bounds */
+
+        /* FILTER_IN */
+        Oid                valueType = InvalidOid;
+        std::vector<Datum> values;
+        bool               hasNullValue = false;
+
+        /* FILTER_NULL_TEST */
+        bool isNull = false;
+    };
+
+    struct Truth
+    {
+        bool canBeTrue;
+        bool canBeFalse;
+    };
 
     /*
-     * bytes_to_postgres_type
-     *      Convert min/max values from column statistics stored in parquet file as
-     *      plain bytes to postgres Datum.
+     * Statistics of a single column decoded once for all the row groups of
+     * the file, so that leaves are evaluated in a sweep over plain arrays.
      */
-    static Datum bytes_to_postgres_type(const char *bytes, arrow::DataType *arrow_type)
+    struct ColumnStats
     {
-        switch (arrow_type->id())
-        {
-        case arrow::Type::BOOL:
-            return BoolGetDatum(*(bool *)bytes);
-        case arrow::Type::INT32:
-            return Int32GetDatum(*(int32 *)bytes);
-        case arrow::Type::INT64:
-            return Int64GetDatum(*(int64 *)bytes);
-        case arrow::Type::FLOAT:
-            return Float4GetDatum(*(float *)bytes);
-        case arrow::Type::DOUBLE:
-            return Float8GetDatum(*(double *)bytes);
-        case arrow::Type::STRING:
-        case arrow::Type::BINARY:
-            return CStringGetTextDatum(bytes);
-        case arrow::Type::TIMESTAMP:
-        {
-            TimestampTz ts;
-            auto        tstype = (arrow::TimestampType *)arrow_type;
+        Oid                pgType = InvalidOid;
+        std::vector<bool>  hasStats;
+        std::vector<bool>  hasNulls;
+        std::vector<bool>  hasValues;
+        std::vector<bool>  hasMinMax;
+        std::vector<Datum> min;
+        std::vector<Datum> max;
+        std::vector<int64_t> nullCount; /* -1 if unknown */
+    };
 
-            to_postgres_timestamp(tstype, *(int64 *)bytes, ts);
-            return TimestampGetDatum(ts);
-        }
-        case arrow::Type::DATE32:
-            return DateADTGetDatum(*(int32 *)bytes + (UNIX_EPOCH_JDATE - POSTGRES_EPOCH_JDATE));
-        default:
-            return PointerGetDatum(NULL);
+    /*
+     * Comparison of values of two types resolved once per leaf. Values of the
+     * same fixed width type are compared natively, others by btree support
+     * function.
+     */
+    struct Comparator
+    {
+        int (*native)(Datum, Datum) = nullptr;
+        FmgrInfo *finfo             = nullptr;
+        Oid       collid            = InvalidOid;
+
+        int operator()(Datum value1, Datum value2) const
+        {
+            if (native)
+                return native(value1, value2);
+            return DatumGetInt32(FunctionCall2Coll(finfo, collid, value1, value2));
         }
-    }
+    };
+
+    std::vector<bool> rowGroupSkipList;
+    FilterNode        root;
+
+    /* context the object is created in, cached functions live there */
+    MemoryContext cxt;
+
+    /* comparison functions by argument types */
+    std::map<std::pair<Oid, Oid>, FmgrInfo> cmpFuncs;
+
+    /* functions of the column transforms */
+    std::map<Oid, FmgrInfo> transformFuncs;
+
+    /* decoded statistics by parquet column index */
+    std::map<int, ColumnStats> columnStats;
+
+    /* whether equality leaves are checked against dictionary pages */
+    bool dictionaryPruning = false;
+
+    /* whether transforms depending on settings like TimeZone are accepted */
+    bool stableTransforms = false;
+
+    /* decoded dictionary pages by row group and parquet column index */
+    std::map<std::pair<int, int>, std::optional<std::vector<Datum>>> dictionaries;
+
+    bool find_cmp_func(FmgrInfo *finfo, Oid type1, Oid type2);
+    bool make_comparator(Comparator *cmp, Oid type1, Oid type2, Oid collid);
+    int  compare(Oid type1, Datum value1, Oid type2, Datum value2, Oid collid, bool *ok);
+    Datum apply_transforms(const FilterNode &node, Datum value);
+
+    bool       extract_column(Expr *expr, FilterNode &column);
+    FilterNode make_node(Expr *clause);
+    FilterNode make_comparison(Expr *left, Expr *right, Oid opno, Oid collid);
+    FilterNode make_prefix_match(Expr *left, Expr *right, bool isLike);
+    FilterNode make_array_comparison(ScalarArrayOpExpr *expr);
+    FilterNode make_row_comparison(RowCompareExpr *expr);
+    FilterNode make_range(const FilterNode &column, Const *value, int strategy, Oid collid);
+    void       merge_column_intervals(FilterNode &node);
+
+    const ColumnStats &column_stats(const ParquetFdwReader &reader, int columnIndex);
+
+    std::vector<Truth> evaluate(const FilterNode &node, const ParquetFdwReader &reader);
+    std::vector<Truth> evaluate_leaf(const FilterNode &node, const ColumnStats &stats);
 
-    bool row_group_matches_filter(parquet::Statistics *stats,
-                                         arrow::DataType *    arrow_type,
-                                         const RowGroupFilter& filter);
+    std::vector<double> selectivity(const FilterNode &node, const ParquetFdwReader &reader);
+    std::vector<double> null_share(const FilterNode &node, const ParquetFdwReader &reader);
+    static bool         judged_by_statistics(const FilterNode &node, const ParquetFdwReader &reader);
+    static double       null_fraction(const ColumnStats &stats, size_t rowGroupId, double numRows);
+    std::vector<double> leaf_selectivity(const FilterNode &node, const ColumnStats &stats,
+                                         const ParquetFdwReader &reader);
+
+    static bool equality_values(const FilterNode &node, std::vector<Datum> *values, Oid *valueType);
+    static bool null_sources(const FilterNode &node, std::set<AttrNumber> &attnums);
+
+    const std::optional<std::vector<Datum>> &dictionary(const ParquetFdwReader &reader,
+                                                        int                     rowGroupId,
+                                                        int                     columnIndex);
+    void probe_dictionaries(const FilterNode &      node,
+                            const ParquetFdwReader &reader,
+                            int                     columnIndex,
+                            std::vector<Truth> &    res);
+
+#ifdef PARQUET_FDW_BLOOM_FILTER
+    void probe_bloom_filters(const FilterNode &      node,
+                             const ParquetFdwReader &reader,
+                             int                     columnIndex,
+                             std::vector<Truth> &    res);
+#endif
+
+#ifdef PARQUET_FDW_PAGE_INDEX
+    /* Rows for which the clause can be true and can be false */
+    struct RowRangesTruth
+    {
+        tRowRanges canBeTrue;
+        tRowRanges canBeFalse;
+    };
+
+    RowRangesTruth evaluate_pages(const FilterNode &                node,
+                                  const ParquetFdwReader &          reader,
+                                  int                               rowGroupId,
+                                  parquet::RowGroupPageIndexReader *pageIndex);
+#endif
 
 public:
+    /*
+     * Min/max statistics of a column collected over the row groups of one or
+     * more files to estimate how selective lookups by the column are.
+     */
+    struct ColumnRanges
+    {
+        Oid                type = InvalidOid;
+        std::vector<Datum> min;
+        std::vector<Datum> max;
+        size_t             numRowGroups = 0;
+        size_t             numUnbounded = 0; /* row groups without min/max */
+    };
+
+    /* Whether none, some or all rows of a row group satisfy the clauses */
+    enum RowGroupMatch
+    {
+        MATCH_NONE,
+        MATCH_SOME,
+        MATCH_ALL,
+    };
 
     FilterPushdown(const int64_t numRowGroups)
     : rowGroupSkipList(numRowGroups, false)
-    { }
+    , cxt(CurrentMemoryContext)
+    {
+        root.kind = FilterNode::FILTER_AND;
+    }
 
     static Oid arrowTypeToPostgresType(int arrow_type)
     {
@@ -117,6 +276,87 @@ public:
     }
 
     void extract_rowgroup_filters(List *scan_clauses);
+
+    /* Append min/max ranges of the attribute in every row group of the file */
+    void collectColumnRanges(const ParquetFdwReader &reader, int attIdx, ColumnRanges &ranges);
+
+    /*
+     * Average share of the row groups whose range contains a single value of
+     * the column, i.e. which a lookup by that value has to read. Returns -1
+     * if the values cannot be compared.
+     */
+    double lookupFraction(const ColumnRanges &ranges, Oid collid);
+
+    /*
+     * Order the row groups of the file by the min statistics of the
+     * attribute, keeping the file order if some have none. Returns true if
+     * none of the ordered ranges overlaps the next one and has NULLs.
+     */
+    bool orderRowGroups(const ParquetFdwReader &reader, int attIdx, Oid collid,
+                        std::vector<int> *order);
+
+    /* Check equality clauses against dictionaries of fully dictionary encoded chunks */
+    void setDictionaryPruning(bool enabled)
+    {
+        dictionaryPruning = enabled;
+    }
+
+    /*
+     * Accept stable transforms like timestamptz_trunc(), only for filters
+     * built at execution as plans may be executed with other settings
+     */
+    void setStableTransforms(bool enabled)
+    {
+        stableTransforms = enabled;
+    }
+
+    /* Whether any of the clauses can be checked against statistics */
+    bool hasFilters() const;
+
+    /*
+     * Check every row group of the file against the clauses. A row group
+     * matches entirely only if statistics prove the clauses true, and not
+     * NULL, for all of its rows.
+     */
+    std::vector<RowGroupMatch> matchRowGroups(const ParquetFdwReader &reader);
+
+    /*
+     * Expected number of rows of the row groups not in the skip list which
+     * satisfy the clauses. Every row group is taken as a histogram bucket of
+     * values spread evenly between its min and max.
+     */
+    double estimateRows(const ParquetFdwReader &reader, List *skipList);
+
+    /* Decoded min/max statistics of the attribute, false if there are none */
+    bool columnMinMax(const ParquetFdwReader &reader, int attIdx, int rowGroupId, Oid *type,
+                      Datum *min, Datum *max);
+
+    /*
+     * Distinct non-null values of the attribute in the row group taken from
+     * the dictionary page of its column chunk. Returns false unless all of
+     * the data pages of the chunk are dictionary encoded.
+     */
+    bool dictionaryValues(const ParquetFdwReader &reader, int attIdx, int rowGroupId, Oid *type,
+                          const std::vector<Datum> **values);
+
+    /*
+     * Value of the attribute no row of the row group comes before in the
+     * sort order, its min for ascending and its max for descending orders.
+     * Returns false if there is none, e.g. if NULLs come first and the row
+     * group has some.
+     */
+    bool sortBound(const ParquetFdwReader &reader, int attIdx, int rowGroupId, bool descending,
+                   bool nullsFirst, Oid *type, Datum *bound);
+
+#ifdef PARQUET_FDW_PAGE_INDEX
+    /*
+     * Rows of the row group which may satisfy the clauses according to the
+     * page index. Returns false if there is no page index or it doesn't rule
+     * out any rows.
+     */
+    bool getRowRanges(ParquetFdwReader &reader, int rowGroupId, tRowRanges *ranges);
+#endif
+
     List* getRowGroupSkipListAndUpdateTupleCount(
         const ParquetFdwReader& reader,
         TupleDesc tupleDesc,
@@ -0,0 +1,388 @@
+#include "HivePartitions.hpp"
+
+#include <algorithm>
+
+extern "C" {
+#include "access/sysattr.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "nodes/pathnodes.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+
+#if PG_VERSION_NUM < 120000
+#    include "optimizer/clauses.h"
+#    include "optimizer/var.h"
+#else
+#    include "optimizer/optimizer.h"
+#endif
+}
+
+const char *HivePartitions::defaultPartitionName = "__HIVE_DEFAULT_PARTITION__";
+
+struct ReplacePartitionVarsContext
+{
+    Index                                 varno;
+    std::vector<std::pair<AttrNumber, Const *>> consts;
+};
+
+/*
+ * replace_partition_vars
+ *      Substitute partition column references with constants.
+ */
+static Node *replace_partition_vars(Node *node, ReplacePartitionVarsContext *context)
+{
+    if (node == NULL)
+        return NULL;
+
+    if (IsA(node, Var))
+    {
+        Var *var = (Var *)node;
+
+        if ((Index)var->varno == context->varno && var->varlevelsup == 0)
+        {
+            for (auto &[attnum, value] : context->consts)
+            {
+                if (attnum == var->varattno)
+                    return (Node *)copyObjectImpl(value);
+            }
+        }
+    }
+
+    return expression_tree_mutator(node, (Node * (*)()) replace_partition_vars, (void *)context);
+}
+
+/*
+ * unescape_path_name
+ *      Undo hive escaping of special characters ("%3A" -> ":").
+ */
+static std::string unescape_path_name(const std::string &str)
+{
+    std::string res;
+
+    res.reserve(str.size());
+    for (size_t i = 0; i < str.size(); ++i)
+    {
+        if (str[i] == '%' && i + 2 < str.size() && isxdigit(str[i + 1]) && isxdigit(str[i + 2]))
+        {
+            res.push_back((char)std::stoi(str.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        }
+        else
+            res.push_back(str[i]);
+    }
+
+    return res;
+}
+
+HivePartitions::HivePartitions(Oid relid, List *partitionAttrs) : varno(0)
+{
+    ListCell *lc;
+
+    foreach (lc, partitionAttrs)
+    {
+        PartitionColumn column;
+
+        column.attnum = lfirst_int(lc);
+#if PG_VERSION_NUM < 110000
+        column.name = get_attname(relid, column.attnum);
+#else
+        column.name = get_attname(relid, column.attnum, false);
+#endif
+        get_atttypetypmodcoll(relid, column.attnum, &column.typid, &column.typmod, &column.collid);
+        get_typlenbyval(column.typid, &column.typlen, &column.typbyval);
+        getTypeInputInfo(column.typid, &column.typinput, &column.typioparam);
+
+        columns.push_back(column);
+    }
+}
+
+int HivePartitions::findColumn(const std::string &name) const
+{
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+        if (columns[i].name == name)
+            return i;
+    }
+    return -1;
+}
+
+bool HivePartitions::isPartitionAttr(AttrNumber attnum) const
+{
+    for (const auto &column : columns)
+    {
+        if (column.attnum == attnum)
+            return true;
+    }
+    return false;
+}
+
+/*
+ * parseSegment
+ *      Parse single "key=value" path segment. Returns index of the partition
+ *      column or -1 if segment doesn't describe a partition.
+ */
+int HivePartitions::parseSegment(const std::string &segment, std::string &value) const
+{
+    const auto pos = segment.find('=');
+
+    if (pos == std::string::npos || pos == 0)
+        return -1;
+
+    const int column = findColumn(unescape_path_name(segment.substr(0, pos)));
+    if (column >= 0)
+        value = unescape_path_name(segment.substr(pos + 1));
+
+    return column;
+}
+
+Datum HivePartitions::toDatum(int column, const std::optional<std::string> &value, bool *isnull) const
+{
+    const auto &col = columns[column];
+
+    if (!value || *value == defaultPartitionName)
+    {
+        *isnull = true;
+        return (Datum)0;
+    }
+
+    *isnull = false;
+    return OidInputFunctionCall(col.typinput, (char *)value->c_str(), col.typioparam, col.typmod);
+}
+
+void HivePartitions::setClauses(Index varno, List *restrictinfo)
+{
+    ListCell *lc;
+
+    this->varno = varno;
+    clauses.clear();
+
+    foreach (lc, restrictinfo)
+    {
+        RestrictInfo *   rinfo    = (RestrictInfo *)lfirst(lc);
+        Bitmapset *      attrs    = NULL;
+        bool             eligible = true;
+        int              attIdx   = -1;
+        PartitionClause  clause;
+
+        if (rinfo->pseudoconstant || contain_volatile_functions((Node *)rinfo->clause))
+            continue;
+
+        pull_varattnos((Node *)rinfo->clause, varno, &attrs);
+
+        while ((attIdx = bms_next_member(attrs, attIdx)) >= 0)
+        {
+            const AttrNumber attnum = attIdx + FirstLowInvalidHeapAttributeNumber;
+            int              column = -1;
+
+            for (size_t i = 0; i < columns.size(); ++i)
+            {
+                if (columns[i].attnum == attnum)
+                    column = i;
+            }
+
+            if (column < 0)
+            {
+                eligible = false;
+                break;
+            }
+            clause.columns.push_back(column);
+        }
+
+        if (!eligible || clause.columns.empty())
+            continue;
+
+        clause.clause = rinfo->clause;
+        clauses.push_back(clause);
+    }
+}
+
+/*
+ * keysMatch
+ *      Evaluate every clause for which all the referenced partition keys are
+ *      already known. Returns false if any of them is definitely not satisfied.
+ *      In exact mode keys missing from the path are NULL and every clause must
+ *      be definitely true instead.
+ */
+bool HivePartitions::keysMatch(const tPartitionKeys &keys, bool exact) const
+{
+    bool          matches = true;
+    MemoryContext evalCxt;
+    MemoryContext oldCxt;
+
+    if (clauses.empty())
+        return true;
+
+    evalCxt = AllocSetContextCreate(CurrentMemoryContext, "parquet_fdw partition pruning",
+                                    ALLOCSET_SMALL_SIZES);
+    oldCxt  = MemoryContextSwitchTo(evalCxt);
+
+    for (const auto &clause : clauses)
+    {
+        ReplacePartitionVarsContext context;
+        bool                        known = true;
+        Node *                      expr;
+
+        for (int column : clause.columns)
+        {
+            const auto &col = columns[column];
+            bool        isnull;
+            Datum       value;
+
+            if (!keys[column] && !exact)
+            {
+                known = false;
+                break;
+            }
+
+            value = toDatum(column, keys[column], &isnull);
+            context.consts.push_back({col.attnum, makeConst(col.typid, col.typmod, col.collid,
+                                                            col.typlen, value, isnull,
+                                                            col.typbyval)});
+        }
+
+        if (!known)
+            continue;
+
+        context.varno = varno;
+        expr          = replace_partition_vars((Node *)clause.clause, &context);
+        expr          = eval_const_expressions(NULL, expr);
+
+        const bool isConst = IsA(expr, Const);
+        const bool isTrue  = isConst && !((Const *)expr)->constisnull
+                            && DatumGetBool(((Const *)expr)->constvalue);
+
+        if (exact ? !isTrue : isConst && !isTrue)
+        {
+            matches = false;
+            break;
+        }
+    }
+
+    MemoryContextSwitchTo(oldCxt);
+    MemoryContextDelete(evalCxt);
+
+    return matches;
+}
+
+bool HivePartitions::pathMatches(const char *path) const
+{
+    tPartitionKeys keys(columns.size());
+
+    for (const auto &segment : std::filesystem::path(path))
+    {
+        std::string value;
+        const int   column = parseSegment(segment.native(), value);
+
+        if (column >= 0)
+            keys[column] = value;
+    }
+
+    return keysMatch(keys);
+}
+
+void HivePartitions::collectFiles(const std::filesystem::path &dir,
+                                  tPartitionKeys &             keys,
+                                  List **                      files) const
+{
+    std::vector<std::filesystem::directory_entry> entries;
+
+    /* Sort entries to get stable file order */
+    for (auto &entry : std::filesystem::directory_iterator(dir))
+        entries.push_back(entry);
+    std::sort(entries.begin(), entries.end());
+
+    for (const auto &entry : entries)
+    {
+        const auto &path = entry.path();
+
+        if (std::filesystem::is_directory(path))
+        {
+            std::string value;
+            const int   column = parseSegment(path.filename().native(), value);
+
+            if (column < 0)
+            {
+                collectFiles(path, keys, files);
+                continue;
+            }
+
+            const auto previous = keys[column];
+            keys[column]        = value;
+
+            if (keysMatch(keys))
+                collectFiles(path, keys, files);
+            else
+                elog(DEBUG1, "parquet_fdw: skipping partition %s", path.c_str());
+
+            keys[column] = previous;
+        }
+        else if (std::filesystem::is_regular_file(path))
+        {
+            elog(DEBUG1, "Appending file %s", path.c_str());
+            *files = lappend(*files, makeString(pstrdup(path.c_str())));
+        }
+    }
+}
+
+bool HivePartitions::pathSatisfies(const char *path) const
+{
+    tPartitionKeys keys(columns.size());
+
+    for (const auto &segment : std::filesystem::path(path))
+    {
+        std::string value;
+        const int   column = parseSegment(segment.native(), value);
+
+        if (column >= 0)
+            keys[column] = value;
+    }
+
+    return keysMatch(keys, true);
+}
+
+List *HivePartitions::listFiles(const char *dir) const
+{
+    tPartitionKeys keys(columns.size());
+    List *         files = NIL;
+
+    /* Partition keys may be a part of the root path itself */
+    for (const auto &segment : std::filesystem::path(dir))
+    {
+        std::string value;
+        const int   column = parseSegment(segment.native(), value);
+
+        if (column >= 0)
+            keys[column] = value;
+    }
+
+    if (!keysMatch(keys))
+    {
+        elog(DEBUG1, "parquet_fdw: skipping partition %s", dir);
+        return NIL;
+    }
+
+    collectFiles(std::filesystem::path(dir), keys, &files);
+    return files;
+}
+
+void HivePartitions::getValues(const char *path, Datum *values, bool *isnull) const
+{
+    tPartitionKeys keys(columns.size());
+
+    for (const auto &segment : std::filesystem::path(path))
+    {
+        std::string value;
+        const int   column = parseSegment(segment.native(), value);
+
+        if (column >= 0)
+            keys[column] = value;
+    }
+
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+        const int attIdx = columns[i].attnum - 1;
+
+        values[attIdx] = toDatum(i, keys[i], &isnull[attIdx]);
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#if __cplusplus > 199711L
+#    define register // Deprecated in C++11.
+#endif               // #if __cplusplus > 199711L
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "postgres.h"
+
+#include "access/attnum.h"
+#include "nodes/pg_list.h"
+#include "nodes/primnodes.h"
+}
+
+/*
+ * HivePartitions
+ *      Support for hive-style directory layouts like
+ *      "/lake/events/dt=2018-01-01/region=eu/part-0.parquet".
+ *
+ * Table columns listed in the "partition_columns" option are not stored in
+ * the parquet files. Their values are parsed from "key=value" path segments
+ * instead. Restriction clauses which reference only partition columns are
+ * evaluated against those values while walking the directory tree so that
+ * whole subtrees can be skipped before any file is listed or opened.
+ */
+class HivePartitions
+{
+private:
+    struct PartitionColumn
+    {
+        std::string name;
+        AttrNumber  attnum;
+        Oid         typid;
+        int32       typmod;
+        Oid         collid;
+        int16       typlen;
+        bool        typbyval;
+        Oid         typinput;
+        Oid         typioparam;
+    };
+
+    struct PartitionClause
+    {
+        Expr *           clause;
+        std::vector<int> columns; /* indices into columns vector */
+    };
+
+    using tPartitionKeys = std::vector<std::optional<std::string>>;
+
+    std::vector<PartitionColumn> columns;
+    std::vector<PartitionClause> clauses;
+    Index                        varno;
+
+    int  findColumn(const std::string &name) const;
+    int  parseSegment(const std::string &segment, std::string &value) const;
+    bool keysMatch(const tPartitionKeys &keys, bool exact = false) const;
+    void collectFiles(const std::filesystem::path &dir, tPartitionKeys &keys, List **files) const;
+
+public:
+    HivePartitions(Oid relid, List *partitionAttrs);
+
+    static const char *defaultPartitionName;
+
+    bool empty() const
+    {
+        return columns.empty();
+    }
+
+    bool isPartitionAttr(AttrNumber attnum) const;
+
+    /* Remember clauses that can be checked against partition values */
+    void setClauses(Index varno, List *restrictinfo);
+
+    /* Whether the file path satisfies the partition clauses */
+    bool pathMatches(const char *path) const;
+
+    /* Whether the partition clauses are known to be true for the file */
+    bool pathSatisfies(const char *path) const;
+
+    /* List files under the directory skipping non-matching partitions */
+    List *listFiles(const char *dir) const;
+
+    /* Fill values of the partition columns from the file path */
+    void getValues(const char *path, Datum *values, bool *isnull) const;
+
+    Datum toDatum(int column, const std::optional<std::string> &value, bool *isnull) const;
+};
@@ -0,0 +1,125 @@
+#include "JoinHashTable.hpp"
+#include "Error.hpp"
+#include "PostgresErrors.hpp"
+
+extern "C" {
+#include "utils/datum.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/typcache.h"
+}
+
+JoinHashTable::JoinHashTable(MemoryContext cxt, const std::vector<Key> &keys)
+    : cxt(cxt), keys(keys), minValues(keys.size()), maxValues(keys.size())
+{
+    for (const auto &k : keys)
+    {
+        TypeCacheEntry *typentry = lookup_type_cache(k.type, TYPECACHE_LT_OPR);
+        SortSupportData sortKey;
+
+        if (!OidIsValid(typentry->lt_opr))
+            throw Error("no ordering operator for type %u", k.type);
+
+        memset(&sortKey, 0, sizeof(SortSupportData));
+        sortKey.ssup_cxt       = cxt;
+        sortKey.ssup_collation = k.collid;
+        sortKey.abbreviate     = false;
+        PrepareSortSupportFromOrderingOp(typentry->lt_opr, &sortKey);
+
+        sortKeys.push_back(sortKey);
+        typlens.push_back(typentry->typlen);
+        typbyvals.push_back(typentry->typbyval);
+    }
+}
+
+/*
+ * encodeKey
+ *      Encode the values of the join keys of the row into `key`. Values of
+ *      fixed length types are encoded as their datums, varlena ones as their
+ *      length followed by their data. Returns false if any of them is NULL.
+ */
+bool JoinHashTable::encodeKey(TupleTableSlot *slot, bool probe)
+{
+    key.clear();
+
+    for (size_t k = 0; k < keys.size(); ++k)
+    {
+        const int attIdx = probe ? keys[k].probeAttIdx : keys[k].buildAttIdx;
+
+        if (slot->tts_isnull[attIdx])
+            return false;
+
+        const Datum value = slot->tts_values[attIdx];
+
+        if (typbyvals[k])
+            key.append((const char *)&value, sizeof(Datum));
+        else if (typlens[k] == -1)
+        {
+            const int32_t len = VARSIZE_ANY_EXHDR(DatumGetPointer(value));
+
+            key.append((const char *)&len, sizeof(len));
+            key.append(VARDATA_ANY(DatumGetPointer(value)), len);
+        }
+        else
+            key.append(DatumGetPointer(value), typlens[k]);
+    }
+
+    return true;
+}
+
+void JoinHashTable::extendRange(size_t k, Datum value)
+{
+    const bool empty = numRows == 0;
+
+    if (!empty
+        && ApplySortComparator(value, false, minValues[k], false, &sortKeys[k]) >= 0
+        && ApplySortComparator(value, false, maxValues[k], false, &sortKeys[k]) <= 0)
+        return;
+
+    MemoryContext oldcxt = MemoryContextSwitchTo(cxt);
+    Datum         copy   = CatchAndRethrow([&]() { return datumCopy(value, typbyvals[k], typlens[k]); });
+
+    MemoryContextSwitchTo(oldcxt);
+    if (empty || ApplySortComparator(value, false, minValues[k], false, &sortKeys[k]) < 0)
+        minValues[k] = copy;
+    if (empty || ApplySortComparator(value, false, maxValues[k], false, &sortKeys[k]) > 0)
+        maxValues[k] = copy;
+}
+
+bool JoinHashTable::insert(TupleTableSlot *slot)
+{
+    if (!encodeKey(slot, false))
+        return false;
+
+    for (size_t k = 0; k < keys.size(); ++k)
+        extendRange(k, slot->tts_values[keys[k].buildAttIdx]);
+
+    MemoryContext oldcxt = MemoryContextSwitchTo(cxt);
+    MinimalTuple  tuple  = ExecCopySlotMinimalTuple(slot);
+
+    MemoryContextSwitchTo(oldcxt);
+    buckets[key].push_back(tuple);
+    numRows++;
+
+    return true;
+}
+
+const std::vector<MinimalTuple> *JoinHashTable::lookup(TupleTableSlot *slot)
+{
+    if (!encodeKey(slot, true))
+        return nullptr;
+
+    const auto it = buckets.find(key);
+
+    return it != buckets.end() ? &it->second : nullptr;
+}
+
+bool JoinHashTable::keyRange(size_t k, Datum *min, Datum *max) const
+{
+    if (numRows == 0)
+        return false;
+
+    *min = minValues[k];
+    *max = maxValues[k];
+    return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+#include "postgres.h"
+#include "access/tupdesc.h"
+#include "executor/tuptable.h"
+#include "utils/palloc.h"
+#include "utils/sortsupport.h"
+}
+
+/*
+ * JoinHashTable
+ *      Rows of the build side of an equi-join by the encoded values of their
+ *      join keys. Keys are of types whose equal values are binary equal, so
+ *      that encoded keys can be compared bytewise. Rows with a NULL key never
+ *      match and are not kept.
+ *
+ * The range of the values of each key is tracked as well, for the probe side
+ * to skip row groups whose statistics fall outside of it.
+ */
+class JoinHashTable
+{
+public:
+    struct Key
+    {
+        int buildAttIdx;
+        int probeAttIdx;
+        Oid type;
+        Oid collid;
+    };
+
+private:
+    MemoryContext                cxt; /* for the kept rows and the key ranges */
+    std::vector<Key>             keys;
+    std::vector<SortSupportData> sortKeys;
+    std::vector<int16>           typlens;
+    std::vector<bool>            typbyvals;
+
+    std::unordered_map<std::string, std::vector<MinimalTuple>> buckets;
+    size_t                                                     numRows = 0;
+
+    std::vector<Datum> minValues;
+    std::vector<Datum> maxValues;
+
+    /* Reused between rows */
+    std::string key;
+
+    bool encodeKey(TupleTableSlot *slot, bool probe);
+    void extendRange(size_t k, Datum value);
+
+public:
+    JoinHashTable(MemoryContext cxt, const std::vector<Key> &keys);
+
+    /* Keep the row of the build side, false if any of its keys is NULL */
+    bool insert(TupleTableSlot *slot);
+
+    /* Rows of the build side matching the row of the probe side, if any */
+    const std::vector<MinimalTuple> *lookup(TupleTableSlot *slot);
+
+    size_t getNumRows() const
+    {
+        return numRows;
+    }
+
+    /* Min and max values of the key among the kept rows, none if there are none */
+    bool keyRange(size_t k, Datum *min, Datum *max) const;
+
+    const std::vector<Key> &getKeys() const
+    {
+        return keys;
+    }
+};
@@ -0,0 +1,181 @@
+#include "MetadataAggregates.hpp"
+#include "Error.hpp"
+
+extern "C" {
+#include "fmgr.h"
+#include "utils/typcache.h"
+}
+
+int MetadataAggregates::compare(const Column &column, Datum value1, Datum value2) const
+{
+    TypeCacheEntry *typentry = lookup_type_cache(column.type, TYPECACHE_CMP_PROC_FINFO);
+
+    if (!OidIsValid(typentry->cmp_proc_finfo.fn_oid))
+        throw Error("no comparison function for type %u", column.type);
+
+    return DatumGetInt32(FunctionCall2Coll(&typentry->cmp_proc_finfo, column.collid, value1, value2));
+}
+
+/*
+ * findGroup
+ *      Index of the group of the partition values, a new one if there is
+ *      none yet. Files of a partition usually come one after another, so the
+ *      last group is checked first.
+ */
+size_t MetadataAggregates::findGroup(const Datum *partitionValues, const bool *partitionNulls)
+{
+    const auto matches = [&](const Group &group) {
+        for (size_t i = 0; i < groupColumns.size(); ++i)
+        {
+            const int attIdx = groupColumns[i].attIdx;
+
+            if (group.keyNulls[i] != partitionNulls[attIdx])
+                return false;
+            if (!group.keyNulls[i]
+                && compare(groupColumns[i], group.keys[i], partitionValues[attIdx]) != 0)
+                return false;
+        }
+        return true;
+    };
+
+    if (!groups.empty() && matches(groups.back()))
+        return groups.size() - 1;
+
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+        if (matches(groups[g]))
+            return g;
+    }
+
+    Group group;
+
+    for (const auto &column : groupColumns)
+    {
+        group.keys.push_back(partitionValues[column.attIdx]);
+        group.keyNulls.push_back(partitionNulls[column.attIdx]);
+    }
+
+    for (const auto &agg : aggregates)
+    {
+        const bool isCount = agg.kind == AGG_COUNT_STAR || agg.kind == AGG_COUNT;
+
+        group.values.push_back(isCount ? Int64GetDatum(0) : (Datum)0);
+        group.nulls.push_back(!isCount);
+    }
+
+    groups.push_back(std::move(group));
+    return groups.size() - 1;
+}
+
+/*
+ * addValue
+ *      Add rows to a count or a candidate value to min/max.
+ */
+void MetadataAggregates::addValue(Group &group, size_t aggIdx, Datum value)
+{
+    const auto &agg = aggregates[aggIdx];
+
+    switch (agg.kind)
+    {
+    case AGG_COUNT_STAR:
+    case AGG_COUNT:
+        group.values[aggIdx] = Int64GetDatum(DatumGetInt64(group.values[aggIdx]) + DatumGetInt64(value));
+        break;
+
+    case AGG_MIN:
+    case AGG_MAX:
+    {
+        const int sign = agg.kind == AGG_MIN ? 1 : -1;
+
+        if (group.nulls[aggIdx] || sign * compare(agg.column, value, group.values[aggIdx]) < 0)
+        {
+            group.values[aggIdx] = value;
+            group.nulls[aggIdx]  = false;
+        }
+        break;
+    }
+    }
+}
+
+bool MetadataAggregates::addFile(const ParquetFdwReader &reader,
+                                 FilterPushdown &        filter,
+                                 const Datum *           partitionValues,
+                                 const bool *            partitionNulls)
+{
+    const auto matches  = filter.matchRowGroups(reader);
+    int        groupIdx = -1;
+
+    for (size_t r = 0; r < matches.size(); ++r)
+    {
+        const auto    rowgroup = reader.getRowGroup(r);
+        const int64_t numRows  = rowgroup->num_rows();
+
+        if (matches[r] == FilterPushdown::MATCH_NONE || numRows == 0)
+            continue;
+
+        if (matches[r] == FilterPushdown::MATCH_SOME)
+            return false;
+
+        if (groupIdx < 0)
+            groupIdx = findGroup(partitionValues, partitionNulls);
+
+        Group &group = groups[groupIdx];
+        numRowGroups++;
+
+        for (size_t i = 0; i < aggregates.size(); ++i)
+        {
+            const auto &agg = aggregates[i];
+
+            if (agg.kind == AGG_COUNT_STAR)
+            {
+                addValue(group, i, Int64GetDatum(numRows));
+                continue;
+            }
+
+            const int attIdx      = agg.column.attIdx;
+            const int columnIndex = reader.columnIndex(attIdx);
+
+            /* Values of partition columns are the same for the whole file */
+            if (columnIndex < 0)
+            {
+                if (!partitionNulls[attIdx])
+                    addValue(group, i, agg.kind == AGG_COUNT ? Int64GetDatum(numRows)
+                                                             : partitionValues[attIdx]);
+                continue;
+            }
+
+            const auto stats = rowgroup->ColumnChunk(columnIndex)->statistics();
+            if (!stats || !stats->HasNullCount())
+                return false;
+
+            if (agg.kind == AGG_COUNT)
+            {
+                addValue(group, i, Int64GetDatum(numRows - stats->null_count()));
+                continue;
+            }
+
+            /* Nothing but NULLs */
+            if (stats->null_count() == numRows)
+                continue;
+
+            Oid   type;
+            Datum min, max;
+
+            if (!filter.columnMinMax(reader, attIdx, r, &type, &min, &max) || type != agg.column.type)
+                return false;
+
+            addValue(group, i, agg.kind == AGG_MIN ? min : max);
+        }
+    }
+
+    return true;
+}
+
+const std::vector<MetadataAggregates::Group> &MetadataAggregates::getGroups()
+{
+    /* Aggregates without grouping produce a row even for no input */
+    if (groups.empty() && groupColumns.empty())
+        findGroup(nullptr, nullptr);
+
+    return groups;
+}
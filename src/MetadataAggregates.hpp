@@ -0,0 +1,91 @@
+#pragma once
+
+#if __cplusplus > 199711L
+#    define register // Deprecated in C++11.
+#endif               // #if __cplusplus > 199711L
+
+#include <vector>
+
+#include "FilterPushdown.hpp"
+#include "ParquetFdwReader.hpp"
+
+extern "C" {
+#include "postgres.h"
+}
+
+/*
+ * MetadataAggregates
+ *      count(*), count(col), min(col) and max(col) computed from parquet
+ *      footers instead of the data: row counts of the row groups and null
+ *      counts and min/max statistics of the column chunks. Results may be
+ *      grouped by hive partition columns, whose values come from file paths.
+ *
+ * Only row groups all rows of which satisfy the scan clauses according to
+ * the statistics, or none of them, can be aggregated this way.
+ */
+class MetadataAggregates
+{
+public:
+    enum Kind
+    {
+        AGG_COUNT_STAR,
+        AGG_COUNT,
+        AGG_MIN,
+        AGG_MAX,
+    };
+
+    struct Column
+    {
+        int attIdx = -1; /* -1 for count(*) */
+        Oid type   = InvalidOid;
+        Oid collid = InvalidOid;
+    };
+
+    struct Aggregate
+    {
+        Kind   kind;
+        Column column;
+    };
+
+    struct Group
+    {
+        std::vector<Datum> keys;
+        std::vector<bool>  keyNulls;
+        std::vector<Datum> values;
+        std::vector<bool>  nulls;
+    };
+
+private:
+    std::vector<Column>    groupColumns; /* partition columns grouped by */
+    std::vector<Aggregate> aggregates;
+    std::vector<Group>     groups;
+    size_t                 numRowGroups = 0;
+
+    int    compare(const Column &column, Datum value1, Datum value2) const;
+    size_t findGroup(const Datum *partitionValues, const bool *partitionNulls);
+    void   addValue(Group &group, size_t aggIdx, Datum value);
+
+public:
+    MetadataAggregates(const std::vector<Column> &groupColumns, const std::vector<Aggregate> &aggregates)
+        : groupColumns(groupColumns), aggregates(aggregates)
+    {
+    }
+
+    /*
+     * Aggregate the row groups of the file left by the filter. Returns false
+     * if any of them can't be aggregated from metadata, the results are
+     * incomplete then.
+     */
+    bool addFile(const ParquetFdwReader &reader,
+                 FilterPushdown &        filter,
+                 const Datum *           partitionValues,
+                 const bool *            partitionNulls);
+
+    /* Results per group, a single one if nothing is grouped by */
+    const std::vector<Group> &getGroups();
+
+    size_t getNumRowGroups() const
+    {
+        return numRowGroups;
+    }
+};
@@ -21,12 +21,33 @@ struct FmgrInfo;
 using Size = size_t;
 
 #include "arrow/api.h"
+#include "arrow/util/config.h"
 #include <list>
+#include <utility>
+#include <vector>
 
 #include "Error.hpp"
 
+/* Parquet page index (column and offset indexes) is readable since Arrow 12 */
+#if ARROW_VERSION_MAJOR >= 12
+#    define PARQUET_FDW_PAGE_INDEX
+#endif
+
+/* Split block bloom filters of column chunks are readable since Arrow 13 */
+#if ARROW_VERSION_MAJOR >= 13
+#    define PARQUET_FDW_BLOOM_FILTER
+#endif
+
+/* Sorting columns of row groups are readable since Arrow 13 */
+#if ARROW_VERSION_MAJOR >= 13
+#    define PARQUET_FDW_SORTING_COLUMNS
+#endif
+
 #define SEGMENT_SIZE (1024 * 1024)
 
+/* Sorted disjoint [first, last) ranges of rows within a row group */
+using tRowRanges = std::vector<std::pair<int64_t, int64_t>>;
+
 #define ERROR_STR_LEN 512
 
 #define to_postgres_timestamp(tstype, i, ts)                                                       \
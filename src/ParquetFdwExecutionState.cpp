@@ -1,12 +1,18 @@
+#include <algorithm>
 #include <sstream>
 #include <utility>
 
+#include "FilterPushdown.hpp"
 #include "ParquetFdwExecutionState.hpp"
 #include "ReadCoordinator.hpp"
 #include "utils/palloc.h"
 
 extern "C" {
+#include "executor/executor.h"
+#include "executor/tuptable.h"
 #include "miscadmin.h"
+#include "utils/memutils.h"
+#include "utils/pg_locale.h"
 }
 
 ParquetFdwExecutionState::ParquetFdwExecutionState(MemoryContext            cxt,
@@ -27,15 +33,137 @@ ParquetFdwExecutionState::~ParquetFdwExecutionState()
 }
 
 bool ParquetFdwExecutionState::next(TupleTableSlot *slot, bool fake)
+{
+    /* Nothing more is read once the limit is reached */
+    if (rowsToReturn == 0)
+        return false;
+
+    if (topN)
+    {
+        if (!topNCollected)
+            collectTopN();
+
+        const bool res = topN->next(slot);
+
+        if (res)
+            ExecStoreVirtualTuple(slot);
+        return res;
+    }
+
+    if (!sortKeys.empty())
+    {
+        const bool res = nextMerged(slot);
+
+        if (res)
+        {
+            if (rowsToReturn > 0)
+                rowsToReturn--;
+            ExecStoreVirtualTuple(slot);
+        }
+        return res;
+    }
+
+    while (true)
+    {
+        if (!currentReader || currentReader->finishedReadingRowGroup())
+        {
+            if (!nextRowGroup())
+                return false;
+            if (projection)
+                projection->addRowGroup(*currentReader);
+        }
+
+        const uint32_t row = currentReader->getRow();
+        const bool     res = currentReader->next(slot, fake);
+
+        if (!res)
+            return false;
+
+        /*
+         * ExecStoreVirtualTuple doesn't throw postgres exceptions thus no
+         * need to wrap it into PG_TRY / PG_CATCH
+         */
+        ExecStoreVirtualTuple(slot);
+
+        if (projection)
+        {
+            if (projectionQual)
+            {
+                projectionContext->ecxt_scantuple = slot;
+
+                const bool matches = ExecQual(projectionQual, projectionContext);
+
+                ResetExprContext(projectionContext);
+                if (!matches)
+                {
+                    numRowsFiltered++;
+                    ExecClearTuple(slot);
+                    continue;
+                }
+            }
+            projection->fillRow(row, slot);
+        }
+
+        if (rowsToReturn > 0)
+            rowsToReturn--;
+        return true;
+    }
+}
+
+void ParquetFdwExecutionState::setProjection(VectorProjection *       vectorProjection,
+                                             const std::vector<bool> &attrEmitList,
+                                             ExprState *              qual,
+                                             ExprContext *            econtext)
+{
+    projection.reset(vectorProjection);
+    projectionQual    = qual;
+    projectionContext = econtext;
+
+    for (const auto &reader : readers)
+        reader->setAttrEmitList(attrEmitList);
+}
+
+/*
+ * skip_rows
+ *      Drop up to the given number of first rows from the row ranges, return
+ *      the number of the dropped ones.
+ */
+static int64_t skip_rows(tRowRanges &ranges, int64_t rows)
+{
+    int64_t skipped = 0;
+
+    while (!ranges.empty() && skipped < rows)
+    {
+        auto &        range = ranges.front();
+        const int64_t n     = std::min(range.second - range.first, rows - skipped);
+
+        range.first += n;
+        skipped += n;
+        if (range.first == range.second)
+            ranges.erase(ranges.begin());
+    }
+
+    return skipped;
+}
+
+/*
+ * nextRowGroup
+ *      Claim the next item of the read list, which may be shared with
+ *      parallel workers, and buffer its row group. Row groups none of whose
+ *      pages may match the scan clauses are passed over. Under a pushed down
+ *      limit, row groups within the offset are passed over by their row
+ *      counts and only the rows up to the limit are read.
+ */
+ParquetFdwReader *ParquetFdwExecutionState::nextRowGroup()
 {
     if (unlikely(coord == nullptr))
         throw std::runtime_error("Coordinator not set");
 
-    if (!currentReader || currentReader->finishedReadingRowGroup())
+    while (true)
     {
         const uint64_t nextReadListItem = coord->getNextReadListItem();
         if (nextReadListItem >= readList.size())
-            return false;
+            return nullptr;
 
         const auto [readerId, rowGroupId] = readList[nextReadListItem];
 
@@ -46,42 +174,376 @@ bool ParquetFdwExecutionState::next(TupleTableSlot *slot, bool fake)
             throw std::runtime_error(ss.str());
         }
 
+        /* Neither this row group nor any of the next ones has rows to keep */
+        if (topN && hasSortBound[readerId][rowGroupId]
+            && !topN->mayEnter(sortBounds[readerId][rowGroupId], false))
+            return nullptr;
+
         const auto previousReader = currentReader;
+        tRowRanges ranges;
+        const bool selected = selectRows(readerId, rowGroupId, &ranges);
+
         currentReader = readers[readerId];
-        currentReader->bufferRowGroup(rowGroupId, tupleDesc, attrUseList);
 
         if (previousReader && (currentReader.get() != previousReader.get()))
             previousReader->finishReadingFile();
+
+        /* No page of the row group may contain matching rows */
+        if (selected && ranges.empty())
+            continue;
+
+        if (dictionaryGroups && !selected && dictionaryGroups->addDictionary(*currentReader, rowGroupId))
+        {
+            numDictionaryRowGroups++;
+            continue;
+        }
+
+        if (rowsToReturn < 0 && rowsToSkip == 0)
+        {
+            currentReader->bufferRowGroup(rowGroupId, tupleDesc, attrUseList);
+            if (selected)
+                currentReader->setRowRanges(ranges);
+            return currentReader.get();
+        }
+
+        const int64_t numRows = currentReader->getRowGroup(rowGroupId)->num_rows();
+
+        if (!selected)
+            ranges = { { 0, numRows } };
+        rowsToSkip -= skip_rows(ranges, rowsToSkip);
+        if (ranges.empty())
+            continue;
+
+        /* Pages past the limit are only left unread without a page filter */
+        currentReader->bufferRowGroup(rowGroupId, tupleDesc, attrUseList,
+                                      selected || rowsToReturn < 0 ? -1
+                                                                   : ranges.front().first + rowsToReturn);
+        currentReader->setRowRanges(ranges);
+
+        return currentReader.get();
     }
+}
+
+/*
+ * streamFollows
+ *      Whether the current row of the first stream comes after the one of the
+ *      second stream. Equal rows are taken in the order of the files.
+ */
+bool ParquetFdwExecutionState::streamFollows(int readerId1, int readerId2) const
+{
+    const TupleTableSlot *slot1 = mergeSlots[readerId1];
+    const TupleTableSlot *slot2 = mergeSlots[readerId2];
 
-    const bool res = currentReader->next(slot, fake);
-    if (res)
+    for (const auto &sortKey : sortKeys)
     {
-        /*
-         * ExecStoreVirtualTuple doesn't throw postgres exceptions thus no
-         * need to wrap it into PG_TRY / PG_CATCH
-         */
-        ExecStoreVirtualTuple(slot);
+        const int attIdx = sortKey.ssup_attno - 1;
+        const int cmp    = ApplySortComparator(slot1->tts_values[attIdx], slot1->tts_isnull[attIdx],
+                                               slot2->tts_values[attIdx], slot2->tts_isnull[attIdx],
+                                               const_cast<SortSupportData *>(&sortKey));
+
+        if (cmp != 0)
+            return cmp > 0;
     }
 
-    return res;
+    return readerId1 > readerId2;
 }
 
-void ParquetFdwExecutionState::addFileToRead(const char* path, MemoryContext cxt, const List* rowGroupSkipList) {
-    std::set<int> rowGroupsToSkip;
-    if (rowGroupSkipList) {
-        ListCell *lc;
-        foreach(lc, rowGroupSkipList) {
-            rowGroupsToSkip.insert(lfirst_int(lc));
+/*
+ * startMerge
+ *      Queue the row groups of the read list per file in the order of their
+ *      min statistics of the first sort key, read the first row of every file
+ *      and build the heap of the streams.
+ */
+void ParquetFdwExecutionState::startMerge()
+{
+    MemoryContext oldcxt = MemoryContextSwitchTo(cxt);
+
+    if (rowGroupRanks.size() != readers.size())
+    {
+        const int attIdx = sortKeys.front().ssup_attno - 1;
+
+        rowGroupRanks.resize(readers.size());
+        for (size_t readerId = 0; readerId < readers.size(); ++readerId)
+        {
+            const auto &     reader = readers[readerId];
+            FilterPushdown   filter(reader->getNumRowGroups());
+            std::vector<int> order;
+
+            filter.orderRowGroups(*reader, attIdx, sortKeys.front().ssup_collation, &order);
+
+            rowGroupRanks[readerId].resize(order.size());
+            for (size_t i = 0; i < order.size(); ++i)
+                rowGroupRanks[readerId][order[i]] = i;
+        }
+    }
+
+    while (mergeSlots.size() < readers.size())
+    {
+#if PG_VERSION_NUM < 120000
+        mergeSlots.push_back(MakeSingleTupleTableSlot(tupleDesc));
+#else
+        mergeSlots.push_back(MakeSingleTupleTableSlot(tupleDesc, &TTSOpsVirtual));
+#endif
+    }
+
+    MemoryContextSwitchTo(oldcxt);
+
+    mergeRowGroups.assign(readers.size(), {});
+    for (const auto &[readerId, rowGroupId] : readList)
+        mergeRowGroups[readerId].push_back(rowGroupId);
+
+    mergeHeap.clear();
+    for (size_t readerId = 0; readerId < readers.size(); ++readerId)
+    {
+        const auto &ranks = rowGroupRanks[readerId];
+
+        std::sort(mergeRowGroups[readerId].begin(), mergeRowGroups[readerId].end(),
+                  [&ranks](int r1, int r2) { return ranks[r1] > ranks[r2]; });
+
+        readers[readerId]->rescan();
+        if (advanceStream(readerId))
+            mergeHeap.push_back(readerId);
+    }
+
+    std::make_heap(mergeHeap.begin(), mergeHeap.end(),
+                   [this](int r1, int r2) { return streamFollows(r1, r2); });
+
+    lastStream   = -1;
+    mergeStarted = true;
+}
+
+/*
+ * advanceStream
+ *      Read the next row of the file into its slot, buffering its next row
+ *      group if needed. Returns false at the end of the file.
+ */
+bool ParquetFdwExecutionState::advanceStream(int readerId)
+{
+    const auto &reader    = readers[readerId];
+    auto &      rowGroups = mergeRowGroups[readerId];
+
+    while (reader->finishedReadingRowGroup())
+    {
+        if (rowGroups.empty())
+        {
+            reader->finishReadingFile();
+            return false;
         }
+
+        const int  rowGroupId = rowGroups.back();
+        tRowRanges ranges;
+
+        rowGroups.pop_back();
+
+        /* No page of the row group may contain matching rows */
+        const bool selected = selectRows(readerId, rowGroupId, &ranges);
+        if (selected && ranges.empty())
+            continue;
+
+        reader->bufferRowGroup(rowGroupId, tupleDesc, attrUseList);
+        if (selected)
+            reader->setRowRanges(ranges);
+    }
+
+    return reader->next(mergeSlots[readerId]);
+}
+
+/*
+ * nextMerged
+ *      Return the least of the current rows of the files. Values of the row
+ *      stay in the buffers of its reader, so its stream is only advanced on
+ *      the next call.
+ */
+bool ParquetFdwExecutionState::nextMerged(TupleTableSlot *slot)
+{
+    const auto follows = [this](int r1, int r2) { return streamFollows(r1, r2); };
+
+    if (!mergeStarted)
+        startMerge();
+    else if (lastStream >= 0 && advanceStream(lastStream))
+    {
+        mergeHeap.push_back(lastStream);
+        std::push_heap(mergeHeap.begin(), mergeHeap.end(), follows);
     }
 
+    lastStream = -1;
+    if (mergeHeap.empty())
+        return false;
+
+    std::pop_heap(mergeHeap.begin(), mergeHeap.end(), follows);
+    lastStream = mergeHeap.back();
+    mergeHeap.pop_back();
+
+    const TupleTableSlot *row   = mergeSlots[lastStream];
+    const int             natts = tupleDesc->natts;
+
+    memcpy(slot->tts_values, row->tts_values, sizeof(Datum) * natts);
+    memcpy(slot->tts_isnull, row->tts_isnull, sizeof(bool) * natts);
+
+    return true;
+}
+
+void ParquetFdwExecutionState::setTopN(const std::vector<SortSupportData> &keys, int64_t count,
+                                       int64_t offset, ExprState *qual, ExprContext *econtext)
+{
+    MemoryContext rowsCxt = AllocSetContextCreate(cxt, "parquet_fdw top rows", ALLOCSET_DEFAULT_SIZES);
+    MemoryContext oldcxt  = MemoryContextSwitchTo(cxt);
+
+    topNKeys    = keys;
+    topNQual    = qual;
+    topNContext = econtext;
+    topN.reset(new TopNRows(rowsCxt, tupleDesc, keys, count, offset));
+#if PG_VERSION_NUM < 120000
+    topNSlot = MakeSingleTupleTableSlot(tupleDesc);
+#else
+    topNSlot = MakeSingleTupleTableSlot(tupleDesc, &TTSOpsVirtual);
+#endif
+
+    MemoryContextSwitchTo(oldcxt);
+}
+
+/*
+ * computeSortBounds
+ *      Decode the statistics bounding the first sort key in every row group.
+ *      Parquet orders strings bytewise, so they don't bound values of other
+ *      collations than C, and leaves NaNs out of float statistics while
+ *      PostgreSQL sorts them above every other value.
+ */
+void ParquetFdwExecutionState::computeSortBounds()
+{
+    const auto &  key    = topNKeys.front();
+    const int     attIdx = key.ssup_attno - 1;
+    const Oid     type   = TupleDescAttr(tupleDesc, attIdx)->atttypid;
+    const bool    usable = type != FLOAT4OID && type != FLOAT8OID
+                           && (!OidIsValid(key.ssup_collation) || lc_collate_is_c(key.ssup_collation));
+    MemoryContext oldcxt = MemoryContextSwitchTo(cxt);
+
+    sortBounds.resize(readers.size());
+    hasSortBound.resize(readers.size());
+
+    for (size_t readerId = 0; readerId < readers.size(); ++readerId)
+    {
+        const auto & reader       = readers[readerId];
+        const size_t numRowGroups = reader->getNumRowGroups();
+
+        sortBounds[readerId].assign(numRowGroups, (Datum)0);
+        hasSortBound[readerId].assign(numRowGroups, false);
+        if (!usable)
+            continue;
+
+        FilterPushdown filter(numRowGroups);
+
+        for (size_t r = 0; r < numRowGroups; ++r)
+        {
+            Oid   boundType;
+            Datum bound;
+
+            if (filter.sortBound(*reader, attIdx, r, key.ssup_reverse, key.ssup_nulls_first,
+                                 &boundType, &bound)
+                && boundType == type)
+            {
+                sortBounds[readerId][r]   = bound;
+                hasSortBound[readerId][r] = true;
+            }
+        }
+    }
+
+    MemoryContextSwitchTo(oldcxt);
+}
+
+/*
+ * collectTopN
+ *      Read the row groups whose rows may be among the first ones, those
+ *      without statistics first and the others in the order of their
+ *      bounds, so that reading stops as soon as the kept rows all come before
+ *      the bound of the next row group.
+ */
+void ParquetFdwExecutionState::collectTopN()
+{
+    ParquetFdwReader *reader;
+
+    if (sortBounds.size() != readers.size())
+        computeSortBounds();
+
+    std::stable_sort(readList.begin(), readList.end(),
+                     [this](const tReadListEntry &entry1, const tReadListEntry &entry2) {
+                         const auto [readerId1, rowGroupId1] = entry1;
+                         const auto [readerId2, rowGroupId2] = entry2;
+                         const bool bounded1 = hasSortBound[readerId1][rowGroupId1];
+                         const bool bounded2 = hasSortBound[readerId2][rowGroupId2];
+
+                         if (!bounded1 || !bounded2)
+                             return !bounded1 && bounded2;
+                         return ApplySortComparator(sortBounds[readerId1][rowGroupId1], false,
+                                                    sortBounds[readerId2][rowGroupId2], false,
+                                                    &topNKeys.front())
+                                < 0;
+                     });
+
+    topN->reset();
+    numRowGroupsRead = 0;
+
+    while ((reader = nextRowGroup()) != nullptr)
+    {
+        numRowGroupsRead++;
+
+        while (!reader->finishedReadingRowGroup())
+        {
+            ExecClearTuple(topNSlot);
+            reader->next(topNSlot);
+            ExecStoreVirtualTuple(topNSlot);
+
+            if (topNQual)
+            {
+                topNContext->ecxt_scantuple = topNSlot;
+
+                const bool matches = ExecQual(topNQual, topNContext);
+
+                ResetExprContext(topNContext);
+                if (!matches)
+                    continue;
+            }
+
+            topN->add(topNSlot);
+        }
+
+        CHECK_FOR_INTERRUPTS();
+    }
+
+    topN->sort();
+    topNCollected = true;
+}
+
+void ParquetFdwExecutionState::setPartitionAttrs(const std::vector<bool> &isPartitionAttr)
+{
+    partitionAttrs = isPartitionAttr;
+}
+
+std::shared_ptr<ParquetFdwReader> ParquetFdwExecutionState::makeReader(const char *path, MemoryContext cxt,
+                                                                      const Datum *partitionValues,
+                                                                      const bool * partitionNulls) const
+{
     const auto sharedReader = std::make_shared<ParquetFdwReader>(path);
     sharedReader->setMemoryContext(cxt);
-    readers.push_back(sharedReader);
+
+    if (!partitionAttrs.empty())
+    {
+        sharedReader->setPartitionAttrs(partitionAttrs);
+        if (partitionValues)
+            sharedReader->setPartitionValues(partitionValues, partitionNulls);
+    }
+
+    return sharedReader;
+}
+
+void ParquetFdwExecutionState::addReader(const std::shared_ptr<ParquetFdwReader> &reader,
+                                         const std::set<int> &                    rowGroupsToSkip)
+{
+    readers.push_back(reader);
+    plannedRowGroupsToSkip.push_back(rowGroupsToSkip);
 
     const auto readerId = readers.size() - 1;
-    const auto numRowGroups = (int32_t)(sharedReader->getNumRowGroups());
+    const auto numRowGroups = (int32_t)(reader->getNumRowGroups());
 
     for (int rowGroupId = 0; rowGroupId < numRowGroups; ++rowGroupId) {
         if (rowGroupsToSkip.find(rowGroupId) != rowGroupsToSkip.cend())
@@ -91,6 +553,204 @@ void ParquetFdwExecutionState::addFileToRead(const char* path, MemoryContext cxt
     }
 }
 
+void ParquetFdwExecutionState::addFileToRead(const char* path, MemoryContext cxt,
+                                             const std::vector<int32_t> &rowGroupSkipList,
+                                             const Datum *partitionValues, const bool *partitionNulls) {
+    const std::set<int> rowGroupsToSkip(rowGroupSkipList.begin(), rowGroupSkipList.end());
+
+    addReader(makeReader(path, cxt, partitionValues, partitionNulls), rowGroupsToSkip);
+}
+
+/*
+ * addFileToPrune
+ *      Same as addFileToRead but for files whose footers were not looked at
+ *      during planning. Returns false if all the row groups of the file were
+ *      filtered out and the file was not added.
+ */
+bool ParquetFdwExecutionState::addFileToPrune(const char *path, MemoryContext cxt, List *scanClauses,
+                                              const Datum *partitionValues, const bool *partitionNulls)
+{
+    const auto    sharedReader = makeReader(path, cxt, partitionValues, partitionNulls);
+    std::set<int> rowGroupsToSkip;
+    uint64_t      numTotalRows   = 0;
+    uint64_t      numRowsToRead  = 0;
+    size_t        numPagesToRead = 0;
+    ListCell *    lc;
+
+    sharedReader->validateSchema(tupleDesc);
+
+    FilterPushdown filterPushdown(sharedReader->getNumRowGroups());
+    filterPushdown.setDictionaryPruning(dictionaryPruning);
+    filterPushdown.setStableTransforms(true);
+    filterPushdown.extract_rowgroup_filters(scanClauses);
+
+    List *skipList = filterPushdown.getRowGroupSkipListAndUpdateTupleCount(
+            *sharedReader, tupleDesc, attrUseList, &numTotalRows, &numRowsToRead, &numPagesToRead);
+
+    if (skipList != NIL && sharedReader->getNumRowGroups() == (size_t)list_length(skipList))
+    {
+        list_free(skipList);
+        return false;
+    }
+
+    foreach (lc, skipList)
+        rowGroupsToSkip.insert(lfirst_int(lc));
+    list_free(skipList);
+
+    addReader(sharedReader, rowGroupsToSkip);
+    return true;
+}
+
+void ParquetFdwExecutionState::setRuntimeClauses(List *clauses)
+{
+    runtimeClauses        = clauses;
+    runtimePruningPending = clauses != NIL;
+}
+
+MemoryContext ParquetFdwExecutionState::resetRuntimeContext()
+{
+    if (!runtimeCxt)
+        runtimeCxt = AllocSetContextCreate(cxt, "parquet_fdw runtime pruning", ALLOCSET_DEFAULT_SIZES);
+    else
+        MemoryContextReset(runtimeCxt);
+
+    return runtimeCxt;
+}
+
+/*
+ * pruneRowGroups
+ *      Rebuild the read list from the row groups left by planner which may
+ *      satisfy the clauses. Footers are already loaded by the readers and
+ *      statistics are decoded on the first call only, so this is cheap enough
+ *      to be repeated on every rescan with new parameters, e.g. for each outer
+ *      row of a nested loop.
+ */
+void ParquetFdwExecutionState::pruneRowGroups(List *clauses)
+{
+    MemoryContext oldcxt = MemoryContextSwitchTo(runtimeCxt);
+
+    readList.clear();
+    runtimeFilters.resize(readers.size());
+
+    for (size_t readerId = 0; readerId < readers.size(); ++readerId)
+    {
+        const auto &  reader          = readers[readerId];
+        auto &        filterPushdown  = runtimeFilters[readerId];
+        std::set<int> rowGroupsToSkip = plannedRowGroupsToSkip[readerId];
+        uint64_t      numTotalRows    = 0;
+        uint64_t      numRowsToRead   = 0;
+        size_t        numPagesToRead  = 0;
+        ListCell *    lc;
+
+        if (!filterPushdown)
+        {
+            MemoryContextSwitchTo(cxt);
+            filterPushdown.reset(new FilterPushdown(reader->getNumRowGroups()));
+            filterPushdown->setDictionaryPruning(dictionaryPruning);
+            filterPushdown->setStableTransforms(true);
+            MemoryContextSwitchTo(runtimeCxt);
+        }
+        filterPushdown->extract_rowgroup_filters(clauses);
+
+        List *skipList = filterPushdown->getRowGroupSkipListAndUpdateTupleCount(
+                *reader, tupleDesc, attrUseList, &numTotalRows, &numRowsToRead, &numPagesToRead);
+
+        foreach (lc, skipList)
+        {
+            if (rowGroupsToSkip.insert(lfirst_int(lc)).second)
+                elog(DEBUG1, "parquet_fdw: skipping rowgroup %d of file %s at execution",
+                     lfirst_int(lc), reader->getPath().c_str());
+        }
+        list_free(skipList);
+
+        const auto numRowGroups = (int32_t)(reader->getNumRowGroups());
+        for (int rowGroupId = 0; rowGroupId < numRowGroups; ++rowGroupId)
+        {
+            if (rowGroupsToSkip.find(rowGroupId) == rowGroupsToSkip.cend())
+                readList.push_back({(int32_t)readerId, rowGroupId});
+        }
+    }
+
+    /* Pages are filtered with the new values as well */
+    runtimeClauseValues = clauses;
+    for (auto &[readerId, filter] : pageFilters)
+        buildPageFilter(*filter);
+
+    MemoryContextSwitchTo(oldcxt);
+
+    runtimePruningPending = false;
+}
+
+void ParquetFdwExecutionState::setPageFilterClauses(List *clauses)
+{
+#ifdef PARQUET_FDW_PAGE_INDEX
+    pageFilterClauses = clauses;
+#endif
+}
+
+/*
+ * selectRows
+ *      Find rows of the row group which may satisfy the scan clauses according
+ *      to the page index and count pages of the used columns left out. Returns
+ *      false if all the rows have to be read.
+ */
+bool ParquetFdwExecutionState::selectRows(int readerId, int rowGroupId, tRowRanges *ranges)
+{
+#ifdef PARQUET_FDW_PAGE_INDEX
+    const auto &  reader = readers[readerId];
+    MemoryContext oldcxt;
+    bool          selected;
+
+    if (pageFilterClauses == NIL)
+        return false;
+
+    auto it = pageFilters.find(readerId);
+    if (it == pageFilters.end())
+    {
+        oldcxt = MemoryContextSwitchTo(cxt);
+        it     = pageFilters.emplace(readerId, new FilterPushdown(reader->getNumRowGroups())).first;
+        if (runtimeCxt)
+            MemoryContextSwitchTo(runtimeCxt);
+        buildPageFilter(*it->second);
+        MemoryContextSwitchTo(oldcxt);
+    }
+
+    if (!it->second->hasFilters())
+        return false;
+
+    if (!pageIndexCxt)
+        pageIndexCxt = AllocSetContextCreate(cxt, "parquet_fdw page index", ALLOCSET_DEFAULT_SIZES);
+
+    oldcxt   = MemoryContextSwitchTo(pageIndexCxt);
+    selected = it->second->getRowRanges(*reader, rowGroupId, ranges);
+    MemoryContextSwitchTo(oldcxt);
+    MemoryContextReset(pageIndexCxt);
+
+    if (selected)
+        numPagesSkipped += reader->countSkippedPages(rowGroupId, *ranges, attrUseList);
+
+    return selected;
+#else
+    return false;
+#endif
+}
+
+/*
+ * buildPageFilter
+ *      Build the page filter tree from the scan clauses and the current values
+ *      of the runtime clauses, if any.
+ */
+void ParquetFdwExecutionState::buildPageFilter(FilterPushdown &filter)
+{
+    List *clauses = pageFilterClauses;
+
+    if (runtimeClauseValues != NIL)
+        clauses = list_concat(list_copy(pageFilterClauses), list_copy(runtimeClauseValues));
+
+    filter.setStableTransforms(true);
+    filter.extract_rowgroup_filters(clauses);
+}
+
 void ParquetFdwExecutionState::set_coordinator(ReadCoordinator *coord)
 {
     this->coord = coord;
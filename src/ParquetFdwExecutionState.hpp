@@ -1,16 +1,24 @@
 #pragma once
 
+#include "FilterPushdown.hpp"
 #include "ParquetFdwReader.hpp"
 #include "ReadCoordinator.hpp"
+#include "TopNRows.hpp"
+#include "VectorAggregates.hpp"
+#include "VectorProjection.hpp"
 #include "utils/palloc.h"
 
+#include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
 
 extern "C" {
 #include "access/tupdesc.h"
+#include "nodes/execnodes.h"
 #include "postgres.h"
+#include "utils/sortsupport.h"
 }
 
 class ParquetFdwExecutionState
@@ -24,7 +32,9 @@ protected:
     MemoryContext cxt;
     TupleDesc     tupleDesc;
     std::vector<bool> attrUseList;
+    std::vector<bool> partitionAttrs;
     bool              use_mmap;
+    bool              dictionaryPruning = false;
 
     ReadCoordinator *coord;
 
@@ -34,6 +44,97 @@ private:
 
     tReadList readList;
 
+    /* Row groups skipped by planner, per reader */
+    std::vector<std::set<int>> plannedRowGroupsToSkip;
+
+    /* Scan clauses with operands known only at execution time */
+    List *runtimeClauses        = NIL;
+    bool  runtimePruningPending = false;
+
+    /*
+     * The same clauses with the current values of the operands and the
+     * memory they and the filter trees built from them live in. Statistics
+     * decoded by the filters are kept for all the rescans.
+     */
+    List *                                       runtimeClauseValues = NIL;
+    MemoryContext                                runtimeCxt          = nullptr;
+    std::vector<std::unique_ptr<FilterPushdown>> runtimeFilters;
+
+    /* Scan clauses checked against page indexes, filter trees per reader */
+    List *                                          pageFilterClauses = NIL;
+    std::map<int, std::unique_ptr<FilterPushdown>> pageFilters;
+    MemoryContext                                   pageIndexCxt = nullptr;
+    uint64                                          numPagesSkipped = 0;
+
+    /*
+     * Pushed down LIMIT and OFFSET, -1 if there is none. What is left of them
+     * while scanning is in rowsToReturn and rowsToSkip.
+     */
+    int64_t limitCount   = -1;
+    int64_t limitOffset  = 0;
+    int64_t rowsToReturn = -1;
+    int64_t rowsToSkip   = 0;
+
+    /*
+     * Sort keys of a sorted scan, which merges the rows of the files. Every
+     * file is a stream of its row groups in the order of the first key, the
+     * streams are kept in a heap by their current rows.
+     */
+    std::vector<SortSupportData>  sortKeys;
+    std::vector<std::vector<int>> rowGroupRanks; /* per reader, position of each row group */
+    std::vector<std::vector<int>> mergeRowGroups; /* per reader, the ones left in reverse order */
+    std::vector<TupleTableSlot *> mergeSlots;     /* current row of each stream */
+    std::vector<int>              mergeHeap;
+    int                           lastStream   = -1;
+    bool                          mergeStarted = false;
+
+    void startMerge();
+    bool advanceStream(int readerId);
+    bool nextMerged(TupleTableSlot *slot);
+    bool streamFollows(int readerId1, int readerId2) const;
+
+    /*
+     * Top-N scans keep the first rows in the order of the keys passing the
+     * qual. Row groups are read in the order of their statistics bounding
+     * the first key, the scan stops at the first one none of whose rows may
+     * be kept.
+     */
+    std::unique_ptr<TopNRows>       topN;
+    std::vector<SortSupportData>    topNKeys;
+    ExprState *                     topNQual      = nullptr;
+    ExprContext *                   topNContext   = nullptr;
+    TupleTableSlot *                topNSlot      = nullptr;
+    std::vector<std::vector<Datum>> sortBounds;   /* per reader and row group */
+    std::vector<std::vector<bool>>  hasSortBound;
+    bool                            topNCollected = false;
+    uint64                          numRowGroupsRead = 0;
+
+    void computeSortBounds();
+    void collectTopN();
+
+    /*
+     * Expressions of the target list computed over whole row groups. The
+     * qual is checked by the scan, so that the expressions are only put into
+     * the rows it returns.
+     */
+    std::unique_ptr<VectorProjection> projection;
+    ExprState *                       projectionQual    = nullptr;
+    ExprContext *                     projectionContext = nullptr;
+    uint64                            numRowsFiltered   = 0;
+
+    /* Aggregates taking the groups of row groups from dictionaries if they can */
+    VectorAggregates *dictionaryGroups       = nullptr;
+    uint64            numDictionaryRowGroups = 0;
+
+    bool selectRows(int readerId, int rowGroupId, tRowRanges *ranges);
+    void buildPageFilter(FilterPushdown &filter);
+
+    std::shared_ptr<ParquetFdwReader> makeReader(const char *path, MemoryContext cxt,
+                                                 const Datum *partitionValues,
+                                                 const bool * partitionNulls) const;
+    void addReader(const std::shared_ptr<ParquetFdwReader> &reader,
+                   const std::set<int> &                    rowGroupsToSkip);
+
 public:
     ParquetFdwExecutionState(MemoryContext            cxt,
                              TupleDesc                tupleDesc,
@@ -43,11 +144,141 @@ public:
     ~ParquetFdwExecutionState();
 
     bool next(TupleTableSlot *slot, bool fake = false);
+    /* Buffer the next row group to read, nullptr at the end of the scan */
+    ParquetFdwReader *nextRowGroup();
     void set_coordinator(ReadCoordinator *coord);
-    void addFileToRead(const char* path, MemoryContext cxt, const List* rowGroupSkipList);
+    void setPartitionAttrs(const std::vector<bool> &isPartitionAttr);
+    void setDictionaryPruning(bool enabled)
+    {
+        dictionaryPruning = enabled;
+    }
+    void addFileToRead(const char* path, MemoryContext cxt, const std::vector<int32_t> &rowGroupSkipList,
+                       const Datum *partitionValues = nullptr, const bool *partitionNulls = nullptr);
+    /* Validate file schema and skip row groups not matching the scan clauses */
+    bool addFileToPrune(const char* path, MemoryContext cxt, List *scanClauses,
+                        const Datum *partitionValues = nullptr, const bool *partitionNulls = nullptr);
+
+    /* Clauses with Params or stable functions to prune row groups with */
+    void setRuntimeClauses(List *clauses);
+    List *getRuntimeClauses() const
+    {
+        return runtimeClauses;
+    }
+    bool isRuntimePruningPending() const
+    {
+        return runtimePruningPending;
+    }
+    /* Reset and return the context to evaluate runtime clauses in */
+    MemoryContext resetRuntimeContext();
+    /*
+     * Rebuild the read list skipping row groups and pages not matching the
+     * clauses, which must be allocated in the runtime context
+     */
+    void pruneRowGroups(List *clauses);
+
+    /* Clauses to skip pages not matching them by page index */
+    void setPageFilterClauses(List *clauses);
+    bool usesPageIndex() const
+    {
+        return pageFilterClauses != NIL;
+    }
+    uint64 getNumPagesSkipped() const
+    {
+        return numPagesSkipped;
+    }
 
-    void rescan()
+    /* Column chunks of all the readers taken from their statistics */
+    uint64 getNumScalarChunks() const
     {
+        uint64 res = 0;
+
+        for (const auto &reader : readers)
+            res += reader->getNumScalarChunks();
+        return res;
+    }
+
+    /*
+     * Return at most count rows after skipping offset ones. Only valid if no
+     * rows returned by next() are filtered out afterwards.
+     */
+    void setLimit(int64_t count, int64_t offset)
+    {
+        limitCount   = rowsToReturn = count;
+        limitOffset  = rowsToSkip   = offset;
+    }
+
+    /*
+     * Merge the rows of the files, each of which is sorted by the keys, into
+     * a single sorted stream
+     */
+    void setSortKeys(const std::vector<SortSupportData> &keys)
+    {
+        sortKeys = keys;
+    }
+    bool isSorted() const
+    {
+        return !sortKeys.empty();
+    }
+
+    /*
+     * Return the first count rows after offset ones in the order of the keys
+     * among the ones the qual accepts, if any
+     */
+    void setTopN(const std::vector<SortSupportData> &keys, int64_t count, int64_t offset,
+                 ExprState *qual, ExprContext *econtext);
+    bool isTopN() const
+    {
+        return topN != nullptr;
+    }
+    /*
+     * Offer every row group to the aggregates before reading it, the ones
+     * whose groups they take from dictionary pages are not read
+     */
+    void setDictionaryGroups(VectorAggregates *aggregates)
+    {
+        dictionaryGroups = aggregates;
+    }
+    uint64 getNumDictionaryRowGroups() const
+    {
+        return numDictionaryRowGroups;
+    }
+
+    /*
+     * Compute the expressions of the target list over row groups and put
+     * only the emitted attributes and the expressions into slots
+     */
+    void setProjection(VectorProjection *projection, const std::vector<bool> &attrEmitList,
+                       ExprState *qual, ExprContext *econtext);
+    /* Rows rejected by the qual checked for the projection */
+    uint64 getNumRowsFiltered() const
+    {
+        return numRowsFiltered;
+    }
+
+    /* Row groups read by the last Top-N scan and all the ones to read */
+    uint64 getNumRowGroupsRead() const
+    {
+        return numRowGroupsRead;
+    }
+    size_t getNumRowGroupsToRead() const
+    {
+        return readList.size();
+    }
+
+    void rescan(bool paramsChanged = false)
+    {
+        if (paramsChanged && runtimeClauses != NIL)
+            runtimePruningPending = true;
+
+        rowsToReturn = limitCount;
+        rowsToSkip   = limitOffset;
+        mergeStarted  = false;
+        topNCollected = false;
+
+        /* Don't continue the row group the previous scan stopped in */
+        if (currentReader)
+            currentReader->rescan();
+
         if (!coord)
             Error("Coordinator not set");
         else
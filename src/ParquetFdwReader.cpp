@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "ParquetFdwReader.hpp"
 #include "Error.hpp"
 #include "PostgresWrappers.hpp"
@@ -10,7 +12,8 @@ extern "C" {
 }
 
 ParquetFdwReader::ParquetFdwReader(const char* parquetFilePath)
-: parquetFilePath(parquetFilePath)
+: rowRange(0)
+, parquetFilePath(parquetFilePath)
 , fileReader(nullptr)
 {
     props.set_use_threads(false);
@@ -44,12 +47,33 @@ std::unique_ptr<parquet::arrow::FileReader> ParquetFdwReader::getFileReader() co
     return reader;
 }
 
+/*
+ * setPartitionAttrs
+ *      Build attribute to parquet column mapping. Hive partition columns are
+ *      not stored in the file so the rest of attributes are shifted.
+ */
+void ParquetFdwReader::setPartitionAttrs(const std::vector<bool>& isPartitionAttr)
+{
+    int column = 0;
+
+    columnMap.clear();
+    for (const bool isPartition : isPartitionAttr)
+        columnMap.push_back(isPartition ? -1 : column++);
+}
+
+void ParquetFdwReader::setPartitionValues(const Datum *values, const bool *isnull)
+{
+    partitionValues.assign(values, values + columnMap.size());
+    partitionNulls.assign(isnull, isnull + columnMap.size());
+}
+
 void ParquetFdwReader::setMemoryContext(MemoryContext cxt) {
     allocator = std::make_unique<FastAllocator>(FastAllocator(cxt));
 }
 
 void ParquetFdwReader::bufferRowGroup(
-    const int32_t rowGroupId, TupleDesc tupleDesc, const std::vector<bool>& attrUseList)
+    const int32_t rowGroupId, TupleDesc tupleDesc, const std::vector<bool>& attrUseList,
+    int64_t maxRows)
 {
     arrow::Status status;
 
@@ -58,13 +82,31 @@ void ParquetFdwReader::bufferRowGroup(
 
     auto rowgroup_meta = fileReader->parquet_reader()->metadata()->RowGroup(rowGroupId);
 
+    /*
+     * Decode only the pages holding the first rows. Batches are made of leaf
+     * columns, which are the fields of the schema only if it is flat.
+     */
+    if (maxRows >= 0 && maxRows < rowgroup_meta->num_rows()
+        && metadata->num_columns() == schema->num_fields())
+    {
+        bufferFirstRows(rowGroupId, tupleDesc, attrUseList, maxRows);
+        return;
+    }
+
     columnChunks.clear();
     for (int numAttr = 0; numAttr < tupleDesc->natts; ++numAttr)
     {
-        if (attrUseList[numAttr])
+        const int                      column = columnIndex(numAttr);
+        std::shared_ptr<arrow::Scalar> scalar;
+
+        if (attrUseList[numAttr] && column >= 0 && chunkScalar(rowGroupId, column, &scalar))
+        {
+            columnChunks.emplace_back(ChunkInfo(scalarArray(*scalar, rowgroup_meta->num_rows())));
+        }
+        else if (attrUseList[numAttr] && column >= 0)
         {
             std::shared_ptr<arrow::ChunkedArray> columnChunk;
-            const auto columnReader = fileReader->RowGroup(rowGroupId)->Column(numAttr);
+            const auto columnReader = fileReader->RowGroup(rowGroupId)->Column(column);
             const auto status       = columnReader->Read(&columnChunk);
             if (!status.ok())
                 throw Error("Could not read column %d in row group %d: %s", numAttr, rowGroupId,
@@ -86,8 +128,404 @@ void ParquetFdwReader::bufferRowGroup(
     this->row_group = rowGroupId;
     this->row       = 0;
     num_rows        = rowgroup_meta->num_rows();
+    rowRanges.clear();
+}
+
+/*
+ * bufferFirstRows
+ *      Read the first rows of the used columns of the row group as a single
+ *      record batch.
+ */
+void ParquetFdwReader::bufferFirstRows(
+    const int32_t rowGroupId, TupleDesc tupleDesc, const std::vector<bool>& attrUseList,
+    int64_t maxRows)
+{
+    std::vector<int>                            columns;
+    std::vector<std::shared_ptr<arrow::Scalar>> scalars(tupleDesc->natts);
+    std::shared_ptr<arrow::RecordBatch>         batch;
+
+    for (int numAttr = 0; numAttr < tupleDesc->natts; ++numAttr)
+    {
+        const int column = columnIndex(numAttr);
+
+        if (attrUseList[numAttr] && column >= 0 && !chunkScalar(rowGroupId, column, &scalars[numAttr]))
+            columns.push_back(column);
+    }
+
+    /* Nothing to decode, the rows are counted only */
+    if (columns.empty())
+    {
+        columnChunks.clear();
+        for (int numAttr = 0; numAttr < tupleDesc->natts; ++numAttr)
+            columnChunks.emplace_back(ChunkInfo(scalars[numAttr] ? scalarArray(*scalars[numAttr], maxRows)
+                                                                 : nullptr));
+
+        this->row_group = rowGroupId;
+        this->row       = 0;
+        num_rows        = maxRows;
+        rowRanges.clear();
+        return;
+    }
+
+    fileReader->set_batch_size(std::max<int64_t>(maxRows, 1));
+
+#if ARROW_VERSION_MAJOR >= 21
+    auto result = fileReader->GetRecordBatchReader({ rowGroupId }, columns);
+    if (!result.ok())
+        throw Error("Could not read row group %d: %s", rowGroupId, result.status().message().c_str());
+    const auto batchReader = std::move(result).ValueUnsafe();
+#else
+    std::shared_ptr<arrow::RecordBatchReader> batchReader;
+    auto status = fileReader->GetRecordBatchReader({ rowGroupId }, columns, &batchReader);
+    if (!status.ok())
+        throw Error("Could not read row group %d: %s", rowGroupId, status.message().c_str());
+#endif
+
+    const auto readStatus = batchReader->ReadNext(&batch);
+    if (!readStatus.ok() || !batch)
+        throw Error("Could not read row group %d: %s", rowGroupId,
+                    readStatus.ok() ? "no rows" : readStatus.message().c_str());
+
+    columnChunks.clear();
+    for (int numAttr = 0, batchColumn = 0; numAttr < tupleDesc->natts; ++numAttr)
+    {
+        if (scalars[numAttr])
+            columnChunks.emplace_back(ChunkInfo(scalarArray(*scalars[numAttr], batch->num_rows())));
+        else if (attrUseList[numAttr] && columnIndex(numAttr) >= 0)
+            columnChunks.emplace_back(ChunkInfo(batch->column(batchColumn++)));
+        else
+            columnChunks.emplace_back(ChunkInfo());
+    }
+
+    this->row_group = rowGroupId;
+    this->row       = 0;
+    num_rows        = batch->num_rows();
+    rowRanges.clear();
+}
+
+/*
+ * chunkScalar
+ *      Whether every value of the column chunk is known from its statistics,
+ *      i.e. the chunk holds nothing but NULLs or a single value without any
+ *      NULLs. The value is then returned as a scalar, a null one in the first
+ *      case. Floats are left out as their statistics leave out NaNs.
+ */
+bool ParquetFdwReader::chunkScalar(int rowGroupId, int column,
+                                   std::shared_ptr<arrow::Scalar> *scalar)
+{
+    /* Statistics of leaf columns only match fields of flat schemas */
+    if (metadata->num_columns() != schema->num_fields())
+        return false;
+
+    const auto rowgroup = metadata->RowGroup(rowGroupId);
+    const auto stats    = rowgroup->ColumnChunk(column)->statistics();
+    const auto type     = schema->field(column)->type();
+
+    if (!stats || !stats->HasNullCount())
+        return false;
+
+    if (stats->null_count() == rowgroup->num_rows())
+    {
+        *scalar = arrow::MakeNullScalar(type);
+        ++numScalarChunks;
+        return true;
+    }
+
+    if (stats->null_count() > 0 || !stats->HasMinMax())
+        return false;
+
+    switch (type->id())
+    {
+    case arrow::Type::BOOL:
+    {
+        const auto typed = static_cast<parquet::BoolStatistics *>(stats.get());
+
+        if (stats->physical_type() != parquet::Type::BOOLEAN || typed->min() != typed->max())
+            return false;
+        *scalar = std::make_shared<arrow::BooleanScalar>(typed->min());
+        break;
+    }
+    case arrow::Type::INT32:
+    case arrow::Type::DATE32:
+    {
+        const auto typed = static_cast<parquet::Int32Statistics *>(stats.get());
+
+        if (stats->physical_type() != parquet::Type::INT32 || typed->min() != typed->max())
+            return false;
+        if (type->id() == arrow::Type::INT32)
+            *scalar = std::make_shared<arrow::Int32Scalar>(typed->min());
+        else
+            *scalar = std::make_shared<arrow::Date32Scalar>(typed->min());
+        break;
+    }
+    case arrow::Type::INT64:
+    case arrow::Type::TIMESTAMP:
+    {
+        const auto typed = static_cast<parquet::Int64Statistics *>(stats.get());
+
+        /* INT96 timestamps are converted while read */
+        if (stats->physical_type() != parquet::Type::INT64 || typed->min() != typed->max())
+            return false;
+        if (type->id() == arrow::Type::INT64)
+            *scalar = std::make_shared<arrow::Int64Scalar>(typed->min());
+        else
+            *scalar = std::make_shared<arrow::TimestampScalar>(typed->min(), type);
+        break;
+    }
+    case arrow::Type::STRING:
+    case arrow::Type::BINARY:
+    {
+        const auto typed = static_cast<parquet::ByteArrayStatistics *>(stats.get());
+
+        if (stats->physical_type() != parquet::Type::BYTE_ARRAY || typed->min() != typed->max())
+            return false;
+
+        const auto value = arrow::Buffer::FromString(
+            std::string(reinterpret_cast<const char *>(typed->min().ptr), typed->min().len));
+        if (type->id() == arrow::Type::STRING)
+            *scalar = std::make_shared<arrow::StringScalar>(value);
+        else
+            *scalar = std::make_shared<arrow::BinaryScalar>(value);
+        break;
+    }
+    default:
+        return false;
+    }
+
+    ++numScalarChunks;
+    return true;
+}
+
+/*
+ * scalarArray
+ *      Array repeating the scalar, built instead of decoding the column chunk.
+ */
+std::shared_ptr<arrow::Array> ParquetFdwReader::scalarArray(const arrow::Scalar &scalar,
+                                                            int64_t              length)
+{
+    auto result = arrow::MakeArrayFromScalar(scalar, length);
+
+    if (!result.ok())
+        throw Error("Could not build array: %s", result.status().message().c_str());
+    return std::move(result).ValueUnsafe();
+}
+
+void ParquetFdwReader::setRowRanges(const tRowRanges &ranges)
+{
+    rowRanges = ranges;
+    rowRange  = 0;
+    skipUnselectedRows();
 }
 
+/*
+ * skipUnselectedRows
+ *      Move to the next row within the row ranges if those are set.
+ */
+void ParquetFdwReader::skipUnselectedRows()
+{
+    if (rowRanges.empty())
+        return;
+
+    while (rowRange < rowRanges.size() && (int64_t)row >= rowRanges[rowRange].second)
+        ++rowRange;
+
+    if (rowRange == rowRanges.size())
+        row = num_rows;
+    else if ((int64_t)row < rowRanges[rowRange].first)
+        row = rowRanges[rowRange].first;
+}
+
+#ifdef PARQUET_FDW_PAGE_INDEX
+std::shared_ptr<parquet::RowGroupPageIndexReader> ParquetFdwReader::getPageIndex(int rowGroupId)
+{
+    if (!this->fileReader)
+        this->fileReader = getFileReader();
+
+    const auto pageIndexReader = fileReader->parquet_reader()->GetPageIndexReader();
+    return pageIndexReader ? pageIndexReader->RowGroup(rowGroupId) : nullptr;
+}
+
+size_t ParquetFdwReader::countSkippedPages(int rowGroupId, const tRowRanges &ranges,
+                                           const std::vector<bool> &attrUseList)
+{
+    const auto    pageIndex = getPageIndex(rowGroupId);
+    const int64_t numRows   = metadata->RowGroup(rowGroupId)->num_rows();
+    size_t        numPages  = 0;
+
+    if (!pageIndex)
+        return 0;
+
+    for (size_t numAttr = 0; numAttr < attrUseList.size(); ++numAttr)
+    {
+        const int column = columnIndex(numAttr);
+
+        if (!attrUseList[numAttr] || column < 0)
+            continue;
+
+        const auto offsetIndex = pageIndex->GetOffsetIndex(column);
+        if (!offsetIndex)
+            continue;
+
+        const auto &pages = offsetIndex->page_locations();
+        size_t      range = 0;
+
+        for (size_t i = 0; i < pages.size(); ++i)
+        {
+            const int64_t first = pages[i].first_row_index;
+            const int64_t last  = i + 1 < pages.size() ? pages[i + 1].first_row_index : numRows;
+
+            while (range < ranges.size() && ranges[range].second <= first)
+                ++range;
+            if (range == ranges.size() || ranges[range].first >= last)
+                ++numPages;
+        }
+    }
+
+    return numPages;
+}
+#endif
+
+parquet::ParquetFileReader *ParquetFdwReader::getPageFileReader() const
+{
+    if (!pageFileReader)
+        pageFileReader = parquet::ParquetFileReader::OpenFile(parquetFilePath, true);
+    return pageFileReader.get();
+}
+
+/*
+ * is_dictionary_encoded
+ *      Whether all the data pages of the column chunk are dictionary encoded,
+ *      i.e. the writer hasn't fallen back to plain encoding for some of them.
+ */
+static bool is_dictionary_encoded(const parquet::ColumnChunkMetaData &chunk)
+{
+    const auto isDictionary = [](parquet::Encoding::type encoding) {
+        return encoding == parquet::Encoding::PLAIN_DICTIONARY
+               || encoding == parquet::Encoding::RLE_DICTIONARY;
+    };
+
+    if (!chunk.has_dictionary_page())
+        return false;
+
+    /* Encodings of every page are known */
+    if (!chunk.encoding_stats().empty())
+    {
+        for (const auto &stats : chunk.encoding_stats())
+        {
+            if (stats.page_type != parquet::PageType::DICTIONARY_PAGE && stats.count > 0
+                && !isDictionary(stats.encoding))
+                return false;
+        }
+        return true;
+    }
+
+    /*
+     * Otherwise, as parquet-mr does, only chunks listing no other encodings
+     * of values than PLAIN_DICTIONARY are trusted. Writers listing the
+     * dictionary page as PLAIN may have fallen back to plain pages, newer
+     * ones to DELTA or BYTE_STREAM_SPLIT ones.
+     */
+    bool hasDictionary = false;
+
+    for (const auto encoding : chunk.encodings())
+    {
+        if (encoding == parquet::Encoding::PLAIN_DICTIONARY)
+            hasDictionary = true;
+        else if (encoding != parquet::Encoding::RLE && encoding != parquet::Encoding::BIT_PACKED)
+            return false;
+    }
+    return hasDictionary;
+}
+
+bool ParquetFdwReader::isDictionaryEncoded(int rowGroupId, int column) const
+{
+    return is_dictionary_encoded(*metadata->RowGroup(rowGroupId)->ColumnChunk(column));
+}
+
+std::shared_ptr<parquet::DictionaryPage> ParquetFdwReader::getDictionaryPage(int rowGroupId,
+                                                                             int column) const
+{
+    try
+    {
+        if (!is_dictionary_encoded(*metadata->RowGroup(rowGroupId)->ColumnChunk(column)))
+            return nullptr;
+
+        const auto pageReader = getPageFileReader()->RowGroup(rowGroupId)->GetColumnPageReader(column);
+        const auto page       = pageReader->NextPage();
+
+        if (page && page->type() == parquet::PageType::DICTIONARY_PAGE)
+            return std::static_pointer_cast<parquet::DictionaryPage>(page);
+    }
+    catch (std::exception &e)
+    {
+        elog(DEBUG1, "parquet_fdw: failed to read dictionary page of file %s: %s",
+             parquetFilePath.c_str(), e.what());
+    }
+
+    return nullptr;
+}
+
+/*
+ * sortingColumn
+ *      Parquet column the rows of every row group are sorted by in ascending
+ *      order according to the sorting columns of the row groups, -1 if there
+ *      is none.
+ */
+int ParquetFdwReader::sortingColumn() const
+{
+    int column = -1;
+
+#ifdef PARQUET_FDW_SORTING_COLUMNS
+    for (int r = 0; r < metadata->num_row_groups(); ++r)
+    {
+        const auto sortingColumns = metadata->RowGroup(r)->sorting_columns();
+
+        if (sortingColumns.empty() || sortingColumns[0].descending
+            || (column >= 0 && sortingColumns[0].column_idx != column))
+            return -1;
+        column = sortingColumns[0].column_idx;
+    }
+#endif
+
+    return column;
+}
+
+#ifdef PARQUET_FDW_BLOOM_FILTER
+/*
+ * getBloomFilter
+ *      Load the bloom filter of the column chunk unless it is cached already.
+ *      Filters that cannot be read are treated as missing.
+ */
+const parquet::BloomFilter *ParquetFdwReader::getBloomFilter(int rowGroupId, int column) const
+{
+    const auto key = std::make_pair(rowGroupId, column);
+    auto       it  = bloomFilters.find(key);
+
+    if (it != bloomFilters.end())
+        return it->second.get();
+
+    std::unique_ptr<parquet::BloomFilter> filter;
+
+    try
+    {
+        if (metadata->RowGroup(rowGroupId)->ColumnChunk(column)->bloom_filter_offset())
+        {
+            const auto rowGroupReader =
+                getPageFileReader()->GetBloomFilterReader().RowGroup(rowGroupId);
+            if (rowGroupReader)
+                filter = rowGroupReader->GetColumnBloomFilter(column);
+        }
+    }
+    catch (std::exception &e)
+    {
+        elog(DEBUG1, "parquet_fdw: failed to read bloom filter of file %s: %s",
+             parquetFilePath.c_str(), e.what());
+    }
+
+    return bloomFilters.emplace(key, std::move(filter)).first->second.get();
+}
+#endif
+
 bool ParquetFdwReader::next(TupleTableSlot *slot, bool fake)
 {
     if (!allocator)
@@ -97,6 +535,7 @@ bool ParquetFdwReader::next(TupleTableSlot *slot, bool fake)
 
     this->populate_slot(slot, fake);
     this->row++;
+    skipUnselectedRows();
 
     return true;
 }
@@ -112,14 +551,25 @@ bool ParquetFdwReader::next(TupleTableSlot *slot, bool fake)
 void ParquetFdwReader::populate_slot(TupleTableSlot *slot, bool fake)
 {
     std::memset(slot->tts_isnull, 1, sizeof(bool) * slot->tts_tupleDescriptor->natts);
-    /* Fill slot values */
-    for (int attr = 0; attr < slot->tts_tupleDescriptor->natts; attr++)
+    /* Fill slot values, the ones after the columns are computed by the scan */
+    for (int attr = 0; attr < (int)columnChunks.size(); attr++)
     {
+        if (!attrEmitList.empty() && !attrEmitList[attr])
+            continue;
+
+        if (!partitionValues.empty() && columnMap[attr] < 0)
+        {
+            slot->tts_values[attr] = partitionValues[attr];
+            slot->tts_isnull[attr] = partitionNulls[attr];
+            continue;
+        }
+
         const auto& columnChunk = columnChunks[attr];
         if (columnChunk.array == nullptr || (columnChunk.hasNulls && columnChunk.array->IsNull(row)))
             continue;
 
-        slot->tts_values[attr] = this->read_primitive_type(columnChunk.array, columnTypes[attr], row);
+        const auto typeId      = columnTypes[columnIndex(attr)];
+        slot->tts_values[attr] = this->read_primitive_type(columnChunk.array, typeId, row);
         slot->tts_isnull[attr] = false;
     }
 }
@@ -240,8 +690,16 @@ void ParquetFdwReader::validateSchema(TupleDesc tupleDesc) const
     {
         const auto attr             = tupleDesc->attrs[numAttr];
         const auto expectedPgTypeId = attr.atttypid;
+        const int  column           = columnIndex(numAttr);
+
+        /* Partition columns are taken from the file path */
+        if (column < 0)
+            continue;
+
+        if (column >= schema->num_fields())
+            throw Error("Column '%s' not found in parquet file.", NameStr(attr.attname));
 
-        const auto field       = schema->field(numAttr);
+        const auto field       = schema->field(column);
         const auto arrowTypeId = field->type()->id();
         const auto pgTypeId    = FilterPushdown::arrowTypeToPostgresType(arrowTypeId);
 
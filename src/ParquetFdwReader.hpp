@@ -4,15 +4,31 @@
 #include "arrow/array.h"
 #include "parquet/arrow/reader.h"
 #include "parquet/arrow/schema.h"
+#include "parquet/column_page.h"
+#include "parquet/column_reader.h"
 #include "parquet/file_reader.h"
 #include "parquet/statistics.h"
 
+#include "Misc.hpp"
+
+#ifdef PARQUET_FDW_PAGE_INDEX
+#    include "parquet/page_index.h"
+#endif
+#ifdef PARQUET_FDW_BLOOM_FILTER
+/* Arrow logging macros refer to FATAL which elog.h may have defined already */
+#    pragma push_macro("FATAL")
+#    undef FATAL
+#    include "parquet/bloom_filter.h"
+#    include "parquet/bloom_filter_reader.h"
+#    pragma pop_macro("FATAL")
+#endif
+
 #include <atomic>
 #include <filesystem>
+#include <map>
 #include <set>
 
 #include "FastAllocator.hpp"
-#include "Misc.hpp"
 #include "ReadCoordinator.hpp"
 #include "FilterPushdown.hpp"
 #include "utils/palloc.h"
@@ -64,10 +80,34 @@ private:
 
     std::vector<PgTypeInfo> pg_types;
 
+    /* Parquet column index of each attribute, -1 for hive partition columns */
+    std::vector<int> columnMap;
+
+    /* Values of hive partition columns parsed from the file path */
+    std::vector<Datum> partitionValues;
+    std::vector<bool>  partitionNulls;
+
+    /* Attributes put into slots, all the read ones if empty */
+    std::vector<bool> attrEmitList;
+
     int                    row_group;  /* current row group index */
     uint32_t               row;        /* current row within row group */
     uint32_t               num_rows;   /* total rows in row group */
 
+    /* Rows of the buffered row group to read, all of them if empty */
+    tRowRanges rowRanges;
+    size_t     rowRange;
+
+    /* Column chunks whose values were taken from their statistics */
+    uint64_t numScalarChunks = 0;
+
+    bool chunkScalar(int rowGroupId, int column, std::shared_ptr<arrow::Scalar> *scalar);
+    static std::shared_ptr<arrow::Array> scalarArray(const arrow::Scalar &scalar, int64_t length);
+
+    void skipUnselectedRows();
+    void bufferFirstRows(const int32_t rowGroupId, TupleDesc tupleDesc,
+        const std::vector<bool>& attrUseList, int64_t maxRows);
+
     /* Wether object is properly initialized */
     // bool initialized;
 
@@ -80,6 +120,18 @@ private:
     std::unique_ptr<parquet::arrow::FileReader> getFileReader() const;
     std::unique_ptr<parquet::arrow::FileReader> fileReader;
 
+#ifdef PARQUET_FDW_BLOOM_FILTER
+    /*
+     * Bloom filters by row group and column, loaded on first use and kept for
+     * the lifetime of the reader (nullptr if the column chunk has none).
+     */
+    mutable std::map<std::pair<int, int>, std::unique_ptr<parquet::BloomFilter>> bloomFilters;
+#endif
+
+    /* Low level reader for bloom filters and dictionary pages */
+    mutable std::unique_ptr<parquet::ParquetFileReader> pageFileReader;
+    parquet::ParquetFileReader *getPageFileReader() const;
+
 public:
 
     ParquetFdwReader(const char* parquetFilePath);
@@ -90,8 +142,12 @@ public:
             allocator.release();
     }
 
+    /*
+     * Read the used columns of the row group, only as many of its first
+     * rows as maxRows if that is not negative
+     */
     void bufferRowGroup(const int32_t rowGroupId, TupleDesc tupleDesc,
-        const std::vector<bool>& attrUseList);
+        const std::vector<bool>& attrUseList, int64_t maxRows = -1);
 
     bool  next(TupleTableSlot *slot, bool fake = false);
     void  populate_slot(TupleTableSlot *slot, bool fake = false);
@@ -137,6 +193,31 @@ public:
         return row >= num_rows;
     }
 
+    /* Row of the buffered row group next() returns next */
+    uint32_t getRow() const {
+        return row;
+    }
+
+    uint32_t getBufferedNumRows() const {
+        return num_rows;
+    }
+
+    /* Buffered column of the attribute, nullptr if it isn't read */
+    const arrow::Array *getColumnArray(const int attIdx) const {
+        return columnChunks[attIdx].array;
+    }
+
+    /* Value of the hive partition column taken from the file path */
+    Datum getPartitionValue(const int attIdx, bool *isnull) const {
+        *isnull = partitionNulls.empty() || partitionNulls[attIdx];
+        return *isnull ? (Datum)0 : partitionValues[attIdx];
+    }
+
+    /* Number of column chunks read from statistics instead of data pages */
+    uint64_t getNumScalarChunks() const {
+        return numScalarChunks;
+    }
+
     bool finishedReadingTable() const {
         return finishedReadingRowGroup();
     }
@@ -145,6 +226,10 @@ public:
         return numRowGroups;
     }
 
+    const std::string &getPath() const {
+        return parquetFilePath;
+    }
+
     auto getRowGroup(const size_t rowGroupId) const {
         return metadata->RowGroup(rowGroupId);
     }
@@ -167,6 +252,55 @@ public:
         return totalSize;
     }
 
+    /*
+     * columnIndex
+     *      Parquet column index of the attribute or -1 if the attribute is a
+     *      hive partition column not stored in the file.
+     */
+    int columnIndex(const int attIdx) const {
+        return columnMap.empty() ? attIdx : columnMap[attIdx];
+    }
+
+    void setPartitionAttrs(const std::vector<bool>& isPartitionAttr);
+    void setPartitionValues(const Datum *values, const bool *isnull);
+
+    /* Leave the values of the other attributes out of slots */
+    void setAttrEmitList(const std::vector<bool> &emitList) {
+        attrEmitList = emitList;
+    }
+
+    /* Read only the given rows of the buffered row group */
+    void setRowRanges(const tRowRanges &ranges);
+
+#ifdef PARQUET_FDW_PAGE_INDEX
+    /* Column and offset indexes of the row group, nullptr if there are none */
+    std::shared_ptr<parquet::RowGroupPageIndexReader> getPageIndex(int rowGroupId);
+
+    /* Number of pages of the used columns with no rows within the ranges */
+    size_t countSkippedPages(int rowGroupId, const tRowRanges &ranges,
+                             const std::vector<bool> &attrUseList);
+#endif
+
+    /* Whether all the data pages of the column chunk are dictionary encoded */
+    bool isDictionaryEncoded(int rowGroupId, int column) const;
+
+    /*
+     * Dictionary page of the column chunk if all of its data pages are
+     * dictionary encoded, nullptr otherwise
+     */
+    std::shared_ptr<parquet::DictionaryPage> getDictionaryPage(int rowGroupId, int column) const;
+
+    /*
+     * Parquet column the rows of every row group are sorted by in ascending
+     * order according to the file metadata, -1 if there is none
+     */
+    int sortingColumn() const;
+
+#ifdef PARQUET_FDW_BLOOM_FILTER
+    /* Bloom filter of the column chunk, nullptr if there is none */
+    const parquet::BloomFilter *getBloomFilter(int rowGroupId, int column) const;
+#endif
+
     void setMemoryContext(MemoryContext cxt);
     void validateSchema(TupleDesc tupleDesc) const;
     void schemaMustBeEqual(const std::shared_ptr<arrow::Schema> otherSchema) const;
@@ -175,5 +309,6 @@ public:
         columnChunks.clear();
         if (fileReader)
             fileReader.reset();
+        pageFileReader.reset();
     }
 };
@@ -0,0 +1,168 @@
+#include "PlanPayload.hpp"
+
+#include <unordered_map>
+
+#include "Error.hpp"
+
+extern "C" {
+#include "catalog/pg_type.h"
+#include "nodes/makefuncs.h"
+#include "utils/builtins.h"
+}
+
+void PlanPayload::writeVarint(std::string &buf, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        buf.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    buf.push_back((char)value);
+}
+
+void PlanPayload::writeString(std::string &buf, const char *str, size_t len)
+{
+    writeVarint(buf, len);
+    buf.append(str, len);
+}
+
+uint64_t PlanPayload::readVarint(const char *&pos, const char *end)
+{
+    uint64_t value = 0;
+
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (pos >= end)
+            break;
+
+        const uint8_t byte = (uint8_t)*pos++;
+
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+
+    throw Error("corrupted plan payload");
+}
+
+std::string PlanPayload::readString(const char *&pos, const char *end)
+{
+    const uint64_t len = readVarint(pos, end);
+
+    if (len > (uint64_t)(end - pos))
+        throw Error("corrupted plan payload");
+
+    std::string res(pos, len);
+    pos += len;
+
+    return res;
+}
+
+Const *PlanPayload::encode(List *filenames, List *rowGroupsToSkip)
+{
+    std::unordered_map<std::string, uint64_t> dirIds;
+    std::string                               dirs;
+    std::string                               files;
+    ListCell *                                lc;
+    ListCell *                                lc2;
+    std::string                               buf;
+    bytea *                                   res;
+
+    if (rowGroupsToSkip != NIL && list_length(filenames) != list_length(rowGroupsToSkip))
+        throw Error("filenames count does not match skiplist count");
+
+    lc2 = list_head(rowGroupsToSkip);
+    foreach (lc, filenames)
+    {
+        const char *filename = strVal((Value *)lfirst(lc));
+        const char *sep      = strrchr(filename, '/');
+        const auto  dirLen   = sep ? (size_t)(sep - filename + 1) : 0;
+        const auto  dir      = std::string(filename, dirLen);
+        auto        it       = dirIds.find(dir);
+
+        if (it == dirIds.end())
+        {
+            it = dirIds.emplace(dir, dirIds.size()).first;
+            writeString(dirs, dir.data(), dir.size());
+        }
+
+        writeVarint(files, it->second);
+        writeString(files, filename + dirLen, strlen(filename + dirLen));
+
+        if (rowGroupsToSkip != NIL)
+        {
+            List *    skipList = (List *)lfirst(lc2);
+            ListCell *lc3;
+            int32_t   prev = 0;
+
+            writeVarint(files, list_length(skipList));
+            foreach (lc3, skipList)
+            {
+                writeVarint(files, lfirst_int(lc3) - prev);
+                prev = lfirst_int(lc3);
+            }
+#if PG_VERSION_NUM < 130000
+            lc2 = lnext(lc2);
+#else
+            lc2 = lnext(rowGroupsToSkip, lc2);
+#endif
+        }
+    }
+
+    writeVarint(buf, rowGroupsToSkip != NIL ? PAYLOAD_HAS_SKIP_LISTS : 0);
+    writeVarint(buf, dirIds.size());
+    buf.append(dirs);
+    writeVarint(buf, list_length(filenames));
+    buf.append(files);
+
+    res = (bytea *)palloc(VARHDRSZ + buf.size());
+    SET_VARSIZE(res, VARHDRSZ + buf.size());
+    memcpy(VARDATA(res), buf.data(), buf.size());
+
+    return makeConst(BYTEAOID, -1, InvalidOid, -1, PointerGetDatum(res), false, false);
+}
+
+std::vector<PlanPayload::File> PlanPayload::decode(const Const *payload)
+{
+    const bytea *            data = DatumGetByteaPP(payload->constvalue);
+    const char *             pos  = VARDATA_ANY(data);
+    const char *             end  = pos + VARSIZE_ANY_EXHDR(data);
+    std::vector<std::string> dirs;
+    std::vector<File>        files;
+
+    const uint64_t flags   = readVarint(pos, end);
+    const uint64_t numDirs = readVarint(pos, end);
+
+    for (uint64_t i = 0; i < numDirs; ++i)
+        dirs.push_back(readString(pos, end));
+
+    const uint64_t numFiles = readVarint(pos, end);
+    files.reserve(numFiles);
+
+    for (uint64_t i = 0; i < numFiles; ++i)
+    {
+        File           file;
+        const uint64_t dirId = readVarint(pos, end);
+
+        if (dirId >= dirs.size())
+            throw Error("corrupted plan payload");
+
+        file.path = dirs[dirId] + readString(pos, end);
+
+        if (flags & PAYLOAD_HAS_SKIP_LISTS)
+        {
+            const uint64_t numSkipped = readVarint(pos, end);
+            int32_t        rowGroup   = 0;
+
+            for (uint64_t j = 0; j < numSkipped; ++j)
+            {
+                rowGroup += (int32_t)readVarint(pos, end);
+                file.rowGroupsToSkip.push_back(rowGroup);
+            }
+        }
+
+        files.push_back(std::move(file));
+    }
+
+    return files;
+}
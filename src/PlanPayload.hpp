@@ -0,0 +1,67 @@
+#pragma once
+
+#if __cplusplus > 199711L
+#    define register // Deprecated in C++11.
+#endif               // #if __cplusplus > 199711L
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "postgres.h"
+
+#include "nodes/pg_list.h"
+#include "nodes/primnodes.h"
+}
+
+/*
+ * PlanPayload
+ *      Compact binary encoding of the per-file part of the plan state.
+ *
+ * Postgres copies fdw_private on plan caching and serializes it for every
+ * parallel worker. A List of String nodes with nested Lists of skipped row
+ * groups grows to tens of megabytes for large file sets, so the file list is
+ * packed into a single bytea Const instead:
+ *
+ *      varint   flags
+ *      varint   number of directories
+ *      string   directory (repeated)
+ *      varint   number of files
+ *      {
+ *          varint   directory index
+ *          string   file name
+ *          varint   number of skipped row groups   (if PAYLOAD_HAS_SKIP_LISTS)
+ *          varint   skipped row group delta        (repeated)
+ *      }
+ *
+ * where string is a varint length followed by the bytes and row group numbers
+ * are stored as deltas from the previous one.
+ */
+class PlanPayload
+{
+public:
+    struct File
+    {
+        std::string          path;
+        std::vector<int32_t> rowGroupsToSkip;
+    };
+
+private:
+    enum
+    {
+        PAYLOAD_HAS_SKIP_LISTS = 0x01
+    };
+
+    static void     writeVarint(std::string &buf, uint64_t value);
+    static void     writeString(std::string &buf, const char *str, size_t len);
+    static uint64_t readVarint(const char *&pos, const char *end);
+    static std::string readString(const char *&pos, const char *end);
+
+public:
+    /* Pack file names and optional row group skip lists into bytea Const */
+    static Const *encode(List *filenames, List *rowGroupsToSkip);
+
+    /* Unpack the payload created by encode() */
+    static std::vector<File> decode(const Const *payload);
+};
@@ -0,0 +1,148 @@
+#include <algorithm>
+
+#include "TopNRows.hpp"
+
+extern "C" {
+#include "utils/memutils.h"
+}
+
+TopNRows::TopNRows(MemoryContext                       cxt,
+                   TupleDesc                           tupleDesc,
+                   const std::vector<SortSupportData> &keys,
+                   int64_t                             count,
+                   int64_t                             offset)
+    : cxt(cxt), keys(keys), bound(count + offset), offset(offset), values(keys.size())
+{
+    isnull = (bool *)palloc(sizeof(bool) * keys.size());
+#if PG_VERSION_NUM < 120000
+    rowSlot = MakeSingleTupleTableSlot(tupleDesc);
+#else
+    rowSlot = MakeSingleTupleTableSlot(tupleDesc, &TTSOpsMinimalTuple);
+#endif
+}
+
+int TopNRows::compare(const Datum *values1, const bool *isnull1, const Datum *values2,
+                      const bool *isnull2) const
+{
+    for (size_t k = 0; k < keys.size(); ++k)
+    {
+        const int cmp = ApplySortComparator(values1[k], isnull1[k], values2[k], isnull2[k],
+                                            const_cast<SortSupportData *>(&keys[k]));
+
+        if (cmp != 0)
+            return cmp;
+    }
+
+    return 0;
+}
+
+/*
+ * storeRow
+ *      Copy the row into the memory of the kept rows and point the values of
+ *      its keys to the copy.
+ */
+void TopNRows::storeRow(Row &row, TupleTableSlot *slot)
+{
+    MemoryContext oldcxt = MemoryContextSwitchTo(cxt);
+
+    row.tuple = ExecCopySlotMinimalTuple(slot);
+    if (!row.values)
+    {
+        row.values = (Datum *)palloc(sizeof(Datum) * keys.size());
+        row.isnull = (bool *)palloc(sizeof(bool) * keys.size());
+    }
+    MemoryContextSwitchTo(oldcxt);
+
+    ExecStoreMinimalTuple(row.tuple, rowSlot, false);
+    for (size_t k = 0; k < keys.size(); ++k)
+        row.values[k] = slot_getattr(rowSlot, keys[k].ssup_attno, &row.isnull[k]);
+    ExecClearTuple(rowSlot);
+}
+
+bool TopNRows::add(TupleTableSlot *slot)
+{
+    const auto before = [this](const Row &row1, const Row &row2) {
+        return compare(row1.values, row1.isnull, row2.values, row2.isnull) < 0;
+    };
+    Row row = { nullptr, nullptr, nullptr };
+
+    if (bound == 0)
+        return false;
+
+    for (size_t k = 0; k < keys.size(); ++k)
+    {
+        const int attIdx = keys[k].ssup_attno - 1;
+
+        values[k] = slot->tts_values[attIdx];
+        isnull[k] = slot->tts_isnull[attIdx];
+    }
+
+    if (rows.size() == bound)
+    {
+        if (compare(values.data(), isnull, rows.front().values, rows.front().isnull) >= 0)
+            return false;
+
+        /* The new row replaces the last one */
+        std::pop_heap(rows.begin(), rows.end(), before);
+        row = rows.back();
+        rows.pop_back();
+        pfree(row.tuple);
+    }
+
+    storeRow(row, slot);
+    rows.push_back(row);
+    std::push_heap(rows.begin(), rows.end(), before);
+
+    return true;
+}
+
+bool TopNRows::mayEnter(Datum value, bool valueIsNull) const
+{
+    if (bound == 0)
+        return false;
+    if (rows.size() < bound)
+        return true;
+
+    const Row &last = rows.front();
+    const int  cmp  = ApplySortComparator(value, valueIsNull, last.values[0], last.isnull[0],
+                                          const_cast<SortSupportData *>(&keys[0]));
+
+    /* Rows equal in the first key may still come first by the others */
+    return cmp < 0 || (cmp == 0 && keys.size() > 1);
+}
+
+void TopNRows::sort()
+{
+    std::sort_heap(rows.begin(), rows.end(), [this](const Row &row1, const Row &row2) {
+        return compare(row1.values, row1.isnull, row2.values, row2.isnull) < 0;
+    });
+    sorted  = true;
+    nextRow = offset;
+}
+
+/*
+ * next
+ *      Put the values of the next row into the slot. They point into the
+ *      kept row, which lives until the rows are reset.
+ */
+bool TopNRows::next(TupleTableSlot *slot)
+{
+    if (!sorted || nextRow >= rows.size())
+        return false;
+
+    ExecStoreMinimalTuple(rows[nextRow++].tuple, rowSlot, false);
+    slot_getallattrs(rowSlot);
+    memcpy(slot->tts_values, rowSlot->tts_values, sizeof(Datum) * slot->tts_tupleDescriptor->natts);
+    memcpy(slot->tts_isnull, rowSlot->tts_isnull, sizeof(bool) * slot->tts_tupleDescriptor->natts);
+    ExecClearTuple(rowSlot);
+
+    return true;
+}
+
+void TopNRows::reset()
+{
+    rows.clear();
+    sorted  = false;
+    nextRow = 0;
+    MemoryContextReset(cxt);
+}
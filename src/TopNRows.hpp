@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+
+extern "C" {
+#include "postgres.h"
+#include "access/tupdesc.h"
+#include "executor/tuptable.h"
+#include "utils/palloc.h"
+#include "utils/sortsupport.h"
+}
+
+/*
+ * TopNRows
+ *      The first rows in the order of the sort keys, kept in a bounded heap
+ *      with the last of them on top. Rows are only copied if they enter the
+ *      heap, so that most of the rows of a large input are passed over after
+ *      comparing their keys with the top.
+ *
+ * The first offset rows are kept as well and skipped when the rows are
+ * returned.
+ */
+class TopNRows
+{
+private:
+    struct Row
+    {
+        MinimalTuple tuple;
+        Datum *      values; /* of the sort keys, pointing into the tuple */
+        bool *       isnull;
+    };
+
+    MemoryContext                cxt; /* for the kept rows */
+    std::vector<SortSupportData> keys;
+    size_t                       bound;
+    size_t                       offset;
+    TupleTableSlot *             rowSlot; /* to deform kept rows */
+
+    /* Keys of the row to add */
+    std::vector<Datum> values;
+    bool *             isnull;
+
+    std::vector<Row> rows;
+    bool             sorted  = false;
+    size_t           nextRow = 0;
+
+    int  compare(const Datum *values1, const bool *isnull1, const Datum *values2,
+                 const bool *isnull2) const;
+    void storeRow(Row &row, TupleTableSlot *slot);
+
+public:
+    TopNRows(MemoryContext                       cxt,
+             TupleDesc                           tupleDesc,
+             const std::vector<SortSupportData> &keys,
+             int64_t                             count,
+             int64_t                             offset);
+
+    /* Keep the row if it is one of the first ones, false otherwise */
+    bool add(TupleTableSlot *slot);
+
+    /* Whether a row with the value of the first key may be kept */
+    bool mayEnter(Datum value, bool valueIsNull) const;
+
+    /* Sort the kept rows, next() returns them afterwards */
+    void sort();
+
+    bool next(TupleTableSlot *slot);
+
+    /* Drop all the rows */
+    void reset();
+};
@@ -0,0 +1,764 @@
+#include <cmath>
+
+#include "VectorAggregates.hpp"
+#include "Error.hpp"
+#include "FilterPushdown.hpp"
+#include "PostgresErrors.hpp"
+
+extern "C" {
+#include "catalog/pg_type.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/date.h"
+#include "utils/datum.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+}
+
+VectorAggregates::VectorAggregates(MemoryContext                 cxt,
+                                   TupleDesc                     tupleDesc,
+                                   const std::vector<int> &      groupAttrs,
+                                   const std::vector<Aggregate> &aggregates,
+                                   bool                          partial)
+    : cxt(cxt), tupleDesc(tupleDesc), groupAttrs(groupAttrs), aggregates(aggregates), partial(partial)
+{
+    reset();
+}
+
+void VectorAggregates::reset()
+{
+    groupIds.clear();
+    keys.clear();
+    keyNulls.clear();
+    states.clear();
+    numGroups = 0;
+    MemoryContextReset(cxt);
+
+    /* Aggregates without grouping produce a row even for no input */
+    if (groupAttrs.empty())
+    {
+        states.resize(aggregates.size());
+        numGroups = 1;
+    }
+}
+
+/*
+ * to_postgres_date
+ *      Parquet dates count days since 1970-01-01, postgres ones since
+ *      2000-01-01.
+ */
+static inline int32_t to_postgres_date(int32_t days)
+{
+    return days + (UNIX_EPOCH_JDATE - POSTGRES_EPOCH_JDATE);
+}
+
+static inline int64_t timestamp_value(const arrow::Array *array, int64_t row)
+{
+    const auto tstype = (arrow::TimestampType *)array->type().get();
+    TimestampTz ts;
+
+    to_postgres_timestamp(tstype, ((const arrow::TimestampArray *)array)->Value(row), ts);
+    return ts;
+}
+
+/*
+ * append_key
+ *      Append the value of the column to the encoded group key. Values equal
+ *      for postgres are encoded the same way, timestamps of files written with
+ *      different precisions included.
+ */
+static void append_key(std::string &key, const arrow::Array *array, int64_t row)
+{
+    if (array->IsNull(row))
+    {
+        key.push_back('\0');
+        return;
+    }
+    key.push_back('\1');
+
+    switch (array->type_id())
+    {
+    case arrow::Type::BOOL:
+        key.push_back(((const arrow::BooleanArray *)array)->Value(row) ? '\1' : '\0');
+        break;
+    case arrow::Type::DATE32:
+        key.append((const char *)(array->data()->GetValues<int32_t>(1) + row), sizeof(int32_t));
+        break;
+    case arrow::Type::INT32:
+    {
+        /* Widened, files may differ in the integer width of the column */
+        const int64_t value = array->data()->GetValues<int32_t>(1)[row];
+
+        key.append((const char *)&value, sizeof(value));
+        break;
+    }
+    case arrow::Type::INT64:
+        key.append((const char *)(array->data()->GetValues<int64_t>(1) + row), sizeof(int64_t));
+        break;
+    case arrow::Type::TIMESTAMP:
+    {
+        const int64_t ts = timestamp_value(array, row);
+
+        key.append((const char *)&ts, sizeof(ts));
+        break;
+    }
+    case arrow::Type::STRING:
+    case arrow::Type::BINARY:
+    {
+        int32_t     len;
+        const char *value = (const char *)((const arrow::BinaryArray *)array)->GetValue(row, &len);
+
+        key.append((const char *)&len, sizeof(len));
+        key.append(value, len);
+        break;
+    }
+    default:
+        throw Error("unsupported type of group key: %d", array->type_id());
+    }
+}
+
+/*
+ * key_datum
+ *      Postgres value of a group key, allocated in the current memory context.
+ */
+static Datum key_datum(const arrow::Array *array, int64_t row, Oid type)
+{
+    switch (array->type_id())
+    {
+    case arrow::Type::BOOL:
+        return BoolGetDatum(((const arrow::BooleanArray *)array)->Value(row));
+    case arrow::Type::INT32:
+    case arrow::Type::INT64:
+    {
+        const int64_t value = array->type_id() == arrow::Type::INT32
+                                  ? ((const arrow::Int32Array *)array)->Value(row)
+                                  : ((const arrow::Int64Array *)array)->Value(row);
+
+        return type == INT4OID ? Int32GetDatum((int32)value) : Int64GetDatum(value);
+    }
+    case arrow::Type::DATE32:
+        if (type != DATEOID)
+            break;
+        return DateADTGetDatum(to_postgres_date(((const arrow::Date32Array *)array)->Value(row)));
+    case arrow::Type::TIMESTAMP:
+        if (type != TIMESTAMPOID)
+            break;
+        return TimestampGetDatum(timestamp_value(array, row));
+    case arrow::Type::STRING:
+    case arrow::Type::BINARY:
+    {
+        int32_t     len;
+        const char *value = (const char *)((const arrow::BinaryArray *)array)->GetValue(row, &len);
+        bytea *     result = (bytea *)exc_palloc(len + VARHDRSZ);
+
+        SET_VARSIZE(result, len + VARHDRSZ);
+        memcpy(VARDATA(result), value, len);
+        return PointerGetDatum(result);
+    }
+    default:
+        break;
+    }
+
+    throw Error("unsupported type of group key: %d", array->type_id());
+}
+
+/*
+ * addGroup
+ *      Add a group for the key of the row, the encoded one is in `key`.
+ */
+uint32_t VectorAggregates::addGroup(const ParquetFdwReader &reader, uint32_t row)
+{
+    MemoryContext oldcxt = MemoryContextSwitchTo(cxt);
+
+    try
+    {
+        for (const int attIdx : groupAttrs)
+        {
+            Datum value;
+            bool  isnull;
+
+            if (reader.columnIndex(attIdx) < 0)
+            {
+                const auto attr = TupleDescAttr(tupleDesc, attIdx);
+
+                value = reader.getPartitionValue(attIdx, &isnull);
+                if (!isnull)
+                    value = CatchAndRethrow([&]() { return datumCopy(value, attr->attbyval, attr->attlen); });
+            }
+            else
+            {
+                const arrow::Array *array = reader.getColumnArray(attIdx);
+
+                isnull = array->IsNull(row);
+                value  = isnull ? (Datum)0 : key_datum(array, row, TupleDescAttr(tupleDesc, attIdx)->atttypid);
+            }
+
+            keys.push_back(value);
+            keyNulls.push_back(isnull);
+        }
+    }
+    catch (...)
+    {
+        MemoryContextSwitchTo(oldcxt);
+        throw;
+    }
+    MemoryContextSwitchTo(oldcxt);
+
+    groupIds.emplace(key, numGroups);
+    states.resize(states.size() + aggregates.size());
+    return numGroups++;
+}
+
+/*
+ * append_datum_key
+ *      Append a postgres value of the column to the encoded group key, the
+ *      same way append_key encodes the arrow one.
+ */
+static void append_datum_key(std::string &key, Datum value, Oid type)
+{
+    key.push_back('\1');
+
+    switch (type)
+    {
+    case INT4OID:
+    {
+        const int64_t v = DatumGetInt32(value);
+
+        key.append((const char *)&v, sizeof(v));
+        break;
+    }
+    case INT8OID:
+    case TIMESTAMPOID:
+    {
+        const int64_t v = DatumGetInt64(value);
+
+        key.append((const char *)&v, sizeof(v));
+        break;
+    }
+    case DATEOID:
+    {
+        const int32_t days = DatumGetDateADT(value) - (UNIX_EPOCH_JDATE - POSTGRES_EPOCH_JDATE);
+
+        key.append((const char *)&days, sizeof(days));
+        break;
+    }
+    case TEXTOID:
+    case BYTEAOID:
+    {
+        const int32_t len = VARSIZE_ANY_EXHDR(DatumGetPointer(value));
+
+        key.append((const char *)&len, sizeof(len));
+        key.append(VARDATA_ANY(DatumGetPointer(value)), len);
+        break;
+    }
+    default:
+        throw Error("unsupported type of group key: %u", type);
+    }
+}
+
+/*
+ * addKeyGroup
+ *      Add a group for the value of the only group key, the encoded one is in
+ *      `key`.
+ */
+void VectorAggregates::addKeyGroup(Datum value, bool isnull)
+{
+    const auto attr = TupleDescAttr(tupleDesc, groupAttrs.front());
+
+    if (!isnull)
+    {
+        MemoryContext oldcxt = MemoryContextSwitchTo(cxt);
+
+        value = CatchAndRethrow([&]() { return datumCopy(value, attr->attbyval, attr->attlen); });
+        MemoryContextSwitchTo(oldcxt);
+    }
+
+    keys.push_back(value);
+    keyNulls.push_back(isnull);
+    groupIds.emplace(key, numGroups);
+    states.resize(states.size() + aggregates.size());
+    numGroups++;
+}
+
+bool VectorAggregates::addDictionary(const ParquetFdwReader &reader, int rowGroupId)
+{
+    if (!aggregates.empty() || groupAttrs.size() != 1)
+        return false;
+
+    const int attIdx      = groupAttrs.front();
+    const int columnIndex = reader.columnIndex(attIdx);
+
+    if (columnIndex < 0)
+        return false;
+
+    /* The dictionary has no NULLs, the statistics tell whether there are some */
+    const auto stats = reader.getRowGroup(rowGroupId)->ColumnChunk(columnIndex)->statistics();
+    if (!stats || !stats->HasNullCount())
+        return false;
+
+    /* Decoded dictionaries are dropped along with the filter */
+    MemoryContext dictCxt = AllocSetContextCreate(cxt, "parquet_fdw dictionary", ALLOCSET_DEFAULT_SIZES);
+    MemoryContext oldcxt  = MemoryContextSwitchTo(dictCxt);
+    bool          found   = false;
+
+    try
+    {
+        FilterPushdown            filter(reader.getNumRowGroups());
+        const std::vector<Datum> *values;
+        Oid                       type;
+
+        MemoryContextSwitchTo(oldcxt);
+
+        found = filter.dictionaryValues(reader, attIdx, rowGroupId, &type, &values)
+                && type == TupleDescAttr(tupleDesc, attIdx)->atttypid;
+
+        for (size_t i = 0; found && i < values->size(); ++i)
+        {
+            key.clear();
+            append_datum_key(key, (*values)[i], type);
+            if (groupIds.find(key) == groupIds.end())
+                addKeyGroup((*values)[i], false);
+        }
+
+        if (found && stats->null_count() > 0)
+        {
+            key.assign(1, '\0');
+            if (groupIds.find(key) == groupIds.end())
+                addKeyGroup((Datum)0, true);
+        }
+    }
+    catch (...)
+    {
+        MemoryContextSwitchTo(oldcxt);
+        MemoryContextDelete(dictCxt);
+        throw;
+    }
+    MemoryContextDelete(dictCxt);
+
+    return found;
+}
+
+/*
+ * assignGroups
+ *      Find the group of each of the rows, adding new ones as needed. Hive
+ *      partition columns are the same for the whole file, so their part of
+ *      the key is only encoded once.
+ */
+void VectorAggregates::assignGroups(const ParquetFdwReader &reader, const std::vector<uint32_t> &rows)
+{
+    std::vector<const arrow::Array *> columns;
+    std::string                       prefix;
+    std::string                       lastKey;
+    uint32_t                          lastGroup = 0;
+
+    rowGroups.resize(rows.size());
+
+    if (groupAttrs.empty())
+    {
+        std::fill(rowGroups.begin(), rowGroups.end(), 0);
+        return;
+    }
+
+    for (const int attIdx : groupAttrs)
+    {
+        if (reader.columnIndex(attIdx) >= 0)
+        {
+            columns.push_back(reader.getColumnArray(attIdx));
+            if (!columns.back())
+                throw Error("group key column %d is not read", attIdx + 1);
+            continue;
+        }
+
+        const auto attr  = TupleDescAttr(tupleDesc, attIdx);
+        bool       isnull;
+        Datum      value = reader.getPartitionValue(attIdx, &isnull);
+
+        prefix.push_back(isnull ? '\0' : '\1');
+        if (isnull)
+            continue;
+        if (attr->attbyval)
+            prefix.append((const char *)&value, sizeof(Datum));
+        else
+            prefix.append(DatumGetPointer(value), datumGetSize(value, false, attr->attlen));
+    }
+
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        key.assign(prefix);
+        for (const auto column : columns)
+            append_key(key, column, rows[i]);
+
+        /* Runs of equal keys are common in sorted and partitioned data */
+        if (i > 0 && key == lastKey)
+        {
+            rowGroups[i] = lastGroup;
+            continue;
+        }
+
+        const auto it = groupIds.find(key);
+
+        lastGroup    = it != groupIds.end() ? it->second : addGroup(reader, rows[i]);
+        lastKey      = key;
+        rowGroups[i] = lastGroup;
+    }
+}
+
+/*
+ * for_each_value
+ *      Call the function with the group and the value of each non-null row.
+ */
+template <typename T, typename Function>
+static inline void for_each_value(const arrow::Array *          array,
+                                  const std::vector<uint32_t> &rows,
+                                  const std::vector<uint32_t> &groups,
+                                  Function                     fun)
+{
+    const T *values = array->data()->GetValues<T>(1);
+
+    if (array->null_count() == 0)
+    {
+        for (size_t i = 0; i < rows.size(); ++i)
+            fun(groups[i], values[rows[i]]);
+    }
+    else
+    {
+        for (size_t i = 0; i < rows.size(); ++i)
+        {
+            if (!array->IsNull(rows[i]))
+                fun(groups[i], values[rows[i]]);
+        }
+    }
+}
+
+/* Floating point comparison of postgres, NaN is greater than anything else */
+static inline bool float_less(double a, double b)
+{
+    if (std::isnan(a))
+        return false;
+    return std::isnan(b) || a < b;
+}
+
+/* Same overflow check as float8_pl and float4_pl */
+template <typename T>
+static inline T float_add(T a, T b)
+{
+    const T result = a + b;
+
+    if (unlikely(std::isinf(result)) && !std::isinf(a) && !std::isinf(b))
+        throw Error("value out of range: overflow");
+    return result;
+}
+
+void VectorAggregates::accumulate(size_t aggIdx, const arrow::Array *array, const std::vector<uint32_t> &rows)
+{
+    const Aggregate &agg    = aggregates[aggIdx];
+    const Oid        type   = agg.attIdx >= 0 ? TupleDescAttr(tupleDesc, agg.attIdx)->atttypid : InvalidOid;
+    const size_t     stride = aggregates.size();
+    State *const     base   = states.data() + aggIdx;
+
+    const auto isum = [&](uint32_t group, auto value) {
+        State &state = base[group * stride];
+
+        state.count++;
+        state.isum += value;
+    };
+
+    const auto float4sum = [&](uint32_t group, float value) {
+        State &state = base[group * stride];
+
+        state.count++;
+        state.fsum = float_add(state.fsum, value);
+    };
+
+    const auto float8sum = [&](uint32_t group, double value) {
+        State &state = base[group * stride];
+
+        state.count++;
+        state.dsum = float_add(state.dsum, value);
+    };
+
+    /* Youngs-Cramer algorithm, the same as float8_accum */
+    const auto favg = [&](uint32_t group, auto value) {
+        State &      state  = base[group * stride];
+        const double newval = value;
+        const double N      = state.count + 1.0;
+        const double Sx     = state.dsum + newval;
+
+        if (state.count > 0)
+        {
+            const double tmp = newval * N - Sx;
+
+            state.sxx += tmp * tmp / (N * state.count);
+            if (std::isinf(Sx) || std::isinf(state.sxx))
+            {
+                if (!std::isinf(state.dsum) && !std::isinf(newval))
+                    throw Error("value out of range: overflow");
+                state.sxx = std::nan("");
+            }
+        }
+        else if (std::isnan(newval) || std::isinf(newval))
+            state.sxx = std::nan("");
+
+        state.count++;
+        state.dsum = Sx;
+    };
+
+    const bool isMin = agg.kind == AGG_MIN;
+
+    const auto imin_max = [&](uint32_t group, int64_t value) {
+        State &state = base[group * stride];
+
+        if (state.count++ == 0 || (isMin ? value < state.ivalue : value > state.ivalue))
+            state.ivalue = value;
+    };
+
+    const auto fmin_max = [&](uint32_t group, double value) {
+        State &state = base[group * stride];
+
+        if (state.count++ == 0
+            || (isMin ? float_less(value, state.dvalue) : float_less(state.dvalue, value)))
+            state.dvalue = value;
+    };
+
+    if (agg.kind == AGG_COUNT_STAR)
+    {
+        for (const uint32_t group : rowGroups)
+            base[group * stride].count++;
+        return;
+    }
+
+    if (!array)
+        throw Error("aggregated column %d is not read", agg.attIdx + 1);
+
+    switch (agg.kind)
+    {
+    case AGG_COUNT:
+        for (size_t i = 0; i < rows.size(); ++i)
+        {
+            if (!array->IsNull(rows[i]))
+                base[rowGroups[i] * stride].count++;
+        }
+        return;
+
+    case AGG_SUM:
+    case AGG_AVG:
+        switch (array->type_id())
+        {
+        case arrow::Type::INT32:
+            return for_each_value<int32_t>(array, rows, rowGroups, isum);
+        case arrow::Type::INT64:
+            return for_each_value<int64_t>(array, rows, rowGroups, isum);
+        case arrow::Type::FLOAT:
+            if (agg.kind == AGG_AVG)
+                return for_each_value<float>(array, rows, rowGroups, favg);
+            if (type == FLOAT4OID)
+                return for_each_value<float>(array, rows, rowGroups, float4sum);
+            return for_each_value<float>(array, rows, rowGroups, float8sum);
+        case arrow::Type::DOUBLE:
+            if (agg.kind == AGG_AVG)
+                return for_each_value<double>(array, rows, rowGroups, favg);
+            /* The column is declared as float4, sum in its precision */
+            if (type == FLOAT4OID)
+                return for_each_value<double>(array, rows, rowGroups, [&](uint32_t group, double value) {
+                    float4sum(group, (float)value);
+                });
+            return for_each_value<double>(array, rows, rowGroups, float8sum);
+        default:
+            break;
+        }
+        break;
+
+    case AGG_MIN:
+    case AGG_MAX:
+        switch (array->type_id())
+        {
+        case arrow::Type::INT32:
+            return for_each_value<int32_t>(array, rows, rowGroups, imin_max);
+        case arrow::Type::DATE32:
+            if (type != DATEOID)
+                break;
+            return for_each_value<int32_t>(array, rows, rowGroups, [&](uint32_t group, int32_t value) {
+                imin_max(group, to_postgres_date(value));
+            });
+        case arrow::Type::INT64:
+            return for_each_value<int64_t>(array, rows, rowGroups, imin_max);
+        case arrow::Type::TIMESTAMP:
+        {
+            const auto tstype = (arrow::TimestampType *)array->type().get();
+
+            if (type != TIMESTAMPOID)
+                break;
+
+            return for_each_value<int64_t>(array, rows, rowGroups, [&](uint32_t group, int64_t value) {
+                TimestampTz ts;
+
+                to_postgres_timestamp(tstype, value, ts);
+                imin_max(group, ts);
+            });
+        }
+        case arrow::Type::FLOAT:
+            return for_each_value<float>(array, rows, rowGroups, fmin_max);
+        case arrow::Type::DOUBLE:
+            return for_each_value<double>(array, rows, rowGroups, fmin_max);
+        default:
+            break;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    throw Error("unsupported aggregate of column %d", agg.attIdx + 1);
+}
+
+void VectorAggregates::addRowGroup(const ParquetFdwReader &reader, const std::vector<uint32_t> &rows)
+{
+    assignGroups(reader, rows);
+
+    for (size_t i = 0; i < aggregates.size(); ++i)
+    {
+        const int attIdx = aggregates[i].attIdx;
+
+        accumulate(i, attIdx >= 0 ? reader.getColumnArray(attIdx) : nullptr, rows);
+    }
+}
+
+/*
+ * int128_numeric
+ *      Exact sum of integers as numeric.
+ */
+static Datum int128_numeric(__int128 value)
+{
+    char               buf[48];
+    char *             p   = buf + sizeof(buf);
+    const bool         neg = value < 0;
+    unsigned __int128  abs = neg ? -(unsigned __int128)value : (unsigned __int128)value;
+
+    *--p = '\0';
+    do
+    {
+        *--p = '0' + (int)(abs % 10);
+        abs /= 10;
+    } while (abs != 0);
+    if (neg)
+        *--p = '-';
+
+    return CatchAndRethrow([&]() {
+        return DirectFunctionCall3(numeric_in, CStringGetDatum(p), ObjectIdGetDatum(InvalidOid),
+                                   Int32GetDatum(-1));
+    });
+}
+
+/*
+ * result
+ *      Final value of the aggregate, or its transition state in partial mode.
+ *      Transition states are the ones of the aggregates in pg_aggregate:
+ *      int8 sums and counts, float4 or float8 sums, {N, sum} arrays for avg
+ *      of int4 and {N, Sx, Sxx} arrays for avg of floats.
+ */
+Datum VectorAggregates::result(size_t aggIdx, const State &state, bool *isnull) const
+{
+    const Aggregate &agg  = aggregates[aggIdx];
+    const Oid        type = agg.attIdx >= 0 ? TupleDescAttr(tupleDesc, agg.attIdx)->atttypid : InvalidOid;
+
+    *isnull = false;
+
+    if (agg.kind == AGG_COUNT_STAR || agg.kind == AGG_COUNT)
+        return Int64GetDatum(state.count);
+
+    if (agg.kind == AGG_AVG && partial)
+    {
+        if (type == INT4OID)
+        {
+            Datum values[2] = { Int64GetDatum(state.count), Int64GetDatum((int64)state.isum) };
+
+            return CatchAndRethrow([&]() {
+                return PointerGetDatum(construct_array(values, 2, INT8OID, sizeof(int64), FLOAT8PASSBYVAL, 'd'));
+            });
+        }
+
+        Datum values[3] = { Float8GetDatum((double)state.count), Float8GetDatum(state.dsum),
+                            Float8GetDatum(state.sxx) };
+
+        return CatchAndRethrow([&]() {
+            return PointerGetDatum(construct_array(values, 3, FLOAT8OID, sizeof(float8), FLOAT8PASSBYVAL, 'd'));
+        });
+    }
+
+    /* Aggregates of no non-null values are NULL */
+    if (state.count == 0)
+    {
+        *isnull = true;
+        return (Datum)0;
+    }
+
+    switch (agg.kind)
+    {
+    case AGG_SUM:
+        switch (type)
+        {
+        case INT4OID:
+            return Int64GetDatum((int64)state.isum);
+        case INT8OID:
+            return int128_numeric(state.isum);
+        case FLOAT4OID:
+            return Float4GetDatum(state.fsum);
+        case FLOAT8OID:
+            return Float8GetDatum(state.dsum);
+        }
+        break;
+
+    case AGG_AVG:
+        if (type == INT4OID || type == INT8OID)
+        {
+            const Datum sum = int128_numeric(state.isum);
+
+            return CatchAndRethrow([&]() {
+                return DirectFunctionCall2(numeric_div, sum,
+                                           DirectFunctionCall1(int8_numeric, Int64GetDatum(state.count)));
+            });
+        }
+        return Float8GetDatum(state.dsum / state.count);
+
+    case AGG_MIN:
+    case AGG_MAX:
+        switch (type)
+        {
+        case INT4OID:
+            return Int32GetDatum((int32)state.ivalue);
+        case DATEOID:
+            return DateADTGetDatum((DateADT)state.ivalue);
+        case INT8OID:
+            return Int64GetDatum(state.ivalue);
+        case TIMESTAMPOID:
+            return TimestampGetDatum(state.ivalue);
+        case FLOAT4OID:
+            return Float4GetDatum((float)state.dvalue);
+        case FLOAT8OID:
+            return Float8GetDatum(state.dvalue);
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    throw Error("unsupported aggregate of column %d", agg.attIdx + 1);
+}
+
+void VectorAggregates::getGroup(size_t group, const std::vector<int> &outputs, Datum *values, bool *nulls) const
+{
+    for (size_t i = 0; i < outputs.size(); ++i)
+    {
+        if (outputs[i] < 0)
+        {
+            const size_t key = group * groupAttrs.size() + (-1 - outputs[i]);
+
+            values[i] = keys[key];
+            nulls[i]  = keyNulls[key];
+        }
+        else
+            values[i] = result(outputs[i], states[group * aggregates.size() + outputs[i]], &nulls[i]);
+    }
+}
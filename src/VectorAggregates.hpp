@@ -0,0 +1,114 @@
+#pragma once
+
+#if __cplusplus > 199711L
+#    define register // Deprecated in C++11.
+#endif               // #if __cplusplus > 199711L
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ParquetFdwReader.hpp"
+
+extern "C" {
+#include "postgres.h"
+#include "access/tupdesc.h"
+#include "utils/palloc.h"
+}
+
+/*
+ * VectorAggregates
+ *      count, sum, avg, min and max computed over the Arrow arrays of whole
+ *      row groups instead of tuples. Rows are assigned to groups by a hash
+ *      table of their encoded key values first, then each aggregate is
+ *      accumulated in a loop over its column. Group keys may be columns of
+ *      the table or hive partition columns.
+ *
+ * In partial mode the transition states of the aggregates are returned
+ * instead of the final values, for Finalize Aggregate to combine the results
+ * of parallel workers.
+ */
+class VectorAggregates
+{
+public:
+    enum Kind
+    {
+        AGG_COUNT_STAR,
+        AGG_COUNT,
+        AGG_SUM,
+        AGG_AVG,
+        AGG_MIN,
+        AGG_MAX,
+    };
+
+    struct Aggregate
+    {
+        Kind kind;
+        int  attIdx; /* -1 for count(*) */
+    };
+
+private:
+    struct State
+    {
+        int64_t  count  = 0; /* rows, non-null ones for aggregates of columns */
+        __int128 isum   = 0;
+        double   dsum   = 0;
+        double   sxx    = 0; /* float avg transition state as in float8_accum */
+        float    fsum   = 0;
+        int64_t  ivalue = 0; /* min or max of integers, dates and timestamps */
+        double   dvalue = 0; /* min or max of floats */
+    };
+
+    MemoryContext          cxt; /* for values of group keys */
+    TupleDesc              tupleDesc;
+    std::vector<int>       groupAttrs;
+    std::vector<Aggregate> aggregates;
+    bool                   partial;
+
+    std::unordered_map<std::string, uint32_t> groupIds; /* by encoded keys */
+    std::vector<Datum>                        keys;     /* groupAttrs.size() per group */
+    std::vector<bool>                         keyNulls;
+    std::vector<State>                        states;   /* aggregates.size() per group */
+    size_t                                    numGroups = 0;
+
+    /* Reused between row groups */
+    std::vector<uint32_t> rowGroups;
+    std::string           key;
+
+    void     assignGroups(const ParquetFdwReader &reader, const std::vector<uint32_t> &rows);
+    uint32_t addGroup(const ParquetFdwReader &reader, uint32_t row);
+    void     addKeyGroup(Datum value, bool isnull);
+    void     accumulate(size_t aggIdx, const arrow::Array *array, const std::vector<uint32_t> &rows);
+    Datum    result(size_t aggIdx, const State &state, bool *isnull) const;
+
+public:
+    VectorAggregates(MemoryContext                 cxt,
+                     TupleDesc                     tupleDesc,
+                     const std::vector<int> &      groupAttrs,
+                     const std::vector<Aggregate> &aggregates,
+                     bool                          partial);
+
+    /* Aggregate the given rows of the row group buffered by the reader */
+    void addRowGroup(const ParquetFdwReader &reader, const std::vector<uint32_t> &rows);
+
+    /*
+     * Add the groups of all the rows of the row group without reading it,
+     * from the dictionary page of the only group key if there are no
+     * aggregates. Returns false if the rows have to be read.
+     */
+    bool addDictionary(const ParquetFdwReader &reader, int rowGroupId);
+
+    size_t getNumGroups() const
+    {
+        return numGroups;
+    }
+
+    /*
+     * Values of the group, in the order of outputs: indexes of aggregates
+     * or -1 - index of the group key
+     */
+    void getGroup(size_t group, const std::vector<int> &outputs, Datum *values, bool *nulls) const;
+
+    /* Drop all the groups */
+    void reset();
+};
@@ -0,0 +1,1130 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "VectorProjection.hpp"
+#include "Error.hpp"
+#include "Misc.hpp"
+
+extern "C" {
+#include "access/htup_details.h"
+#include "access/stratnum.h"
+#include "catalog/pg_language.h"
+#include "catalog/pg_proc.h"
+#include "catalog/pg_type.h"
+#include "nodes/nodeFuncs.h"
+#include "utils/builtins.h"
+#include "utils/date.h"
+#include "utils/datetime.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/numeric.h"
+#include "utils/pg_locale.h"
+#include "utils/syscache.h"
+#include "utils/timestamp.h"
+#include "utils/typcache.h"
+}
+
+/* Field name of datetime.h clashing with arrow::TimeUnit */
+#undef SECOND
+
+/* Strategy of the <> operator, which has none in btree opfamilies */
+#define NOT_EQUAL_STRATEGY (BTMaxStrategyNumber + 1)
+
+enum ErrorCode
+{
+    ERR_NONE,
+    ERR_INTEGER,
+    ERR_BIGINT,
+    ERR_DIVISION,
+    ERR_OVERFLOW,
+    ERR_UNDERFLOW,
+};
+
+/* The same messages as the ones of the postgres functions */
+static const char *const errorMessages[] = {
+    nullptr,
+    "integer out of range",
+    "bigint out of range",
+    "division by zero",
+    "value out of range: overflow",
+    "value out of range: underflow",
+};
+
+enum Kind
+{
+    KIND_NONE,
+    KIND_INT,
+    KIND_FLOAT,
+    KIND_TEXT,
+};
+
+/*
+ * value_kind
+ *      How the values of the type are kept in vectors, KIND_NONE if the type
+ *      is not supported.
+ */
+static Kind value_kind(Oid type)
+{
+    switch (type)
+    {
+    case BOOLOID:
+    case INT4OID:
+    case INT8OID:
+    case DATEOID:
+    case TIMESTAMPOID:
+        return KIND_INT;
+    case FLOAT4OID:
+    case FLOAT8OID:
+    case NUMERICOID:
+        return KIND_FLOAT;
+    case TEXTOID:
+        return KIND_TEXT;
+    default:
+        return KIND_NONE;
+    }
+}
+
+/*
+ * internal_function
+ *      Name of the C function implementing the postgres function, empty if
+ *      it is not an internal one. Unlike oids of overloaded functions, these
+ *      are the same in all versions of postgres.
+ */
+static std::string internal_function(Oid funcid)
+{
+    HeapTuple   tuple = SearchSysCache1(PROCOID, ObjectIdGetDatum(funcid));
+    std::string name;
+
+    if (!HeapTupleIsValid(tuple))
+        return name;
+
+    if (((Form_pg_proc)GETSTRUCT(tuple))->prolang == INTERNALlanguageId)
+    {
+        bool  isnull;
+        Datum prosrc = SysCacheGetAttr(PROCOID, tuple, Anum_pg_proc_prosrc, &isnull);
+
+        if (!isnull)
+            name = TextDatumGetCString(prosrc);
+    }
+    ReleaseSysCache(tuple);
+
+    return name;
+}
+
+/*
+ * comparable_types
+ *      Whether values of the types are compared as they are kept in vectors.
+ */
+static bool comparable_types(Oid type1, Oid type2)
+{
+    const auto isInt   = [](Oid type) { return type == INT4OID || type == INT8OID; };
+    const auto isFloat = [](Oid type) { return type == FLOAT4OID || type == FLOAT8OID; };
+
+    return type1 == type2 ? type1 != NUMERICOID
+                          : (isInt(type1) && isInt(type2)) || (isFloat(type1) && isFloat(type2));
+}
+
+/*
+ * compile
+ *      Build the node computing the expression, return false if it is not
+ *      supported. Vars must belong to the relation unless relid is 0.
+ */
+bool VectorProjection::compile(Expr *expr, ExprNode &node, bool isRoot, Index relid)
+{
+    if (!IsA(expr, Var) && !IsA(expr, Const) && !IsA(expr, RelabelType) && !IsA(expr, OpExpr)
+        && !IsA(expr, FuncExpr) && !IsA(expr, BoolExpr) && !IsA(expr, CaseExpr))
+        return false;
+
+    node.type = exprType((Node *)expr);
+
+    const Kind kind = value_kind(node.type);
+
+    /* Numerics are computed by extract() only and can't be operands */
+    if (kind == KIND_NONE || (node.type == NUMERICOID && !isRoot))
+        return false;
+
+    switch (nodeTag(expr))
+    {
+    case T_Var:
+    {
+        Var *var = (Var *)expr;
+
+        if (var->varattno <= 0 || var->varlevelsup != 0 || (relid != 0 && (Index)var->varno != relid)
+            || node.type == NUMERICOID)
+            return false;
+
+        node.op     = OP_COLUMN;
+        node.attIdx = var->varattno - 1;
+        return true;
+    }
+
+    case T_Const:
+    {
+        Const *value = (Const *)expr;
+
+        if (node.type == NUMERICOID)
+            return false;
+
+        node.op     = OP_CONST;
+        node.isnull = value->constisnull;
+        if (node.isnull)
+            return true;
+
+        switch (node.type)
+        {
+        case BOOLOID:
+            node.ivalue = DatumGetBool(value->constvalue);
+            break;
+        case INT4OID:
+            node.ivalue = DatumGetInt32(value->constvalue);
+            break;
+        case INT8OID:
+            node.ivalue = DatumGetInt64(value->constvalue);
+            break;
+        case DATEOID:
+            node.ivalue = DatumGetDateADT(value->constvalue);
+            break;
+        case TIMESTAMPOID:
+            node.ivalue = DatumGetTimestamp(value->constvalue);
+            break;
+        case FLOAT4OID:
+            node.fvalue = DatumGetFloat4(value->constvalue);
+            break;
+        case FLOAT8OID:
+            node.fvalue = DatumGetFloat8(value->constvalue);
+            break;
+        case TEXTOID:
+        {
+            text *t = DatumGetTextPP(value->constvalue);
+
+            node.svalue.assign(VARDATA_ANY(t), VARSIZE_ANY_EXHDR(t));
+            break;
+        }
+        }
+        return true;
+    }
+
+    /* Changes of the collation only */
+    case T_RelabelType:
+    {
+        RelabelType *relabel = (RelabelType *)expr;
+
+        if (exprType((Node *)relabel->arg) != relabel->resulttype)
+            return false;
+        return compile(relabel->arg, node, isRoot, relid);
+    }
+
+    case T_OpExpr:
+    case T_FuncExpr:
+    {
+        Oid   funcid;
+        Oid   opno = InvalidOid;
+        Oid   inputcollid;
+        List *args;
+
+        if (IsA(expr, OpExpr))
+        {
+            OpExpr *op = (OpExpr *)expr;
+
+            opno        = op->opno;
+            funcid      = OidIsValid(op->opfuncid) ? op->opfuncid : get_opcode(op->opno);
+            inputcollid = op->inputcollid;
+            args        = op->args;
+            if (op->opretset)
+                return false;
+        }
+        else
+        {
+            FuncExpr *func = (FuncExpr *)expr;
+
+            funcid      = func->funcid;
+            inputcollid = func->inputcollid;
+            args        = func->args;
+            if (func->funcretset)
+                return false;
+        }
+
+        /* Comparisons of two values of the same kind */
+        if (OidIsValid(opno) && node.type == BOOLOID && list_length(args) == 2)
+        {
+            const Oid       type1 = exprType((Node *)linitial(args));
+            const Oid       type2 = exprType((Node *)lsecond(args));
+            TypeCacheEntry *typentry;
+            int             strategy = 0;
+
+            if (!comparable_types(type1, type2))
+                return false;
+
+            typentry = lookup_type_cache(type1, TYPECACHE_BTREE_OPFAMILY);
+            if (!OidIsValid(typentry->btree_opf))
+                return false;
+
+            strategy = get_op_opfamily_strategy(opno, typentry->btree_opf);
+            if (strategy == 0)
+            {
+                const Oid negator = get_negator(opno);
+
+                if (!OidIsValid(negator)
+                    || get_op_opfamily_strategy(negator, typentry->btree_opf) != BTEqualStrategyNumber)
+                    return false;
+                strategy = NOT_EQUAL_STRATEGY;
+            }
+
+            /* Text is compared bytewise */
+            if (type1 == TEXTOID)
+            {
+                if (!OidIsValid(inputcollid))
+                    return false;
+                if (strategy == BTEqualStrategyNumber || strategy == NOT_EQUAL_STRATEGY)
+                {
+#if PG_VERSION_NUM >= 120000
+                    if (!get_collation_isdeterministic(inputcollid))
+                        return false;
+#endif
+                }
+                else if (!lc_collate_is_c(inputcollid))
+                    return false;
+            }
+
+            node.op       = OP_CMP;
+            node.strategy = strategy;
+            node.args.resize(2);
+            return compile((Expr *)linitial(args), node.args[0], false, relid)
+                   && compile((Expr *)lsecond(args), node.args[1], false, relid);
+        }
+
+        const std::string name = internal_function(funcid);
+
+        static const struct
+        {
+            const char *name;
+            Op          op;
+        } functions[] = {
+            {"int4pl", OP_ADD},   {"int8pl", OP_ADD},    {"int48pl", OP_ADD},  {"int84pl", OP_ADD},
+            {"float4pl", OP_ADD}, {"float8pl", OP_ADD},  {"int4mi", OP_SUB},   {"int8mi", OP_SUB},
+            {"int48mi", OP_SUB},  {"int84mi", OP_SUB},   {"float4mi", OP_SUB}, {"float8mi", OP_SUB},
+            {"int4mul", OP_MUL},  {"int8mul", OP_MUL},   {"int48mul", OP_MUL}, {"int84mul", OP_MUL},
+            {"float4mul", OP_MUL}, {"float8mul", OP_MUL}, {"int4div", OP_DIV},  {"int8div", OP_DIV},
+            {"int48div", OP_DIV}, {"int84div", OP_DIV},  {"float4div", OP_DIV}, {"float8div", OP_DIV},
+            {"int4um", OP_NEG},   {"int8um", OP_NEG},    {"float4um", OP_NEG}, {"float8um", OP_NEG},
+            {"int48", OP_CAST},   {"int84", OP_CAST},    {"i4tod", OP_CAST},   {"i8tod", OP_CAST},
+            {"i4tof", OP_CAST},   {"ftod", OP_CAST},     {"dtof", OP_CAST},    {"lower", OP_LOWER},
+            {"upper", OP_UPPER},  {"timestamp_part", OP_EXTRACT}, {"extract_timestamp", OP_EXTRACT},
+        };
+        bool found = false;
+
+        for (const auto &function : functions)
+        {
+            if (name == function.name)
+            {
+                node.op = function.op;
+                found   = true;
+                break;
+            }
+        }
+        if (!found)
+            return false;
+
+        if (node.op == OP_LOWER || node.op == OP_UPPER)
+        {
+            if (!OidIsValid(inputcollid) || !lc_ctype_is_c(inputcollid))
+                return false;
+        }
+        else if (node.op == OP_EXTRACT)
+        {
+            static const struct
+            {
+                const char *name;
+                Field       field;
+            } fields[] = {
+                {"year", FIELD_YEAR}, {"month", FIELD_MONTH},   {"day", FIELD_DAY}, {"hour", FIELD_HOUR},
+                {"minute", FIELD_MINUTE}, {"dow", FIELD_DOW}, {"doy", FIELD_DOY},
+            };
+            Const *     unit = (Const *)linitial(args);
+            std::string fieldName;
+
+            if (list_length(args) != 2 || !IsA(unit, Const) || unit->constisnull
+                || exprType((Node *)lsecond(args)) != TIMESTAMPOID)
+                return false;
+
+            fieldName = TextDatumGetCString(unit->constvalue);
+            for (auto &c : fieldName)
+                c = pg_ascii_tolower(c);
+
+            found = false;
+            for (const auto &field : fields)
+            {
+                if (fieldName == field.name)
+                {
+                    node.field = field.field;
+                    found      = true;
+                    break;
+                }
+            }
+            if (!found)
+                return false;
+
+            node.args.resize(1);
+            return compile((Expr *)lsecond(args), node.args[0], false, relid);
+        }
+
+        node.args.resize(list_length(args));
+        for (int i = 0; i < list_length(args); ++i)
+        {
+            Expr *arg = (Expr *)list_nth(args, i);
+
+            if (value_kind(exprType((Node *)arg)) == KIND_TEXT && node.op != OP_LOWER && node.op != OP_UPPER)
+                return false;
+            if (!compile(arg, node.args[i], false, relid))
+                return false;
+        }
+        return true;
+    }
+
+    case T_BoolExpr:
+    {
+        BoolExpr *boolexpr = (BoolExpr *)expr;
+        ListCell *lc;
+
+        switch (boolexpr->boolop)
+        {
+        case AND_EXPR:
+            node.op = OP_AND;
+            break;
+        case OR_EXPR:
+            node.op = OP_OR;
+            break;
+        case NOT_EXPR:
+            node.op = OP_NOT;
+            break;
+        default:
+            return false;
+        }
+
+        foreach (lc, boolexpr->args)
+        {
+            node.args.emplace_back();
+            if (!compile((Expr *)lfirst(lc), node.args.back(), false, relid))
+                return false;
+        }
+        return true;
+    }
+
+    /* Only CASE WHEN, not CASE expr WHEN */
+    case T_CaseExpr:
+    {
+        CaseExpr *caseexpr = (CaseExpr *)expr;
+        ListCell *lc;
+
+        if (caseexpr->arg != nullptr || node.type == NUMERICOID)
+            return false;
+
+        node.op = OP_CASE;
+        foreach (lc, caseexpr->args)
+        {
+            CaseWhen *when = (CaseWhen *)lfirst(lc);
+
+            node.args.emplace_back();
+            if (!compile(when->expr, node.args.back(), false, relid))
+                return false;
+            node.args.emplace_back();
+            if (!compile(when->result, node.args.back(), false, relid))
+                return false;
+        }
+        node.args.emplace_back();
+        return caseexpr->defresult != nullptr && compile(caseexpr->defresult, node.args.back(), false, relid);
+    }
+
+    default:
+        return false;
+    }
+}
+
+/*
+ * has_partition_column
+ *      Whether the node reads any of the partition columns, whose values are
+ *      not kept in arrays.
+ */
+static bool has_partition_column(const std::vector<bool> &partitionAttrs, int attIdx)
+{
+    return !partitionAttrs.empty() && partitionAttrs[attIdx];
+}
+
+bool VectorProjection::supported(Expr *expr, Index relid, const std::vector<bool> &partitionAttrs)
+{
+    ExprNode node;
+
+    if (!compile(expr, node, true, relid))
+        return false;
+
+    /* A constant expression is better left to the planner */
+    std::vector<const ExprNode *> stack = {&node};
+    bool                      hasColumns = false;
+
+    while (!stack.empty())
+    {
+        const ExprNode *n = stack.back();
+
+        stack.pop_back();
+        if (n->op == OP_COLUMN)
+        {
+            if (has_partition_column(partitionAttrs, n->attIdx))
+                return false;
+            hasColumns = true;
+        }
+        for (const auto &arg : n->args)
+            stack.push_back(&arg);
+    }
+
+    return hasColumns;
+}
+
+VectorProjection::VectorProjection(MemoryContext               rowCxt,
+                                   const std::vector<Expr *> &exprs,
+                                   const std::vector<int> &   outputAttrs)
+    : rowCxt(rowCxt), outputAttrs(outputAttrs)
+{
+    nodes.resize(exprs.size());
+    for (size_t i = 0; i < exprs.size(); ++i)
+    {
+        if (!compile(exprs[i], nodes[i], true, 0))
+            throw Error("unsupported expression of the scan target list");
+    }
+}
+
+void VectorProjection::initVector(Vector &out, Oid type) const
+{
+    out.nulls.assign(numRows, 0);
+    out.errors.assign(numRows, ERR_NONE);
+
+    switch (value_kind(type))
+    {
+    case KIND_INT:
+        out.ints.resize(numRows);
+        break;
+    case KIND_FLOAT:
+        out.floats.resize(numRows);
+        break;
+    case KIND_TEXT:
+        out.texts.resize(numRows);
+        break;
+    default:
+        throw Error("unsupported type %u of a computed expression", type);
+    }
+}
+
+/*
+ * strictRow
+ *      Take an error or NULL of the arguments, evaluated in this order, for
+ *      the row. Returns true if the result is to be computed.
+ */
+bool VectorProjection::strictRow(Vector &out, size_t row, const Vector &arg1, const Vector *arg2)
+{
+    if (arg1.errors[row] != ERR_NONE || (arg2 && arg2->errors[row] != ERR_NONE))
+    {
+        out.errors[row] = arg1.errors[row] != ERR_NONE ? arg1.errors[row] : arg2->errors[row];
+        return false;
+    }
+    if (arg1.nulls[row] || (arg2 && arg2->nulls[row]))
+    {
+        out.nulls[row] = 1;
+        return false;
+    }
+    return true;
+}
+
+void VectorProjection::copyValue(const Vector &from, Vector &to, size_t row)
+{
+    to.errors[row] = from.errors[row];
+    to.nulls[row]  = from.nulls[row];
+    if (!from.ints.empty())
+        to.ints[row] = from.ints[row];
+    else if (!from.floats.empty())
+        to.floats[row] = from.floats[row];
+    else if (!from.texts.empty())
+        to.texts[row] = from.texts[row];
+}
+
+/*
+ * to_postgres_date
+ *      Parquet dates count days since 1970-01-01, postgres ones since
+ *      2000-01-01.
+ */
+static inline int32_t to_postgres_date(int32_t days)
+{
+    return days + (UNIX_EPOCH_JDATE - POSTGRES_EPOCH_JDATE);
+}
+
+void VectorProjection::readColumn(const ExprNode &node, const ParquetFdwReader &reader, Vector &out) const
+{
+    const arrow::Array *array = reader.getColumnArray(node.attIdx);
+
+    if (!array)
+        throw Error("column %d of a computed expression is not read", node.attIdx + 1);
+
+    if (array->null_count() > 0)
+    {
+        for (size_t i = 0; i < numRows; ++i)
+            out.nulls[i] = array->IsNull(i);
+    }
+
+    switch (array->type_id())
+    {
+    case arrow::Type::BOOL:
+        for (size_t i = 0; i < numRows; ++i)
+            out.ints[i] = ((const arrow::BooleanArray *)array)->Value(i);
+        return;
+    case arrow::Type::INT32:
+    {
+        const int32_t *values = array->data()->GetValues<int32_t>(1);
+
+        std::copy(values, values + numRows, out.ints.begin());
+        return;
+    }
+    case arrow::Type::INT64:
+    {
+        const int64_t *values = array->data()->GetValues<int64_t>(1);
+
+        std::copy(values, values + numRows, out.ints.begin());
+        return;
+    }
+    case arrow::Type::DATE32:
+    {
+        const int32_t *values = array->data()->GetValues<int32_t>(1);
+
+        for (size_t i = 0; i < numRows; ++i)
+            out.ints[i] = to_postgres_date(values[i]);
+        return;
+    }
+    case arrow::Type::TIMESTAMP:
+    {
+        const auto     tstype = (arrow::TimestampType *)array->type().get();
+        const int64_t *values = array->data()->GetValues<int64_t>(1);
+
+        for (size_t i = 0; i < numRows; ++i)
+        {
+            TimestampTz ts;
+
+            to_postgres_timestamp(tstype, values[i], ts);
+            out.ints[i] = ts;
+        }
+        return;
+    }
+    case arrow::Type::FLOAT:
+    {
+        const float *values = array->data()->GetValues<float>(1);
+
+        std::copy(values, values + numRows, out.floats.begin());
+        return;
+    }
+    case arrow::Type::DOUBLE:
+    {
+        const double *values = array->data()->GetValues<double>(1);
+
+        /* The column is declared as float4, compute in its precision */
+        if (node.type == FLOAT4OID)
+            for (size_t i = 0; i < numRows; ++i)
+                out.floats[i] = (float)values[i];
+        else
+            std::copy(values, values + numRows, out.floats.begin());
+        return;
+    }
+    case arrow::Type::STRING:
+    case arrow::Type::BINARY:
+        for (size_t i = 0; i < numRows; ++i)
+        {
+            int32_t     len   = 0;
+            const char *value = (const char *)((const arrow::BinaryArray *)array)->GetValue(i, &len);
+
+            out.texts[i] = std::string_view(value, len);
+        }
+        return;
+    default:
+        throw Error("unsupported type %d of column %d of a computed expression", array->type_id(),
+                    node.attIdx + 1);
+    }
+}
+
+/* Integer arithmetic in 64 bits, results of int4 operators are checked after */
+static uint8_t int_operator(VectorProjection::Op op, bool isInt4, int64_t a, int64_t b, int64_t &result)
+{
+    bool overflow = false;
+
+    switch (op)
+    {
+    case VectorProjection::OP_ADD:
+        overflow = __builtin_add_overflow(a, b, &result);
+        break;
+    case VectorProjection::OP_SUB:
+        overflow = __builtin_sub_overflow(a, b, &result);
+        break;
+    case VectorProjection::OP_MUL:
+        overflow = __builtin_mul_overflow(a, b, &result);
+        break;
+    case VectorProjection::OP_DIV:
+        if (b == 0)
+            return ERR_DIVISION;
+        if (b == -1)
+            overflow = __builtin_sub_overflow((int64_t)0, a, &result);
+        else
+            result = a / b;
+        break;
+    default:
+        break;
+    }
+
+    if (overflow)
+        return ERR_BIGINT;
+    if (isInt4 && (result < PG_INT32_MIN || result > PG_INT32_MAX))
+        return ERR_INTEGER;
+    return ERR_NONE;
+}
+
+/*
+ * Float arithmetic in double precision with the checks of float8pl and the
+ * like. Results of float4 operators are rounded to single precision, which
+ * gives the same values as computing them in single precision.
+ */
+static uint8_t float_operator(VectorProjection::Op op, bool isFloat4, double a, double b, double &result)
+{
+    switch (op)
+    {
+    case VectorProjection::OP_ADD:
+        result = a + b;
+        break;
+    case VectorProjection::OP_SUB:
+        result = a - b;
+        break;
+    case VectorProjection::OP_MUL:
+        result = a * b;
+        break;
+    case VectorProjection::OP_DIV:
+        if (b == 0.0 && !std::isnan(a))
+            return ERR_DIVISION;
+        result = a / b;
+        break;
+    default:
+        break;
+    }
+
+    if (isFloat4)
+        result = (float)result;
+
+    if (std::isinf(result) && !std::isinf(a) && (op == VectorProjection::OP_DIV || !std::isinf(b)))
+        return ERR_OVERFLOW;
+    if (result == 0.0 && a != 0.0
+        && ((op == VectorProjection::OP_MUL && b != 0.0) || (op == VectorProjection::OP_DIV && !std::isinf(b))))
+        return ERR_UNDERFLOW;
+    return ERR_NONE;
+}
+
+/* Comparison of floats of postgres, NaN is equal to itself and greater than anything else */
+static inline int float_compare(double a, double b)
+{
+    if (std::isnan(a))
+        return std::isnan(b) ? 0 : 1;
+    if (std::isnan(b))
+        return -1;
+    return (a > b) - (a < b);
+}
+
+/* Bytewise comparison of strings as in the C collation */
+static inline int text_compare(std::string_view a, std::string_view b)
+{
+    const int res = memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+
+    if (res != 0)
+        return res;
+    return (a.size() > b.size()) - (a.size() < b.size());
+}
+
+/*
+ * extract_field
+ *      Field of a timestamp as extract() computes it. Infinite timestamps
+ *      only have infinite years.
+ */
+static bool extract_field(int field, Timestamp ts, double &result)
+{
+    int64_t days, time;
+    int     year, month, day;
+
+    if (TIMESTAMP_NOT_FINITE(ts))
+    {
+        if (field != VectorProjection::FIELD_YEAR)
+            return false;
+        result = TIMESTAMP_IS_NOBEGIN(ts) ? -INFINITY : INFINITY;
+        return true;
+    }
+
+    days = ts / USECS_PER_DAY;
+    time = ts % USECS_PER_DAY;
+    if (time < 0)
+    {
+        time += USECS_PER_DAY;
+        days--;
+    }
+    days += POSTGRES_EPOCH_JDATE;
+
+    switch (field)
+    {
+    case VectorProjection::FIELD_HOUR:
+        result = time / USECS_PER_HOUR;
+        return true;
+    case VectorProjection::FIELD_MINUTE:
+        result = (time / USECS_PER_MINUTE) % MINS_PER_HOUR;
+        return true;
+    case VectorProjection::FIELD_DOW:
+        result = j2day(days);
+        return true;
+    default:
+        break;
+    }
+
+    j2date(days, &year, &month, &day);
+
+    switch (field)
+    {
+    case VectorProjection::FIELD_YEAR:
+        /* There is no year 0, 1 BC comes before 1 AD */
+        result = year > 0 ? year : year - 1;
+        break;
+    case VectorProjection::FIELD_MONTH:
+        result = month;
+        break;
+    case VectorProjection::FIELD_DAY:
+        result = day;
+        break;
+    case VectorProjection::FIELD_DOY:
+        result = days - date2j(year, 1, 1) + 1;
+        break;
+    }
+    return true;
+}
+
+void VectorProjection::evaluate(const ExprNode &node, const ParquetFdwReader &reader, Vector &out)
+{
+    std::vector<Vector> args(node.args.size());
+
+    initVector(out, node.type);
+
+    if (node.op == OP_COLUMN)
+    {
+        readColumn(node, reader, out);
+        return;
+    }
+
+    if (node.op == OP_CONST)
+    {
+        if (node.isnull)
+            std::fill(out.nulls.begin(), out.nulls.end(), 1);
+        else if (!out.ints.empty())
+            std::fill(out.ints.begin(), out.ints.end(), node.ivalue);
+        else if (!out.floats.empty())
+            std::fill(out.floats.begin(), out.floats.end(), node.fvalue);
+        else
+            std::fill(out.texts.begin(), out.texts.end(), std::string_view(node.svalue));
+        return;
+    }
+
+    for (size_t i = 0; i < node.args.size(); ++i)
+        evaluate(node.args[i], reader, args[i]);
+
+    switch (node.op)
+    {
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+        for (size_t i = 0; i < numRows; ++i)
+        {
+            if (!strictRow(out, i, args[0], &args[1]))
+                continue;
+
+            if (value_kind(node.type) == KIND_FLOAT)
+                out.errors[i] = float_operator(node.op, node.type == FLOAT4OID, args[0].floats[i],
+                                               args[1].floats[i], out.floats[i]);
+            else
+                out.errors[i] = int_operator(node.op, node.type == INT4OID, args[0].ints[i],
+                                             args[1].ints[i], out.ints[i]);
+        }
+        break;
+
+    case OP_NEG:
+        for (size_t i = 0; i < numRows; ++i)
+        {
+            if (!strictRow(out, i, args[0]))
+                continue;
+
+            if (value_kind(node.type) == KIND_FLOAT)
+                out.floats[i] = -args[0].floats[i];
+            else if ((node.type == INT4OID && args[0].ints[i] == PG_INT32_MIN)
+                     || args[0].ints[i] == PG_INT64_MIN)
+                out.errors[i] = node.type == INT4OID ? ERR_INTEGER : ERR_BIGINT;
+            else
+                out.ints[i] = -args[0].ints[i];
+        }
+        break;
+
+    case OP_CAST:
+        for (size_t i = 0; i < numRows; ++i)
+        {
+            if (!strictRow(out, i, args[0]))
+                continue;
+
+            if (value_kind(node.type) == KIND_INT)
+            {
+                out.ints[i] = args[0].ints[i];
+                if (node.type == INT4OID && (out.ints[i] < PG_INT32_MIN || out.ints[i] > PG_INT32_MAX))
+                    out.errors[i] = ERR_INTEGER;
+                continue;
+            }
+
+            const double value = args[0].ints.empty() ? args[0].floats[i] : (double)args[0].ints[i];
+
+            out.floats[i] = node.type == FLOAT4OID ? (float)value : value;
+
+            /* dtof */
+            if (node.type == FLOAT4OID && !args[0].floats.empty())
+            {
+                if (std::isinf(out.floats[i]) && !std::isinf(value))
+                    out.errors[i] = ERR_OVERFLOW;
+                else if (out.floats[i] == 0.0 && value != 0.0)
+                    out.errors[i] = ERR_UNDERFLOW;
+            }
+        }
+        break;
+
+    case OP_LOWER:
+    case OP_UPPER:
+    {
+        size_t size = 0;
+
+        for (size_t i = 0; i < numRows; ++i)
+        {
+            if (strictRow(out, i, args[0]))
+                size += args[0].texts[i].size();
+        }
+
+        strings.emplace_back(size);
+
+        char *buf = strings.back().data();
+
+        for (size_t i = 0; i < numRows; ++i)
+        {
+            const auto &value = args[0].texts[i];
+
+            if (out.nulls[i] || out.errors[i] != ERR_NONE)
+                continue;
+
+            for (size_t c = 0; c < value.size(); ++c)
+                buf[c] = node.op == OP_LOWER ? pg_ascii_tolower(value[c]) : pg_ascii_toupper(value[c]);
+            out.texts[i] = std::string_view(buf, value.size());
+            buf += value.size();
+        }
+        break;
+    }
+
+    case OP_EXTRACT:
+        for (size_t i = 0; i < numRows; ++i)
+        {
+            if (strictRow(out, i, args[0]) && !extract_field(node.field, args[0].ints[i], out.floats[i]))
+                out.nulls[i] = 1;
+        }
+        break;
+
+    case OP_CMP:
+    {
+        const Kind kind = value_kind(node.args[0].type);
+
+        for (size_t i = 0; i < numRows; ++i)
+        {
+            int cmp;
+
+            if (!strictRow(out, i, args[0], &args[1]))
+                continue;
+
+            if (kind == KIND_INT)
+                cmp = (args[0].ints[i] > args[1].ints[i]) - (args[0].ints[i] < args[1].ints[i]);
+            else if (kind == KIND_FLOAT)
+                cmp = float_compare(args[0].floats[i], args[1].floats[i]);
+            else
+                cmp = text_compare(args[0].texts[i], args[1].texts[i]);
+
+            switch (node.strategy)
+            {
+            case BTLessStrategyNumber:
+                out.ints[i] = cmp < 0;
+                break;
+            case BTLessEqualStrategyNumber:
+                out.ints[i] = cmp <= 0;
+                break;
+            case BTEqualStrategyNumber:
+                out.ints[i] = cmp == 0;
+                break;
+            case BTGreaterEqualStrategyNumber:
+                out.ints[i] = cmp >= 0;
+                break;
+            case BTGreaterStrategyNumber:
+                out.ints[i] = cmp > 0;
+                break;
+            case NOT_EQUAL_STRATEGY:
+                out.ints[i] = cmp != 0;
+                break;
+            }
+        }
+        break;
+    }
+
+    /*
+     * Arguments are taken in order until one of them decides the result,
+     * errors of the rest are ignored as postgres doesn't evaluate them
+     */
+    case OP_AND:
+    case OP_OR:
+    {
+        const int64_t decisive = node.op == OP_OR;
+
+        for (size_t i = 0; i < numRows; ++i)
+        {
+            bool hasNull = false;
+            bool decided = false;
+
+            for (const auto &arg : args)
+            {
+                if (arg.errors[i] != ERR_NONE)
+                    out.errors[i] = arg.errors[i];
+                else if (arg.nulls[i])
+                {
+                    hasNull = true;
+                    continue;
+                }
+                else if (arg.ints[i] != decisive)
+                    continue;
+
+                out.ints[i] = decisive;
+                decided     = true;
+                break;
+            }
+
+            if (!decided)
+            {
+                out.ints[i] = !decisive;
+                out.nulls[i] = hasNull;
+            }
+        }
+        break;
+    }
+
+    case OP_NOT:
+        for (size_t i = 0; i < numRows; ++i)
+        {
+            if (strictRow(out, i, args[0]))
+                out.ints[i] = !args[0].ints[i];
+        }
+        break;
+
+    /* Values of the first branch whose condition is true, or of the default */
+    case OP_CASE:
+        for (size_t i = 0; i < numRows; ++i)
+        {
+            size_t branch = 0;
+
+            for (; branch + 1 < args.size(); branch += 2)
+            {
+                const Vector &cond = args[branch];
+
+                if (cond.errors[i] != ERR_NONE || (!cond.nulls[i] && cond.ints[i]))
+                    break;
+            }
+
+            if (branch + 1 < args.size() && args[branch].errors[i] != ERR_NONE)
+                out.errors[i] = args[branch].errors[i];
+            else
+                copyValue(args[branch + 1 < args.size() ? branch + 1 : branch], out, i);
+        }
+        break;
+
+    default:
+        throw Error("unexpected operation %d of a computed expression", node.op);
+    }
+}
+
+void VectorProjection::addRowGroup(const ParquetFdwReader &reader)
+{
+    strings.clear();
+    numRows = reader.getBufferedNumRows();
+    values.resize(nodes.size());
+
+    for (size_t i = 0; i < nodes.size(); ++i)
+        evaluate(nodes[i], reader, values[i]);
+}
+
+Datum VectorProjection::toDatum(Oid type, const Vector &vector, size_t row) const
+{
+    switch (type)
+    {
+    case BOOLOID:
+        return BoolGetDatum(vector.ints[row] != 0);
+    case INT4OID:
+        return Int32GetDatum((int32)vector.ints[row]);
+    case INT8OID:
+        return Int64GetDatum(vector.ints[row]);
+    case DATEOID:
+        return DateADTGetDatum((DateADT)vector.ints[row]);
+    case TIMESTAMPOID:
+        return TimestampGetDatum(vector.ints[row]);
+    case FLOAT4OID:
+        return Float4GetDatum((float4)vector.floats[row]);
+    case FLOAT8OID:
+        return Float8GetDatum(vector.floats[row]);
+#if PG_VERSION_NUM >= 140000
+    /* extract() returns whole numbers or infinities */
+    case NUMERICOID:
+        if (std::isinf(vector.floats[row]))
+            return DirectFunctionCall1(float8_numeric, Float8GetDatum(vector.floats[row]));
+        return NumericGetDatum(int64_to_numeric((int64)vector.floats[row]));
+#endif
+    case TEXTOID:
+    {
+        const auto &value = vector.texts[row];
+        text *      t     = (text *)exc_palloc(value.size() + VARHDRSZ);
+
+        SET_VARSIZE(t, value.size() + VARHDRSZ);
+        memcpy(VARDATA(t), value.data(), value.size());
+        return PointerGetDatum(t);
+    }
+    default:
+        throw Error("unsupported type %u of a computed expression", type);
+    }
+}
+
+void VectorProjection::fillRow(uint32_t row, TupleTableSlot *slot)
+{
+    MemoryContext oldcxt;
+
+    MemoryContextReset(rowCxt);
+    oldcxt = MemoryContextSwitchTo(rowCxt);
+
+    try
+    {
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            const Vector &vector = values[i];
+            const int     attr   = outputAttrs[i];
+
+            if (vector.errors[row] != ERR_NONE)
+                throw Error("%s", errorMessages[vector.errors[row]]);
+
+            slot->tts_isnull[attr] = vector.nulls[row];
+            slot->tts_values[attr] = vector.nulls[row] ? (Datum)0 : toDatum(nodes[i].type, vector, row);
+        }
+    }
+    catch (...)
+    {
+        MemoryContextSwitchTo(oldcxt);
+        throw;
+    }
+
+    MemoryContextSwitchTo(oldcxt);
+}
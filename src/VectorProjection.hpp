@@ -0,0 +1,127 @@
+#pragma once
+
+#if __cplusplus > 199711L
+#    define register // Deprecated in C++11.
+#endif               // #if __cplusplus > 199711L
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ParquetFdwReader.hpp"
+
+extern "C" {
+#include "postgres.h"
+#include "executor/tuptable.h"
+#include "nodes/primnodes.h"
+#include "utils/palloc.h"
+}
+
+/*
+ * VectorProjection
+ *      Expressions of the target list computed over the Arrow arrays of
+ *      whole row groups instead of row by row. Only a few immutable
+ *      operators and functions are supported: arithmetic of integers and
+ *      floats and casts between them, lower() and upper() of text in the C
+ *      collation, date_part() and extract() of some fields of timestamps,
+ *      comparisons, boolean operators and CASE WHEN.
+ *
+ * The values are converted into Datums only for the rows returned by the
+ * scan. Errors like overflows are kept per row and raised when the row is
+ * returned, so that rows filtered out by the conditions or branches of CASE
+ * not taken don't fail as they wouldn't in postgres.
+ */
+class VectorProjection
+{
+public:
+    enum Op
+    {
+        OP_COLUMN,
+        OP_CONST,
+        OP_ADD,
+        OP_SUB,
+        OP_MUL,
+        OP_DIV,
+        OP_NEG,
+        OP_CAST,
+        OP_LOWER,
+        OP_UPPER,
+        OP_EXTRACT,
+        OP_CMP,
+        OP_AND,
+        OP_OR,
+        OP_NOT,
+        OP_CASE,
+    };
+
+    enum Field
+    {
+        FIELD_YEAR,
+        FIELD_MONTH,
+        FIELD_DAY,
+        FIELD_HOUR,
+        FIELD_MINUTE,
+        FIELD_DOW,
+        FIELD_DOY,
+    };
+
+private:
+    struct ExprNode
+    {
+        Op                    op;
+        Oid                   type;          /* result type */
+        int                   attIdx   = -1; /* OP_COLUMN */
+        int64_t               ivalue   = 0;  /* OP_CONST */
+        double                fvalue   = 0;
+        std::string           svalue;
+        bool                  isnull   = false;
+        int                   field    = 0;  /* OP_EXTRACT */
+        int                   strategy = 0;  /* OP_CMP, btree strategy or 0 for <> */
+        std::vector<ExprNode> args;          /* OP_CASE: conditions and results, then the default */
+    };
+
+    /*
+     * Values of a node for the rows of the row group. Integers, dates,
+     * timestamps and booleans are kept as ints, floats and numerics as
+     * floats, errors are indexes into the messages or 0.
+     */
+    struct Vector
+    {
+        std::vector<int64_t>          ints;
+        std::vector<double>           floats;
+        std::vector<std::string_view> texts;
+        std::vector<uint8_t>          nulls;
+        std::vector<uint8_t>          errors;
+    };
+
+    MemoryContext         rowCxt; /* for the Datums of the current row */
+    std::vector<ExprNode> nodes;
+    std::vector<int>      outputAttrs;
+
+    /* Values of the expressions and the strings computed for the row group */
+    std::vector<Vector>           values;
+    std::deque<std::vector<char>> strings;
+    size_t                        numRows = 0;
+
+    static bool compile(Expr *expr, ExprNode &node, bool isRoot, Index relid);
+    static bool strictRow(Vector &out, size_t row, const Vector &arg1, const Vector *arg2 = nullptr);
+    static void copyValue(const Vector &from, Vector &to, size_t row);
+
+    void  initVector(Vector &out, Oid type) const;
+    void  readColumn(const ExprNode &node, const ParquetFdwReader &reader, Vector &out) const;
+    void  evaluate(const ExprNode &node, const ParquetFdwReader &reader, Vector &out);
+    Datum toDatum(Oid type, const Vector &vector, size_t row) const;
+
+public:
+    /* Whether the scan of the relation can compute the expression */
+    static bool supported(Expr *expr, Index relid, const std::vector<bool> &partitionAttrs);
+
+    VectorProjection(MemoryContext cxt, const std::vector<Expr *> &exprs, const std::vector<int> &outputAttrs);
+
+    /* Compute the expressions over the row group buffered by the reader */
+    void addRowGroup(const ParquetFdwReader &reader);
+
+    /* Put the values of the row of the row group into the output attributes */
+    void fillRow(uint32_t row, TupleTableSlot *slot);
+};